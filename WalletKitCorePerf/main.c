@@ -10,11 +10,13 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include "support/BROSCompat.h"
 #include "support/BRBIP39WordsEn.h"
 #include "ethereum/blockchain/BREthereumAccount.h"
 #include "test.h"  // runSyncTest
+#include "perf.h"
 
 #if defined (NEVER_EWM)
 extern BREthereumClient
@@ -82,14 +84,64 @@ runSyncMany (BREthereumNetwork newtork,
 }
 #endif
 
+static void runFileServiceSuite (const char *path)   { runFileServicePerfTests (path, 10000); }
+static void runBitcoinWalletSuite (const char *path) { runBitcoinWalletPerfTests (100000); }
+static void runBitcoinSignSuite (const char *path)   { runBitcoinTransactionSignPerfTests (0); }
+static void runWalletKitSuite (const char *path)     { runWalletKitTransferPerfTests (100000); }
+static void runKeccakSuite (const char *path)        { runKeccakPerfTests (100000); }
+
+// The perf suites, run by name from the command line
+static struct {
+    const char *name;
+    void (*run) (const char *path);
+} perfSuites[] = {
+    { "fileService",   runFileServiceSuite },
+    { "bitcoinWallet", runBitcoinWalletSuite },
+    { "bitcoinSign",   runBitcoinSignSuite },
+    { "walletKit",     runWalletKitSuite },
+    { "keccak",        runKeccakSuite }
+};
+
+#define PERF_SUITES_COUNT   (sizeof (perfSuites) / sizeof (perfSuites[0]))
+
+static void
+perfUsage (const char *program) {
+    printf ("usage: %s all | <suite> ...\nsuites:", program);
+    for (size_t index = 0; index < PERF_SUITES_COUNT; index++)
+        printf (" %s", perfSuites[index].name);
+    printf ("\n");
+}
+
 int main(int argc, const char * argv[]) {
     WKSyncMode mode = WK_SYNC_MODE_API_WITH_P2P_SEND;
 
-    const char *paperKey = (argc > 1 ? argv[1] : "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7ef");
+    const char *paperKey = "0xa9de3dbd7d561e67527bc1ecb025c59d53b9f7ef";
     BREthereumAccount account = ethAccountCreate (paperKey);
     BREthereumTimestamp timestamp = 1539330275; // ETHEREUM_TIMESTAMP_UNKNOWN;
     const char *path = "core";
 
+    if (argc < 2) {
+        perfUsage (argv[0]);
+        return 1;
+    }
+
+    for (int arg = 1; arg < argc; arg++) {
+        int all   = (0 == strcmp (argv[arg], "all"));
+        int found = all;
+
+        for (size_t index = 0; index < PERF_SUITES_COUNT; index++)
+            if (all || 0 == strcmp (argv[arg], perfSuites[index].name)) {
+                perfSuites[index].run (path);
+                found = 1;
+            }
+
+        if (!found) {
+            fprintf (stderr, "unknown suite: %s\n", argv[arg]);
+            perfUsage (argv[0]);
+            return 1;
+        }
+    }
+
 #if defined (NEVER_EWM)
     runSyncTest (ethNetworkMainnet,  account, mode, timestamp,  5 * 60, path);
 //    runSyncMany(ethereumMainnet, mode, 10 * 60, 1000);
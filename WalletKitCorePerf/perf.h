@@ -0,0 +1,55 @@
+//
+//  perf.h
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#ifndef BR_Perf_H
+#define BR_Perf_H
+
+#include <stddef.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seconds on a monotonic clock, for timing the runs below
+static inline double
+perfTimeNow (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+// File Service - save/load/iterate throughput across durability profiles
+extern void
+runFileServicePerfTests (const char *storagePath,
+                         size_t entitiesCount);
+
+// Bitcoin Wallet - btcWalletNew() load time for unordered, in-block dependent transactions
+extern void
+runBitcoinWalletPerfTests (size_t txCount);
+
+// Bitcoin Transaction - btcTransactionSign() vs btcTransactionSignParallel() for 1 to 1000 inputs; a threadCount of 0
+// uses one thread per processor
+extern void
+runBitcoinTransactionSignPerfTests (size_t threadCount);
+
+// WalletKit Transfers - wkWalletAddTransfers() recovery of many transfers into one wallet, then lookup by hash and uids
+extern void
+runWalletKitTransferPerfTests (size_t transferCount);
+
+// Keccak - BRKeccak256(), the BRKeccak context and BRKeccak256Many() for messageCount messages of several lengths
+extern void
+runKeccakPerfTests (size_t messageCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BR_Perf_H */
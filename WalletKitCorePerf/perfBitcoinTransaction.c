@@ -0,0 +1,96 @@
+//
+//  perfBitcoinTransaction.c
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include <stdio.h>
+#include <time.h>
+#include "bitcoin/BRBitcoinTransaction.h"
+#include "bitcoin/BRBitcoinChainParams.h"
+#include "support/BRCrypto.h"
+#include "support/BROSCompat.h"
+#include "perf.h"
+
+#define PERF_TRANSACTION_OUTPUT_COUNT       (2)
+
+// An unsigned transaction with `inputCount` inputs, each spending `script`.  Every other input is
+// pay-to-witness-pubkey-hash, the rest pay-to-pubkey-hash, so both sighash algorithms are covered.
+static BRBitcoinTransaction *
+perfTransactionCreateUnsigned (size_t inputCount,
+                               const uint8_t *pkhScript, size_t pkhScriptLen,
+                               const uint8_t *wpkhScript, size_t wpkhScriptLen) {
+    BRBitcoinTransaction *tx = btcTransactionNew ();
+
+    for (size_t index = 0; index < inputCount; index++) {
+        UInt256 inHash;
+        arc4random_buf_brd (inHash.u8, sizeof (inHash));
+
+        btcTransactionAddInput (tx, inHash, (uint32_t) index, 100000,
+                                (index % 2 ? wpkhScript : pkhScript),
+                                (index % 2 ? wpkhScriptLen : pkhScriptLen),
+                                NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    }
+
+    for (size_t index = 0; index < PERF_TRANSACTION_OUTPUT_COUNT; index++)
+        btcTransactionAddOutput (tx, 1000 * inputCount, pkhScript, pkhScriptLen);
+
+    return tx;
+}
+
+extern void
+runBitcoinTransactionSignPerfTests (size_t threadCount) {
+    printf ("==== Perf: BitcoinTransaction\n");
+
+    const BRBitcoinChainParams *params = btcChainParams (true);
+    UInt256 secret;
+    arc4random_buf_brd (secret.u8, sizeof (secret));
+
+    BRKey key;
+    BRKeySetSecret (&key, &secret, 1);
+
+    BRAddress pkhAddress, wpkhAddress;
+    BRKeyLegacyAddr (&key, pkhAddress.s,  sizeof (pkhAddress),  params->addrParams);
+    BRKeyAddress    (&key, wpkhAddress.s, sizeof (wpkhAddress), params->addrParams);
+
+    uint8_t pkhScript[64], wpkhScript[64];
+    size_t pkhScriptLen  = BRAddressScriptPubKey (pkhScript,  sizeof (pkhScript),  params->addrParams, pkhAddress.s);
+    size_t wpkhScriptLen = BRAddressScriptPubKey (wpkhScript, sizeof (wpkhScript), params->addrParams, wpkhAddress.s);
+
+    size_t inputCounts[] = { 1, 10, 100, 1000 };
+
+    for (size_t index = 0; index < sizeof (inputCounts) / sizeof (inputCounts[0]); index++) {
+        size_t inputCount = inputCounts[index];
+
+        BRBitcoinTransaction *sequential = perfTransactionCreateUnsigned (inputCount,
+                                                                          pkhScript, pkhScriptLen,
+                                                                          wpkhScript, wpkhScriptLen);
+        BRBitcoinTransaction *parallel   = btcTransactionCopy (sequential);
+
+        double start = perfTimeNow();
+        btcTransactionSign (sequential, 0, &key, 1);
+        double sequentialSeconds = perfTimeNow() - start;
+
+        start = perfTimeNow();
+        btcTransactionSignParallel (parallel, 0, &key, 1, threadCount);
+        double parallelSeconds = perfTimeNow() - start;
+
+        int identical = (btcTransactionIsSigned (sequential) &&
+                         UInt256Eq (sequential->txHash,  parallel->txHash) &&
+                         UInt256Eq (sequential->wtxHash, parallel->wtxHash));
+
+        printf ("BTC: sign %4zu inputs: sequential %8.4f s, parallel %8.4f s (%5.2fx)%s\n",
+                inputCount, sequentialSeconds, parallelSeconds, sequentialSeconds / parallelSeconds,
+                (identical ? "" : ", SIGNATURES DIFFER"));
+
+        btcTransactionFree (parallel);
+        btcTransactionFree (sequential);
+    }
+
+    mem_clean (&secret, sizeof (secret));
+    BRKeyClean (&key);
+}
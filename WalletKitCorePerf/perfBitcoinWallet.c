@@ -0,0 +1,106 @@
+//
+//  perfBitcoinWallet.c
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bitcoin/BRBitcoinWallet.h"
+#include "bitcoin/BRBitcoinChainParams.h"
+#include "support/BRBIP32Sequence.h"
+#include "support/BRBIP39Mnemonic.h"
+#include "support/BROSCompat.h"
+#include "perf.h"
+
+#define PERF_WALLET_ADDRESS_COUNT       (100)
+#define PERF_WALLET_TXS_PER_BLOCK       (10)
+
+// A transaction paying `amount` to `address`, spending output 0 of `parent` or, if NULL, an external output.  The
+// signature is a placeholder; the wallet only requires that one exists.  The hash is random, and so unique.
+static BRBitcoinTransaction *
+perfWalletCreateTransaction (BRAddressParams addrParams,
+                             const BRBitcoinTransaction *parent,
+                             uint64_t amount,
+                             const char *address,
+                             uint32_t blockHeight) {
+    uint8_t script[64], signature[1] = { 0 };
+    size_t scriptLen = BRAddressScriptPubKey (script, sizeof (script), addrParams, address);
+    UInt256 inHash;
+
+    if (NULL != parent) inHash = parent->txHash;
+    else arc4random_buf_brd (inHash.u8, sizeof (inHash));
+
+    BRBitcoinTransaction *tx = btcTransactionNew ();
+    btcTransactionAddInput (tx, inHash, 0, amount + 1000, NULL, 0, signature, sizeof (signature),
+                            signature, sizeof (signature), TXIN_SEQUENCE);
+    btcTransactionAddOutput (tx, amount, script, scriptLen);
+    arc4random_buf_brd (tx->txHash.u8, sizeof (tx->txHash));
+    tx->blockHeight = blockHeight;
+    tx->timestamp   = 1500000000 + 600 * blockHeight;
+    return tx;
+}
+
+extern void
+runBitcoinWalletPerfTests (size_t txCount) {
+    printf ("==== Perf: BitcoinWallet\n");
+
+    const BRBitcoinChainParams *params = btcChainParams (true);
+    UInt512 seed;
+    BRBIP39DeriveKey (&seed, "a random seed", NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey (&seed, sizeof (seed));
+
+    BRBitcoinWallet *wallet = btcWalletNew (params->addrParams, NULL, 0, mpk);
+    BRAddress addresses[PERF_WALLET_ADDRESS_COUNT];
+    btcWalletUnusedAddrs (wallet, addresses, PERF_WALLET_ADDRESS_COUNT, SEQUENCE_EXTERNAL_CHAIN);
+    btcWalletFree (wallet);
+
+    // Blocks of transactions where each spends the one before it, so the in-block order matters.
+    BRBitcoinTransaction **transactions = calloc (txCount, sizeof (BRBitcoinTransaction *));
+    for (size_t index = 0; index < txCount; index++) {
+        uint32_t blockHeight = 500000 + (uint32_t) (index / PERF_WALLET_TXS_PER_BLOCK);
+        BRBitcoinTransaction *parent = (0 == index % PERF_WALLET_TXS_PER_BLOCK ? NULL : transactions[index - 1]);
+
+        transactions[index] = perfWalletCreateTransaction (params->addrParams,
+                                                           parent,
+                                                           100000000 - 1000 * (index % PERF_WALLET_TXS_PER_BLOCK),
+                                                           addresses[index % PERF_WALLET_ADDRESS_COUNT].s,
+                                                           blockHeight);
+    }
+
+    // Loaded from storage, transactions arrive in no particular order.
+    for (size_t index = txCount; index > 1; index--) {
+        size_t other = arc4random_uniform_brd ((uint32_t) index);
+        BRBitcoinTransaction *tx = transactions[index - 1];
+        transactions[index - 1] = transactions[other];
+        transactions[other] = tx;
+    }
+
+    double start = perfTimeNow();
+    wallet = btcWalletNew (params->addrParams, transactions, txCount, mpk);
+    double seconds = perfTimeNow() - start;
+
+    printf ("BTC: load %7zu transactions in %8.3f s: %10.0f transactions/s\n",
+            txCount, seconds, (double) txCount / seconds);
+
+    size_t loadedCount = (NULL == wallet ? 0 : btcWalletTransactions (wallet, NULL, 0));
+    BRBitcoinTransaction **loaded = calloc (loadedCount + 1, sizeof (BRBitcoinTransaction *));
+    if (NULL != wallet) btcWalletTransactions (wallet, loaded, loadedCount);
+
+    size_t outOfOrder = 0;
+    for (size_t index = 1; index < loadedCount; index++)
+        if (loaded[index]->blockHeight == loaded[index - 1]->blockHeight &&
+            !UInt256Eq (loaded[index]->inputs[0].txHash, loaded[index - 1]->txHash))
+            outOfOrder++;
+
+    printf ("BTC: loaded %zu of %zu transactions, %zu out of order\n", loadedCount, txCount, outOfOrder);
+    free (loaded);
+
+    if (NULL != wallet) btcWalletFree (wallet);   // A failed btcWalletNew() has already freed the transactions
+    free (transactions);
+}
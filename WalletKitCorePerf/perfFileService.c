@@ -0,0 +1,165 @@
+//
+//  perfFileService.c
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "support/BRFileService.h"
+#include "support/BRArray.h"
+#include "support/BROSCompat.h"
+#include "perf.h"
+
+#define PERF_ENTITY_DATA_SIZE       (256)
+
+typedef struct {
+    UInt256 identifier;
+    uint8_t data[PERF_ENTITY_DATA_SIZE];
+} PerfEntity;
+
+static size_t
+perfEntityHash (const void *entity) {
+    return (size_t) ((const PerfEntity *) entity)->identifier.u32[0];
+}
+
+static int
+perfEntityEq (const void *entity1, const void *entity2) {
+    return UInt256Eq (((const PerfEntity *) entity1)->identifier,
+                      ((const PerfEntity *) entity2)->identifier);
+}
+
+static UInt256
+perfEntityIdentifier (BRFileServiceContext context,
+                      BRFileService fs,
+                      const void *entity) {
+    return ((const PerfEntity *) entity)->identifier;
+}
+
+static void *
+perfEntityReader (BRFileServiceContext context,
+                  BRFileService fs,
+                  uint8_t *bytes,
+                  uint32_t bytesCount) {
+    if (sizeof (PerfEntity) != bytesCount) return NULL;
+
+    PerfEntity *entity = malloc (sizeof (PerfEntity));
+    memcpy (entity, bytes, sizeof (PerfEntity));
+    return entity;
+}
+
+static uint8_t *
+perfEntityWriter (BRFileServiceContext context,
+                  BRFileService fs,
+                  const void* entity,
+                  uint32_t *bytesCount) {
+    uint8_t *bytes = malloc (sizeof (PerfEntity));
+    memcpy (bytes, entity, sizeof (PerfEntity));
+    *bytesCount = sizeof (PerfEntity);
+    return bytes;
+}
+
+static uint64_t
+perfEntitySortKey (BRFileServiceContext context,
+                   BRFileService fs,
+                   const void *entity) {
+    return ((const PerfEntity *) entity)->identifier.u64[0];
+}
+
+static void
+perfEntityRelease (BRFileServiceContext context,
+                   BRFileService fs,
+                   void *entity) {
+    free (entity);
+}
+
+static int
+perfEntityIterateHandler (BRFileServiceContext context,
+                          BRFileService fs,
+                          const char *type,
+                          void *entity) {
+    *((size_t *) context) += 1;
+    free (entity);
+    return 1;
+}
+
+static void
+perfReport (const char *profileName, const char *operation, size_t count, double seconds) {
+    printf ("FS: %-8s %-10s %7zu entities in %8.3f s: %10.0f entities/s\n",
+            profileName, operation, count, seconds, (double) count / seconds);
+}
+
+static void
+runFileServicePerfTestForProfile (const char *storagePath,
+                                  const char *profileName,
+                                  const BRFileServiceDurabilityProfile *profile,
+                                  PerfEntity *entities,
+                                  size_t entitiesCount) {
+    const char *type = "perf";
+
+    fileServiceWipe (storagePath, "perf", profileName);
+    BRFileService fs = fileServiceCreate (storagePath, "perf", profileName, profile, NULL, NULL);
+    if (NULL == fs) { printf ("FS: %s: create failed\n", profileName); return; }
+
+    fileServiceDefineType (fs, type, 0, NULL, perfEntityIdentifier, perfEntityReader, perfEntityWriter);
+    fileServiceDefineCurrentVersion (fs, type, 0);
+    fileServiceDefineSortKey (fs, type, NULL, perfEntitySortKey, perfEntityRelease);
+
+    // One save (and thus one DB transaction) per entity.
+    double start = perfTimeNow();
+    for (size_t index = 0; index < entitiesCount; index++)
+        fileServiceSave (fs, type, &entities[index]);
+    perfReport (profileName, "save", entitiesCount, perfTimeNow() - start);
+
+    // All saves in one DB transaction.
+    const void **entityRefs = calloc (entitiesCount, sizeof (PerfEntity *));
+    for (size_t index = 0; index < entitiesCount; index++)
+        entityRefs[index] = &entities[index];
+
+    start = perfTimeNow();
+    fileServiceSaveMany (fs, type, entityRefs, entitiesCount);
+    perfReport (profileName, "saveMany", entitiesCount, perfTimeNow() - start);
+    free (entityRefs);
+
+    BRSet *loaded = BRSetNew (perfEntityHash, perfEntityEq, entitiesCount);
+    start = perfTimeNow();
+    fileServiceLoad (fs, loaded, type, 0);
+    perfReport (profileName, "load", BRSetCount (loaded), perfTimeNow() - start);
+    BRSetFreeAll (loaded, free);
+
+    // One entity at a time, by sort key.
+    size_t iterated = 0;
+    start = perfTimeNow();
+    fileServiceLoadIterate (fs, type, 0, &iterated, perfEntityIterateHandler);
+    perfReport (profileName, "iterate", iterated, perfTimeNow() - start);
+
+    fileServiceRelease (fs);
+    fileServiceWipe (storagePath, "perf", profileName);
+}
+
+extern void
+runFileServicePerfTests (const char *storagePath,
+                         size_t entitiesCount) {
+    printf ("==== Perf: FileService\n");
+
+    PerfEntity *entities = calloc (entitiesCount, sizeof (PerfEntity));
+    for (size_t index = 0; index < entitiesCount; index++) {
+        arc4random_buf_brd (entities[index].data, PERF_ENTITY_DATA_SIZE);
+        memcpy (entities[index].identifier.u8, entities[index].data, sizeof (UInt256));
+    }
+
+    BRFileServiceDurabilityProfile profileWALNoSync = fileServiceDurabilityProfileWAL;
+    profileWALNoSync.synchronous = FILE_SERVICE_SYNCHRONOUS_OFF;
+
+    runFileServicePerfTestForProfile (storagePath, "default", &fileServiceDurabilityProfileDefault, entities, entitiesCount);
+    runFileServicePerfTestForProfile (storagePath, "wal",     &fileServiceDurabilityProfileWAL,     entities, entitiesCount);
+    runFileServicePerfTestForProfile (storagePath, "walOff",  &profileWALNoSync,                    entities, entitiesCount);
+
+    free (entities);
+}
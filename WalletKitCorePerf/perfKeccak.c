@@ -0,0 +1,70 @@
+//
+//  perfKeccak.c
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "support/BRCrypto.h"
+#include "support/BROSCompat.h"
+#include "ethereum/util/BRKeccak.h"
+#include "perf.h"
+
+extern void
+runKeccakPerfTests (size_t messageCount) {
+    printf ("==== Perf: Keccak\n");
+
+    // An address, a public key, a 32 byte hash pair and a transaction sized message
+    size_t messageLens[] = { 20, 64, 136, 532 };
+
+    for (size_t index = 0; index < sizeof (messageLens) / sizeof (messageLens[0]); index++) {
+        size_t messageLen = messageLens[index];
+
+        uint8_t *messages = malloc (messageCount * messageLen);
+        uint8_t *singles  = malloc (messageCount * 32);
+        uint8_t *contexts = malloc (messageCount * 32);
+        uint8_t *batch    = malloc (messageCount * 32);
+        arc4random_buf_brd (messages, messageCount * messageLen);
+
+        double start = perfTimeNow();
+        for (size_t i = 0; i < messageCount; i++)
+            BRKeccak256 (&singles[i * 32], &messages[i * messageLen], messageLen);
+        double singleSeconds = perfTimeNow() - start;
+
+        start = perfTimeNow();
+        for (size_t i = 0; i < messageCount; i++) {
+            BRKeccak context = keccak_create256 ();
+            keccak_update (context, &messages[i * messageLen], messageLen);
+            keccak_final  (context, &contexts[i * 32]);
+            keccak_release (context);
+        }
+        double contextSeconds = perfTimeNow() - start;
+
+        start = perfTimeNow();
+        BRKeccak256Many (batch, messages, messageLen, messageCount);
+        double batchSeconds = perfTimeNow() - start;
+
+        int identical = (0 == memcmp (singles, contexts, messageCount * 32) &&
+                         0 == memcmp (singles, batch,    messageCount * 32));
+
+        printf ("ETH: keccak-256 %3zu bytes: single %7.1f ns, context %7.1f ns, batch %7.1f ns (%5.2fx)%s\n",
+                messageLen,
+                1e9 * singleSeconds  / (double) messageCount,
+                1e9 * contextSeconds / (double) messageCount,
+                1e9 * batchSeconds   / (double) messageCount,
+                singleSeconds / batchSeconds,
+                (identical ? "" : ", DIGESTS DIFFER"));
+
+        free (batch);
+        free (contexts);
+        free (singles);
+        free (messages);
+    }
+}
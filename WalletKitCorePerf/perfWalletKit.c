@@ -0,0 +1,128 @@
+//
+//  perfWalletKit.c
+//  CorePerf
+//
+//  Copyright © 2021 Breadwinner AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "WKWallet.h"
+#include "walletkit/WKTransferP.h"
+#include "walletkit/WKWalletP.h"
+#include "walletkit/handlers/btc/WKBTC.h"
+#include "bitcoin/BRBitcoinWallet.h"
+#include "bitcoin/BRBitcoinChainParams.h"
+#include "support/BRBIP32Sequence.h"
+#include "support/BRBIP39Mnemonic.h"
+#include "support/BROSCompat.h"
+#include "perf.h"
+
+#define PERF_WALLETKIT_ADDRESS_COUNT        (100)
+
+// A transaction paying `amount` to `address` from an external output.  The signature is a placeholder and the hash
+// is random, and so unique.
+static BRBitcoinTransaction *
+perfWalletKitCreateTransaction (BRAddressParams addrParams,
+                                uint64_t amount,
+                                const char *address,
+                                uint32_t blockHeight) {
+    uint8_t script[64], signature[1] = { 0 };
+    size_t scriptLen = BRAddressScriptPubKey (script, sizeof (script), addrParams, address);
+    UInt256 inHash;
+    arc4random_buf_brd (inHash.u8, sizeof (inHash));
+
+    BRBitcoinTransaction *tx = btcTransactionNew ();
+    btcTransactionAddInput (tx, inHash, 0, amount + 1000, NULL, 0, signature, sizeof (signature),
+                            signature, sizeof (signature), TXIN_SEQUENCE);
+    btcTransactionAddOutput (tx, amount, script, scriptLen);
+    arc4random_buf_brd (tx->txHash.u8, sizeof (tx->txHash));
+    tx->blockHeight = blockHeight;
+    tx->timestamp   = 1500000000 + 600 * blockHeight;
+    return tx;
+}
+
+extern void
+runWalletKitTransferPerfTests (size_t transferCount) {
+    printf ("==== Perf: WalletKit Transfers\n");
+
+    const BRBitcoinChainParams *params = btcChainParams (true);
+    UInt512 seed;
+    BRBIP39DeriveKey (&seed, "a random seed", NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey (&seed, sizeof (seed));
+
+    BRBitcoinWallet *wid = btcWalletNew (params->addrParams, NULL, 0, mpk);
+    btcWalletSetCallbacks (wid, NULL, NULL, NULL, NULL, NULL);
+
+    BRAddress addresses[PERF_WALLETKIT_ADDRESS_COUNT];
+    btcWalletUnusedAddrs (wid, addresses, PERF_WALLETKIT_ADDRESS_COUNT, SEQUENCE_EXTERNAL_CHAIN);
+
+    WKCurrency btc = wkCurrencyCreate ("bitcoin-mainnet:__native__", "Bitcoin", "btc", "native", NULL);
+    WKUnit     sat = wkUnitCreateAsBase (btc, "sat", "Satoshi", "SAT");
+
+    WKWalletListener   walletListener   = { NULL };
+    WKTransferListener transferListener = { NULL };
+    WKWallet wallet = wkWalletCreateAsBTC (WK_NETWORK_TYPE_BTC, walletListener, sat, sat, wid);
+
+    // As recovered from storage, as a single batch
+    BRArrayOf(WKTransfer) transfers;
+    array_new (transfers, transferCount);
+    for (size_t index = 0; index < transferCount; index++) {
+        BRBitcoinTransaction *tid = perfWalletKitCreateTransaction (params->addrParams,
+                                                                    100000 + index,
+                                                                    addresses[index % PERF_WALLETKIT_ADDRESS_COUNT].s,
+                                                                    500000 + (uint32_t) index);
+        array_add (transfers, wkTransferCreateAsBTC (transferListener, sat, sat, wid, tid, WK_NETWORK_TYPE_BTC));
+    }
+
+    WKHash *hashes = calloc (transferCount, sizeof (WKHash));
+    char  **uids   = calloc (transferCount, sizeof (char *));
+    for (size_t index = 0; index < transferCount; index++) {
+        hashes[index] = wkTransferGetHash (transfers[index]);
+        uids[index]   = (NULL == transfers[index]->uids ? NULL : strdup (transfers[index]->uids));
+    }
+
+    double start = perfTimeNow();
+    wkWalletAddTransfers (wallet, transfers);   // ownership given
+    double seconds = perfTimeNow() - start;
+
+    printf ("WK : recover %7zu transfers in %8.3f s: %10.0f transfers/s\n",
+            transferCount, seconds, (double) transferCount / seconds);
+
+    size_t found = 0;
+    start = perfTimeNow();
+    for (size_t index = 0; index < transferCount; index++) {
+        WKTransfer transfer = wkWalletGetTransferByHash (wallet, hashes[index]);
+        if (NULL != transfer) { found++; wkTransferGive (transfer); }
+    }
+    seconds = perfTimeNow() - start;
+
+    printf ("WK : lookup  %7zu transfers by hash in %8.3f s: %zu found\n", transferCount, seconds, found);
+
+    found = 0;
+    start = perfTimeNow();
+    for (size_t index = 0; index < transferCount; index++) {
+        WKTransfer transfer = (NULL == uids[index] ? NULL : wkWalletGetTransferByUIDS (wallet, uids[index]));
+        if (NULL != transfer) { found++; wkTransferGive (transfer); }
+    }
+    seconds = perfTimeNow() - start;
+
+    printf ("WK : lookup  %7zu transfers by uids in %8.3f s: %zu found\n", transferCount, seconds, found);
+
+    for (size_t index = 0; index < transferCount; index++) {
+        wkHashGive (hashes[index]);
+        if (NULL != uids[index]) free (uids[index]);
+    }
+    free (hashes);
+    free (uids);
+
+    wkWalletGive (wallet);
+    btcWalletFree (wid);
+    wkUnitGive (sat);
+    wkCurrencyGive (btc);
+}
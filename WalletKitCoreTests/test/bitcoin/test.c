@@ -60,6 +60,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
 #include <pthread.h>
 
 #define SKIP_BIP38 1
@@ -743,6 +744,8 @@ int BRDogecoinAuxPowTests()
     return r;
 }
 
+int BRSHA256SetFeaturesTest(int features);
+
 int BRHashTests()
 {
     // test sha1
@@ -823,6 +826,31 @@ int BRHashTests()
                     "\x14\x7c\x4e\x72\xb9\x80\x77\x85\xaf\xee\x48\xbb", *(UInt256 *)md))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256() test 6", __func__);
 
+    // test double-sha256 of many messages, for message lengths around the padding boundaries
+
+    uint8_t msgs[19*130], mds[19*32];
+
+    for (size_t i = 0; i < sizeof(msgs); i++) msgs[i] = (uint8_t)(i*7 + 3);
+
+    for (size_t len = 0; len <= 130; len++) {
+        BRSHA256_2Many(mds, msgs, len, 19);
+
+        for (size_t i = 0; i < 19; i++) {
+            BRSHA256_2(md, &msgs[i*len], len);
+            if (! UInt256Eq(*(UInt256 *)md, *(UInt256 *)&mds[i*32]))
+                r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256_2Many() length %zu message %zu", __func__, len, i);
+        }
+    }
+
+    memcpy(mds, msgs, sizeof(mds));
+    BRSHA256_2Many(mds, mds, 64, 9); // in place, as for a merkle tree level
+
+    for (size_t i = 0; i < 9; i++) {
+        BRSHA256_2(md, &msgs[i*64], 64);
+        if (! UInt256Eq(*(UInt256 *)md, *(UInt256 *)&mds[i*32]))
+            r = 0, fprintf(stderr, "\n***FAILED*** %s: BRSHA256_2Many() in place message %zu", __func__, i);
+    }
+
     // test sha512
     
     s = "Free online SHA512 Calculator, type text here...";
@@ -968,6 +996,63 @@ int BRHashTests()
                     "\x82\x27\x3b\x7b\xfa\xd8\x04\x5d\x85\xa4\x70", *(UInt256 *)md))
         r = 0, fprintf(stderr, "***FAILED*** %s: Keccak-256() test 1\n", __func__);
 
+    s = "abc";
+    BRKeccak256(md, s, strlen(s));
+    if (! UInt256Eq(*(UInt256 *)"\x4e\x03\x65\x7a\xea\x45\xa9\x4f\xc7\xd4\x7b\xa8\x26\xc8\xd6\x67\xc0\xd1\xe6\xe3\x3a"
+                    "\x64\xa0\x36\xec\x44\xf5\x8f\xa1\x2d\x6c\x45", *(UInt256 *)md))
+        r = 0, fprintf(stderr, "***FAILED*** %s: Keccak-256() test 2\n", __func__);
+
+    // test keccak-256 of many messages, for message lengths around the 136 byte block boundaries
+
+    for (size_t len = 0; len <= 280; len++) {
+        BRKeccak256Many(mds, msgs, len, 7);
+
+        for (size_t i = 0; i < 7; i++) {
+            BRKeccak256(md, &msgs[i*len], len);
+            if (! UInt256Eq(*(UInt256 *)md, *(UInt256 *)&mds[i*32]))
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRKeccak256Many() length %zu message %zu\n", __func__, len, i);
+        }
+    }
+
+    memcpy(mds, msgs, sizeof(mds));
+    BRKeccak256Many(mds, mds, 64, 9); // in place
+
+    for (size_t i = 0; i < 9; i++) {
+        BRKeccak256(md, &msgs[i*64], 64);
+        if (! UInt256Eq(*(UInt256 *)md, *(UInt256 *)&mds[i*32]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeccak256Many() in place message %zu\n", __func__, i);
+    }
+
+    // test each x86 backend that the cpu supports, 0x01 sha-ni, 0x02 avx2 or both, against the scalar one
+
+    for (int features = 0x01; features <= 0x03; features++) {
+        for (size_t len = 0; len <= 130; len++) {
+            uint8_t sha[32], sha2[19*32], keccak[7*32];
+
+            BRSHA256SetFeaturesTest(0);
+            BRSHA256(sha, msgs, len);
+            BRSHA256_2Many(sha2, msgs, len, 19);
+            BRKeccak256Many(keccak, msgs, len, 7);
+            BRSHA256SetFeaturesTest(features);
+
+            BRSHA256(md, msgs, len);
+            if (! UInt256Eq(*(UInt256 *)md, *(UInt256 *)sha))
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRSHA256() features %d length %zu\n", __func__, features, len);
+
+            BRSHA256_2Many(mds, msgs, len, 19);
+            if (memcmp(mds, sha2, sizeof(sha2)) != 0)
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRSHA256_2Many() features %d length %zu\n", __func__,
+                               features, len);
+
+            BRKeccak256Many(mds, msgs, len, 7);
+            if (memcmp(mds, keccak, sizeof(keccak)) != 0)
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRKeccak256Many() features %d length %zu\n", __func__,
+                               features, len);
+        }
+    }
+
+    BRSHA256SetFeaturesTest(-1);
+
     // test murmurHash3-x86_32
     
     if (BRMurmur3_32("", 0, 0) != 0)
@@ -1055,6 +1140,49 @@ int BRMacTests()
                "\x27\x0c\xd7\xea\x25\x05\x54\x97\x58\xbf\x75\xc0\x5a\x99\x4a\x6d\x03\x4f\x65\xf8\xf0\xe6\xfd\xca\xea"
                "\xb1\xa3\x4d\x4a\x6b\x4b\x63\x6e\x07\x0a\x38\xbc\xe7\x37", mac, 64) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRHMAC() sha512 test 2\n", __func__);
+
+    // test hmac with precomputed key state, including a key longer than the block size, and reuse of the key state
+
+    const char k3[] = "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+    "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+    "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+    "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+    "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+    "\xaa\xaa",
+    d3[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+    const char *keys[] = { k1, k2, k3 }, *datas[] = { d1, d2, d3 };
+    size_t keyLens[] = { sizeof(k1) - 1, sizeof(k2) - 1, sizeof(k3) - 1 },
+    dataLens[] = { sizeof(d1) - 1, sizeof(d2) - 1, sizeof(d3) - 1 };
+    void (*hashes[])(void *, const void *, size_t) = { BRSHA224, BRSHA256, BRSHA384, BRSHA512 };
+    size_t hashLens[] = { 224/8, 256/8, 384/8, 512/8 };
+    uint8_t mac2[64];
+    BRHMACCtx ctx;
+
+    for (size_t h = 0; h < sizeof(hashes)/sizeof(*hashes); h++) {
+        for (size_t k = 0; k < sizeof(keys)/sizeof(*keys); k++) {
+            BRHMACCtxInit(&ctx, hashes[h], hashLens[h], keys[k], keyLens[k]);
+
+            for (size_t d = 0; d < sizeof(datas)/sizeof(*datas); d++) {
+                BRHMAC(mac, hashes[h], hashLens[h], keys[k], keyLens[k], datas[d], dataLens[d]);
+                BRHMACCtxMac(mac2, &ctx, datas[d], dataLens[d]);
+                if (memcmp(mac, mac2, hashLens[h]) != 0)
+                    r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACCtxMac() hash %zu key %zu data %zu\n", __func__,
+                                   h, k, d);
+            }
+        }
+    }
+
+    BRHMACCtxInit(&ctx, BRSHA256, 256/8, k3, sizeof(k3) - 1);
+    BRHMACCtxMac(mac, &ctx, d3, sizeof(d3) - 1);
+    if (memcmp("\x60\xe4\x31\x59\x1e\xe0\xb6\x7f\x0d\x8a\x26\xaa\xcb\xf5\xb7\x7f\x8e\x0b\xc6\x21\x37\x28\xc5\x14\x05"
+               "\x46\x04\x0f\x0e\xe3\x7f\x54", mac, 32) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACCtxMac() sha256 test 3\n", __func__);
+
+    memcpy(mac2, mac, 32);
+    BRHMACCtxMac(mac2, &ctx, mac2, 32); // mac written over data
+    BRHMAC(mac, BRSHA256, 256/8, k3, sizeof(k3) - 1, mac, 32);
+    if (memcmp(mac, mac2, 32) != 0) r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACCtxMac() sha256 test 4\n", __func__);
+    var_clean(&ctx);
     
     // test poly1305
 
@@ -1950,7 +2078,44 @@ int BRKeyTests()
     
     if (pkLen5 != pkLen || memcmp(pubKey, pubKey5, pkLen) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRPubKeyRecover() test 3\n", __func__);
-    
+
+    // batch verification and pubkey recovery, every fifth signature is for another message
+    BRKey keys[40], pubKeys[40], recoveredKeys[40];
+    UInt256 mds[40];
+    uint8_t sigs[40][72], compactSigs[40*65];
+    const void *sigPtrs[40];
+    size_t sigLens[40];
+    int verified[40], recovered[40];
+
+    for (size_t i = 0; i < 40; i++) {
+        UInt256 secret = UINT256_ZERO;
+
+        secret.u32[0] = (uint32_t)i + 1;
+        BRKeySetSecret(&keys[i], &secret, (i % 2) == 0);
+        BRSHA256(&mds[i], &secret, sizeof(secret));
+        sigLens[i] = BRKeySign(&keys[i], sigs[i], sizeof(sigs[i]), mds[i]);
+        sigPtrs[i] = sigs[i];
+        BRKeyCompactSign(&keys[i], &compactSigs[i*65], 65, mds[i]);
+        BRKeySetPubKey(&pubKeys[i], keys[i].pubKey, BRKeyPubKey(&keys[i], NULL, 0));
+        if (i % 5 == 4) mds[i].u8[0] ^= 1;
+    }
+
+    for (size_t threadCount = 1; threadCount <= 4; threadCount += 3) {
+        if (BRKeyVerifyMany(pubKeys, mds, sigPtrs, sigLens, verified, 40, threadCount) != 32)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerifyMany() test 1\n", __func__);
+
+        if (BRKeyRecoverPubKeyMany(recoveredKeys, mds, compactSigs, recovered, 40, threadCount) != 40)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyMany() test 1\n", __func__);
+
+        for (size_t i = 0; i < 40; i++) {
+            if (verified[i] != (i % 5 != 4) || verified[i] != BRKeyVerify(&pubKeys[i], mds[i], sigs[i], sigLens[i]))
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerifyMany() signature %zu\n", __func__, i);
+
+            if (i % 5 != 4 && ! BRKeyPubKeyMatch(&recoveredKeys[i], &pubKeys[i]))
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyMany() signature %zu\n", __func__, i);
+        }
+    }
+
     // paper wallet key pair
     BRKeyGenerateRandom (&key, 1);
     
@@ -2366,6 +2531,31 @@ int BRBIP32SequenceTests()
                     uint256("7b6a7dd645507d775215a9035be06700e1ed8c541da9351b4bd14bd50ab61428")))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKey() test\n", __func__);
 
+    // ranges, including the last unhardened and first hardened children, match BRBIP32PubKey()
+    BRECPoint pubKeys[40];
+    uint32_t froms[] = { 0, 1000, 0x7ffffffe };
+
+    for (size_t i = 0; i < sizeof(froms)/sizeof(*froms); i++) {
+        for (uint32_t chain = SEQUENCE_EXTERNAL_CHAIN; chain <= SEQUENCE_INTERNAL_CHAIN; chain++) {
+            if (! BRBIP32PubKeyRange(pubKeys, 40, mpk, chain, froms[i]))
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() %u/%u\n", __func__, chain, froms[i]);
+
+            for (uint32_t j = 0; j < 40; j++) {
+                BRBIP32PubKey(pubKey, mpk, chain, froms[i] + j);
+                if (memcmp(pubKey, &pubKeys[j], sizeof(pubKey)) != 0)
+                    r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() %u/%u\n", __func__, chain,
+                                   froms[i] + j);
+            }
+        }
+    }
+
+    // a master pubKey that isn't a valid point fails instead of returning garbage keys
+    BRMasterPubKey badMpk = mpk;
+
+    badMpk.pubKey[0] = 0x05;
+    if (BRBIP32PubKeyRange(pubKeys, 40, badMpk, SEQUENCE_EXTERNAL_CHAIN, 0))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() invalid master pubKey\n", __func__);
+
     UInt512 dk;
     BRAddress addr;
 
@@ -2629,6 +2819,39 @@ int btcTransactionTests()
     if (len8 != sizeof(buf9) - 1 || memcmp(buf8, buf9, len8))
         r = 0, fprintf(stderr, "\n***FAILED*** %s: btcTransactionSign() test 4", __func__);
 
+    BRKeyLegacyAddr(&k[1], address.s, sizeof(address), btcMainNetParams->addrParams);
+    BRKeyAddress(&k[1], addr.s, sizeof(addr), btcMainNetParams->addrParams);
+    
+    uint8_t pkhScript[BRAddressScriptPubKey(NULL, 0, btcMainNetParams->addrParams, address.s)],
+            wpkhScript[BRAddressScriptPubKey(NULL, 0, btcMainNetParams->addrParams, addr.s)];
+    size_t pkhLen = BRAddressScriptPubKey(pkhScript, sizeof(pkhScript), btcMainNetParams->addrParams, address.s),
+           wpkhLen = BRAddressScriptPubKey(wpkhScript, sizeof(wpkhScript), btcMainNetParams->addrParams, addr.s);
+    
+    for (int forkId = 0; forkId <= 0x40; forkId += 0x40) { // parallel signatures match sequential ones
+        BRBitcoinTransaction *tx1 = btcTransactionNew(), *tx2;
+        
+        for (uint32_t i = 0; i < 64; i++) {
+            btcTransactionAddInput(tx1, inHash, i, 100000 + i, (i % 3) ? wpkhScript : pkhScript,
+                                   (i % 3) ? wpkhLen : pkhLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        }
+        
+        btcTransactionAddOutput(tx1, 5000000, pkhScript, pkhLen);
+        tx2 = btcTransactionCopy(tx1);
+        btcTransactionSign(tx1, forkId, k, 2);
+        
+        if (! btcTransactionSignParallel(tx2, forkId, k, 2, 4))
+            r = 0, fprintf(stderr, "\n***FAILED*** %s: btcTransactionSignParallel() test 1", __func__);
+        
+        uint8_t buf1[btcTransactionSerialize(tx1, NULL, 0)], buf2[btcTransactionSerialize(tx2, NULL, 0)];
+        size_t len1 = btcTransactionSerialize(tx1, buf1, sizeof(buf1)),
+               len2 = btcTransactionSerialize(tx2, buf2, sizeof(buf2));
+        
+        if (len1 != len2 || memcmp(buf1, buf2, len1) != 0 || ! UInt256Eq(tx1->wtxHash, tx2->wtxHash))
+            r = 0, fprintf(stderr, "\n***FAILED*** %s: btcTransactionSignParallel() test 2", __func__);
+        btcTransactionFree(tx1);
+        btcTransactionFree(tx2);
+    }
+
     char buf0[] = "\x01\x00\x00\x00\x00\x01\x01\x7b\x03\x2f\x6a\x65\x1c\x7d\xcb\xcf\xb7\x8d\x81\x7b\x30\x3b\xe8\xd2\x0a"
     "\xfa\x22\x90\x16\x18\xb5\x17\xf2\x17\x55\xa7\xcd\x8d\x48\x01\x00\x00\x00\x23\x22\x00\x20\xe0\x62\x7b\x64\x74\x59"
     "\x05\x64\x6f\x27\x6f\x35\x55\x02\xa4\x05\x30\x58\xb6\x4e\xdb\xf2\x77\x11\x92\x49\x61\x1c\x98\xda\x41\x69\xff\xff"
@@ -2902,7 +3125,139 @@ int btcWalletTests()
 
     if (tx) btcTransactionFree(tx);
     btcWalletFree(w);
-    
+
+    // balance and utxos applied incrementally on register must match a wallet rebuilt from the same transactions
+    w = btcWalletNew(btcMainNetParams->addrParams, NULL, 0, mpk);
+    for (uint32_t i = 0; i < 8; i++) {
+        recvAddr = btcWalletReceiveAddress(w);
+        outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), btcMainNetParams->addrParams, recvAddr.s);
+        inHash.u32[0] = i + 2;
+        tx = btcTransactionNew();
+        btcTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        btcTransactionAddOutput(tx, SATOSHIS/8, outScript, outScriptLen);
+        btcTransactionSign(tx, 0, &k, 1);
+        tx->timestamp = 1;
+        btcWalletRegisterTransaction(w, tx);
+
+        tx = btcWalletCreateTransaction(w, SATOSHIS/32, (i % 2) ? addr.s : recvAddr.s);
+        if (tx) btcWalletSignTransaction(w, tx, 0x00, btcMainNetParams->bip32depth, btcMainNetParams->bip32child,
+                                         &seed, sizeof(seed));
+        if (tx) tx->timestamp = 1, btcWalletRegisterTransaction(w, tx);
+    }
+
+    size_t txCount = btcWalletTransactions(w, NULL, 0), utxoCount = btcWalletUTXOs(w, NULL, 0);
+    BRBitcoinTransaction *txs[txCount];
+    btcWalletTransactions(w, txs, txCount);
+    for (size_t i = 0; i < txCount; i++) txs[i] = btcTransactionCopy(txs[i]);
+
+    BRBitcoinWallet *w2 = btcWalletNew(btcMainNetParams->addrParams, txs, txCount, mpk);
+    BRBitcoinUTXO utxos[utxoCount], utxos2[utxoCount];
+
+    if (btcWalletBalance(w) != btcWalletBalance(w2) || btcWalletTotalSent(w) != btcWalletTotalSent(w2) ||
+        btcWalletTotalReceived(w) != btcWalletTotalReceived(w2) || btcWalletUTXOs(w2, NULL, 0) != utxoCount)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletRegisterTransaction() test 6\n", __func__);
+    else {
+        btcWalletUTXOs(w, utxos, utxoCount);
+        btcWalletUTXOs(w2, utxos2, utxoCount);
+        for (size_t i = 0; i < utxoCount; i++) {
+            if (! btcUTXOEq(&utxos[i], &utxos2[i]))
+                r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletUTXOs() test\n", __func__);
+        }
+    }
+
+    btcWalletFree(w2);
+
+    // transactions given children first must still be ordered with each parent before any tx that spends it
+    BRBitcoinTransaction *reversed[txCount];
+    btcWalletTransactions(w, txs, txCount);
+    for (size_t i = 0; i < txCount; i++) reversed[i] = btcTransactionCopy(txs[txCount - 1 - i]);
+    w2 = btcWalletNew(btcMainNetParams->addrParams, reversed, txCount, mpk);
+    btcWalletTransactions(w2, txs, txCount);
+
+    for (size_t i = 0; i < txCount; i++) {
+        for (size_t j = i + 1; j < txCount; j++) {
+            for (size_t n = 0; n < txs[i]->inCount; n++) {
+                if (UInt256Eq(txs[i]->inputs[n].txHash, txs[j]->txHash))
+                    r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletNew() test 2\n", __func__);
+            }
+        }
+    }
+
+    btcWalletFree(w2);
+
+    // a confirmed tx moves ahead of the unconfirmed ones, and its balance history must move with it, so the wallet still
+    // matches a rebuilt one after another tx is registered
+    BRBitcoinWallet *w3 = btcWalletNew(btcMainNetParams->addrParams, NULL, 0, mpk);
+    BRBitcoinTransaction *received[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        recvAddr = btcWalletReceiveAddress(w3);
+        outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), btcMainNetParams->addrParams, recvAddr.s);
+        inHash.u32[0] = i + 20;
+        received[i] = btcTransactionNew();
+        btcTransactionAddInput(received[i], inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        btcTransactionAddOutput(received[i], (i + 1)*SATOSHIS/8, outScript, outScriptLen);
+        btcTransactionSign(received[i], 0, &k, 1);
+        received[i]->timestamp = 1;
+        btcWalletRegisterTransaction(w3, received[i]);
+        if (i == 2) btcWalletUpdateTransactions(w3, &received[i]->txHash, 1, 100, 1);
+    }
+
+    for (size_t i = 0; i < 4; i++) txs[i] = btcTransactionCopy(received[i]);
+    w2 = btcWalletNew(btcMainNetParams->addrParams, txs, 4, mpk);
+
+    if (btcWalletTransactions(w3, txs, 4) != 4 || txs[0] != received[2])
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletUpdateTransactions() test\n", __func__);
+
+    for (size_t i = 0; i < 4; i++) {
+        if (btcWalletBalanceAfterTx(w3, received[i]) != btcWalletBalanceAfterTx(w2, received[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletBalanceAfterTx() test %zu\n", __func__, i);
+    }
+
+    btcWalletFree(w2);
+    btcWalletFree(w3);
+
+    // a wallet seeded with previously generated chains must match, and must ignore a chain that doesn't match mpk
+    size_t internalCount = btcWalletChainPKHs(w, NULL, 0, SEQUENCE_INTERNAL_CHAIN),
+           externalCount = btcWalletChainPKHs(w, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+    UInt160 internalChain[internalCount], externalChain[externalCount], chain[internalCount + externalCount];
+
+    btcWalletChainPKHs(w, internalChain, internalCount, SEQUENCE_INTERNAL_CHAIN);
+    btcWalletChainPKHs(w, externalChain, externalCount, SEQUENCE_EXTERNAL_CHAIN);
+    w2 = btcWalletNewWithChains(btcMainNetParams->addrParams, NULL, 0, mpk, internalChain, internalCount,
+                                externalChain, externalCount);
+
+    if (btcWalletChainPKHs(w2, chain, internalCount + externalCount, SEQUENCE_INTERNAL_CHAIN) != internalCount ||
+        memcmp(chain, internalChain, sizeof(internalChain)) != 0 ||
+        btcWalletChainPKHs(w2, chain, internalCount + externalCount, SEQUENCE_EXTERNAL_CHAIN) != externalCount ||
+        memcmp(chain, externalChain, sizeof(externalChain)) != 0 || ! btcWalletContainsAddress(w2, recvAddr.s))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletNewWithChains() test 1\n", __func__);
+
+    btcWalletFree(w2);
+    externalChain[externalCount - 1].u8[0] ^= 1;
+    w2 = btcWalletNewWithChains(btcMainNetParams->addrParams, NULL, 0, mpk, internalChain, internalCount,
+                                externalChain, externalCount);
+    externalChain[externalCount - 1].u8[0] ^= 1;
+
+    if (btcWalletChainPKHs(w2, chain, internalCount + externalCount, SEQUENCE_EXTERNAL_CHAIN) !=
+            SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED ||
+        memcmp(chain, externalChain, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED*sizeof(*chain)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletNewWithChains() test 2\n", __func__);
+
+    btcWalletFree(w2);
+    internalChain[0].u8[0] ^= 1;
+    w2 = btcWalletNewWithChains(btcMainNetParams->addrParams, NULL, 0, mpk, internalChain, internalCount,
+                                externalChain, externalCount);
+    internalChain[0].u8[0] ^= 1;
+
+    if (btcWalletChainPKHs(w2, chain, internalCount + externalCount, SEQUENCE_INTERNAL_CHAIN) !=
+            SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED ||
+        memcmp(chain, internalChain, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED*sizeof(*chain)) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletNewWithChains() test 3\n", __func__);
+
+    btcWalletFree(w2);
+    btcWalletFree(w);
+
     amt = btcBitcoinAmount(50000, 50000);
     if (amt != SATOSHIS) r = 0, fprintf(stderr, "***FAILED*** %s: BRBitcoinAmount() test 1\n", __func__);
 
@@ -2918,6 +3273,134 @@ int btcWalletTests()
     return r;
 }
 
+static uint64_t coinSelectionFee(void *info, size_t vsize)
+{
+    return vsize*10; // 10 satoshis per vbyte
+}
+
+static uint64_t coinSelectionRoundedFee(void *info, size_t vsize)
+{
+    return ((vsize*1450/1000 + 99)/100)*100; // 1.45 satoshis per vbyte, rounded up to the nearest 100 satoshis
+}
+
+int btcCoinSelectionTests()
+{
+    int r = 1;
+    const BRBitcoinChainParams *btcMainNetParams = btcChainParams(true);
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRKey k;
+    BRAddress addr;
+    BRBitcoinCoinSelectionInput inputs[6];
+    uint64_t amounts[6] = { 100000, 200000, 500000, 1000000, 3000000, 50000 }, fee, total;
+    size_t selected[6], count;
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRKeyAddress(&k, addr.s, sizeof(addr), btcMainNetParams->addrParams);
+    uint8_t script[BRAddressScriptPubKey(NULL, 0, btcMainNetParams->addrParams, addr.s)];
+    size_t scriptLen = BRAddressScriptPubKey(script, sizeof(script), btcMainNetParams->addrParams, addr.s);
+
+    for (size_t i = 0; i < 6; i++) inputs[i] = btcCoinSelectionInput(amounts[i], script, scriptLen);
+
+    // each P2WPKH input adds 68 vbytes, so 500000 and 200000 cover an output of 696600 and its 1780 fee, leaving less
+    // than a change output is worth, which goes to the fee
+    BRBitcoinTransaction *tx = btcTransactionNew();
+    btcTransactionAddOutput(tx, 696600, script, scriptLen);
+
+    count = btcCoinSelect(BTC_COIN_SELECTION_BRANCH_AND_BOUND, tx, inputs, 6, 5000, 10000, NULL,
+                          coinSelectionFee, selected, &fee);
+    if (count != 2 || selected[0] != 1 || selected[1] != 2 || fee != 3400)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() branch and bound test\n", __func__);
+
+    count = btcCoinSelect(BTC_COIN_SELECTION_LARGEST_FIRST, tx, inputs, 6, 5000, 10000, NULL,
+                          coinSelectionFee, selected, &fee);
+    if (count != 1 || selected[0] != 4)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() largest first test\n", __func__);
+
+    // wallet order takes a prefix, and its fee matches btcTransactionVSize() of the tx with a change output
+    count = btcCoinSelect(BTC_COIN_SELECTION_WALLET_ORDER, tx, inputs, 6, 5000, 10000, NULL,
+                          coinSelectionFee, selected, &fee);
+    for (size_t i = 0; i < count; i++) {
+        btcTransactionAddInput(tx, UINT256_ZERO, (uint32_t)i, amounts[i], script, scriptLen, NULL, 0, NULL, 0,
+                               TXIN_SEQUENCE);
+    }
+
+    if (count != 3 || fee != coinSelectionFee(NULL, btcTransactionVSize(tx) + TX_OUTPUT_SIZE))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() wallet order test\n", __func__);
+
+    btcTransactionFree(tx);
+    tx = btcTransactionNew();
+    btcTransactionAddOutput(tx, 1200000, script, scriptLen);
+
+    for (int i = 0; i < 10; i++) { // knapsack is randomized
+        count = btcCoinSelect(BTC_COIN_SELECTION_KNAPSACK, tx, inputs, 6, 5000, 10000, NULL,
+                              coinSelectionFee, selected, &fee);
+        total = 0;
+        for (size_t j = 0; j < count; j++) total += amounts[selected[j]];
+        if (count == 0 || (total != 1200000 + fee && total < 1200000 + fee + 5000))
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() knapsack test\n", __func__);
+    }
+
+    btcTransactionFree(tx);
+    tx = btcTransactionNew();
+    btcTransactionAddOutput(tx, 4850000, script, scriptLen);
+
+    for (int s = BTC_COIN_SELECTION_WALLET_ORDER; s <= BTC_COIN_SELECTION_KNAPSACK; s++) {
+        if (btcCoinSelect(s, tx, inputs, 6, 5000, 10000, NULL, coinSelectionFee, selected, &fee) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() insufficient funds test %d\n", __func__, s);
+    }
+
+    btcTransactionFree(tx);
+
+    // input costs are estimated at the unrounded rate, so 500000 and 200000 are found to pay for 699700 plus the
+    // rounded fee of 300 without change; a rate taken from the rounded fee for 1000 vbytes overcharges each input
+    tx = btcTransactionNew();
+    btcTransactionAddOutput(tx, 699700, script, scriptLen);
+    count = btcCoinSelect(BTC_COIN_SELECTION_BRANCH_AND_BOUND, tx, inputs, 6, 1000, 1450, NULL,
+                          coinSelectionRoundedFee, selected, &fee);
+    if (count != 2 || selected[0] != 1 || selected[1] != 2 || fee != 300)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCoinSelect() branch and bound rounded fee test\n", __func__);
+
+    btcTransactionFree(tx);
+
+    // every strategy builds a balanced tx from wallet UTXOs
+    UInt512 seed;
+    BRBIP39DeriveKey(&seed, "a random seed", NULL);
+    BRBitcoinWallet *w = btcWalletNew(btcMainNetParams->addrParams, NULL, 0, BRBIP32MasterPubKey(&seed, sizeof(seed)));
+    UInt256 inHash = UINT256_ZERO;
+
+    for (size_t i = 0; i < 6; i++) {
+        BRAddress recvAddr = btcWalletReceiveAddress(w);
+        uint8_t outScript[BRAddressScriptPubKey(NULL, 0, btcMainNetParams->addrParams, recvAddr.s)];
+        size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), btcMainNetParams->addrParams,
+                                                    recvAddr.s);
+
+        inHash.u32[0] = (uint32_t)i + 1;
+        tx = btcTransactionNew();
+        btcTransactionAddInput(tx, inHash, 0, 1, script, scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        btcTransactionAddOutput(tx, amounts[i], outScript, outScriptLen);
+        btcTransactionSign(tx, 0, &k, 1);
+        tx->timestamp = 1;
+        btcWalletRegisterTransaction(w, tx);
+    }
+
+    BRBitcoinTxOutput o = BR_TX_OUTPUT_NONE;
+    o.amount = 696600;
+    btcTxOutputSetAddress(&o, btcMainNetParams->addrParams, addr.s);
+
+    for (int s = BTC_COIN_SELECTION_WALLET_ORDER; s <= BTC_COIN_SELECTION_KNAPSACK; s++) {
+        tx = btcWalletCreateTxForOutputsWithCoinSelection(w, UINT64_MAX, s, &o, 1);
+        if (! tx || btcWalletAmountSentByTx(w, tx) != btcWalletAmountReceivedFromTx(w, tx) + o.amount +
+                                                      btcWalletFeeForTx(w, tx))
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcWalletCreateTxForOutputsWithCoinSelection() test %d\n",
+                           __func__, s);
+        if (tx) btcTransactionFree(tx);
+    }
+
+    btcTxOutputSetAddress(&o, btcMainNetParams->addrParams, NULL);
+    btcWalletFree(w);
+    return r;
+}
+
 int btcBloomFilterTests()
 {
     int r = 1;
@@ -2989,10 +3472,106 @@ int btcBloomFilterTests()
     if (len2 != sizeof(d2) - 1 || memcmp(buf2, d2, len2) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: btcBloomFilterSerialize() test 2\n", __func__);
     
+    btcBloomFilterFree(f);
+    f = btcBloomFilterNew(BLOOM_REDUCED_FALSEPOSITIVE_RATE, 1000, 0, BLOOM_UPDATE_ALL);
+
+    if (btcBloomFilterFalsePositiveRate(f, 0) != 0.0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcBloomFilterFalsePositiveRate() test 1\n", __func__);
+
+    // a filter sized for 1000 elements is at its target false positive rate with 1000 inserted
+    for (uint32_t i = 0; i < 900; i++) btcBloomFilterInsertData(f, (uint8_t *)&i, sizeof(i));
+
+    if (btcBloomFilterFalsePositiveRate(f, 100) < BLOOM_REDUCED_FALSEPOSITIVE_RATE*0.9 ||
+        btcBloomFilterFalsePositiveRate(f, 100) > BLOOM_REDUCED_FALSEPOSITIVE_RATE*1.1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcBloomFilterFalsePositiveRate() test 2\n", __func__);
+
+    if (btcBloomFilterFalsePositiveRate(f, 0) >= btcBloomFilterFalsePositiveRate(f, 100))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcBloomFilterFalsePositiveRate() test 3\n", __func__);
+
     btcBloomFilterFree(f);
     return r;
 }
 
+static BRBitcoinCompactFilter *_relayedCFilter = NULL;
+
+static void _testRelayedCFilter(void *info, BRBitcoinCompactFilter *filter)
+{
+    if (_relayedCFilter) btcCompactFilterFree(_relayedCFilter);
+    _relayedCFilter = filter;
+}
+
+void btcPeerAcceptMessageTest(BRBitcoinPeer *peer, const uint8_t *msg, size_t len, const char *type);
+
+int btcCompactFilterTests()
+{
+    int r = 1;
+    // testnet genesis block, from the BIP158 test vectors
+    UInt256 blockHash = UInt256Reverse(uint256("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943"));
+    char script[] = "\x41\x04\x67\x8a\xfd\xb0\xfe\x55\x48\x27\x19\x67\xf1\xa6\x71\x30\xb7\x10\x5c\xd6\xa8\x28\xe0\x39"
+    "\x09\xa6\x79\x62\xe0\xea\x1f\x61\xde\xb6\x49\xf6\xbc\x3f\x4c\xef\x38\xc4\xf3\x55\x04\xe5\x1e\xc1\x12\xde\x5c"
+    "\x38\x4d\xf7\xba\x0b\x8d\x57\x8a\x4c\x70\x2b\x6b\xf1\x1d\x5f\xac";
+    const uint8_t *items[] = { (uint8_t *)script, (uint8_t *)script };
+    size_t itemLens[] = { sizeof(script) - 1, sizeof(script) - 2 };
+    char d[] = "\x01\x9d\xfc\xa8";
+    BRBitcoinCompactFilter *f = btcCompactFilterNew(blockHash, items, itemLens, 1), *g;
+
+    if (f->n != 1 || f->length != sizeof(d) - 1 || memcmp(f->filter, d, f->length) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterNew() test\n", __func__);
+
+    if (! UInt256Eq(btcCompactFilterHeader(btcCompactFilterHash(f), UINT256_ZERO),
+                    UInt256Reverse(uint256("21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750"))))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterHeader() test\n", __func__);
+
+    if (! btcCompactFilterContainsData(f, items[0], itemLens[0]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterContainsData() test 1\n", __func__);
+
+    if (btcCompactFilterContainsData(f, items[1], itemLens[1]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterContainsData() test 2\n", __func__);
+
+    if (! btcCompactFilterMatchAny(f, &items[0], &itemLens[0], 2) ||
+        btcCompactFilterMatchAny(f, &items[1], &itemLens[1], 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterMatchAny() test\n", __func__);
+
+    g = btcCompactFilterParse(CFILTER_TYPE_BASIC, blockHash, (uint8_t *)d, sizeof(d) - 1);
+
+    if (! g || g->n != 1 || ! btcCompactFilterContainsData(g, items[0], itemLens[0]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterParse() test 1\n", __func__);
+
+    if (g) btcCompactFilterFree(g);
+    g = btcCompactFilterParse(CFILTER_TYPE_BASIC, blockHash, (uint8_t *)d, 1); // truncated
+
+    if (g && btcCompactFilterContainsData(g, items[0], itemLens[0]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcCompactFilterParse() test 2\n", __func__);
+
+    if (g) btcCompactFilterFree(g);
+
+    // a cfilter message is relayed only to peers syncing with compact filters
+    BRBitcoinPeer *p = btcPeerNew(btcChainParams(true)->magicNumber);
+    uint8_t msg[sizeof(uint8_t) + sizeof(UInt256) + 1 + sizeof(d) - 1];
+
+    msg[0] = CFILTER_TYPE_BASIC;
+    UInt256Set(&msg[1], blockHash);
+    msg[1 + sizeof(UInt256)] = sizeof(d) - 1;
+    memcpy(&msg[2 + sizeof(UInt256)], d, sizeof(d) - 1);
+    btcPeerAcceptMessageTest(p, msg, sizeof(msg), MSG_CFILTER);
+
+    if (_relayedCFilter)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerAcceptMessage() unrequested cfilter test\n", __func__);
+
+    btcPeerSetCompactFilterCallbacks(p, NULL, NULL, _testRelayedCFilter, NULL, NULL);
+    btcPeerAcceptMessageTest(p, msg, sizeof(msg), MSG_CFILTER);
+
+    if (! _relayedCFilter || ! UInt256Eq(_relayedCFilter->blockHash, blockHash) ||
+        ! UInt256Eq(btcCompactFilterHash(_relayedCFilter), btcCompactFilterHash(f)))
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerAcceptMessage() cfilter test\n", __func__);
+
+    if (_relayedCFilter) btcCompactFilterFree(_relayedCFilter);
+    _relayedCFilter = NULL;
+    btcPeerFree(p);
+    btcCompactFilterFree(f);
+    return r;
+}
+
 // true if block and otherBlock have equal data (in their respective structures).
 static int btcMerkleBlockEqual (const BRBitcoinMerkleBlock *block1, const BRBitcoinMerkleBlock *block2) {
     return 0 == memcmp(&block1->blockHash, &block2->blockHash, sizeof(UInt256))
@@ -3028,7 +3607,7 @@ int btcMerkleBlockTests()
     "\xab\x74\x1f\xa7\x82\x76\x22\x26\x51\x20\x9f\xe1\xa2\xc4\xc0\xfa\x1c\x58\x51\x0a\xec\x8b\x09\x0d\xd1\xeb\x1f\x82"
     "\xf9\xd2\x61\xb8\x27\x3b\x52\x5b\x02\xff\x1a";
     uint8_t block2[sizeof(block) - 1];
-    BRBitcoinMerkleBlock *b;
+    BRBitcoinMerkleBlock *b, *c;
     
     b = btcMerkleBlockParse((uint8_t *)block, sizeof(block) - 1);
     
@@ -3065,13 +3644,90 @@ int btcMerkleBlockTests()
     if (! UInt256Eq(txHashes[3], uint256("c9ab658448c10b6921b7a4ce3021eb22ed6bb6a7fde1e5bcc4b1db6615c6abc5")))
         r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockTxHashes() test 4\n", __func__);
     
-    // TODO: test a block with an odd number of tree rows both at the tx level and merkle node level
+    // test blocks with every tx matched, including odd numbers of tree rows at the tx and merkle node levels, and the
+    // (CVE-2012-2459) vulnerability where the last tx is repeated to make an even row
+    
+    for (uint32_t txCount = 1; txCount <= 40; txCount++) {
+        UInt256 hashes[txCount], row[txCount + 1];
+        uint8_t flags[txCount];
+        size_t rowCount = txCount;
+        
+        memset(hashes, 0, sizeof(hashes));
+        for (uint32_t i = 0; i < txCount; i++) UInt32SetLE(&hashes[i], i + 1), UInt32SetLE(&hashes[i].u8[28], txCount);
+        if (txCount % 2 == 0 && txCount > 2) hashes[txCount - 1] = hashes[txCount - 2]; // (CVE-2012-2459)
+        memcpy(row, hashes, sizeof(hashes));
+        memset(flags, 0xff, sizeof(flags));
+        
+        while (rowCount > 1) { // the merkle root, one pair at a time
+            if (rowCount % 2) row[rowCount] = row[rowCount - 1], rowCount++;
+            for (size_t i = 0; i < rowCount/2; i++) BRSHA256_2(&row[i], &row[i*2], sizeof(UInt256)*2);
+            rowCount /= 2;
+        }
+        
+        c = btcMerkleBlockNew();
+        c->target = b->target;
+        c->timestamp = b->timestamp;
+        c->totalTx = txCount;
+        c->merkleRoot = row[0];
+        btcMerkleBlockSetTxHashes(c, hashes, txCount, flags, sizeof(flags));
+        c->hashesCount = txCount;
+        c->flagsLen = sizeof(flags);
+        
+        if (btcMerkleBlockIsValid(c, (uint32_t)time(NULL)) != (txCount % 2 == 1 || txCount == 2))
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockIsValid() %"PRIu32" txs\n", __func__, txCount);
+        
+        if (btcMerkleBlockTxHashes(c, NULL, 0) != txCount)
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockTxHashes() %"PRIu32" txs\n", __func__, txCount);
+        
+        btcMerkleBlockFree(c);
+    }
 
-    // TODO: XXX test btcMerkleBlockVerifyDifficulty()
+    // test partial merkle trees built from full blocks, matching every third tx
     
-    // TODO: test (CVE-2012-2459) vulnerability
+    for (uint32_t txCount = 1; txCount <= 20; txCount++) {
+        UInt256 hashes[txCount], matched[txCount], row[txCount + 1];
+        uint8_t matches[txCount];
+        size_t rowCount = txCount, matchedCount = 0;
+        
+        memset(hashes, 0, sizeof(hashes));
+        
+        for (uint32_t i = 0; i < txCount; i++) {
+            UInt32SetLE(&hashes[i], i + 1), UInt32SetLE(&hashes[i].u8[28], txCount);
+            matches[i] = (i % 3 == 0);
+            if (matches[i]) matched[matchedCount++] = hashes[i];
+        }
+        
+        memcpy(row, hashes, sizeof(hashes));
+        
+        while (rowCount > 1) {
+            if (rowCount % 2) row[rowCount] = row[rowCount - 1], rowCount++;
+            for (size_t i = 0; i < rowCount/2; i++) BRSHA256_2(&row[i], &row[i*2], sizeof(UInt256)*2);
+            rowCount /= 2;
+        }
+        
+        c = btcMerkleBlockNew();
+        c->target = b->target;
+        c->timestamp = b->timestamp;
+        c->merkleRoot = row[0];
+        btcMerkleBlockSetMatchedTxHashes(c, hashes, matches, txCount);
+        
+        if (! btcMerkleBlockIsValid(c, (uint32_t)time(NULL)))
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockSetMatchedTxHashes() %"PRIu32" txs\n", __func__,
+                           txCount);
+        
+        UInt256 txHashes[txCount];
+        
+        if (btcMerkleBlockTxHashes(c, txHashes, txCount) != matchedCount ||
+            memcmp(txHashes, matched, matchedCount*sizeof(UInt256)) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockTxHashes() %"PRIu32" txs matched\n", __func__,
+                           txCount);
+        
+        btcMerkleBlockFree(c);
+    }
+
+    // TODO: XXX test btcMerkleBlockVerifyDifficulty()
 
-    BRBitcoinMerkleBlock *c = btcMerkleBlockCopy(b);
+    c = btcMerkleBlockCopy(b);
 
     if (!btcMerkleBlockEqual(b, c))
         r = 0, fprintf(stderr, "***FAILED*** %s: btcMerkleBlockEqual() test 1\n", __func__);
@@ -3534,7 +4190,482 @@ int btcPaymentProtocolEncryptionTests()
     return r;
 }
 
-void btcPeerAcceptMessageTest(BRBitcoinPeer *peer, const uint8_t *msg, size_t len, const char *type);
+static long _relayedHeadersCount = -1;
+
+static void _testRelayedHeaders(void *info, size_t headersCount)
+{
+    _relayedHeadersCount = (long)headersCount;
+}
+
+int btcPeerReceiveTest(BRBitcoinPeer *peer, const uint8_t *buf, size_t bufLen);
+
+int btcPeerReceiveTests()
+{
+    int r = 1;
+    uint32_t magicNumber = btcChainParams(true)->magicNumber;
+    BRBitcoinPeer *p = btcPeerNew(magicNumber);
+    uint8_t msg[3 + 24 + 1], hash[32], payload[] = { 0x00 };
+
+    // a few junk bytes, then a headers message with no headers
+    msg[0] = 0x01, msg[1] = 0x02, msg[2] = 0x03;
+    UInt32SetLE(&msg[3], magicNumber);
+    strncpy((char *)&msg[7], MSG_HEADERS, 12);
+    UInt32SetLE(&msg[19], sizeof(payload));
+    BRSHA256_2(hash, payload, sizeof(payload));
+    memcpy(&msg[23], hash, sizeof(uint32_t));
+    msg[27] = payload[0];
+    btcPeerSetHeadersFirst(p, _testRelayedHeaders);
+
+    if (btcPeerReceiveTest(p, msg, 10) != 0 || _relayedHeadersCount != -1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerReceive() partial header test\n", __func__);
+
+    if (btcPeerReceiveTest(p, &msg[10], sizeof(msg) - 11) != 0 || _relayedHeadersCount != -1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerReceive() partial payload test\n", __func__);
+
+    if (btcPeerReceiveTest(p, &msg[sizeof(msg) - 1], 1) != 0 || _relayedHeadersCount != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerReceive() headers test\n", __func__);
+
+    msg[23] ^= 0xff; // corrupt the checksum
+
+    if (btcPeerReceiveTest(p, msg, sizeof(msg)) != EPROTO)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerReceive() checksum test\n", __func__);
+
+    btcPeerFree(p);
+    return r;
+}
+
+size_t btcPeerSendTest(BRBitcoinPeer *peer, int socket);
+
+int btcPeerSendTests()
+{
+    int r = 1, fds[2];
+    uint32_t magicNumber = btcChainParams(true)->magicNumber;
+    BRBitcoinPeer *p = btcPeerNew(magicNumber);
+    size_t payloadLen = 0x100000, queued, off = 0;
+    uint8_t *payload = malloc(payloadLen), *buf = malloc(24 + payloadLen), hash[32];
+    ssize_t n;
+
+    for (size_t i = 0; i < payloadLen; i++) payload[i] = (uint8_t)i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        r = 0, fprintf(stderr, "***FAILED*** %s: socketpair() %s\n", __func__, strerror(errno));
+    }
+    else {
+        // a message larger than the socket buffer is queued, rather than blocking until the remote end reads it
+        btcPeerSendTest(p, fds[0]);
+        btcPeerSendMessage(p, payload, payloadLen, MSG_TX);
+        queued = btcPeerSendTest(p, fds[0]);
+
+        if (queued == 0 || queued >= 24 + payloadLen)
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerSendMessage() queue test\n", __func__);
+
+        while (off < 24 + payloadLen && (n = recv(fds[1], &buf[off], 24 + payloadLen - off, MSG_DONTWAIT)) != 0) {
+            if (n > 0) off += (size_t)n;
+            else if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR) break;
+            queued = btcPeerSendTest(p, fds[0]); // the rest is sent as the socket becomes writable
+        }
+
+        BRSHA256_2(hash, payload, payloadLen);
+
+        if (off != 24 + payloadLen || queued != 0 || UInt32GetLE(buf) != magicNumber ||
+            strncmp((const char *)&buf[4], MSG_TX, 12) != 0 || UInt32GetLE(&buf[16]) != payloadLen ||
+            memcmp(&buf[20], hash, sizeof(uint32_t)) != 0 || memcmp(&buf[24], payload, payloadLen) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerSendMessage() send test\n", __func__);
+
+        btcPeerSendTest(p, -1);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    btcPeerFree(p);
+    free(payload);
+    free(buf);
+    return r;
+}
+
+size_t btcPeerManagerTxPeerIndexTest(const UInt256 txHashes[], size_t txCount, const BRBitcoinPeer peers[],
+                                     size_t peersCount);
+
+int btcTxPeerIndexTests()
+{
+    int r = 1;
+    size_t txCount = 25000, count;
+    UInt256 *txHashes = calloc(txCount, sizeof(*txHashes));
+    BRBitcoinPeer peers[3];
+
+    memset(peers, 0, sizeof(peers));
+
+    for (size_t i = 0; i < sizeof(peers)/sizeof(*peers); i++) {
+        peers[i].address.u16[5] = 0xffff;
+        peers[i].address.u32[3] = (uint32_t)i + 1;
+        peers[i].port = 8333;
+    }
+
+    for (size_t i = 0; i < txCount; i++) BRSHA256(&txHashes[i], &i, sizeof(i));
+
+    // replay a large mempool inv stream, every tx announced by every peer
+    count = btcPeerManagerTxPeerIndexTest(txHashes, txCount, peers, sizeof(peers)/sizeof(*peers));
+
+    if (count != 10000) // TX_PEER_LIST_CAPACITY
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerManagerTxPeerIndexTest() capacity test\n", __func__);
+
+    count = btcPeerManagerTxPeerIndexTest(txHashes, 100, peers, sizeof(peers)/sizeof(*peers));
+
+    if (count != 100)
+        r = 0, fprintf(stderr, "***FAILED*** %s: btcPeerManagerTxPeerIndexTest() test\n", __func__);
+
+    free(txHashes);
+    return r;
+}
+
+void btcPeerSetConnectedTest(BRBitcoinPeer *peer, uint32_t lastBlock);
+void btcPeerManagerPeerConnectedTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer);
+void btcPeerManagerRelayedHeadersTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer,
+                                      BRBitcoinMerkleBlock *headers[], size_t headersCount);
+void btcPeerManagerRelayedBlockTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer,
+                                    BRBitcoinTransaction *txs[], size_t txCount, BRBitcoinMerkleBlock *block);
+size_t btcPeerManagerBlockRangesTest(BRBitcoinPeerManager *manager, uint32_t startHeights[], BRBitcoinPeer *peers[],
+                                     size_t count, size_t *staleCount, uint32_t *syncedHeight);
+int btcPeerManagerHeadersPendingTest(BRBitcoinPeerManager *manager);
+size_t btcPeerPongTest(BRBitcoinPeer *peer);
+int btcPeerManagerBloomFilterContainsTest(BRBitcoinPeerManager *manager, const uint8_t *data, size_t dataLen);
+
+#define RANGE_TEST_START (2016*3000) // a difficulty transition above every checkpoint
+#define RANGE_TEST_COUNT 1300        // headers relayed after RANGE_TEST_START
+#define RANGE_TEST_WINDOW (40*500)   // most headers held ahead of the synced height, BLOCK_RANGE_WINDOW*BLOCK_RANGE_SIZE
+
+static int _rangeTestVerifyDifficulty(const BRBitcoinMerkleBlock *block, const BRSet *blockSet)
+{
+    return 1; // the test chain has no proof-of-work
+}
+
+static UInt256 _rangeTestHash(uint32_t n)
+{
+    UInt256 hash;
+
+    BRSHA256(&hash, &n, sizeof(n));
+    return hash;
+}
+
+// the header at height in the test chain, or its merkle block, matching tx if it isn't NULL
+static BRBitcoinMerkleBlock *_rangeTestBlock(uint32_t height, const BRBitcoinTransaction *tx, int isHeader)
+{
+    BRBitcoinMerkleBlock *block = btcMerkleBlockNew();
+    UInt256 txHash = (tx) ? tx->txHash : _rangeTestHash(~height);
+    uint8_t match = (tx != NULL);
+
+    block->blockHash = _rangeTestHash(height);
+    block->prevBlock = _rangeTestHash(height - 1);
+    block->height = height;
+    block->timestamp = 1600000000 + (height - RANGE_TEST_START)*600;
+    if (! isHeader) btcMerkleBlockSetMatchedTxHashes(block, &txHash, &match, 1);
+    return block;
+}
+
+// relays the merkle blocks from startHeight through startHeight + count - 1 from peer, with a copy of tx before the
+// block at txHeight
+static void _rangeTestRelay(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer, uint32_t startHeight, uint32_t count,
+                            const BRBitcoinTransaction *tx, uint32_t txHeight)
+{
+    for (uint32_t height = startHeight; height < startHeight + count; height++) {
+        BRBitcoinTransaction *txs[] = { (tx && height == txHeight) ? btcTransactionCopy(tx) : NULL };
+
+        btcPeerManagerRelayedBlockTest(manager, peer, txs, (txs[0]) ? 1 : 0, _rangeTestBlock(height, txs[0], 0));
+    }
+}
+
+int btcBlockRangeSyncTests()
+{
+    int r = 1;
+    BRBitcoinChainParams params = *btcChainParams(true);
+    UInt512 seed = UINT512_ZERO;
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRBitcoinWallet *w = btcWalletNew(params.addrParams, NULL, 0, mpk);
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRKey k;
+    BRAddress addr, recvAddr = btcWalletReceiveAddress(w);
+    BRBitcoinTransaction *tx1 = btcTransactionNew(), *tx2 = btcTransactionNew(), *spend = btcTransactionNew(), *tx;
+    BRBitcoinMerkleBlock *base = _rangeTestBlock(RANGE_TEST_START, NULL, 1), *headers[RANGE_TEST_COUNT];
+    BRBitcoinPeerManager *manager;
+    BRBitcoinPeer *peers[4], *a, *b;
+    uint32_t heights[4], syncedHeight, start = RANGE_TEST_START, earliestKeyTime;
+    size_t count, staleCount;
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRKeyAddress(&k, addr.s, sizeof(addr), params.addrParams);
+
+    uint8_t inScript[BRAddressScriptPubKey(NULL, 0, params.addrParams, addr.s)];
+    size_t inScriptLen = BRAddressScriptPubKey(inScript, sizeof(inScript), params.addrParams, addr.s);
+    uint8_t outScript[BRAddressScriptPubKey(NULL, 0, params.addrParams, recvAddr.s)];
+    size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), params.addrParams, recvAddr.s);
+
+    // two tx receiving to the wallet
+    btcTransactionAddInput(tx1, _rangeTestHash(1), 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    btcTransactionAddOutput(tx1, SATOSHIS, outScript, outScriptLen);
+    btcTransactionSign(tx1, 0, &k, 1);
+    btcTransactionAddInput(tx2, _rangeTestHash(2), 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    btcTransactionAddOutput(tx2, SATOSHIS, outScript, outScriptLen);
+    btcTransactionSign(tx2, 0, &k, 1);
+
+    // keys are older than the first 200 blocks, by more than a week
+    earliestKeyTime = base->timestamp + 200*600 + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT + 1;
+    params.verifyDifficulty = _rangeTestVerifyDifficulty;
+    params.checkpoints = NULL;
+    params.checkpointsCount = 0;
+    manager = btcPeerManagerNew(&params, w, earliestKeyTime, &base, 1, NULL, 0);
+
+    for (size_t i = 0; i < 2; i++) { // the first peer is the download peer
+        peers[i] = btcPeerNew(params.magicNumber);
+        peers[i]->address.u16[5] = 0xffff;
+        peers[i]->address.u32[3] = (uint32_t)i + 1;
+        peers[i]->port = params.standardPort;
+        peers[i]->services = params.services | SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM;
+        btcPeerSetConnectedTest(peers[i], start + RANGE_TEST_COUNT);
+        btcPeerManagerPeerConnectedTest(manager, peers[i]);
+    }
+
+    a = peers[0], b = peers[1];
+    for (uint32_t i = 0; i < RANGE_TEST_COUNT; i++) headers[i] = _rangeTestBlock(start + 1 + i, NULL, 1);
+    btcPeerManagerRelayedHeadersTest(manager, a, headers, RANGE_TEST_COUNT);
+
+    // headers older than earliestKeyTime are skipped, the rest are split into ranges, at most two in flight per peer
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (count != 3 || syncedHeight != start + 200 || heights[0] != start + 201 || heights[1] != start + 701 ||
+        heights[2] != start + 1201 || peers[0] != b || peers[1] != b || peers[2] != a)
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range split test\n", __func__);
+
+    // a range completed before the ones ahead of it is held
+    _rangeTestRelay(manager, a, start + 1201, 100, tx2, start + 1250);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (count != 3 || syncedHeight != start + 200 || btcWalletTransactionForHash(w, tx2->txHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range order test\n", __func__);
+
+    // the first range is applied up to the block receiving to the wallet, the rest is requested again, and ranges in
+    // flight, or already completed, were filtered without the new wallet addresses, so they're requested again
+    _rangeTestRelay(manager, b, start + 201, 500, tx1, start + 300);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+    tx = btcWalletTransactionForHash(w, tx1->txHash);
+
+    if (count != 3 || staleCount != 1 || syncedHeight != start + 300 || ! tx || tx->blockHeight != start + 300 ||
+        heights[0] != start + 301 || heights[1] != start + 701 || heights[2] != start + 1201 || peers[0] != b ||
+        peers[1] != a || peers[2] != a || btcWalletTransactionForHash(w, tx2->txHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range receive split test\n", __func__);
+
+    // the output received through peer b is added to the filters of every peer, a has to match tx spending it
+    UInt256Set(o, tx1->txHash);
+    UInt32SetLE(&o[sizeof(UInt256)], 0);
+
+    if (! btcPeerManagerBloomFilterContainsTest(manager, o, sizeof(o)))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range receive filter test\n", __func__);
+
+    // a spend of the received output with no change, matched only by its outpoint
+    btcTransactionAddInput(spend, tx1->txHash, 0, SATOSHIS, outScript, outScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    btcTransactionAddOutput(spend, SATOSHIS - 1000, inScript, inScriptLen);
+    btcWalletSignTransaction(w, spend, 0x00, params.bip32depth, params.bip32child, &seed, sizeof(seed));
+
+    // replies to the stale request are discarded
+    _rangeTestRelay(manager, b, start + 701, 500, NULL, 0);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (count != 3 || staleCount != 0 || syncedHeight != start + 300 || peers[0] != b || peers[1] != a)
+        r = 0, fprintf(stderr, "***FAILED*** %s: stale block range test\n", __func__);
+
+    // completed ranges are applied in chain order once the first one completes
+    _rangeTestRelay(manager, a, start + 701, 500, spend, start + 800);
+    _rangeTestRelay(manager, a, start + 1201, 100, tx2, start + 1250);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (count != 3 || syncedHeight != start + 300 || btcWalletTransactionForHash(w, tx2->txHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range order test 2\n", __func__);
+
+    _rangeTestRelay(manager, b, start + 301, 400, NULL, 0);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+    tx = btcWalletTransactionForHash(w, tx2->txHash);
+
+    if (count != 1 || syncedHeight != start + 1250 || ! tx || tx->blockHeight != start + 1250 ||
+        heights[0] != start + 1251 || peers[0] != b)
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range order test 3\n", __func__);
+
+    tx = btcWalletTransactionForHash(w, spend->txHash);
+
+    if (! btcTransactionIsSigned(spend) || ! tx || tx->blockHeight != start + 800 || btcWalletBalance(w) != SATOSHIS)
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range spend test\n", __func__);
+
+    _rangeTestRelay(manager, b, start + 1251, 50, NULL, 0);
+    count = btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (count != 0 || staleCount != 0 || syncedHeight != start + RANGE_TEST_COUNT)
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range sync test\n", __func__);
+
+    btcPeerManagerFree(manager);
+
+    // headers are requested in batches of 2000 until they're a window of block ranges ahead of the synced height
+    base = _rangeTestBlock(RANGE_TEST_START, NULL, 1);
+    manager = btcPeerManagerNew(&params, w, base->timestamp, &base, 1, NULL, 0);
+    a = btcPeerNew(params.magicNumber);
+    a->address.u16[5] = 0xffff;
+    a->address.u32[3] = 1;
+    a->port = params.standardPort;
+    a->services = params.services | SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM;
+    btcPeerSetConnectedTest(a, start + RANGE_TEST_WINDOW + 10000);
+    btcPeerManagerPeerConnectedTest(manager, a);
+
+    for (uint32_t height = start; height < start + RANGE_TEST_WINDOW + 2000; height += 2000) {
+        BRBitcoinMerkleBlock *batch[2000];
+
+        if (! btcPeerManagerHeadersPendingTest(manager))
+            r = 0, fprintf(stderr, "***FAILED*** %s: block range headers test %"PRIu32"\n", __func__, height - start);
+        for (uint32_t i = 0; i < 2000; i++) batch[i] = _rangeTestBlock(height + 1 + i, NULL, 1);
+        btcPeerManagerRelayedHeadersTest(manager, a, batch, 2000);
+    }
+
+    if (btcPeerManagerHeadersPendingTest(manager))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range headers window test\n", __func__);
+
+    // more headers are requested once applied ranges bring the synced height within a window of the last header
+    _rangeTestRelay(manager, a, start + 1, 1000, NULL, 0);
+
+    if (btcPeerManagerHeadersPendingTest(manager))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range headers window test 2\n", __func__);
+
+    _rangeTestRelay(manager, a, start + 1001, 1000, NULL, 0);
+    btcPeerManagerBlockRangesTest(manager, heights, peers, 4, &staleCount, &syncedHeight);
+
+    if (syncedHeight != start + 2000 || ! btcPeerManagerHeadersPendingTest(manager))
+        r = 0, fprintf(stderr, "***FAILED*** %s: block range headers window test 3\n", __func__);
+
+    btcPeerManagerFree(manager);
+    btcWalletFree(w);
+    btcTransactionFree(tx1);
+    btcTransactionFree(tx2);
+    btcTransactionFree(spend);
+    return r;
+}
+
+// reads the messages a peer sent to socket, and counts the filterload and filteradd messages
+static void _filterTestSentCounts(int socket, size_t *filterloadCount, size_t *filteraddCount)
+{
+    uint8_t buf[0x10000];
+    size_t off = 0, len = 0;
+    ssize_t n;
+
+    *filterloadCount = *filteraddCount = 0;
+    while (len < sizeof(buf) && (n = recv(socket, &buf[len], sizeof(buf) - len, MSG_DONTWAIT)) > 0) len += (size_t)n;
+
+    while (off + 24 <= len) {
+        if (strncmp((const char *)&buf[off + 4], MSG_FILTERLOAD, 12) == 0) (*filterloadCount)++;
+        if (strncmp((const char *)&buf[off + 4], MSG_FILTERADD, 12) == 0) (*filteraddCount)++;
+        off += 24 + UInt32GetLE(&buf[off + 16]);
+    }
+}
+
+int btcBloomFilterExtendTests()
+{
+    int r = 1, fds[2][2];
+    BRBitcoinChainParams params = *btcChainParams(true);
+    UInt512 seed = UINT512_ZERO;
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRBitcoinWallet *w = btcWalletNew(params.addrParams, NULL, 0, mpk);
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRKey k;
+    BRAddress addr, addrs[SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED];
+    BRBitcoinTransaction *tx0 = btcTransactionNew(), *tx = btcTransactionNew(), *txs[1];
+    BRBitcoinMerkleBlock *base = _rangeTestBlock(RANGE_TEST_START, NULL, 1);
+    BRBitcoinPeerManager *manager;
+    BRBitcoinPeer *peers[2];
+    UInt160 hash = UINT160_ZERO;
+    size_t count, loadedCount, pkhsCount, filterloadCount, filteraddCount;
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRKeyAddress(&k, addr.s, sizeof(addr), params.addrParams);
+
+    uint8_t inScript[BRAddressScriptPubKey(NULL, 0, params.addrParams, addr.s)];
+    size_t inScriptLen = BRAddressScriptPubKey(inScript, sizeof(inScript), params.addrParams, addr.s);
+
+    // the wallet already has an output the filters are loaded with
+    btcWalletUnusedAddrs(w, addrs, 1, SEQUENCE_EXTERNAL_CHAIN);
+
+    uint8_t outScript0[BRAddressScriptPubKey(NULL, 0, params.addrParams, addrs[0].s)];
+    size_t outScript0Len = BRAddressScriptPubKey(outScript0, sizeof(outScript0), params.addrParams, addrs[0].s);
+
+    btcTransactionAddInput(tx0, _rangeTestHash(3), 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    btcTransactionAddOutput(tx0, SATOSHIS, outScript0, outScript0Len);
+    btcTransactionSign(tx0, 0, &k, 1);
+    btcWalletRegisterTransaction(w, tx0);
+
+    params.verifyDifficulty = _rangeTestVerifyDifficulty;
+    params.checkpoints = NULL;
+    params.checkpointsCount = 0;
+    manager = btcPeerManagerNew(&params, w, base->timestamp, &base, 1, NULL, 0);
+
+    // the chain is already synced, so each peer has a bloom filter loaded as it connects
+    for (size_t i = 0; i < 2; i++) {
+        peers[i] = btcPeerNew(params.magicNumber);
+        peers[i]->address.u16[5] = 0xffff;
+        peers[i]->address.u32[3] = (uint32_t)i + 1;
+        peers[i]->port = params.standardPort;
+        peers[i]->services = params.services | SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM;
+        btcPeerSetConnectedTest(peers[i], RANGE_TEST_START);
+        btcPeerManagerPeerConnectedTest(manager, peers[i]);
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) < 0) {
+            fprintf(stderr, "***FAILED*** %s: socketpair() %s\n", __func__, strerror(errno));
+            return 0;
+        }
+
+        btcPeerSendTest(peers[i], fds[i][0]);
+    }
+
+    // a tx receiving to a wallet address near the end of the spare addresses the filters were loaded with
+    loadedCount = btcWalletChainPKHs(w, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+    btcWalletUnusedAddrs(w, addrs, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN);
+
+    uint8_t outScript[BRAddressScriptPubKey(NULL, 0, params.addrParams, addrs[105].s)];
+    size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), params.addrParams, addrs[105].s);
+
+    btcTransactionAddInput(tx, _rangeTestHash(4), 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    btcTransactionAddOutput(tx, SATOSHIS, outScript, outScriptLen);
+    btcTransactionSign(tx, 0, &k, 1);
+    txs[0] = btcTransactionCopy(tx);
+    btcPeerManagerRelayedBlockTest(manager, peers[0], txs, 1, _rangeTestBlock(RANGE_TEST_START + 1, tx, 0));
+
+    // once the download peer sends pong, the new addresses and output are sent to every peer with filteradd
+    for (count = 0; count < 10 && (btcPeerPongTest(peers[0]) > 0 || btcPeerPongTest(peers[1]) > 0); count++);
+    pkhsCount = btcWalletChainPKHs(w, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+    UInt160 pkhs[pkhsCount];
+
+    btcWalletChainPKHs(w, pkhs, pkhsCount, SEQUENCE_EXTERNAL_CHAIN);
+    UInt256Set(o, tx->txHash);
+    UInt32SetLE(&o[sizeof(UInt256)], 0);
+
+    for (size_t i = 0; i < 2; i++) { // the addresses past the ones loaded, and the received output
+        _filterTestSentCounts(fds[i][1], &filterloadCount, &filteraddCount);
+
+        if (filterloadCount != 0 || filteraddCount != pkhsCount - loadedCount + 1)
+            r = 0, fprintf(stderr, "***FAILED*** %s: bloom filter extend test %zu\n", __func__, i);
+    }
+
+    if (pkhsCount <= loadedCount ||
+        ! btcPeerManagerBloomFilterContainsTest(manager, pkhs[pkhsCount - 1].u8, sizeof(*pkhs)) ||
+        ! btcPeerManagerBloomFilterContainsTest(manager, o, sizeof(o)) ||
+        btcPeerManagerBloomFilterContainsTest(manager, hash.u8, sizeof(hash)))
+        r = 0, fprintf(stderr, "***FAILED*** %s: bloom filter extend contains test\n", __func__);
+
+    for (size_t i = 0; i < 2; i++) {
+        btcPeerSendTest(peers[i], -1);
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+
+    btcPeerManagerFree(manager);
+    btcWalletFree(w);
+    btcTransactionFree(tx);
+    return r;
+}
 
 int btcPeerTests()
 {
@@ -3601,10 +4732,24 @@ int BRRunTests()
     printf("%s\n", (btcTransactionTests()) ? "success" : (fail++, "***FAIL***"));
     printf("btcWalletTests...                   ");
     printf("%s\n", (btcWalletTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcCoinSelectionTests...            ");
+    printf("%s\n", (btcCoinSelectionTests()) ? "success" : (fail++, "***FAIL***"));
     printf("btcBloomFilterTests...              ");
     printf("%s\n", (btcBloomFilterTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcCompactFilterTests...            ");
+    printf("%s\n", (btcCompactFilterTests()) ? "success" : (fail++, "***FAIL***"));
     printf("btcMerkleBlockTests...              ");
     printf("%s\n", (btcMerkleBlockTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcPeerReceiveTests...              ");
+    printf("%s\n", (btcPeerReceiveTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcPeerSendTests...                 ");
+    printf("%s\n", (btcPeerSendTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcTxPeerIndexTests...              ");
+    printf("%s\n", (btcTxPeerIndexTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcBlockRangeSyncTests...           ");
+    printf("%s\n", (btcBlockRangeSyncTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("btcBloomFilterExtendTests...        ");
+    printf("%s\n", (btcBloomFilterExtendTests()) ? "success" : (fail++, "***FAIL***"));
     printf("btcPaymentProtocolTests...          ");
     printf("%s\n", (btcPaymentProtocolTests()) ? "success" : (fail++, "***FAIL***"));
     printf("btcPaymentProtocolEncryptionTests...");
@@ -534,6 +534,39 @@ runPerfTestsCoder (int repeat, int many) {
     rlpCoderRelease(coderSaved);
 }
 
+static void
+testTransactionDecodeMany (void) {
+    printf ("==== Transaction Decode Many\n");
+
+    BRRlpCoder coder = rlpCoderCreate();
+
+    BRRlpData data;
+    data.bytes = hexDecodeCreate(&data.bytesCount, TEST_CODER_SIGNED_TX, strlen (TEST_CODER_SIGNED_TX));
+
+    BRRlpItem item = rlpDataGetItem(coder, data);
+    BREthereumTransaction transaction = ethTransactionRlpDecode(item, ethNetworkMainnet, RLP_TYPE_TRANSACTION_SIGNED, coder);
+    BREthereumAddress source = ethTransactionGetSourceAddress (transaction);
+    assert (ETHEREUM_BOOLEAN_IS_FALSE (ethAddressEqual (source, (BREthereumAddress) ETHEREUM_EMPTY_ADDRESS_INIT)));
+
+    BRRlpItem items[40];
+    for (size_t index = 0; index < 40; index++) items[index] = item;
+
+    BRArrayOf(BREthereumTransaction) transactions = ethTransactionRlpDecodeMany (items, 40, ethNetworkMainnet, RLP_TYPE_TRANSACTION_SIGNED, coder);
+    assert (40 == array_count (transactions));
+
+    for (size_t index = 0; index < 40; index++) {
+        assert (ETHEREUM_BOOLEAN_IS_TRUE (ethAddressEqual (source, ethTransactionGetSourceAddress (transactions[index]))));
+        assert (ETHEREUM_BOOLEAN_IS_TRUE (ethHashEqual (ethTransactionGetHash (transaction), ethTransactionGetHash (transactions[index]))));
+        ethTransactionRelease (transactions[index]);
+    }
+
+    array_free (transactions);
+    ethTransactionRelease (transaction);
+    rlpDataRelease(data);
+    rlpItemRelease(coder, item);
+    rlpCoderRelease(coder);
+}
+
 #if REFACTOR
 extern void
 installTokensForTest (void);
@@ -548,6 +581,7 @@ runTransactionTests (int reallySend) {
 #endif
 
     runAccountTests();
+    testTransactionDecodeMany ();
 #if REFACTOR
     testTransactionCodingEther ();
     testTransactionCodingToken ();
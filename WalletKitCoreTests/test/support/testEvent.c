@@ -9,10 +9,13 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <pthread.h>
+#include <time.h>
 #include "support/event/BREvent.h"
 #include "support/event/BREventAlarm.h"
+#include "support/event/BREventQueue.h"
 
 static pthread_cond_t testEventAlarmConditional = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t testEventAlarmMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -49,7 +52,189 @@ runEventTest (void) {
     alarmClockDestroy(alarmClock);
 }
 
+///
+/// MARK: - Event Queue
+///
+
+#define TEST_EVENT_QUEUE_PRODUCERS          (4)
+#define TEST_EVENT_QUEUE_PRODUCER_EVENTS    (50000)
+#define TEST_EVENT_QUEUE_BACKLOG_EVENTS     (100000)
+
+typedef struct {
+    struct BREventRecord base;
+    size_t producer;
+    size_t sequence;
+    double enqueued;
+} BRTestEvent;
+
+static BREventType testEventType = {
+    "Test Event",
+    sizeof (BRTestEvent),
+    NULL,
+    NULL
+};
+
+static double
+testEventTimeNow (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+static BRTestEvent
+testEventCreate (size_t producer, size_t sequence) {
+    return (BRTestEvent) { { NULL, &testEventType }, producer, sequence, testEventTimeNow() };
+}
+
+static BREventQueue
+testEventQueueCreate (int lockFree) {
+    return (lockFree
+            ? eventQueueCreateLockFree (sizeof (BRTestEvent))
+            : eventQueueCreate (sizeof (BRTestEvent)));
+}
+
+static void
+runEventQueueOrderTest (int lockFree) {
+    BREventQueue queue = testEventQueueCreate (lockFree);
+    BRTestEvent event;
+
+    assert (!eventQueueHasPending (queue));
+    assert (EVENT_STATUS_NONE_PENDING == eventQueueDequeue (queue, (BREvent*) &event));
+
+    // Tail events in order; head (OOB) events ahead of all of them, latest first.
+    for (size_t sequence = 2; sequence < 6; sequence++) {
+        event = testEventCreate (0, sequence);
+        eventQueueEnqueueTail (queue, (BREvent*) &event);
+    }
+    event = testEventCreate (0, 1);
+    eventQueueEnqueueHead (queue, (BREvent*) &event);
+    event = testEventCreate (0, 0);
+    eventQueueEnqueueHeadSignal (queue, (BREvent*) &event);
+    assert (eventQueueHasPending (queue));
+
+    for (size_t sequence = 0; sequence < 3; sequence++) {
+        assert (EVENT_STATUS_SUCCESS == eventQueueDequeue (queue, (BREvent*) &event));
+        assert (sequence == event.sequence);
+    }
+
+    // With some dequeued, tail and head events still go after and before the rest.
+    event = testEventCreate (0, 6);
+    eventQueueEnqueueTailSignal (queue, (BREvent*) &event);
+    event = testEventCreate (0, 2);
+    eventQueueEnqueueHead (queue, (BREvent*) &event);
+
+    for (size_t sequence = 2; sequence < 7; sequence++) {
+        assert (EVENT_STATUS_SUCCESS == eventQueueDequeueWait (queue, (BREvent*) &event));
+        assert (sequence == event.sequence);
+    }
+    assert (!eventQueueHasPending (queue));
+
+    // Emptied, the tail is reset.
+    event = testEventCreate (0, 7);
+    eventQueueEnqueueTail (queue, (BREvent*) &event);
+    event = testEventCreate (0, 8);
+    eventQueueEnqueueTail (queue, (BREvent*) &event);
+    assert (EVENT_STATUS_SUCCESS == eventQueueDequeue (queue, (BREvent*) &event) && 7 == event.sequence);
+    assert (EVENT_STATUS_SUCCESS == eventQueueDequeue (queue, (BREvent*) &event) && 8 == event.sequence);
+
+    // Cleared, pending events are gone.
+    eventQueueEnqueueTail (queue, (BREvent*) &event);
+    eventQueueClear (queue);
+    assert (!eventQueueHasPending (queue));
+
+    eventQueueDestroy (queue);
+}
+
+static void
+runEventQueueBacklogTest (int lockFree) {
+    BREventQueue queue = testEventQueueCreate (lockFree);
+    BRTestEvent event;
+
+    // Enqueuing at the tail takes constant time however many events are pending.
+    double start = testEventTimeNow();
+    for (size_t sequence = 0; sequence < TEST_EVENT_QUEUE_BACKLOG_EVENTS; sequence++) {
+        event = testEventCreate (0, sequence);
+        eventQueueEnqueueTail (queue, (BREvent*) &event);
+    }
+    double seconds = testEventTimeNow() - start;
+
+    for (size_t sequence = 0; sequence < TEST_EVENT_QUEUE_BACKLOG_EVENTS; sequence++) {
+        assert (EVENT_STATUS_SUCCESS == eventQueueDequeue (queue, (BREvent*) &event));
+        assert (sequence == event.sequence);
+    }
+    assert (!eventQueueHasPending (queue));
+
+    printf ("    Backlog (%s): %d events enqueued in %.3f s\n",
+            (lockFree ? "lock-free" : "locked"), TEST_EVENT_QUEUE_BACKLOG_EVENTS, seconds);
+
+    eventQueueDestroy (queue);
+}
+
+typedef struct {
+    BREventQueue queue;
+    size_t producer;
+} BRTestEventProducer;
+
+static void *
+testEventQueueProducer (void *context) {
+    BRTestEventProducer *producer = context;
+
+    for (size_t sequence = 0; sequence < TEST_EVENT_QUEUE_PRODUCER_EVENTS; sequence++) {
+        BRTestEvent event = testEventCreate (producer->producer, sequence);
+        eventQueueEnqueueTailSignal (producer->queue, (BREvent*) &event);
+    }
+    return NULL;
+}
+
+static void
+runEventQueueProducersTest (int lockFree) {
+    BREventQueue queue = testEventQueueCreate (lockFree);
+    BRTestEventProducer producers[TEST_EVENT_QUEUE_PRODUCERS];
+    pthread_t threads[TEST_EVENT_QUEUE_PRODUCERS];
+    size_t sequences[TEST_EVENT_QUEUE_PRODUCERS] = { 0 };
+
+    double start = testEventTimeNow();
+    for (size_t index = 0; index < TEST_EVENT_QUEUE_PRODUCERS; index++) {
+        producers[index] = (BRTestEventProducer) { queue, index };
+        pthread_create (&threads[index], NULL, testEventQueueProducer, &producers[index]);
+    }
+
+    // Every event arrives once, and in order for each producer.
+    double latency = 0.0;
+    size_t count = TEST_EVENT_QUEUE_PRODUCERS * TEST_EVENT_QUEUE_PRODUCER_EVENTS;
+    for (size_t index = 0; index < count; index++) {
+        BRTestEvent event;
+        assert (EVENT_STATUS_SUCCESS == eventQueueDequeueWait (queue, (BREvent*) &event));
+        assert (event.producer < TEST_EVENT_QUEUE_PRODUCERS);
+        assert (sequences[event.producer] == event.sequence);
+        sequences[event.producer]++;
+        latency += testEventTimeNow() - event.enqueued;
+    }
+    double seconds = testEventTimeNow() - start;
+
+    for (size_t index = 0; index < TEST_EVENT_QUEUE_PRODUCERS; index++)
+        pthread_join (threads[index], NULL);
+    assert (!eventQueueHasPending (queue));
+
+    printf ("    Producers (%s): %zu events in %.3f s, %.0f events/s, %.1f us mean latency\n",
+            (lockFree ? "lock-free" : "locked"), count, seconds, (double) count / seconds,
+            1e6 * latency / (double) count);
+
+    eventQueueDestroy (queue);
+}
+
+static void
+runEventQueueTests (void) {
+    printf ("  Event Queue\n");
+    for (int lockFree = 0; lockFree <= 1; lockFree++) {
+        runEventQueueOrderTest (lockFree);
+        runEventQueueBacklogTest (lockFree);
+        runEventQueueProducersTest (lockFree);
+    }
+}
+
 extern void
 runEventTests (void) {
+    runEventQueueTests();
     runEventTest();
 }
@@ -20,6 +20,7 @@
 #include "support/BRFileService.h"
 #include "support/BRAssert.h"
 #include "support/BROSCompat.h"
+#include "vendor/sqlite3/sqlite3.h"
 
 /// MARK: - File Service Tests
 
@@ -84,7 +85,7 @@ fileServiceErrorHandler (BRFileServiceContext context,
 
 static BRFileService
 fileServiceSetup (const char *path, const char *currency, const char *network, const char *type1) {
-    BRFileService fs = fileServiceCreate(path, currency, network, NULL, fileServiceErrorHandler);
+    BRFileService fs = fileServiceCreate(path, currency, network, NULL, NULL, fileServiceErrorHandler);
     if (NULL == fs) return fileServiceSetupError (path, fs);
 
     if (1 != fileServiceDefineType(fs, type1, 0, NULL, NULL, NULL, NULL))
@@ -116,7 +117,7 @@ static int runSupFileServiceTests (void) {
     if (0 == stat  (path, &dirStat)) _rmdir (path);
     if (0 != mkdir (path, 0000)) return 0;
 
-    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    fs = fileServiceCreate(path, currency, network, NULL, NULL, NULL);
     if (NULL != fs) return fileServiceTestDone(path, 0);
 
     //
@@ -125,7 +126,7 @@ static int runSupFileServiceTests (void) {
     if (0 == stat  (path, &dirStat)) _rmdir (path);
     if (0 != mkdir (path, 0700)) return 0;
 
-    fs = fileServiceCreate(path, currency, network, NULL, NULL);
+    fs = fileServiceCreate(path, currency, network, NULL, NULL, NULL);
     if (NULL == fs) return fileServiceTestDone(path, 0);
 
     // Confirm the full path exists.
@@ -228,6 +229,374 @@ static int runSupFileServiceMultiTests (void) {
     return fileServiceTestDone(path, success);
 }
 
+/// MARK: - File Service Entity Tests
+
+typedef struct {
+    UInt256 identifier;
+    uint64_t value;
+} SupEntity;
+
+static size_t
+supEntityHash (const void *entity) {
+    return (size_t) ((const SupEntity *) entity)->identifier.u32[0];
+}
+
+static int
+supEntityEq (const void *entity1, const void *entity2) {
+    return UInt256Eq (((const SupEntity *) entity1)->identifier,
+                      ((const SupEntity *) entity2)->identifier);
+}
+
+static UInt256
+supEntityIdentifier (BRFileServiceContext context,
+                     BRFileService fs,
+                     const void *entity) {
+    return ((const SupEntity *) entity)->identifier;
+}
+
+static void *
+supEntityReader (BRFileServiceContext context,
+                 BRFileService fs,
+                 uint8_t *bytes,
+                 uint32_t bytesCount) {
+    if (sizeof (SupEntity) != bytesCount) return NULL;
+
+    SupEntity *entity = malloc (sizeof (SupEntity));
+    memcpy (entity, bytes, sizeof (SupEntity));
+    return entity;
+}
+
+static uint8_t *
+supEntityWriter (BRFileServiceContext context,
+                 BRFileService fs,
+                 const void* entity,
+                 uint32_t *bytesCount) {
+    uint8_t *bytes = malloc (sizeof (SupEntity));
+    memcpy (bytes, entity, sizeof (SupEntity));
+    *bytesCount = sizeof (SupEntity);
+    return bytes;
+}
+
+static uint64_t
+supEntitySortKey (BRFileServiceContext context,
+                  BRFileService fs,
+                  const void *entity) {
+    return ((const SupEntity *) entity)->value;
+}
+
+static void
+supEntityRelease (BRFileServiceContext context,
+                  BRFileService fs,
+                  void *entity) {
+    free (entity);
+}
+
+static SupEntity
+supEntityCreate (uint64_t value) {
+    SupEntity entity = { UINT256_ZERO, value };
+    entity.identifier.u64[0] = value;
+    entity.identifier.u64[3] = ~value;
+    return entity;
+}
+
+static BRFileService
+fileServiceSetupEntity (const char *path, const char *currency, const char *network, const char *type,
+                        const BRFileServiceDurabilityProfile *profile) {
+    BRFileService fs = fileServiceCreate(path, currency, network, profile, NULL, fileServiceErrorHandler);
+    if (NULL == fs) return NULL;
+
+    if (1 != fileServiceDefineType (fs, type, 0, NULL,
+                                    supEntityIdentifier,
+                                    supEntityReader,
+                                    supEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type, 0)) {
+        fileServiceRelease (fs);
+        return NULL;
+    }
+
+    return fs;
+}
+
+/// Load all entities of `type` and confirm there are `count` of them, with values [0, count).
+static int
+fileServiceLoadEntityCheck (BRFileService fs, const char *type, uint64_t count) {
+    BRSet *entities = BRSetNew (supEntityHash, supEntityEq, 100);
+    int success = fileServiceLoad (fs, entities, type, 1);
+
+    success &= (count == BRSetCount (entities));
+    for (uint64_t value = 0; success && value < count; value++) {
+        SupEntity entity = supEntityCreate (value);
+        SupEntity *loaded = BRSetGet (entities, &entity);
+        success &= (NULL != loaded && value == loaded->value);
+    }
+
+    BRSetFreeAll (entities, free);
+    return success;
+}
+
+#define SUP_ENTITY_COUNT        (100)
+
+static int runSupFileServiceEntityTests (void) {
+    printf ("==== SUP:FileServiceEntity\n");
+
+    struct stat dirStat;
+
+    BRFileService fs;
+    char *path = "private";
+    char *currency = "btc", *network = "mainnet";
+    char *type1 = "foo";
+
+    char dbpath[1024];
+    sprintf (dbpath, "%s/%s-%s-entities.db", path,  currency, network);
+
+    //
+    // Save and load entities as BLOBs
+    //
+    if (0 == stat  (path, &dirStat)) _rmdir (path);
+    if (0 != mkdir (path, 0700)) return 0;
+
+    fs = fileServiceSetupEntity (path, currency, network, type1, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    for (uint64_t value = 0; value < SUP_ENTITY_COUNT; value++) {
+        SupEntity entity = supEntityCreate (value);
+        if (1 != fileServiceSave (fs, type1, &entity)) {
+            fileServiceRelease (fs);
+            return fileServiceTestDone (path, 0);
+        }
+    }
+
+    int success = fileServiceLoadEntityCheck (fs, type1, SUP_ENTITY_COUNT);
+    fileServiceRelease (fs);
+    if (!success) return fileServiceTestDone (path, 0);
+
+    //
+    // Migrate a legacy DB, with hex-encoded TEXT data, in place.
+    //
+    if (0 == stat  (path, &dirStat)) _rmdir (path);
+    if (0 != mkdir (path, 0700)) return 0;
+
+    sqlite3 *sdb;
+    if (SQLITE_OK != sqlite3_open (dbpath, &sdb)) return fileServiceTestDone (path, 0);
+
+    sqlite3_stmt *stmt;
+    success = (SQLITE_OK == sqlite3_exec (sdb,
+                                          "CREATE TABLE Entity(Type CHAR(64) NOT NULL, Hash CHAR(64) NOT NULL, "
+                                          "Data TEXT NOT NULL, PRIMARY KEY (Type, Hash));",
+                                          NULL, NULL, NULL) &&
+               SQLITE_OK == sqlite3_prepare_v2 (sdb, "INSERT INTO Entity (Type, Hash, Data) VALUES (?, ?, ?);",
+                                                -1, &stmt, NULL));
+
+    for (uint64_t value = 0; success && value < SUP_ENTITY_COUNT; value++) {
+        SupEntity entity = supEntityCreate (value);
+
+        // {HeaderFormatVersion, Current(Type)Version, EntityBytesCount, EntityBytes}
+        uint8_t bytes[1 + 1 + sizeof (uint32_t) + sizeof (SupEntity)] = { 0, 0 };
+        UInt32SetBE (&bytes[2], sizeof (SupEntity));
+        memcpy (&bytes[6], &entity, sizeof (SupEntity));
+
+        char data[2 * sizeof (bytes) + 1];
+        for (size_t index = 0; index < sizeof (bytes); index++)
+            sprintf (&data[2 * index], "%02x", bytes[index]);
+
+        sqlite3_reset (stmt);
+        success &= (SQLITE_OK   == sqlite3_bind_text (stmt, 1, type1, -1, SQLITE_STATIC) &&
+                    SQLITE_OK   == sqlite3_bind_text (stmt, 2, u256hex (entity.identifier), -1, SQLITE_TRANSIENT) &&
+                    SQLITE_OK   == sqlite3_bind_text (stmt, 3, data, -1, SQLITE_TRANSIENT) &&
+                    SQLITE_DONE == sqlite3_step (stmt));
+    }
+    sqlite3_finalize (stmt);
+    sqlite3_close (sdb);
+    if (!success) return fileServiceTestDone (path, 0);
+
+    fs = fileServiceSetupEntity (path, currency, network, type1, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    success = fileServiceLoadEntityCheck (fs, type1, SUP_ENTITY_COUNT);
+    fileServiceRelease (fs);
+    if (!success) return fileServiceTestDone (path, 0);
+
+    // Confirm no TEXT data remains
+    if (SQLITE_OK != sqlite3_open (dbpath, &sdb)) return fileServiceTestDone (path, 0);
+    success = (SQLITE_OK  == sqlite3_prepare_v2 (sdb, "SELECT COUNT(*) FROM Entity WHERE typeof(Data) != 'blob';",
+                                                 -1, &stmt, NULL) &&
+               SQLITE_ROW == sqlite3_step (stmt) &&
+               0          == sqlite3_column_int (stmt, 0));
+    sqlite3_finalize (stmt);
+    sqlite3_close (sdb);
+
+    return fileServiceTestDone (path, success);
+}
+
+static int runSupFileServiceBatchTests (void) {
+    printf ("==== SUP:FileServiceBatch\n");
+
+    struct stat dirStat;
+
+    BRFileService fs;
+    char *path = "private";
+    char *currency = "btc", *network = "mainnet";
+    char *type1 = "foo", *type2 = "bar";
+
+    if (0 == stat  (path, &dirStat)) _rmdir (path);
+    if (0 != mkdir (path, 0700)) return 0;
+
+    fs = fileServiceSetupEntity (path, currency, network, type1, &fileServiceDurabilityProfileWAL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type2, 0, NULL,
+                                    supEntityIdentifier,
+                                    supEntityReader,
+                                    supEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type2, 0)) {
+        fileServiceRelease (fs);
+        return fileServiceTestDone (path, 0);
+    }
+
+    SupEntity   entities   [SUP_ENTITY_COUNT];
+    const void *entityRefs [SUP_ENTITY_COUNT];
+    for (uint64_t value = 0; value < SUP_ENTITY_COUNT; value++) {
+        entities[value]   = supEntityCreate (value);
+        entityRefs[value] = &entities[value];
+    }
+
+    // Save many, in one transaction
+    int success = (1 == fileServiceSaveMany (fs, type1, entityRefs, SUP_ENTITY_COUNT) &&
+                   fileServiceLoadEntityCheck (fs, type1, SUP_ENTITY_COUNT));
+
+    // Save across types, within a (nested) batch
+    success &= (1 == fileServiceClear (fs, type1));
+    success &= (1 == fileServiceBeginBatch (fs));
+    success &= (1 == fileServiceBeginBatch (fs));
+    for (uint64_t value = 0; value < SUP_ENTITY_COUNT; value++)
+        success &= (1 == fileServiceSave (fs, type1, &entities[value]));
+    success &= (1 == fileServiceCommitBatch (fs));
+    success &= (1 == fileServiceReplace (fs, type2, entityRefs, SUP_ENTITY_COUNT / 2));
+    success &= (1 == fileServiceCommitBatch (fs));
+
+    // An unmatched commit fails
+    success &= (0 == fileServiceCommitBatch (fs));
+
+    success &= fileServiceLoadEntityCheck (fs, type1, SUP_ENTITY_COUNT);
+    success &= fileServiceLoadEntityCheck (fs, type2, SUP_ENTITY_COUNT / 2);
+
+    // Confirm WAL journaling
+    char walpath[1024];
+    sprintf (walpath, "%s/%s-%s-entities.db-wal", path,  currency, network);
+    success &= (0 == stat (walpath, &dirStat));
+
+    fileServiceRelease (fs);
+
+    // Confirm a wipe removes the DB and the WAL journal
+    success &= (0 == fileServiceWipe (path, currency, network));
+    success &= (0 != stat (walpath, &dirStat));
+
+    return fileServiceTestDone (path, success);
+}
+
+typedef struct {
+    size_t count;
+    size_t limit;
+    uint64_t lastValue;
+    int sorted;
+    uint8_t *seen;      // visits of each value below seenCount, if not NULL
+    size_t seenCount;
+} SupEntityIterateState;
+
+static int
+supEntityIterateHandler (BRFileServiceContext context,
+                         BRFileService fs,
+                         const char *type,
+                         void *entity) {
+    SupEntityIterateState *state = (SupEntityIterateState *) context;
+    uint64_t value = ((SupEntity *) entity)->value;
+
+    if (0 != state->count && value <= state->lastValue) state->sorted = 0;
+    state->lastValue = value;
+    state->count += 1;
+    if (NULL != state->seen && value < state->seenCount) state->seen[value] += 1;
+
+    free (entity);
+    return state->count < state->limit;
+}
+
+/// Iterate over entities of `type`, up to `limit`, and confirm there are `count` of them, sorted.
+static int
+fileServiceLoadIterateEntityCheck (BRFileService fs, const char *type, size_t count, size_t limit) {
+    SupEntityIterateState state = { 0, limit, 0, 1, NULL, 0 };
+    return (1 == fileServiceLoadIterate (fs, type, 1, &state, supEntityIterateHandler) &&
+            count == state.count &&
+            state.sorted);
+}
+
+/// Iterate over entities of `type`, in any order, and confirm each value below `count` is visited once.
+static int
+fileServiceLoadIterateUnsortedEntityCheck (BRFileService fs, const char *type, size_t count) {
+    SupEntityIterateState state = { 0, SIZE_MAX, 0, 1, calloc (count, 1), count };
+    int success = (1 == fileServiceLoadIterate (fs, type, 1, &state, supEntityIterateHandler) &&
+                   count == state.count);
+
+    for (size_t index = 0; success && index < count; index++)
+        success = (1 == state.seen[index]);
+
+    free (state.seen);
+    return success;
+}
+
+static int runSupFileServiceIterateTests (void) {
+    printf ("==== SUP:FileServiceIterate\n");
+
+    struct stat dirStat;
+
+    BRFileService fs;
+    char *path = "private";
+    char *currency = "btc", *network = "mainnet";
+    char *type1 = "foo";
+
+    if (0 == stat  (path, &dirStat)) _rmdir (path);
+    if (0 != mkdir (path, 0700)) return 0;
+
+    // Save entities, in reverse order, without a sort key; enough for several chunks.
+    fs = fileServiceSetupEntity (path, currency, network, type1, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    SupEntity   entities   [5 * SUP_ENTITY_COUNT];
+    const void *entityRefs [5 * SUP_ENTITY_COUNT];
+    for (uint64_t index = 0; index < 5 * SUP_ENTITY_COUNT; index++) {
+        entities[index]   = supEntityCreate (5 * SUP_ENTITY_COUNT - 1 - index);
+        entityRefs[index] = &entities[index];
+    }
+
+    int success = (1 == fileServiceSaveMany (fs, type1, entityRefs, 5 * SUP_ENTITY_COUNT));
+
+    // Without a sort key, every entity is iterated once, in an unspecified order
+    success &= fileServiceLoadIterateUnsortedEntityCheck (fs, type1, 5 * SUP_ENTITY_COUNT);
+    fileServiceRelease (fs);
+    if (!success) return fileServiceTestDone (path, 0);
+
+    // With a sort key, the existing entities get one and are iterated in order
+    fs = fileServiceSetupEntity (path, currency, network, type1, NULL);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    success &= (1 == fileServiceDefineSortKey (fs, type1, NULL, supEntitySortKey, supEntityRelease));
+    success &= fileServiceLoadIterateEntityCheck (fs, type1, 5 * SUP_ENTITY_COUNT, SIZE_MAX);
+
+    // Newly saved entities are in order too
+    SupEntity entity = supEntityCreate (5 * SUP_ENTITY_COUNT);
+    success &= (1 == fileServiceSave (fs, type1, &entity));
+    success &= fileServiceLoadIterateEntityCheck (fs, type1, 5 * SUP_ENTITY_COUNT + 1, SIZE_MAX);
+
+    // Stop early
+    success &= fileServiceLoadIterateEntityCheck (fs, type1, SUP_ENTITY_COUNT, SUP_ENTITY_COUNT);
+
+    // Stopping an iteration early leaves nothing behind; a full load still gets every entity
+    success &= fileServiceLoadEntityCheck (fs, type1, 5 * SUP_ENTITY_COUNT + 1);
+
+    fileServiceRelease (fs);
+
+    return fileServiceTestDone (path, success);
+}
+
 /// MARK: - Assert Tests
 
 #define DEFAULT_WORKERS     (5)
@@ -526,6 +895,9 @@ int BRRunSupTests (void) {
 
     success &= runSupFileServiceTests();
     success &= runSupFileServiceMultiTests ();
+    success &= runSupFileServiceEntityTests ();
+    success &= runSupFileServiceBatchTests ();
+    success &= runSupFileServiceIterateTests ();
     success &= runSupAssertTests();
 
     return success;
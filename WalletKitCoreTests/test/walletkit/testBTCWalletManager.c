@@ -119,9 +119,76 @@ runTestnetTransactionSigningTest() {
     releaseTestBTCManager(mgr);
 }
 
+// Returns true if the `chain` loaded for `mpk` holds exactly `pkhs`.
+static int
+addressChainLoadEquals (WKWalletManager mgr,
+                        BRMasterPubKey mpk,
+                        uint32_t chain,
+                        const UInt160 *pkhs,
+                        size_t pkhsCount) {
+    BRArrayOf(UInt160) internalChain;
+    BRArrayOf(UInt160) externalChain;
+    initialAddressChainsLoadBTC (mgr, mpk, &internalChain, &externalChain);
+
+    BRArrayOf(UInt160) loaded = (SEQUENCE_INTERNAL_CHAIN == chain ? internalChain : externalChain);
+    int equal = (0 == pkhsCount
+                 ? NULL == loaded
+                 : (NULL != loaded &&
+                    pkhsCount == array_count (loaded) &&
+                    0 == memcmp (loaded, pkhs, pkhsCount * sizeof (UInt160))));
+
+    if (NULL != internalChain) array_free (internalChain);
+    if (NULL != externalChain) array_free (externalChain);
+    return equal;
+}
+
+static void
+runAddressChainSaveLoadTest() {
+    WKWalletManager mgr = createTestBTCManager(false);
+    WKWallet wallet = wkWalletManagerGetWallet (mgr);
+    assert (NULL != wallet);
+
+    // The wallet's chains are saved when the wallet is created
+    BRBitcoinWallet *wid = wkWalletCoerceBTC(wallet)->wid;
+    BRMasterPubKey mpk = *((BRMasterPubKey*) wkAccountAs (mgr->account, mgr->type));
+
+    size_t externalCount = btcWalletChainPKHs (wid, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+    UInt160 *external = calloc (externalCount, sizeof (UInt160));
+    btcWalletChainPKHs (wid, external, externalCount, SEQUENCE_EXTERNAL_CHAIN);
+    assert (addressChainLoadEquals (mgr, mpk, SEQUENCE_EXTERNAL_CHAIN, external, externalCount));
+    free (external);
+
+    // A chain spanning several segments, saved whole and then extended, of an unrelated key
+    BRMasterPubKey other = mpk;
+    other.fingerPrint ^= 0xffffffff;
+
+    UInt160 pkhs[305];
+    for (size_t index = 0; index < 305; index++) {
+        memset (pkhs[index].u8, 0, sizeof (UInt160));
+        UInt32SetLE (pkhs[index].u8, (uint32_t) index);
+    }
+
+    addressChainSaveBTC (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 250, 0);
+    assert (addressChainLoadEquals (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 250));
+    assert (addressChainLoadEquals (mgr, other, SEQUENCE_EXTERNAL_CHAIN, NULL, 0));
+
+    addressChainSaveBTC (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 305, 250);
+    assert (addressChainLoadEquals (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 305));
+
+    // A short chain saved whole ends the chain, even over a previously saved longer one
+    addressChainSaveBTC (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 120, 0);
+    assert (addressChainLoadEquals (mgr, other, SEQUENCE_INTERNAL_CHAIN, pkhs, 120));
+
+    releaseTestBTCManager(mgr);
+}
+
 extern void
 runBTCWalletManagerTests (void) {
     
+    printf("Address chain save/load test\n");
+    runAddressChainSaveLoadTest();
+
+
     printf("Testnet transaction signing test\n");
     runTestnetTransactionSigningTest();
     
@@ -9,11 +9,13 @@
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
 #include <assert.h>
+#include <ctype.h>
 #include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include "WKAmount.h"
@@ -31,6 +33,7 @@
 #include "bitcoin/BRBitcoinWallet.h"
 
 #include "walletkit/handlers/btc/WKBTC.h"
+#include "walletkit/handlers/eth/WKETH.h"
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -302,10 +305,317 @@ transferTestsAddress (void) {
     wkCurrencyGive(btc);
 }
 
+/// The BTC currency, unit and wallet shared by the wallet transfer tests.
+typedef struct {
+    WKCurrency btc;
+    WKUnit sat;
+    BRBitcoinWallet *wid;
+    WKListener listener;
+    WKTransferListener transferListener;
+} TransferTestsWalletFixture;
+
+static TransferTestsWalletFixture
+transferTestsWalletFixtureCreate (void) {
+    TransferTestsWalletFixture fixture;
+
+    fixture.btc = wkCurrencyCreate ("BitcoinUIDS",
+                                    "Bitcoin",
+                                    "BTC",
+                                    "native",
+                                    NULL);
+
+    fixture.sat = wkUnitCreateAsBase (fixture.btc,
+                                      "SatoshiUIDS",
+                                      "Satoshi",
+                                      "SAT");
+
+    BRMasterPubKey mpk = transferTestsGetMPK();
+    const BRBitcoinChainParams *btcTestNetParams = btcChainParams(false);
+    fixture.wid = btcWalletNew (btcTestNetParams->addrParams, NULL, 0, mpk);
+    btcWalletSetCallbacks (fixture.wid, NULL, NULL, NULL, NULL, NULL);
+
+    fixture.listener = NULL;
+    fixture.transferListener = (WKTransferListener) { NULL };
+    return fixture;
+}
+
+static WKWallet
+transferTestsWalletFixtureCreateWallet (TransferTestsWalletFixture *fixture) {
+    WKWalletListener walletListener = { fixture->listener };
+    return wkWalletCreateAsBTC (WK_NETWORK_TYPE_BTC, walletListener, fixture->sat, fixture->sat, fixture->wid);
+}
+
+/// Fill `transfers` with a new transfer for each of `transferTests`; each must be given.
+static void
+transferTestsWalletFixtureCreateTransfers (TransferTestsWalletFixture *fixture,
+                                           WKTransfer *transfers) {
+    for (size_t index = 0; index < numberOfTransferTests; index++) {
+        WKTransferTest *test = &transferTests[index];
+
+        size_t   testRawSize;
+        uint8_t *testRawBytes = hexDecodeCreate(&testRawSize, test->rawChars, strlen (test->rawChars));
+
+        BRBitcoinTransaction *tid = btcTransactionParse (testRawBytes, testRawSize);
+        transfers[index] = wkTransferCreateAsBTC (fixture->transferListener, fixture->sat, fixture->sat,
+                                                  fixture->wid, tid, WK_NETWORK_TYPE_BTC);
+        free (testRawBytes);
+    }
+}
+
+static void
+transferTestsWalletFixtureRelease (TransferTestsWalletFixture *fixture) {
+    btcWalletFree(fixture->wid);
+    wkUnitGive(fixture->sat);
+    wkCurrencyGive(fixture->btc);
+}
+
+static void
+transferTestsWallet (void) {
+    TransferTestsWalletFixture fixture = transferTestsWalletFixtureCreate ();
+    WKWallet wallet = transferTestsWalletFixtureCreateWallet (&fixture);
+
+    WKTransfer transfers[numberOfTransferTests];
+    char *transfersUids[numberOfTransferTests];
+    BRArrayOf(WKTransfer) additions;
+    array_new (additions, numberOfTransferTests);
+
+    transferTestsWalletFixtureCreateTransfers (&fixture, transfers);
+    for (size_t index = 0; index < numberOfTransferTests; index++) {
+        // Half of the transfers get their `uids` only after being added, as on recovery.
+        transfersUids[index] = strdup (transfers[index]->uids);
+        if (1 == index % 2) wkTransferSetUids (transfers[index], NULL);
+
+        array_add (additions, wkTransferTake (transfers[index]));
+    }
+    wkWalletAddTransfers (wallet, additions);  // ownership given
+
+    size_t transfersCount;
+    WKTransfer *walletTransfers = wkWalletGetTransfers (wallet, &transfersCount);
+    assert (numberOfTransferTests == transfersCount);
+    for (size_t index = 0; index < transfersCount; index++)
+        wkTransferGive (walletTransfers[index]);
+    free (walletTransfers);
+
+    for (size_t index = 0; index < numberOfTransferTests; index++) {
+        const char *uids = transfersUids[index];
+        WKTransfer found;
+        WKBoolean  hasTransfer;
+
+        if (1 == index % 2) {
+            found = wkWalletGetTransferByUIDS (wallet, uids);
+            assert (NULL == found);
+            wkTransferSetUids (transfers[index], uids);
+        }
+
+        WKHash hash = wkTransferGetHash (transfers[index]);
+
+        found = wkWalletGetTransferByHash (wallet, hash);
+        assert (transfers[index] == found);
+        wkTransferGive (found);
+
+        found = wkWalletGetTransferByUIDS (wallet, uids);
+        assert (transfers[index] == found);
+        wkTransferGive (found);
+
+        found = wkWalletGetTransferByHashOrUIDS (wallet, hash, uids);
+        assert (transfers[index] == found);
+        wkTransferGive (found);
+
+        hasTransfer = wkWalletHasTransfer (wallet, transfers[index]);
+        assert (WK_TRUE == hasTransfer);
+        wkHashGive (hash);
+
+        // A distinct transfer with the same transaction is also in the wallet
+        WKTransfer copy = wkTransferCreateAsBTC (fixture.transferListener, fixture.sat, fixture.sat, fixture.wid,
+                                                 btcTransactionCopy (wkTransferAsBTC (transfers[index])),
+                                                 WK_NETWORK_TYPE_BTC);
+        hasTransfer = wkWalletHasTransfer (wallet, copy);
+        assert (WK_TRUE == hasTransfer);
+
+        // ... and can replace the original
+        if (0 == index % 3) {
+            wkWalletReplaceTransfer (wallet, transfers[index], wkTransferTake (copy));
+            hash = wkTransferGetHash (copy);
+
+            found = wkWalletGetTransferByHash (wallet, hash);
+            assert (copy == found);
+            wkTransferGive (found);
+
+            found = wkWalletGetTransferByUIDS (wallet, uids);
+            assert (copy == found);
+            wkTransferGive (found);
+            wkHashGive (hash);
+        }
+        wkTransferGive (copy);
+    }
+
+    // Remove every transfer; none are then found.
+    for (size_t index = 0; index < numberOfTransferTests; index++) {
+        WKHash hash = wkTransferGetHash (transfers[index]);
+
+        wkWalletRemTransfer (wallet, transfers[index]);
+
+        WKBoolean  hasTransfer = wkWalletHasTransfer (wallet, transfers[index]);
+        WKTransfer found       = wkWalletGetTransferByHash (wallet, hash);
+        assert (WK_FALSE == hasTransfer && NULL == found);
+
+        wkHashGive (hash);
+        wkTransferGive (transfers[index]);
+        free (transfersUids[index]);
+    }
+    walletTransfers = wkWalletGetTransfers (wallet, &transfersCount);
+    assert (0 == transfersCount && NULL == walletTransfers);
+
+    wkWalletGive (wallet);
+    transferTestsWalletFixtureRelease (&fixture);
+}
+
+/// Counts of the transfer additions announced, to `listener`, for `wallet`.
+typedef struct {
+    pthread_mutex_t lock;
+    WKWallet wallet;
+    size_t transferAddedEvents;
+    size_t transfersAddedEvents;
+    size_t transfersAddedTransfers;
+} TransferTestsWalletEventCounts;
+
+static void
+transferTestsWalletEventCountsCallback (WKListenerContext context,
+                                        WKWalletManager manager,
+                                        WKWallet wallet,
+                                        WKWalletEvent event) {
+    TransferTestsWalletEventCounts *counts = (TransferTestsWalletEventCounts *) context;
+    size_t transfersCount = 0;
+
+    pthread_mutex_lock (&counts->lock);
+    if (wallet == counts->wallet) {
+        switch (wkWalletEventGetType (event)) {
+            case WK_WALLET_EVENT_TRANSFER_ADDED:
+                counts->transferAddedEvents++;
+                break;
+            case WK_WALLET_EVENT_TRANSFERS_ADDED:
+                wkWalletEventExtractTransfers (event, &transfersCount, NULL);
+                counts->transfersAddedEvents++;
+                counts->transfersAddedTransfers += transfersCount;
+                break;
+            default:
+                break;
+        }
+    }
+    pthread_mutex_unlock (&counts->lock);
+
+    wkWalletEventGive (event);
+    wkWalletGive (wallet);
+    wkWalletManagerGive (manager);
+}
+
+static void
+transferTestsWalletDeferred (void) {
+    TransferTestsWalletFixture fixture = transferTestsWalletFixtureCreate ();
+
+    TransferTestsWalletEventCounts counts = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0 };
+    fixture.listener = wkListenerCreate (&counts, NULL, NULL, NULL, transferTestsWalletEventCountsCallback, NULL);
+    wkListenerStart (fixture.listener);
+
+    // `wallet1` gets each transfer announced as added; `wallet2` gets them deferred.
+    WKWallet wallet1 = transferTestsWalletFixtureCreateWallet (&fixture);
+    WKWallet wallet2 = transferTestsWalletFixtureCreateWallet (&fixture);
+
+    pthread_mutex_lock (&counts.lock);
+    counts.wallet = wallet2;
+    pthread_mutex_unlock (&counts.lock);
+
+    WKTransfer transfers[numberOfTransferTests];
+    transferTestsWalletFixtureCreateTransfers (&fixture, transfers);
+
+    // All but the first transfer remain
+    for (size_t index = 1; index < numberOfTransferTests; index++)
+        wkWalletAddTransfer (wallet1, transfers[index]);
+
+    WKAmount balance2 = wkWalletGetBalance (wallet2);
+
+    wkWalletDeferTransferAdditions (wallet2);
+    wkWalletDeferTransferAdditions (wallet2);  // nested
+    for (size_t index = 0; index < numberOfTransferTests; index++) {
+        wkWalletAddTransfer (wallet2, transfers[index]);
+
+        WKBoolean hasTransfer = wkWalletHasTransfer (wallet2, transfers[index]);
+        assert (WK_TRUE == hasTransfer);
+    }
+    assert (numberOfTransferTests == array_count (wallet2->transfersAdded));
+
+    // Removing a deferred addition drops it from the additions
+    wkWalletRemTransfer (wallet2, transfers[0]);
+    assert (numberOfTransferTests - 1 == array_count (wallet2->transfersAdded));
+
+    // The balance is unchanged until the outermost flush
+    wkWalletFlushTransferAdditions (wallet2);
+    assert (NULL != wallet2->transfersAdded);
+    assert (WK_COMPARE_EQ == wkAmountCompare (balance2, wallet2->balance));
+
+    wkWalletFlushTransferAdditions (wallet2);
+    assert (NULL == wallet2->transfersAdded);
+    assert (WK_COMPARE_EQ == wkAmountCompare (wallet1->balance, wallet2->balance));
+    wkAmountGive (balance2);
+
+    // The remaining additions are announced by one TRANSFERS_ADDED and no TRANSFER_ADDED; events
+    // are dispatched in order, so any TRANSFER_ADDED would be counted by the time it arrives.
+    size_t transfersAddedEvents = 0;
+    for (size_t tries = 0; 0 == transfersAddedEvents && tries < 500; tries++) {
+        usleep (10 * 1000);
+        pthread_mutex_lock (&counts.lock);
+        transfersAddedEvents = counts.transfersAddedEvents;
+        pthread_mutex_unlock (&counts.lock);
+    }
+
+    pthread_mutex_lock (&counts.lock);
+    assert (1 == counts.transfersAddedEvents);
+    assert (numberOfTransferTests - 1 == counts.transfersAddedTransfers);
+    assert (0 == counts.transferAddedEvents);
+    pthread_mutex_unlock (&counts.lock);
+
+    // A TRANSFERS_ADDED event holds its transfers
+    BRArrayOf(WKTransfer) eventTransfers;
+    array_new (eventTransfers, numberOfTransferTests);
+    for (size_t index = 0; index < numberOfTransferTests; index++)
+        array_add (eventTransfers, wkTransferTake (transfers[index]));
+
+    WKWalletEvent event = wkWalletEventCreateTransfers (eventTransfers);
+    assert (WK_TRUE == wkWalletEventIsEqual (event, event));
+
+    size_t      extractedCount = 0;
+    WKTransfer *extracted      = NULL;
+    WKTransfer  extractedOne   = NULL;
+    WKBoolean   extractedOneOK = wkWalletEventExtractTransfer  (event, &extractedOne);
+    WKBoolean   extractedOK    = wkWalletEventExtractTransfers (event, &extractedCount, &extracted);
+    assert (WK_FALSE == extractedOneOK && NULL == extractedOne);
+    assert (WK_TRUE  == extractedOK);
+    assert (numberOfTransferTests == extractedCount);
+    for (size_t index = 0; index < extractedCount; index++) {
+        assert (transfers[index] == extracted[index]);
+        wkTransferGive (extracted[index]);
+    }
+    free (extracted);
+    wkWalletEventGive (event);
+
+    for (size_t index = 0; index < numberOfTransferTests; index++)
+        wkTransferGive (transfers[index]);
+
+    wkWalletGive (wallet2);
+    wkWalletGive (wallet1);
+
+    // Once stopped, no callback is left running with the wallets
+    wkListenerStop (fixture.listener);
+    wkListenerGive (fixture.listener);
+    transferTestsWalletFixtureRelease (&fixture);
+}
+
 static void
 runWalletKitTransferTests (void) {
     transferTestsBalance();
     transferTestsAddress();
+    transferTestsWallet();
+    transferTestsWalletDeferred();
 }
 
 ///
@@ -1613,9 +1923,103 @@ runWalletKitTestsWithAccountAndNetwork (WKAccount account,
     return success;
 }
 
+///
+/// Mark: WKNetwork Tests
+///
+
+static char *
+networkTestsUppercase (const char *string) {
+    char *upper = strdup (string);
+    for (char *c = upper; '\0' != *c; c++) *c = toupper ((unsigned char) *c);
+    return upper;
+}
+
+static void
+runWalletKitNetworkTests (void) {
+    WKNetwork network = wkNetworkFindBuiltin ("ethereum-mainnet", true);
+    assert (NULL != network);
+
+    WKCurrency ethCurrency = wkNetworkGetCurrency (network);
+
+    // Lookups find the first currency with the uids or issuer, ignoring case, or the code.  An
+    // issuer is also found without its '0x' prefix, and by a token with that address.
+    size_t currencyCount = wkNetworkGetCurrencyCount (network);
+    for (size_t index = 0; index < currencyCount; index++) {
+        WKCurrency currency = wkNetworkGetCurrencyAt (network, index);
+        assert (WK_TRUE == wkNetworkHasCurrency (network, currency));
+
+        char *uids = networkTestsUppercase (wkCurrencyGetUids (currency));
+        WKCurrency found = wkNetworkGetCurrencyForUids (network, uids);
+        assert (WK_TRUE == wkCurrencyIsIdentical (currency, found));
+        wkCurrencyGive (found);
+        free (uids);
+
+        found = wkNetworkGetCurrencyForCode (network, wkCurrencyGetCode (currency));
+        assert (0 == strcmp (wkCurrencyGetCode (currency), wkCurrencyGetCode (found)));
+        wkCurrencyGive (found);
+
+        if (NULL != wkCurrencyGetIssuer (currency)) {
+            char *issuer = networkTestsUppercase (wkCurrencyGetIssuer (currency));
+            found = wkNetworkGetCurrencyForIssuer (network, issuer);
+            assert (0 == strcasecmp (wkCurrencyGetIssuer (currency), wkCurrencyGetIssuer (found)));
+            wkCurrencyGive (found);
+
+            found = wkNetworkGetCurrencyForIssuer (network, &issuer[2]);
+            assert (NULL != found && 0 == strcasecmp (wkCurrencyGetIssuer (currency), wkCurrencyGetIssuer (found)));
+            wkCurrencyGive (found);
+
+            issuer[1] = 'x';  // a token address is '0x'-prefixed
+            BREthereumToken token = ethTokenCreate (issuer, "TST", "Test", "", 18,
+                                                    ethGasCreate (0), ethGasPriceCreate (ethEtherCreateZero ()));
+            found = wkNetworkGetCurrencyforTokenETH (network, token);
+            assert (NULL != found && 0 == strcasecmp (wkCurrencyGetIssuer (currency), wkCurrencyGetIssuer (found)));
+            wkCurrencyGive (found);
+            ethTokenRelease (token);
+            free (issuer);
+        }
+
+        wkCurrencyGive (currency);
+    }
+
+    // A later currency with an existing code does not replace the first.
+    WKCurrency other = wkCurrencyCreate ("ethereum-mainnet:0xNetworkTests", "Other", wkCurrencyGetCode (ethCurrency), "erc20", "0xNetworkTests");
+    WKUnit     otherUnit = wkUnitCreateAsBase (other, "other", "Other", "OTH");
+    wkNetworkAddCurrency (network, other, otherUnit, otherUnit);
+
+    assert (currencyCount + 1 == wkNetworkGetCurrencyCount (network));
+    assert (WK_TRUE == wkNetworkHasCurrency (network, other));
+
+    WKCurrency found = wkNetworkGetCurrencyForCode (network, wkCurrencyGetCode (ethCurrency));
+    assert (found == ethCurrency);
+    wkCurrencyGive (found);
+
+    found = wkNetworkGetCurrencyForIssuer (network, "0xnetworktests");
+    assert (found == other);
+    wkCurrencyGive (found);
+
+    WKUnit foundUnit = wkNetworkGetUnitAsBase (network, other);
+    assert (foundUnit == otherUnit);
+    wkUnitGive (foundUnit);
+
+    // An exact uids match is needed to have a currency.
+    WKCurrency otherUpper = wkCurrencyCreate ("ETHEREUM-MAINNET:0XNETWORKTESTS", "Other", "oth", "erc20", NULL);
+    assert (WK_FALSE == wkNetworkHasCurrency (network, otherUpper));
+    wkCurrencyGive (otherUpper);
+
+    assert (NULL == wkNetworkGetCurrencyForUids   (network, "ethereum-mainnet:0xNone"));
+    assert (NULL == wkNetworkGetCurrencyForIssuer (network, "0xNone"));
+    assert (NULL == wkNetworkGetCurrencyForCode   (network, "none"));
+
+    wkUnitGive (otherUnit);
+    wkCurrencyGive (other);
+    wkCurrencyGive (ethCurrency);
+    wkNetworkGive (network);
+}
+
 extern void
 runWalletKitTests (void) {
     runWalletKitAmountTests ();
     runWalletKitTransferTests();
+    runWalletKitNetworkTests();
     return;
 }
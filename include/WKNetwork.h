@@ -272,7 +272,8 @@ wkNetworkGetCurrencyForUids (WKNetwork network,
                              const char *uids);
 
 /**
- * Get the network's currency with `issuer`; otherwise `NULL`
+ * Get the network's currency with `issuer`; otherwise `NULL`.  Issuers match by their hex digits,
+ * ignoring case and a '0x' prefix.
  */
 extern WKCurrency
 wkNetworkGetCurrencyForIssuer (WKNetwork network,
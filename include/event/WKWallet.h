@@ -60,6 +60,11 @@ typedef enum {
 
     /// Signaled when the wallet's feeBaiss is estimated.
     WK_WALLET_EVENT_FEE_BASIS_ESTIMATED,
+
+    /// Signaled, in place of one TRANSFER_ADDED per transfer, when a batch of transfers is
+    /// added to the wallet, such as on recovery.  A listener that tracks the wallet's transfers
+    /// must handle both events.
+    WK_WALLET_EVENT_TRANSFERS_ADDED,
 } WKWalletEventType;
 
 extern const char *
@@ -79,6 +84,13 @@ extern WKBoolean
 wkWalletEventExtractTransfer (WKWalletEvent event,
                               WKTransfer *transfer);
 
+/// Extract the transfers from a TRANSFERS_ADDED event.  The returned array, of `count` transfers,
+/// must be freed and each transfer given.
+extern WKBoolean
+wkWalletEventExtractTransfers (WKWalletEvent event,
+                               size_t *count,
+                               WKTransfer **transfers);
+
 extern WKBoolean
 wkWalletEventExtractTransferSubmit (WKWalletEvent event,
                                     WKTransfer *transfer);
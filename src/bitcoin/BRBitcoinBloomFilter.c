@@ -154,6 +154,18 @@ void btcBloomFilterInsertData(BRBitcoinBloomFilter *filter, const uint8_t *data,
     if (data) filter->elemCount++;
 }
 
+// estimated false positive rate of filter once another insertCount elements are added
+double btcBloomFilterFalsePositiveRate(const BRBitcoinBloomFilter *filter, size_t insertCount)
+{
+    double n, k;
+
+    assert(filter != NULL);
+    n = (double)filter->elemCount + (double)insertCount;
+    k = filter->hashFuncs;
+    if (k < 1.0) return 1.0;
+    return pow(1.0 - exp(-k*n/((double)filter->length*8.0)), k);
+}
+
 // frees memory allocated for filter
 void btcBloomFilterFree(BRBitcoinBloomFilter *filter)
 {
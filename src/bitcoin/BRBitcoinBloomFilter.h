@@ -72,6 +72,9 @@ int btcBloomFilterContainsData(const BRBitcoinBloomFilter *filter, const uint8_t
 // add data to filter
 void btcBloomFilterInsertData(BRBitcoinBloomFilter *filter, const uint8_t *data, size_t dataLen);
 
+// estimated false positive rate of filter once another insertCount elements are added
+double btcBloomFilterFalsePositiveRate(const BRBitcoinBloomFilter *filter, size_t insertCount);
+
 // frees memory allocated for filter
 void btcBloomFilterFree(BRBitcoinBloomFilter *filter);
 
@@ -0,0 +1,348 @@
+//
+//  BRBitcoinCoinSelection.c
+//
+//  Copyright (c) 2021 Breadwinner AG
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRBitcoinCoinSelection.h"
+#include "support/BRKey.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define BNB_MAX_TRIES      100000 // branch-and-bound search steps before giving up on a changeless selection
+#define KNAPSACK_ROUNDS    1000   // random subsets tried by knapsack for each target
+#define KNAPSACK_MAX_PASSES 8     // knapsack targets tried while the fee for the selected inputs keeps growing
+
+// running size of a transaction as inputs are added, so vsize is O(1) rather than a walk over all inputs
+typedef struct {
+    size_t baseSize; // size of the tx without inputs, less the input count varint
+    size_t size;
+    size_t witSize;
+    size_t count;
+} BRCoinSelectionSize;
+
+inline static void _sizeAdd(BRCoinSelectionSize *s, const BRBitcoinCoinSelectionInput *input)
+{
+    s->size += input->size;
+    s->witSize += input->witSize;
+    s->count++;
+}
+
+// same as btcTransactionVSize() of the tx with the inputs added so far, plus an optional change output
+inline static size_t _sizeVSize(const BRCoinSelectionSize *s, int withChange)
+{
+    size_t size = s->baseSize + BRVarIntSize(s->count) + s->size,
+           witSize = (s->witSize > 0) ? s->witSize + 2 + s->count : 0;
+
+    return (size*4 + witSize + 3)/4 + ((withChange) ? TX_OUTPUT_SIZE : 0);
+}
+
+BRBitcoinCoinSelectionInput btcCoinSelectionInput(uint64_t amount, const uint8_t *script, size_t scriptLen)
+{
+    BRBitcoinCoinSelectionInput input = { amount, TX_INPUT_SIZE, 0 };
+    size_t witnessless = sizeof(UInt256) + sizeof(uint32_t) + BRVarIntSize(0) + sizeof(uint32_t);
+
+    if (script && scriptLen > 0 && script[0] == OP_0) { // estimated P2WPKH input size
+        input.size = witnessless;
+        input.witSize = TX_INPUT_SIZE - witnessless;
+    }
+
+    return input;
+}
+
+// adds inputs in the given order until they cover amount plus fee, either exactly or leaving at least minChange
+static size_t _coinSelectInOrder(const size_t order[], const BRBitcoinCoinSelectionInput inputs[], size_t inCount,
+                                 BRCoinSelectionSize s, uint64_t amount, uint64_t minChange, void *feeInfo,
+                                 BRBitcoinCoinSelectionFee feeFn, size_t selected[], uint64_t *fee)
+{
+    uint64_t total = 0;
+    size_t i;
+
+    *fee = feeFn(feeInfo, _sizeVSize(&s, 1));
+
+    for (i = 0; i < inCount; i++) {
+        selected[i] = order[i];
+        total += inputs[order[i]].amount;
+        _sizeAdd(&s, &inputs[order[i]]);
+        *fee = feeFn(feeInfo, _sizeVSize(&s, 1)); // fee amount after adding a change output
+        if (total == amount + *fee || total >= amount + *fee + minChange) break;
+    }
+
+    return (total >= amount + *fee) ? ((i < inCount) ? i + 1 : inCount) : 0;
+}
+
+static int _coinSelectCompareIndex(const void *a, const void *b)
+{
+    size_t i = *(const size_t *)a, j = *(const size_t *)b;
+
+    return (i < j) ? -1 : (i > j) ? 1 : 0;
+}
+
+typedef struct {
+    size_t index;
+    int64_t value;
+} BRCoinSelectionValue;
+
+static int _coinSelectCompareValueDesc(const void *a, const void *b)
+{
+    int64_t i = ((const BRCoinSelectionValue *)a)->value, j = ((const BRCoinSelectionValue *)b)->value;
+
+    return (i > j) ? -1 : (i < j) ? 1 : 0;
+}
+
+// depth-first search, largest first, for a set of inputs whose value net of their own fees lands between the outputs
+// plus fee and that plus the cost of a change output that wouldn't be worth making, so that the tx needs no change
+static size_t _coinSelectBranchAndBound(const BRBitcoinCoinSelectionInput inputs[], size_t inCount,
+                                        BRCoinSelectionSize s, uint64_t amount, uint64_t minChange,
+                                        uint64_t feePerKb, void *feeInfo, BRBitcoinCoinSelectionFee feeFn,
+                                        size_t selected[], uint64_t *fee)
+{
+    BRCoinSelectionValue *values = calloc(inCount + 1, sizeof(*values));
+    uint8_t *included = calloc(inCount + 1, 1), *best = calloc(inCount + 1, 1);
+    uint64_t total = 0;
+    int64_t target, upper, current = 0, remaining = 0, bestExcess = INT64_MAX;
+    size_t n = 0, depth = 0, count = 0;
+
+    assert(values != NULL && included != NULL && best != NULL);
+    // the search runs on the unrounded fee rate, so feeFn's rounding isn't charged again for every input
+    target = (int64_t)(amount + feePerKb*_sizeVSize(&s, 0)/1000);
+    upper = target + (int64_t)(minChange + feePerKb*TX_OUTPUT_SIZE/1000);
+
+    for (size_t i = 0; i < inCount; i++) { // effective value of each input, net of the fee to spend it
+        size_t vsize = (inputs[i].size*4 + inputs[i].witSize + ((inputs[i].witSize > 0) ? 1 : 0) + 3)/4;
+        int64_t value = (int64_t)inputs[i].amount - (int64_t)(feePerKb*vsize/1000);
+
+        if (value > 0) values[n++] = (BRCoinSelectionValue) { i, value }, remaining += value;
+    }
+
+    qsort(values, n, sizeof(*values), _coinSelectCompareValueDesc);
+
+    for (size_t tries = 0; tries < BNB_MAX_TRIES; tries++) {
+        if (depth == n || current >= target || current + remaining < target) {
+            if (current >= target && current <= upper && current - target < bestExcess) {
+                bestExcess = current - target;
+                memcpy(best, included, n);
+                if (bestExcess == 0) break;
+            }
+
+            while (depth > 0 && ! included[depth - 1]) remaining += values[--depth].value; // undo trailing omissions
+            if (depth == 0) break; // search exhausted
+            included[depth - 1] = 0; // try omitting the last included input instead
+            current -= values[depth - 1].value;
+        }
+        else {
+            included[depth] = 1;
+            current += values[depth].value;
+            remaining -= values[depth].value;
+            depth++;
+        }
+    }
+
+    for (size_t i = 0; bestExcess != INT64_MAX && i < n; i++) {
+        if (! best[i]) continue;
+        selected[count++] = values[i].index;
+        total += inputs[values[i].index].amount;
+        _sizeAdd(&s, &inputs[values[i].index]);
+    }
+
+    // effective values are an estimate, so check the real fee; the excess over outputs and fee goes to the fee
+    if (count > 0 && total >= amount + feeFn(feeInfo, _sizeVSize(&s, 0)) &&
+        total <= amount + feeFn(feeInfo, _sizeVSize(&s, 1)) + minChange) *fee = total - amount;
+    else count = 0;
+
+    free(best);
+    free(included);
+    free(values);
+    return count;
+}
+
+// randomly includes inputs smaller than target, keeping the subset with the smallest total that still reaches it
+static uint64_t _coinSelectApproximateBestSubset(const BRCoinSelectionValue smaller[], size_t n, uint64_t total,
+                                                 uint64_t target, uint8_t *best)
+{
+    uint8_t *included = calloc(n + 1, 1);
+    uint64_t bestTotal = total, current;
+    int reached;
+
+    assert(included != NULL);
+    memset(best, 1, n);
+
+    for (size_t round = 0; round < KNAPSACK_ROUNDS && bestTotal != target; round++) {
+        memset(included, 0, n);
+        current = 0;
+        reached = 0;
+
+        for (int pass = 0; pass < 2 && ! reached; pass++) { // first pass random inclusion, second pass fills in
+            for (size_t i = 0; i < n; i++) {
+                if (included[i] || (pass == 0 ? BRRand(2) == 0 : 0)) continue;
+                current += (uint64_t)smaller[i].value;
+                included[i] = 1;
+
+                if (current >= target) {
+                    reached = 1;
+                    if (current < bestTotal) bestTotal = current, memcpy(best, included, n);
+                    current -= (uint64_t)smaller[i].value; // see if a later, smaller input can reach target instead
+                    included[i] = 0;
+                }
+            }
+        }
+    }
+
+    free(included);
+    return bestTotal;
+}
+
+// selects the inputs that come closest to the outputs plus fee plus minChange, preferring an exact match, otherwise
+// the best of a random subset search over smaller inputs and the smallest single input that covers it all
+static size_t _coinSelectKnapsack(const BRBitcoinCoinSelectionInput inputs[], size_t inCount, BRCoinSelectionSize s,
+                                  uint64_t amount, uint64_t minChange, void *feeInfo,
+                                  BRBitcoinCoinSelectionFee feeFn, size_t selected[], uint64_t *fee)
+{
+    BRCoinSelectionValue *smaller = calloc(inCount + 1, sizeof(*smaller));
+    uint8_t *best = calloc(inCount + 1, 1);
+    BRCoinSelectionSize selectedSize = s;
+    uint64_t target, total = 0, smallerTotal, bestTotal;
+    size_t count = 0, n, larger;
+
+    assert(smaller != NULL && best != NULL);
+    *fee = feeFn(feeInfo, _sizeVSize(&s, 1) + TX_INPUT_SIZE); // a guess of one input, refined by the inputs selected
+
+    for (size_t pass = 0; pass < KNAPSACK_MAX_PASSES; pass++) {
+        target = amount + *fee + minChange;
+        larger = inCount;
+        smallerTotal = 0;
+        n = 0;
+
+        for (size_t i = 0; i < inCount; i++) {
+            if (inputs[i].amount < target) {
+                smaller[n++] = (BRCoinSelectionValue) { i, (int64_t)inputs[i].amount };
+                smallerTotal += inputs[i].amount;
+            }
+            else if (larger == inCount || inputs[i].amount < inputs[larger].amount) larger = i;
+        }
+
+        count = 0;
+
+        if (smallerTotal < target) { // smaller inputs can't do it, only the smallest larger input can
+            if (larger < inCount) selected[count++] = larger;
+        }
+        else {
+            qsort(smaller, n, sizeof(*smaller), _coinSelectCompareValueDesc);
+            bestTotal = _coinSelectApproximateBestSubset(smaller, n, smallerTotal, target, best);
+
+            if (larger < inCount && bestTotal != target && inputs[larger].amount <= bestTotal) {
+                selected[count++] = larger;
+            }
+            else {
+                for (size_t i = 0; i < n; i++) if (best[i]) selected[count++] = smaller[i].index;
+            }
+        }
+
+        selectedSize = s;
+        total = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            total += inputs[selected[i]].amount;
+            _sizeAdd(&selectedSize, &inputs[selected[i]]);
+        }
+
+        *fee = feeFn(feeInfo, _sizeVSize(&selectedSize, 1));
+        if (count > 0 && (total == amount + *fee || total >= amount + *fee + minChange)) break;
+        if (amount + *fee + minChange <= target) break; // no progress, so nothing will fit
+    }
+
+    free(best);
+    free(smaller);
+    if (count > 0) qsort(selected, count, sizeof(*selected), _coinSelectCompareIndex);
+    return (count > 0 && total >= amount + *fee) ? count : 0;
+}
+
+// selects from inputs to pay for the outputs of tx, which must not have any inputs yet
+// writes the indexes of the selected inputs in ascending order to selected, which must have room for inCount indexes,
+// and writes the fee to fee; the fee includes a change output, except for a changeless selection where it is all of
+// the selected amount beyond the outputs
+// a change output should be added when the selected amount exceeds outputs plus fee by more than minChange
+// feePerKb is the unrounded fee rate that feeFn charges, used to estimate what each input costs to spend
+// returns the number of inputs selected, or 0 if all inputs together can't pay for the outputs and fee
+size_t btcCoinSelect(BRBitcoinCoinSelectionStrategy strategy, const BRBitcoinTransaction *tx,
+                     const BRBitcoinCoinSelectionInput inputs[], size_t inCount, uint64_t minChange,
+                     uint64_t feePerKb, void *feeInfo, BRBitcoinCoinSelectionFee feeFn, size_t selected[],
+                     uint64_t *fee)
+{
+    BRCoinSelectionSize s = { 0, 0, 0, 0 };
+    uint64_t amount = 0;
+    size_t count = 0, *order;
+
+    assert(tx != NULL && tx->inCount == 0);
+    assert(inputs != NULL || inCount == 0);
+    assert(selected != NULL || inCount == 0);
+    assert(feeFn != NULL);
+    assert(fee != NULL);
+
+    s.baseSize = btcTransactionSize(tx) - BRVarIntSize(0);
+    for (size_t i = 0; i < tx->outCount; i++) amount += tx->outputs[i].amount;
+
+    switch (strategy) {
+        case BTC_COIN_SELECTION_WALLET_ORDER:
+        case BTC_COIN_SELECTION_LARGEST_FIRST:
+            order = calloc(inCount + 1, sizeof(*order));
+            assert(order != NULL);
+            for (size_t i = 0; i < inCount; i++) order[i] = i;
+
+            if (strategy == BTC_COIN_SELECTION_LARGEST_FIRST) {
+                BRCoinSelectionValue *values = calloc(inCount + 1, sizeof(*values));
+
+                assert(values != NULL);
+                for (size_t i = 0; i < inCount; i++) values[i] = (BRCoinSelectionValue) { i, (int64_t)inputs[i].amount };
+                qsort(values, inCount, sizeof(*values), _coinSelectCompareValueDesc);
+                for (size_t i = 0; i < inCount; i++) order[i] = values[i].index;
+                free(values);
+            }
+
+            count = _coinSelectInOrder(order, inputs, inCount, s, amount, minChange, feeInfo, feeFn, selected, fee);
+            free(order);
+            if (count > 0) qsort(selected, count, sizeof(*selected), _coinSelectCompareIndex);
+            break;
+
+        case BTC_COIN_SELECTION_BRANCH_AND_BOUND:
+            count = _coinSelectBranchAndBound(inputs, inCount, s, amount, minChange, feePerKb, feeInfo, feeFn,
+                                              selected, fee);
+            if (count > 0) {
+                qsort(selected, count, sizeof(*selected), _coinSelectCompareIndex);
+                break;
+            }
+            // no changeless selection, fall through to knapsack
+
+        case BTC_COIN_SELECTION_KNAPSACK:
+            count = _coinSelectKnapsack(inputs, inCount, s, amount, minChange, feeInfo, feeFn, selected, fee);
+            if (count > 0) break;
+
+            // no selection leaves a worthwhile change output, so settle for one that gives the excess to the fee
+            order = calloc(inCount + 1, sizeof(*order));
+            assert(order != NULL);
+            for (size_t i = 0; i < inCount; i++) order[i] = i;
+            count = _coinSelectInOrder(order, inputs, inCount, s, amount, minChange, feeInfo, feeFn, selected, fee);
+            free(order);
+            break;
+    }
+
+    return count;
+}
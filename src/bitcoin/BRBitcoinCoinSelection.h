@@ -0,0 +1,70 @@
+//
+//  BRBitcoinCoinSelection.h
+//
+//  Copyright (c) 2021 Breadwinner AG
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRBitcoinCoinSelection_h
+#define BRBitcoinCoinSelection_h
+
+#include "BRBitcoinTransaction.h"
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BTC_COIN_SELECTION_WALLET_ORDER,     // inputs in the given order until outputs and fee are covered
+    BTC_COIN_SELECTION_LARGEST_FIRST,    // largest inputs first, for the fewest inputs
+    BTC_COIN_SELECTION_BRANCH_AND_BOUND, // a changeless set of inputs if one exists, otherwise knapsack
+    BTC_COIN_SELECTION_KNAPSACK          // the set of inputs that comes closest to covering outputs, fee and change
+} BRBitcoinCoinSelectionStrategy;
+
+typedef struct {
+    uint64_t amount;
+    size_t size;    // bytes the input adds to the non-witness part of a tx
+    size_t witSize; // bytes the input adds to the witness part of a tx
+} BRBitcoinCoinSelectionInput;
+
+// returns the fee for a transaction of the given virtual size
+typedef uint64_t (*BRBitcoinCoinSelectionFee)(void *info, size_t vsize);
+
+// returns a selection input for an unsigned input of amount spending script, sized as btcTransactionVSize() estimates
+BRBitcoinCoinSelectionInput btcCoinSelectionInput(uint64_t amount, const uint8_t *script, size_t scriptLen);
+
+// selects from inputs to pay for the outputs of tx, which must not have any inputs yet
+// writes the indexes of the selected inputs in ascending order to selected, which must have room for inCount indexes,
+// and writes the fee to fee; the fee includes a change output, except for a changeless selection where it is all of
+// the selected amount beyond the outputs
+// a change output should be added when the selected amount exceeds outputs plus fee by more than minChange
+// feePerKb is the unrounded fee rate that feeFn charges, used to estimate what each input costs to spend
+// returns the number of inputs selected, or 0 if all inputs together can't pay for the outputs and fee
+size_t btcCoinSelect(BRBitcoinCoinSelectionStrategy strategy, const BRBitcoinTransaction *tx,
+                     const BRBitcoinCoinSelectionInput inputs[], size_t inCount, uint64_t minChange,
+                     uint64_t feePerKb, void *feeInfo, BRBitcoinCoinSelectionFee feeFn, size_t selected[],
+                     uint64_t *fee);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRBitcoinCoinSelection_h
@@ -0,0 +1,251 @@
+//
+//  BRBitcoinCompactFilter.c
+//
+//  Created by Breadwinner AG on 10/16/26.
+//  Copyright © 2026 Breadwinner AG.  All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#include "BRBitcoinCompactFilter.h"
+#include "support/BRCrypto.h"
+#include "support/BRAddress.h"
+#include "support/BRInt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define CFILTER_MAX_ITEMS 0xffffffffULL
+
+typedef struct {
+    const uint8_t *buf;
+    size_t bits, pos;
+} _BRGolombReader;
+
+typedef struct {
+    uint8_t *buf;
+    size_t pos;
+} _BRGolombWriter;
+
+// high 64 bits of the 128 bit product a*b
+inline static uint64_t _mulHigh64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)a*b) >> 64);
+#else
+    uint64_t aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32,
+             lo = aLo*bLo, mid1 = aHi*bLo + (lo >> 32), mid2 = aLo*bHi + (uint32_t)mid1;
+
+    return aHi*bHi + (mid1 >> 32) + (mid2 >> 32);
+#endif
+}
+
+// maps an item uniformly onto [0, n*M), keyed by the first 16 bytes of the block hash
+inline static uint64_t _btcCompactFilterHashToRange(UInt256 blockHash, uint64_t range, const uint8_t *data,
+                                                    size_t dataLen)
+{
+    return _mulHigh64(BRSip64(blockHash.u8, data, dataLen), range);
+}
+
+static int _btcUInt64Compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void _btcGolombWriteBit(_BRGolombWriter *w, int bit)
+{
+    if (bit) w->buf[w->pos >> 3] |= (uint8_t)(0x80 >> (w->pos & 7));
+    w->pos++;
+}
+
+// returns the next bit, or -1 past the end of the set
+static int _btcGolombReadBit(_BRGolombReader *r)
+{
+    if (r->pos >= r->bits) return -1;
+    int bit = (r->buf[r->pos >> 3] >> (7 - (r->pos & 7))) & 1;
+    r->pos++;
+    return bit;
+}
+
+// reads the next golomb-rice coded delta into *delta, returns false past the end of the set
+static int _btcGolombReadDelta(_BRGolombReader *r, uint64_t *delta)
+{
+    uint64_t q = 0, rem = 0;
+    int bit;
+
+    while ((bit = _btcGolombReadBit(r)) == 1) q++;
+    if (bit < 0 || r->pos + CFILTER_BASIC_P > r->bits) return 0;
+
+    for (int i = 0; i < CFILTER_BASIC_P; i++) rem = (rem << 1) | (uint64_t)_btcGolombReadBit(r);
+    *delta = (q << CFILTER_BASIC_P) | rem;
+    return 1;
+}
+
+// returns a newly allocated basic filter of the given items for the block with blockHash, that must be freed by calling
+// btcCompactFilterFree(), items must be distinct
+BRBitcoinCompactFilter *btcCompactFilterNew(UInt256 blockHash, const uint8_t *const items[], const size_t itemLens[],
+                                            size_t itemsCount)
+{
+    BRBitcoinCompactFilter *filter = calloc(1, sizeof(*filter));
+    uint64_t *values = (itemsCount > 0) ? malloc(itemsCount*sizeof(*values)) : NULL, range, last = 0, q;
+    size_t i, bits = 0, off;
+    _BRGolombWriter w;
+
+    assert(filter != NULL);
+    assert(items != NULL || itemsCount == 0);
+    assert(itemsCount <= CFILTER_MAX_ITEMS);
+    filter->blockHash = blockHash;
+    filter->type = CFILTER_TYPE_BASIC;
+    filter->n = itemsCount;
+    range = filter->n*CFILTER_BASIC_M;
+
+    for (i = 0; i < itemsCount; i++) {
+        values[i] = _btcCompactFilterHashToRange(blockHash, range, items[i], itemLens[i]);
+    }
+
+    if (itemsCount > 0) qsort(values, itemsCount, sizeof(*values), _btcUInt64Compare);
+    for (i = 0; i < itemsCount; i++) bits += ((values[i] - (i > 0 ? values[i - 1] : 0)) >> CFILTER_BASIC_P) + 1 +
+                                             CFILTER_BASIC_P;
+
+    off = BRVarIntSize(filter->n);
+    filter->length = off + (bits + 7)/8;
+    filter->filter = calloc(filter->length, sizeof(*(filter->filter)));
+    assert(filter->filter != NULL);
+    BRVarIntSet(filter->filter, filter->length, filter->n);
+    w.buf = &filter->filter[off];
+    w.pos = 0;
+
+    for (i = 0; i < itemsCount; i++) {
+        for (q = (values[i] - last) >> CFILTER_BASIC_P; q > 0; q--) _btcGolombWriteBit(&w, 1);
+        _btcGolombWriteBit(&w, 0);
+        for (int b = CFILTER_BASIC_P - 1; b >= 0; b--) _btcGolombWriteBit(&w, ((values[i] - last) >> b) & 1);
+        last = values[i];
+    }
+
+    if (values) free(values);
+    return filter;
+}
+
+// buf must contain a serialized filter
+// returns a filter struct that must be freed by calling btcCompactFilterFree(), or NULL if buf is malformed
+BRBitcoinCompactFilter *btcCompactFilterParse(uint8_t type, UInt256 blockHash, const uint8_t *buf, size_t bufLen)
+{
+    BRBitcoinCompactFilter *filter = NULL;
+    size_t len = 0;
+    uint64_t n;
+
+    assert(buf != NULL || bufLen == 0);
+    n = (buf) ? BRVarInt(buf, bufLen, &len) : 0;
+
+    if (buf && len > 0 && len <= bufLen && n <= CFILTER_MAX_ITEMS && (n == 0 || bufLen > len)) {
+        filter = calloc(1, sizeof(*filter));
+        assert(filter != NULL);
+        filter->blockHash = blockHash;
+        filter->type = type;
+        filter->n = n;
+        filter->length = bufLen;
+        filter->filter = malloc(bufLen);
+        assert(filter->filter != NULL);
+        memcpy(filter->filter, buf, bufLen);
+    }
+
+    return filter;
+}
+
+// the double-sha-256 of the serialized filter, as committed to by filter headers
+UInt256 btcCompactFilterHash(const BRBitcoinCompactFilter *filter)
+{
+    UInt256 md;
+
+    assert(filter != NULL);
+    BRSHA256_2(&md, filter->filter, filter->length);
+    return md;
+}
+
+// the filter header of the filter with filterHash, chained to the header of the previous block's filter
+UInt256 btcCompactFilterHeader(UInt256 filterHash, UInt256 prevHeader)
+{
+    uint8_t buf[sizeof(UInt256)*2];
+    UInt256 md;
+
+    UInt256Set(buf, filterHash);
+    UInt256Set(&buf[sizeof(UInt256)], prevHeader);
+    BRSHA256_2(&md, buf, sizeof(buf));
+    return md;
+}
+
+// true if any of the given items is matched by filter (false positive rate is 1/CFILTER_BASIC_M per item)
+int btcCompactFilterMatchAny(const BRBitcoinCompactFilter *filter, const uint8_t *const items[],
+                             const size_t itemLens[], size_t itemsCount)
+{
+    uint64_t *queries, range, value = 0, delta;
+    size_t i = 0, off = 0;
+    uint64_t n = 0;
+    _BRGolombReader r;
+    int match = 0;
+
+    assert(filter != NULL);
+    assert(items != NULL || itemsCount == 0);
+    if (filter->n == 0 || itemsCount == 0) return 0;
+
+    BRVarInt(filter->filter, filter->length, &off);
+    range = filter->n*CFILTER_BASIC_M;
+    queries = malloc(itemsCount*sizeof(*queries));
+    assert(queries != NULL);
+
+    // hash the queries into the filter's range and walk both sorted lists together, so the set is decoded only once
+    for (i = 0; i < itemsCount; i++) {
+        queries[i] = _btcCompactFilterHashToRange(filter->blockHash, range, items[i], itemLens[i]);
+    }
+
+    qsort(queries, itemsCount, sizeof(*queries), _btcUInt64Compare);
+    r.buf = &filter->filter[off];
+    r.bits = (filter->length - off)*8;
+    r.pos = 0;
+    i = 0;
+
+    while (! match && i < itemsCount && n < filter->n && _btcGolombReadDelta(&r, &delta)) {
+        value += delta;
+        n++;
+        while (i < itemsCount && queries[i] < value) i++;
+        if (i < itemsCount && queries[i] == value) match = 1;
+    }
+
+    free(queries);
+    return match;
+}
+
+// true if data is matched by filter
+int btcCompactFilterContainsData(const BRBitcoinCompactFilter *filter, const uint8_t *data, size_t dataLen)
+{
+    const uint8_t *items[] = { data };
+    const size_t itemLens[] = { dataLen };
+
+    assert(data != NULL || dataLen == 0);
+    return (data) ? btcCompactFilterMatchAny(filter, items, itemLens, 1) : 0;
+}
+
+// frees memory allocated for filter
+void btcCompactFilterFree(BRBitcoinCompactFilter *filter)
+{
+    assert(filter != NULL);
+    if (filter->filter) free(filter->filter);
+    free(filter);
+}
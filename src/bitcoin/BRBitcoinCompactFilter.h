@@ -0,0 +1,82 @@
+//
+//  BRBitcoinCompactFilter.h
+//
+//  Created by Breadwinner AG on 10/16/26.
+//  Copyright © 2026 Breadwinner AG.  All rights reserved.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+
+#ifndef BRCompactFilter_h
+#define BRCompactFilter_h
+
+#include "support/BRInt.h"
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// compact block filters are explained in BIP158: https://github.com/bitcoin/bips/blob/master/bip-0158.mediawiki
+// and the protocol for fetching them in BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+
+#define CFILTER_TYPE_BASIC     0x00
+#define CFILTER_BASIC_P        19     // golomb-rice coding parameter
+#define CFILTER_BASIC_M        784931 // inverse false positive rate
+#define CFILTER_MAX_FILTERS    1000   // most filters a getcfilters request may ask for
+#define CFILTER_MAX_HEADERS    2000   // most filter hashes a getcfheaders request may ask for
+
+typedef struct {
+    UInt256 blockHash;
+    uint8_t type;
+    uint64_t n;      // number of items in the set
+    uint8_t *filter; // compact size n followed by the golomb-rice coded set, as relayed in a cfilter message
+    size_t length;
+} BRBitcoinCompactFilter;
+
+// returns a newly allocated basic filter of the given items for the block with blockHash, that must be freed by calling
+// btcCompactFilterFree(), items must be distinct
+BRBitcoinCompactFilter *btcCompactFilterNew(UInt256 blockHash, const uint8_t *const items[], const size_t itemLens[],
+                                            size_t itemsCount);
+
+// buf must contain a serialized filter
+// returns a filter struct that must be freed by calling btcCompactFilterFree(), or NULL if buf is malformed
+BRBitcoinCompactFilter *btcCompactFilterParse(uint8_t type, UInt256 blockHash, const uint8_t *buf, size_t bufLen);
+
+// the double-sha-256 of the serialized filter, as committed to by filter headers
+UInt256 btcCompactFilterHash(const BRBitcoinCompactFilter *filter);
+
+// the filter header of the filter with filterHash, chained to the header of the previous block's filter
+UInt256 btcCompactFilterHeader(UInt256 filterHash, UInt256 prevHeader);
+
+// true if any of the given items is matched by filter (false positive rate is 1/CFILTER_BASIC_M per item)
+int btcCompactFilterMatchAny(const BRBitcoinCompactFilter *filter, const uint8_t *const items[],
+                             const size_t itemLens[], size_t itemsCount);
+
+// true if data is matched by filter
+int btcCompactFilterContainsData(const BRBitcoinCompactFilter *filter, const uint8_t *data, size_t dataLen);
+
+// frees memory allocated for filter
+void btcCompactFilterFree(BRBitcoinCompactFilter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRCompactFilter_h
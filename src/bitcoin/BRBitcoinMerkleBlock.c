@@ -35,6 +35,7 @@
 
 #define MAX_PROOF_OF_WORK 0x1d00ffff    // highest value for difficulty target (higher values are less difficult)
 #define TARGET_TIMESPAN   (14*24*60*60) // the targeted timespan between difficulty target adjustments
+#define MERKLE_NODES_ON_STACK 128         // partial merkle trees up to this many nodes are hashed without heap buffers
 
 inline static uint32_t _ceil_log2(uint32_t x)
 {
@@ -329,11 +330,26 @@ size_t btcMerkleBlockSerialize(const BRBitcoinMerkleBlock *block, uint8_t *buf,
     return (! buf || off <= bufLen) ? off : 0;
 }
 
-static size_t _btcMerkleBlockTxHashesR(const BRBitcoinMerkleBlock *block, UInt256 *txHashes, size_t hashesCount,
-                                       size_t *idx, size_t *hashIdx, size_t *flagIdx, uint32_t depth)
+// a partial merkle tree node, as visited in depth-first order
+typedef struct {
+    uint32_t depth;
+    int isLeaf;
+    UInt256 hash; // zero for a missing right branch, for internal nodes it's filled in by _btcMerkleBlockRoot()
+} _BRMerkleNode;
+
+// walks the partial merkle tree depth-first, consuming flag bits and hashes as they were written during encoding,
+// appends each visited node to nodes if not NULL, and writes up to hashesCount matched tx hashes to txHashes if not NULL
+// returns the number of matched tx hashes
+static size_t _btcMerkleBlockWalkR(const BRBitcoinMerkleBlock *block, _BRMerkleNode *nodes, size_t *nodesCount,
+                                   UInt256 *txHashes, size_t hashesCount, size_t *idx, size_t *hashIdx,
+                                   size_t *flagIdx, uint32_t depth)
 {
+    _BRMerkleNode *node = (nodes) ? &nodes[*nodesCount] : NULL;
     uint8_t flag;
     
+    if (node) node->depth = depth, node->isLeaf = 1, node->hash = UINT256_ZERO;
+    (*nodesCount)++;
+
     if (*flagIdx/8 < block->flagsLen && *hashIdx < block->hashesCount) {
         flag = (block->flags[*flagIdx/8] & (1 << (*flagIdx % 8)));
         (*flagIdx)++;
@@ -344,11 +360,15 @@ static size_t _btcMerkleBlockTxHashesR(const BRBitcoinMerkleBlock *block, UInt25
                 (*idx)++;
             }
         
+            if (node) node->hash = block->hashes[*hashIdx];
             (*hashIdx)++;
         }
         else {
-            _btcMerkleBlockTxHashesR(block, txHashes, hashesCount, idx, hashIdx, flagIdx, depth + 1); // left branch
-            _btcMerkleBlockTxHashesR(block, txHashes, hashesCount, idx, hashIdx, flagIdx, depth + 1); // right branch
+            if (node) node->isLeaf = 0;
+            _btcMerkleBlockWalkR(block, nodes, nodesCount, txHashes, hashesCount, idx, hashIdx, flagIdx,
+                                 depth + 1); // left branch
+            _btcMerkleBlockWalkR(block, nodes, nodesCount, txHashes, hashesCount, idx, hashIdx, flagIdx,
+                                 depth + 1); // right branch
         }
     }
 
@@ -359,11 +379,12 @@ static size_t _btcMerkleBlockTxHashesR(const BRBitcoinMerkleBlock *block, UInt25
 // returns number of hashes written, or the total hashesCount needed if txHashes is NULL
 size_t btcMerkleBlockTxHashes(const BRBitcoinMerkleBlock *block, UInt256 *txHashes, size_t hashesCount)
 {
-    size_t idx = 0, hashIdx = 0, flagIdx = 0;
+    size_t nodesCount = 0, idx = 0, hashIdx = 0, flagIdx = 0;
 
     assert(block != NULL);
     
-    return _btcMerkleBlockTxHashesR(block, txHashes, (txHashes) ? hashesCount : SIZE_MAX, &idx, &hashIdx, &flagIdx, 0);
+    return _btcMerkleBlockWalkR(block, NULL, &nodesCount, txHashes, (txHashes) ? hashesCount : SIZE_MAX, &idx,
+                                &hashIdx, &flagIdx, 0);
 }
 
 // sets the hashes and flags fields for a block created with btcMerkleBlockNew()
@@ -382,29 +403,150 @@ void btcMerkleBlockSetTxHashes(BRBitcoinMerkleBlock *block, const UInt256 hashes
     if (block->flags) memcpy(block->flags, flags, flagsLen);
 }
 
-// recursively walks the merkle tree to calculate the merkle root
+// appends the flag bit and hashes for the subtree at the given height and position in depth-first order, as described
+// above, where rows[height] holds the tree row that many levels above the txs, and matched the matching row of flags
+static void _btcMerkleBlockBuildR(UInt256 *const rows[], uint8_t *const matched[], const size_t widths[],
+                                  uint32_t height, size_t pos, UInt256 *hashes, size_t *hashesCount,
+                                  uint8_t *flags, size_t *flagIdx)
+{
+    if (matched[height][pos]) flags[*flagIdx/8] |= (uint8_t)(1 << (*flagIdx % 8));
+    (*flagIdx)++;
+
+    if (height == 0 || ! matched[height][pos]) hashes[(*hashesCount)++] = rows[height][pos];
+    else {
+        _btcMerkleBlockBuildR(rows, matched, widths, height - 1, pos*2, hashes, hashesCount, flags,
+                              flagIdx); // left branch
+        
+        if (pos*2 + 1 < widths[height - 1]) { // right branch, if it isn't a duplicate of the left
+            _btcMerkleBlockBuildR(rows, matched, widths, height - 1, pos*2 + 1, hashes, hashesCount, flags, flagIdx);
+        }
+    }
+}
+
+// sets totalTx, hashes and flags to the partial merkle tree of a block's complete list of txHashes, in block order,
+// marking the txs where matches[i] is true, or all of them if matches is NULL
+void btcMerkleBlockSetMatchedTxHashes(BRBitcoinMerkleBlock *block, const UInt256 txHashes[], const uint8_t *matches,
+                                      size_t txCount)
+{
+    assert(block != NULL);
+    assert(txHashes != NULL || txCount == 0);
+    assert(txCount <= UINT32_MAX);
+    
+    uint32_t height, maxHeight = _ceil_log2((uint32_t)txCount);
+    UInt256 *rows[maxHeight + 1], *pairs, *hashes;
+    uint8_t *matched[maxHeight + 1], *flags;
+    size_t i, widths[maxHeight + 1], nodesCount = 0, hashesCount = 0, flagIdx = 0;
+
+    if (block->hashes) free(block->hashes);
+    if (block->flags) free(block->flags);
+    block->totalTx = (uint32_t)txCount;
+    block->hashes = NULL, block->hashesCount = 0;
+    block->flags = NULL, block->flagsLen = 0;
+    if (txCount == 0) return;
+    
+    for (height = 0; height <= maxHeight; height++) {
+        widths[height] = (txCount + ((size_t)1 << height) - 1) >> height;
+        nodesCount += widths[height];
+    }
+
+    rows[0] = malloc(nodesCount*sizeof(UInt256));
+    matched[0] = malloc(nodesCount);
+    pairs = malloc(widths[0]*2*sizeof(UInt256));
+    assert(rows[0] != NULL);
+    assert(matched[0] != NULL);
+    assert(pairs != NULL);
+    memcpy(rows[0], txHashes, txCount*sizeof(UInt256));
+    for (i = 0; i < txCount; i++) matched[0][i] = (! matches || matches[i]) ? 1 : 0;
+    
+    for (height = 1; height <= maxHeight; height++) { // hash each row of the tree at once, from the txs up
+        rows[height] = rows[height - 1] + widths[height - 1];
+        matched[height] = matched[height - 1] + widths[height - 1];
+
+        for (i = 0; i < widths[height]; i++) {
+            pairs[i*2] = rows[height - 1][i*2];
+            pairs[i*2 + 1] = (i*2 + 1 < widths[height - 1]) ? rows[height - 1][i*2 + 1] : pairs[i*2];
+            matched[height][i] = matched[height - 1][i*2] |
+                                 ((i*2 + 1 < widths[height - 1]) ? matched[height - 1][i*2 + 1] : 0);
+        }
+        
+        BRSHA256_2Many(rows[height], pairs, sizeof(UInt256)*2, widths[height]);
+    }
+
+    hashes = malloc(nodesCount*sizeof(UInt256));
+    flags = calloc((nodesCount + 7)/8, sizeof(*flags));
+    assert(hashes != NULL);
+    assert(flags != NULL);
+    _btcMerkleBlockBuildR(rows, matched, widths, maxHeight, 0, hashes, &hashesCount, flags, &flagIdx);
+    btcMerkleBlockSetTxHashes(block, hashes, hashesCount, flags, (flagIdx + 7)/8);
+    block->hashesCount = hashesCount;
+    block->flagsLen = (flagIdx + 7)/8;
+    free(flags);
+    free(hashes);
+    free(pairs);
+    free(matched[0]);
+    free(rows[0]);
+}
+
+// calculates the merkle root one tree row at a time, from the deepest row up, hashing all the sibling pairs in a row with
+// a single BRSHA256_2Many() call; in any row, the children of that row's internal nodes, in left to right order, are
+// exactly the nodes of the row below
 // NOTE: this merkle tree design has a security vulnerability (CVE-2012-2459), which can be defended against by
 // considering the merkle root invalid if there are duplicate hashes in any rows with an even number of elements
-static UInt256 _btcMerkleBlockRootR(const BRBitcoinMerkleBlock *block, size_t *hashIdx, size_t *flagIdx, uint32_t depth)
+static UInt256 _btcMerkleBlockRoot(const BRBitcoinMerkleBlock *block)
 {
-    uint8_t flag;
-    UInt256 hashes[2], md = UINT256_ZERO;
-
-    if (*flagIdx/8 < block->flagsLen && *hashIdx < block->hashesCount) {
-        flag = (block->flags[*flagIdx/8] & (1 << (*flagIdx % 8)));
-        (*flagIdx)++;
+    uint32_t depth, maxDepth = _ceil_log2(block->totalTx);
+    size_t i, j, k, nodesCount = 0, idx = 0, hashIdx = 0, flagIdx = 0, rowStart[maxDepth + 2];
+    size_t nodesMax = 2*8*block->flagsLen + 1; // every visited node but a missing branch consumes a flag bit
+    _BRMerkleNode nodesBuf[MERKLE_NODES_ON_STACK], *nodes = nodesBuf;
+    size_t rowBuf[MERKLE_NODES_ON_STACK], *row = rowBuf;
+    UInt256 pairsBuf[MERKLE_NODES_ON_STACK], *pairs = pairsBuf, left, right, md = UINT256_ZERO;
+    int r = 1;
 
-        if (flag && depth != _ceil_log2(block->totalTx)) {
-            hashes[0] = _btcMerkleBlockRootR(block, hashIdx, flagIdx, depth + 1); // left branch
-            hashes[1] = _btcMerkleBlockRootR(block, hashIdx, flagIdx, depth + 1); // right branch
+    if (nodesMax > MERKLE_NODES_ON_STACK) { // filtered blocks usually match few txs, so avoid the heap for small trees
+        nodes = malloc(nodesMax*sizeof(*nodes));
+        row = malloc(nodesMax*sizeof(*row));
+        pairs = malloc(nodesMax*sizeof(*pairs));
+    }
 
-            if (! UInt256IsZero(hashes[0]) && ! UInt256Eq(hashes[0], hashes[1])) {
-                if (UInt256IsZero(hashes[1])) hashes[1] = hashes[0]; // if right branch is missing, dup left branch
-                BRSHA256_2(&md, hashes, sizeof(hashes));
+    assert(nodes != NULL);
+    assert(row != NULL);
+    assert(pairs != NULL);
+    _btcMerkleBlockWalkR(block, nodes, &nodesCount, NULL, 0, &idx, &hashIdx, &flagIdx, 0);
+
+    // sort node indexes by depth, keeping depth-first order within each row, so each row is in left to right order
+    memset(rowStart, 0, sizeof(rowStart));
+    for (i = 0; i < nodesCount; i++) rowStart[nodes[i].depth + 1]++;
+    for (depth = 0; depth <= maxDepth; depth++) rowStart[depth + 1] += rowStart[depth];
+    for (i = 0; i < nodesCount; i++) row[rowStart[nodes[i].depth]++] = i;
+    for (depth = maxDepth + 1; depth > 0; depth--) rowStart[depth] = rowStart[depth - 1];
+    rowStart[0] = 0;
+
+    for (depth = maxDepth; r && depth > 0; depth--) { // hash the internal nodes of row depth - 1
+        for (i = rowStart[depth - 1], j = rowStart[depth], k = 0; r && i < rowStart[depth]; i++) {
+            if (nodes[row[i]].isLeaf) continue;
+            left = nodes[row[j++]].hash;
+            right = nodes[row[j++]].hash;
+            
+            if (! UInt256IsZero(left) && ! UInt256Eq(left, right)) {
+                pairs[k++] = left;
+                pairs[k++] = (UInt256IsZero(right)) ? left : right; // if right branch is missing, dup left branch
             }
-            else *hashIdx = SIZE_MAX; // defend against (CVE-2012-2459)
+            else r = 0; // defend against (CVE-2012-2459)
         }
-        else md = block->hashes[(*hashIdx)++]; // leaf
+        
+        if (r) BRSHA256_2Many(pairs, pairs, sizeof(UInt256)*2, k/2);
+
+        for (i = rowStart[depth - 1], k = 0; r && i < rowStart[depth]; i++) {
+            if (! nodes[row[i]].isLeaf) nodes[row[i]].hash = pairs[k++];
+        }
+    }
+
+    if (r && nodesCount > 0) md = nodes[0].hash;
+    
+    if (nodes != nodesBuf) {
+        free(pairs);
+        free(row);
+        free(nodes);
     }
     
     return md;
@@ -435,8 +577,7 @@ int btcMerkleBlockIsValid(const BRBitcoinMerkleBlock *block, uint32_t currentTim
     // target is in "compact" format, where the most significant byte is the size of the value in bytes, next
     // bit is the sign, and the last 23 bits is the value after having been right shifted by (size - 3)*8 bits
     const uint32_t size = block->target >> 24, target = block->target & 0x007fffff;
-    size_t hashIdx = 0, flagIdx = 0;
-    UInt256 merkleRoot = _btcMerkleBlockRootR(block, &hashIdx, &flagIdx, 0);
+    UInt256 merkleRoot = _btcMerkleBlockRoot(block);
     _BRAuxPow *ap = ((_BRAuxPowBlock *)block)->ap;
     int r = 1;
     
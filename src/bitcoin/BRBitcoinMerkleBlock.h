@@ -77,6 +77,11 @@ size_t btcMerkleBlockTxHashes(const BRBitcoinMerkleBlock *block, UInt256 *txHash
 void btcMerkleBlockSetTxHashes(BRBitcoinMerkleBlock *block, const UInt256 hashes[], size_t hashesCount,
                                const uint8_t *flags, size_t flagsLen);
 
+// sets totalTx, hashes and flags to the partial merkle tree of a block's complete list of txHashes, in block order,
+// marking the txs where matches[i] is true, or all of them if matches is NULL
+void btcMerkleBlockSetMatchedTxHashes(BRBitcoinMerkleBlock *block, const UInt256 txHashes[], const uint8_t *matches,
+                                      size_t txCount);
+
 // true if the given tx hash is known to be included in the block
 int btcMerkleBlockContainsTxHash(const BRBitcoinMerkleBlock *block, UInt256 txHash);
 
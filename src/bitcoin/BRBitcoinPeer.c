@@ -39,6 +39,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>	
@@ -55,6 +56,14 @@
 #define MESSAGE_TIMEOUT    10.0
 #define WITNESS_FLAG       0x40000000
 
+#define PEER_POLL_TIMEOUT  1.0     // longest the network thread sleeps before checking peer timeouts
+#define RECEIVE_LENGTH     0x10000 // least free space in a peer's receive buffer before each read
+#define MAX_SEND_LENGTH    (2*(HEADER_LENGTH + MAX_MSG_LENGTH)) // most bytes queued for a peer that isn't reading them
+
+#ifndef MSG_NOSIGNAL   // linux based systems have a MSG_NOSIGNAL send flag, useful for supressing SIGPIPE signals
+#define MSG_NOSIGNAL 0 // set to 0 if undefined (BSD has the SO_NOSIGPIPE sockopt, and windows has no signals at all)
+#endif
+
 #define PTHREAD_STACK_SIZE  (512 * 1024)
 
 // the standard blockchain download protocol works as follows (for SPV mode):
@@ -84,6 +93,19 @@
 // - if at any point tx messages consume enough wallet addresses to drop below the bip32 chain gap limit, more addresses
 //   are generated and local peer sends filterload with an updated bloom filter
 // - after filterload is sent, getdata is sent to re-request recent blocks that may contain new tx matching the filter
+//
+// in compact block filter mode (BIP157) the peer manager drives the sync, and the peer only relays what it receives:
+// - local peer sends getheaders, remote peer responds with up to 2000 headers, repeated until the tip is reached
+// - local peer sends getcfheaders and getcfilters for up to 1000 blocks at a time
+// - remote peer responds with cfheaders, the filter hashes committed to by the filter header chain, and a cfilter for
+//   each block, which is matched locally against the wallet's scripts
+// - local peer sends getdata for the full blocks whose filters matched, and remote peer responds with block messages
+// - block announcements are passed along, rather than requested as filtered blocks
+//
+// in headers-first mode the peer manager also drives the sync, so it can spread the chain download over many peers:
+// - local peer sends getheaders, remote peer responds with up to 2000 headers, and more headers are only requested by
+//   the peer manager
+// - the peer manager sends getdata for ranges of merkle blocks to each connected peer, and reassembles them in order
 
 typedef enum {
     inv_undefined = 0,
@@ -107,12 +129,20 @@ typedef struct {
     uint32_t version, lastblock, earliestKeyTime, currentBlockHeight;
     double startTime, pingTime;
     volatile double disconnectTime, mempoolTime;
-    int sentVerack, gotVerack, sentGetaddr, sentFilter, sentGetdata, sentMempool, sentGetblocks;
+    int sentVerack, gotVerack, sentGetaddr, sentFilter, sentGetdata, sentMempool, sentGetblocks, compactFilters,
+        headersFirst;
     UInt256 lastBlockHash;
     BRBitcoinMerkleBlock *currentBlock;
     UInt256 *currentBlockTxHashes, *knownBlockHashes, *knownTxHashes;
     BRSet *knownTxHashSet;
     volatile int socket;
+    int socketFlags, connecting;
+    uint8_t *recvBuf; // bytes received but not yet accepted are those from recvStart to recvEnd
+    size_t recvStart, recvEnd, recvCapacity, recvNeeded;
+    double msgTimeout;
+    uint8_t *sendBuf; // bytes queued but not yet sent are those from sendStart to sendEnd, guarded by lock
+    size_t sendStart, sendEnd, sendCapacity;
+    double sendTimeout;
     void *info;
     void (*connected)(void *info);
     void (*disconnected)(void *info, int error);
@@ -127,14 +157,24 @@ typedef struct {
     BRBitcoinTransaction *(*requestedTx)(void *info, UInt256 txHash);
     int (*networkIsReachable)(void *info);
     void (*threadCleanup)(void *info);
+    void (*relayedHeaders)(void *info, size_t headersCount);
+    void (*relayedCFHeaders)(void *info, uint8_t filterType, UInt256 stopHash, UInt256 prevFilterHeader,
+                             const UInt256 filterHashes[], size_t hashesCount);
+    void (*relayedCFilter)(void *info, BRBitcoinCompactFilter *filter);
+    void (*relayedFullBlock)(void *info, BRBitcoinMerkleBlock *block, BRBitcoinTransaction *txs[], size_t txCount);
+    void (*announcedBlocks)(void *info, const UInt256 blockHashes[], size_t blockCount);
     void **volatile pongInfo;
     void (**volatile pongCallback)(void *info, int success);
     void *volatile mempoolInfo;
     void (*volatile mempoolCallback)(void *info, int success);
-    pthread_t thread;
     pthread_mutex_t lock;
 } BRBitcoinPeerContext;
 
+// every connected peer is serviced by a single network thread, _peersLock guards the list of those peers
+static pthread_mutex_t _peersLock = PTHREAD_MUTEX_INITIALIZER;
+static BRBitcoinPeerContext **_peers = NULL;
+static int _wakePipe[2] = { -1, -1 }, _networkThreadRunning = 0;
+
 void btcPeerSendVersionMessage(BRBitcoinPeer *peer);
 void btcPeerSendVerackMessage(BRBitcoinPeer *peer);
 void btcPeerSendAddr(BRBitcoinPeer *peer);
@@ -359,12 +399,18 @@ static int _btcPeerAcceptInvMessage(BRBitcoinPeer *peer, const uint8_t *msg, siz
             r = 0;
         }
         else {
-            if (! ctx->sentFilter && ! ctx->sentGetblocks) blockCount = 0;
+            if (! ctx->sentFilter && ! ctx->sentGetblocks && ! ctx->compactFilters) blockCount = 0;
             if (blockCount == 1 && UInt256Eq(ctx->lastBlockHash, UInt256Get(blocks[0]))) blockCount = 0;
             if (blockCount == 1) ctx->lastBlockHash = UInt256Get(blocks[0]);
 
             UInt256 hash, blockHashes[blockCount], txHashes[txCount];
 
+            if (ctx->compactFilters) { // with compact filters, new headers are requested by the peer manager
+                for (i = 0; i < blockCount; i++) blockHashes[i] = UInt256Get(blocks[i]);
+                if (blockCount > 0 && ctx->announcedBlocks) ctx->announcedBlocks(ctx->info, blockHashes, blockCount);
+                blockCount = 0;
+            }
+
             for (i = 0; i < blockCount; i++) {
                 blockHashes[i] = UInt256Get(blocks[i]);
                 // remember blockHashes in case we need to re-request them with an updated bloom filter
@@ -460,7 +506,7 @@ static int _btcPeerAcceptHeadersMessage(BRBitcoinPeer *peer, const uint8_t *msg,
 {
     BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
     size_t i, off = 0, count = (size_t)BRVarInt(msg, msgLen, &off);
-    int sentRequest = 0, r = 1;
+    int sentRequest = ctx->headersFirst, r = 1; // with headers-first sync, the peer manager requests more headers
     uint32_t timestamp = (count > 0 && msgLen >= 81) ? UInt32GetLE(&msg[(msgLen - 81) + 68]) : 0;
     time_t now = time(NULL); // TODO: use estimated network time instead of system time (avoids timejacking attacks)
     UInt256 locators[2];
@@ -468,7 +514,9 @@ static int _btcPeerAcceptHeadersMessage(BRBitcoinPeer *peer, const uint8_t *msg,
     
     peer_log(peer, "got %zu header(s)", count);
     
-    if (count < 2000 && (timestamp == 0 || timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT < ctx->earliestKeyTime)) {
+    // with headers-first sync, headers are requested up to the tip, so an empty response just means we're up to date
+    if (count < 2000 && (timestamp == 0 || timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT < ctx->earliestKeyTime) &&
+        ! (ctx->headersFirst && count == 0)) {
         peer_log(peer, "non-standard headers message, %zu is fewer header(s) than expected", count);
         r = 0;
     }
@@ -505,6 +553,7 @@ static int _btcPeerAcceptHeadersMessage(BRBitcoinPeer *peer, const uint8_t *msg,
         }
     }
     
+    if (r && ctx->headersFirst && ctx->relayedHeaders) ctx->relayedHeaders(ctx->info, count);
     return r;
 }
 
@@ -748,6 +797,189 @@ static int _btcPeerAcceptMerkleblockMessage(BRBitcoinPeer *peer, const uint8_t *
     return r;
 }
 
+// reads the compact size at buf[*off] and advances *off past it, or past bufLen if it's truncated or larger than bufLen
+static size_t _btcPeerReadVarInt(const uint8_t *buf, size_t bufLen, size_t *off)
+{
+    size_t len = 0;
+    uint64_t i = (*off < bufLen) ? BRVarInt(&buf[*off], bufLen - *off, &len) : 0;
+
+    *off = (len > 0 && *off + len <= bufLen && i <= bufLen) ? *off + len : bufLen + 1;
+    return (*off <= bufLen) ? (size_t)i : 0;
+}
+
+// returns the serialized length of the tx at the start of buf, or 0 if buf doesn't start with a complete tx, and sets
+// txHash to the hash of its serialization without witness data
+// NOTE: btcTransactionParse() treats signature scripts that look like pubkey scripts as unsigned, so it can't be used to
+// find where each tx in a block ends
+static size_t _btcPeerScanTx(const uint8_t *buf, size_t bufLen, UInt256 *txHash)
+{
+    size_t i, j, len, inCount, outCount, itemCount, witnessOff, off = sizeof(uint32_t);
+    uint8_t witnessFlag = 0, *sBuf;
+
+    inCount = _btcPeerReadVarInt(buf, bufLen, &off);
+    
+    if (inCount == 0 && off < bufLen) { // BIP144 marker, followed by flag
+        witnessFlag = buf[off++];
+        inCount = _btcPeerReadVarInt(buf, bufLen, &off);
+    }
+
+    for (i = 0; off <= bufLen && i < inCount; i++) {
+        off += sizeof(UInt256) + sizeof(uint32_t); // previous outpoint
+        len = _btcPeerReadVarInt(buf, bufLen, &off);
+        off += len + sizeof(uint32_t); // signature script and sequence
+    }
+
+    outCount = _btcPeerReadVarInt(buf, bufLen, &off);
+
+    for (i = 0; off <= bufLen && i < outCount; i++) {
+        off += sizeof(uint64_t); // amount
+        len = _btcPeerReadVarInt(buf, bufLen, &off);
+        off += len; // pubkey script
+    }
+
+    for (i = 0, witnessOff = off; witnessFlag && off <= bufLen && i < inCount; i++) {
+        itemCount = _btcPeerReadVarInt(buf, bufLen, &off);
+
+        for (j = 0; off <= bufLen && j < itemCount; j++) {
+            len = _btcPeerReadVarInt(buf, bufLen, &off);
+            off += len;
+        }
+    }
+
+    off += sizeof(uint32_t); // lock time
+    if (inCount == 0 || outCount == 0 || witnessFlag > 1 || off > bufLen) return 0;
+
+    if (witnessFlag) {
+        sBuf = malloc((witnessOff - 2) + sizeof(uint32_t));
+        assert(sBuf != NULL);
+        memcpy(sBuf, buf, sizeof(uint32_t));
+        memcpy(&sBuf[sizeof(uint32_t)], &buf[sizeof(uint32_t) + 2], witnessOff - (sizeof(uint32_t) + 2));
+        memcpy(&sBuf[witnessOff - 2], &buf[off - sizeof(uint32_t)], sizeof(uint32_t));
+        BRSHA256_2(txHash, sBuf, (witnessOff - 2) + sizeof(uint32_t));
+        free(sBuf);
+    }
+    else BRSHA256_2(txHash, buf, off);
+
+    return off;
+}
+
+// full blocks are only requested in compact filter mode
+static int _btcPeerAcceptBlockMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    BRBitcoinMerkleBlock *block = btcMerkleBlockParse(msg, (msgLen < 80) ? msgLen : 80); // merge-mining not supported
+    size_t i, len, txCount = 0, off = 80, count = _btcPeerReadVarInt(msg, msgLen, &off);
+    int r = 1;
+
+    if (! block || count == 0 || off > msgLen || count > (msgLen - off)/60) { // a tx is at least 60 bytes
+        peer_log(peer, "malformed block message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->compactFilters || ! ctx->sentGetdata) {
+        peer_log(peer, "got block message before requesting blocks");
+        r = 0;
+    }
+    else {
+        UInt256 *txHashes = malloc(count*sizeof(*txHashes));
+        BRBitcoinTransaction **txs = calloc(count, sizeof(*txs));
+
+        assert(txHashes != NULL);
+        assert(txs != NULL);
+
+        for (i = 0; r && i < count; i++) {
+            len = _btcPeerScanTx(&msg[off], msgLen - off, &txHashes[i]);
+            txs[txCount] = (len > 0) ? btcTransactionParse(&msg[off], len) : NULL;
+
+            // skip any tx the parser misreads, it's not one the wallet could have produced or be watching for
+            if (txs[txCount] && UInt256Eq(txs[txCount]->txHash, txHashes[i])) txCount++;
+            else if (txs[txCount]) btcTransactionFree(txs[txCount]);
+            if (len == 0) r = 0;
+            off += len;
+        }
+
+        if (r && off == msgLen) btcMerkleBlockSetMatchedTxHashes(block, txHashes, NULL, count);
+        free(txHashes);
+
+        if (! r || off != msgLen) {
+            peer_log(peer, "malformed block message with length: %zu", msgLen);
+            r = 0;
+        }
+        else if (! btcMerkleBlockIsValid(block, (uint32_t)time(NULL))) {
+            peer_log(peer, "invalid block: %s", u256hex(block->blockHash));
+            r = 0;
+        }
+        else {
+            peer_log(peer, "got block: %s with %zu tx", u256hex(block->blockHash), count);
+
+            if (ctx->relayedFullBlock) {
+                ctx->relayedFullBlock(ctx->info, block, txs, txCount);
+                block = NULL;
+                txCount = 0;
+            }
+        }
+
+        for (i = 0; i < txCount; i++) btcTransactionFree(txs[i]);
+        free(txs);
+    }
+
+    if (block) btcMerkleBlockFree(block);
+    return r;
+}
+
+// BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+static int _btcPeerAcceptCFHeadersMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    size_t i, off = sizeof(uint8_t) + sizeof(UInt256)*2, count = _btcPeerReadVarInt(msg, msgLen, &off);
+    int r = 1;
+
+    if (off > msgLen || off + count*sizeof(UInt256) != msgLen) {
+        peer_log(peer, "malformed cfheaders message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->compactFilters || count > CFILTER_MAX_HEADERS) {
+        peer_log(peer, "got unrequested cfheaders message with %zu filter hash(es)", count);
+        r = 0;
+    }
+    else {
+        UInt256 filterHashes[count];
+
+        peer_log(peer, "got cfheaders with %zu filter hash(es)", count);
+        for (i = 0; i < count; i++) filterHashes[i] = UInt256Get(&msg[off + i*sizeof(UInt256)]);
+
+        if (ctx->relayedCFHeaders) {
+            ctx->relayedCFHeaders(ctx->info, msg[0], UInt256Get(&msg[sizeof(uint8_t)]),
+                                  UInt256Get(&msg[sizeof(uint8_t) + sizeof(UInt256)]), filterHashes, count);
+        }
+    }
+
+    return r;
+}
+
+// BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+static int _btcPeerAcceptCFilterMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    size_t off = sizeof(uint8_t) + sizeof(UInt256), len = _btcPeerReadVarInt(msg, msgLen, &off);
+    BRBitcoinCompactFilter *filter = (off <= msgLen && off + len == msgLen) ?
+        btcCompactFilterParse(msg[0], UInt256Get(&msg[sizeof(uint8_t)]), &msg[off], len) : NULL;
+    int r = 1;
+
+    if (! filter) {
+        peer_log(peer, "malformed cfilter message with length: %zu", msgLen);
+        r = 0;
+    }
+    else if (! ctx->compactFilters) {
+        peer_log(peer, "got unrequested cfilter message");
+        btcCompactFilterFree(filter);
+        r = 0;
+    }
+    else if (ctx->relayedCFilter) ctx->relayedCFilter(ctx->info, filter);
+    else btcCompactFilterFree(filter);
+
+    return r;
+}
+
 // described in BIP61: https://github.com/bitcoin/bips/blob/master/bip-0061.mediawiki
 static int _btcPeerAcceptRejectMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen)
 {
@@ -846,19 +1078,73 @@ static int _btcPeerAcceptMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t
     else if (strncmp(MSG_MERKLEBLOCK, type, 12) == 0) r = _btcPeerAcceptMerkleblockMessage(peer, msg, msgLen);
     else if (strncmp(MSG_REJECT, type, 12) == 0) r = _btcPeerAcceptRejectMessage(peer, msg, msgLen);
     else if (strncmp(MSG_FEEFILTER, type, 12) == 0) r = _btcPeerAcceptFeeFilterMessage(peer, msg, msgLen);
+    else if (strncmp(MSG_BLOCK, type, 12) == 0) r = _btcPeerAcceptBlockMessage(peer, msg, msgLen);
+    else if (strncmp(MSG_CFHEADERS, type, 12) == 0) r = _btcPeerAcceptCFHeadersMessage(peer, msg, msgLen);
+    else if (strncmp(MSG_CFILTER, type, 12) == 0) r = _btcPeerAcceptCFilterMessage(peer, msg, msgLen);
     else peer_log(peer, "dropping %s, length %zu, not implemented", type, msgLen);
 
     return r;
 }
 
-static int _btcPeerOpenSocket(BRBitcoinPeer *peer, int domain, double timeout, int *error)
+static int _peerGetSocket (BRBitcoinPeerContext *ctx) {
+    int socket;
+
+    pthread_mutex_lock(&ctx->lock);
+    socket = ctx->socket;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return socket;
+}
+
+static double _peerGetDisconnectTime (BRBitcoinPeerContext *ctx) {
+    double value;
+
+    pthread_mutex_lock(&ctx->lock);
+    value = ctx->disconnectTime;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return value;
+}
+
+static int _peerHasQueuedSend (BRBitcoinPeerContext *ctx) {
+    int value;
+
+    pthread_mutex_lock(&ctx->lock);
+    value = (ctx->sendStart < ctx->sendEnd);
+    pthread_mutex_unlock(&ctx->lock);
+
+    return value;
+}
+
+static double _peerGetSendTimeout (BRBitcoinPeerContext *ctx) {
+    double value;
+
+    pthread_mutex_lock(&ctx->lock);
+    value = ctx->sendTimeout;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return value;
+}
+
+static double _peerGetMempoolTime (BRBitcoinPeerContext *ctx) {
+    double value;
+
+    pthread_mutex_lock(&ctx->lock);
+    value = ctx->mempoolTime;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return value;
+}
+
+// starts a non-blocking connect to peer, the network thread waits for the socket to become writable to complete it
+// returns true if the connect is in progress
+static int _btcPeerOpenSocket(BRBitcoinPeer *peer, int domain, int *error)
 {
     BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
     struct sockaddr_storage addr;
     struct timeval tv;
-    fd_set fds;
-    socklen_t addrLen, optLen;
-    int count, arg = 0, err = 0, on = 1, r = 1;
+    socklen_t addrLen;
+    int arg = 0, err = 0, on = 1, r = 1;
     int sock;
 
     pthread_mutex_lock(&ctx->lock);
@@ -870,17 +1156,17 @@ static int _btcPeerOpenSocket(BRBitcoinPeer *peer, int domain, double timeout, i
         r = 0;
     }
     else {
-        tv.tv_sec = 1; // one second timeout for send/receive, so thread doesn't block for too long
+        tv.tv_sec = 1; // one second timeout for send, so a send doesn't hold up the network thread for too long
         tv.tv_usec = 0;
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
         setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
         setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
 #ifdef SO_NOSIGPIPE // BSD based systems have a SO_NOSIGPIPE socket option to supress SIGPIPE signals
         setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
 #endif
         arg = fcntl(sock, F_GETFL, NULL);
-        if (arg < 0 || fcntl(sock, F_SETFL, arg | O_NONBLOCK) < 0) r = 0; // temporarily set socket non-blocking
+        if (arg < 0 || fcntl(sock, F_SETFL, arg | O_NONBLOCK) < 0) r = 0; // set socket non-blocking until connected
         if (! r) err = errno;
+        ctx->socketFlags = arg;
     }
 
     if (r) {
@@ -901,192 +1187,225 @@ static int _btcPeerOpenSocket(BRBitcoinPeer *peer, int domain, double timeout, i
         
         if (connect(sock, (struct sockaddr *)&addr, addrLen) < 0) err = errno;
         
-        if (err == EINPROGRESS) {
+        if (err == EINPROGRESS || err == 0) {
             err = 0;
-            optLen = sizeof(err);
-            tv.tv_sec  = (long)  timeout;
-            tv.tv_usec = (long) (timeout*1000000) % 1000000;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            count = select(sock + 1, NULL, &fds, NULL, &tv);
-
-            if (count <= 0 || getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &optLen) < 0 || err) {
-                if (count == 0) err = ETIMEDOUT;
-                if (count < 0 || ! err) err = errno;
-                r = 0;
-            }
+            ctx->connecting = 1;
         }
-        else if (err && domain == PF_INET6 && _btcPeerIsIPv4(peer)) {
-            return _btcPeerOpenSocket(peer, PF_INET, timeout, error); // fallback to IPv4
+        else if (domain == PF_INET6 && _btcPeerIsIPv4(peer)) {
+            pthread_mutex_lock(&ctx->lock);
+            ctx->socket = -1;
+            pthread_mutex_unlock(&ctx->lock);
+            close(sock);
+            return _btcPeerOpenSocket(peer, PF_INET, error); // fallback to IPv4
         }
-        else if (err) r = 0;
-
-        if (r) peer_log(peer, "socket connected");
-        fcntl(sock, F_SETFL, arg); // restore socket non-blocking status
+        else r = 0;
     }
 
-    if (! r && err) peer_log(peer, "connect error: %s", strerror(err));
+    if (! r && ! err) err = ENOTCONN;
+    if (! r) peer_log(peer, "connect error: %s", strerror(err));
     if (error && err) *error = err;
     return r;
 }
 
-static int _peerCheckAndGetSocket (BRBitcoinPeerContext *ctx, int *socket) {
-    int exists;
+// completes a connect started by _btcPeerOpenSocket() once the socket is writable, and starts the handshake
+// returns an errno.h code, or 0 if connected
+static int _btcPeerDidOpenSocket(BRBitcoinPeer *peer, double time)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    socklen_t optLen = sizeof(int);
+    int socket = _peerGetSocket(ctx), err = 0;
+
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &err, &optLen) < 0) err = errno;
 
-    pthread_mutex_lock(&ctx->lock);
-    exists = ctx->socket >= 0;
-    if (NULL != socket) *socket = ctx->socket;
-    pthread_mutex_unlock(&ctx->lock);
+    if (err) peer_log(peer, "connect error: %s", strerror(err));
+    else {
+        fcntl(socket, F_SETFL, ctx->socketFlags); // restore socket non-blocking status
+        ctx->connecting = 0;
+        peer_log(peer, "socket connected");
+        ctx->startTime = time;
+        btcPeerSendVersionMessage(peer);
+    }
 
-    return exists;
+    return err;
 }
 
-static int _peerGetSocket (BRBitcoinPeerContext *ctx) {
-    int socket;
+// makes room in peer's receive buffer for at least len more bytes
+static void _btcPeerReserveReceive(BRBitcoinPeerContext *ctx, size_t len)
+{
+    if (ctx->recvStart > 0 && ctx->recvCapacity - ctx->recvEnd < len) { // move unparsed bytes to the start, just once
+        memmove(ctx->recvBuf, &ctx->recvBuf[ctx->recvStart], ctx->recvEnd - ctx->recvStart);
+        ctx->recvEnd -= ctx->recvStart;
+        ctx->recvStart = 0;
+    }
 
-    pthread_mutex_lock(&ctx->lock);
-    socket = ctx->socket;
-    pthread_mutex_unlock(&ctx->lock);
+    if (ctx->recvCapacity - ctx->recvEnd < len) {
+        ctx->recvCapacity = ctx->recvEnd + len;
+        ctx->recvBuf = realloc(ctx->recvBuf, ctx->recvCapacity);
+        assert(ctx->recvBuf != NULL);
+    }
+}
 
-    return socket;
+// accepts each complete message in peer's receive buffer, skipping any bytes before a message's magic number
+// returns an errno.h code, or 0 if all complete messages were accepted
+static int _btcPeerAcceptReceived(BRBitcoinPeer *peer, double time)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    const uint8_t *header;
+    const char *type;
+    size_t off = ctx->recvStart;
+    uint32_t msgLen, checksum;
+    UInt256 hash;
+    int error = 0;
+
+    ctx->recvNeeded = 0;
+
+    while (! error) {
+        // consume bytes until we find the magic number, keeping the last few in case they start it
+        while (off + sizeof(uint32_t) <= ctx->recvEnd && UInt32GetLE(&ctx->recvBuf[off]) != ctx->magicNumber) off++;
+        ctx->recvStart = off;
+        if (ctx->recvEnd - off < HEADER_LENGTH) break;
+        header = &ctx->recvBuf[off];
+        type = (const char *)&header[4];
+        msgLen = UInt32GetLE(&header[16]);
+        checksum = UInt32GetLE(&header[20]);
+
+        if (header[15] != 0) { // verify header type field is NULL terminated
+            peer_log(peer, "malformed message header: type not NULL terminated");
+            error = EPROTO;
+        }
+        else if (msgLen > MAX_MSG_LENGTH) { // check message length
+            peer_log(peer, "error reading %s, message length %"PRIu32" is too long", type, msgLen);
+            error = EPROTO;
+        }
+        else if (ctx->recvEnd - off < HEADER_LENGTH + msgLen) { // wait for the rest of the message
+            ctx->recvNeeded = HEADER_LENGTH + msgLen - (ctx->recvEnd - off);
+            break;
+        }
+        else {
+            BRSHA256_2(&hash, &header[HEADER_LENGTH], msgLen);
+            
+            if (UInt32GetLE(&hash) != checksum) { // verify checksum
+                peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
+                         ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
+                error = EPROTO;
+            }
+            else if (! _btcPeerAcceptMessage(peer, &header[HEADER_LENGTH], msgLen, type)) error = EPROTO;
+
+            off += HEADER_LENGTH + msgLen;
+        }
+    }
+
+    if (ctx->recvStart == ctx->recvEnd) ctx->recvStart = ctx->recvEnd = 0;
+    
+    // the rest of a message must keep arriving, once its header has
+    ctx->msgTimeout = (ctx->recvNeeded > 0) ? time + MESSAGE_TIMEOUT : DBL_MAX;
+    return error;
 }
 
-static double _peerGetDisconnectTime (BRBitcoinPeerContext *ctx) {
-    double value;
+// reads whatever has arrived on peer's socket, and accepts the complete messages received
+// returns an errno.h code, or 0 if the connection is still open
+static int _btcPeerReceive(BRBitcoinPeer *peer, double time)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    ssize_t n;
+
+    _btcPeerReserveReceive(ctx, (ctx->recvNeeded > RECEIVE_LENGTH) ? ctx->recvNeeded : RECEIVE_LENGTH);
+    n = recv(_peerGetSocket(ctx), &ctx->recvBuf[ctx->recvEnd], ctx->recvCapacity - ctx->recvEnd, MSG_DONTWAIT);
+    if (n == 0) return ECONNRESET;
+    if (n < 0) return (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR) ? 0 : errno;
+    ctx->recvEnd += (size_t)n;
+    return _btcPeerAcceptReceived(peer, time);
+}
 
-    pthread_mutex_lock(&ctx->lock);
-    value = ctx->disconnectTime;
-    pthread_mutex_unlock(&ctx->lock);
+// sends as much of peer's queued bytes as the socket takes without blocking, ctx->lock must be held
+// returns an errno.h code, or 0 if the connection is still open
+static int _btcPeerFlushSend(BRBitcoinPeerContext *ctx, double time)
+{
+    ssize_t n;
+
+    while (ctx->sendStart < ctx->sendEnd) {
+        n = send(ctx->socket, &ctx->sendBuf[ctx->sendStart], ctx->sendEnd - ctx->sendStart,
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) return (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR) ? 0 : errno;
+        ctx->sendStart += (size_t)n;
+        ctx->sendTimeout = time + MESSAGE_TIMEOUT; // the rest must keep draining, as long as the peer reads
+    }
 
-    return value;
+    ctx->sendStart = ctx->sendEnd = 0;
+    ctx->sendTimeout = DBL_MAX;
+    return 0;
 }
 
-static double _peerGetMempoolTime (BRBitcoinPeerContext *ctx) {
-    double value;
+// sends peer's queued bytes once its socket is writable again
+// returns an errno.h code, or 0 if the connection is still open
+static int _btcPeerSend(BRBitcoinPeer *peer, double time)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    int error;
 
     pthread_mutex_lock(&ctx->lock);
-    value = ctx->mempoolTime;
+    error = _btcPeerFlushSend(ctx, time);
     pthread_mutex_unlock(&ctx->lock);
-
-    return value;
+    return error;
 }
 
-
-static void *_peerThreadRoutine(void *arg)
+// returns ETIMEDOUT if peer's scheduled disconnect or message timeout has passed, and pings peer once it's done
+// waiting for a mempool response
+static int _btcPeerCheckTimeouts(BRBitcoinPeer *peer, double time)
 {
-    BRBitcoinPeer *peer = arg;
-    BRBitcoinPeerContext *ctx = arg;
-    int socket, error = 0;
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
 
-    pthread_cleanup_push(ctx->threadCleanup, ctx->info);
+    if (time >= _peerGetDisconnectTime(ctx) || time >= ctx->msgTimeout || time >= _peerGetSendTimeout(ctx)) {
+        return ETIMEDOUT;
+    }
 
-    char name[9 + 1 + INET6_ADDRSTRLEN + 1];
-    sprintf (name, "Core BTX, %s", ctx->host);
-    pthread_setname_brd (pthread_self(), name);
+    if (time >= _peerGetMempoolTime(ctx)) {
+        peer_log(peer, "done waiting for mempool response");
+        btcPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
+        ctx->mempoolCallback = NULL;
 
-    if (_btcPeerOpenSocket(peer, PF_INET6, CONNECT_TIMEOUT, &error)) {
-        struct timeval tv;
-        double time = 0, msgTimeout;
-        uint8_t header[HEADER_LENGTH], *payload = malloc(0x1000);
-        size_t len = 0, payloadLen = 0x1000;
-        ssize_t n = 0;
+        pthread_mutex_lock(&ctx->lock);
+        ctx->mempoolTime = DBL_MAX;
+        pthread_mutex_unlock(&ctx->lock);
+    }
 
-        assert(payload != NULL);
-        gettimeofday(&tv, NULL);
-        ctx->startTime = tv.tv_sec + (double)tv.tv_usec/1000000;
-        btcPeerSendVersionMessage(peer);
+    return 0;
+}
 
-        while (_peerCheckAndGetSocket(ctx, &socket) && ! error) {
-            len = 0;
-
-            while (socket >= 0 && ! error && len < HEADER_LENGTH) {
-                n = read(socket, &header[len], sizeof(header) - len);
-                if (n > 0) len += (size_t) n;
-                if (n == 0) error = ECONNRESET;
-                if (n < 0 && errno != EWOULDBLOCK) error = errno;
-                gettimeofday(&tv, NULL);
-                time = tv.tv_sec + (double)tv.tv_usec/1000000;
-                if (! error && time >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
-
-                if (! error && time >= _peerGetMempoolTime(ctx)) {
-                    peer_log(peer, "done waiting for mempool response");
-                    btcPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
-                    ctx->mempoolCallback = NULL;
-
-                    pthread_mutex_lock(&ctx->lock);
-                    ctx->mempoolTime = DBL_MAX;
-                    pthread_mutex_unlock(&ctx->lock);
-                }
+// closes peer's socket, stops servicing it on the network thread, and notifies pending callbacks and the peer's owner
+static void _btcPeerDidDisconnect(BRBitcoinPeer *peer, int error)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    void (*threadCleanup)(void *info) = ctx->threadCleanup;
+    void *info = ctx->info; // peer may be freed by the disconnected callback
+    int socket;
 
-                while (sizeof(uint32_t) <= len && UInt32GetLE(header) != ctx->magicNumber) {
-                    memmove(header, &header[1], --len); // consume one byte at a time until we find the magic number
-                }
+    pthread_mutex_lock(&_peersLock);
 
-                socket = _peerGetSocket(ctx);
-            }
-            
-            if (error) {
-                peer_log(peer, "%s", strerror(error));
-            }
-            else if (header[15] != 0) { // verify header type field is NULL terminated
-                peer_log(peer, "malformed message header: type not NULL terminated");
-                error = EPROTO;
-            }
-            else if (len == HEADER_LENGTH) {
-                const char *type = (const char *)(&header[4]);
-                uint32_t msgLen = UInt32GetLE(&header[16]);
-                uint32_t checksum = UInt32GetLE(&header[20]);
-                UInt256 hash;
-                
-                if (msgLen > MAX_MSG_LENGTH) { // check message length
-                    peer_log(peer, "error reading %s, message length %"PRIu32" is too long", type, msgLen);
-                    error = EPROTO;
-                }
-                else {
-                    if (msgLen > payloadLen) payload = realloc(payload, (payloadLen = msgLen));
-                    assert(payload != NULL);
-                    len = 0;
-                    socket = _peerGetSocket(ctx);
-                    msgTimeout = time + MESSAGE_TIMEOUT;
-                    
-                    while (socket >= 0 && ! error && len < msgLen) {
-                        n = read(socket, &payload[len], msgLen - len);
-                        if (n > 0) len += (size_t) n;
-                        if (n == 0) error = ECONNRESET;
-                        if (n < 0 && errno != EWOULDBLOCK) error = errno;
-                        gettimeofday(&tv, NULL);
-                        time = tv.tv_sec + (double)tv.tv_usec/1000000;
-                        if (n > 0) msgTimeout = time + MESSAGE_TIMEOUT;
-                        if (! error && time >= msgTimeout) error = ETIMEDOUT;
-                        socket = _peerGetSocket(ctx);
-                    }
-                    
-                    if (error) {
-                        peer_log(peer, "%s", strerror(error));
-                    }
-                    else if (len == msgLen) {
-                        BRSHA256_2(&hash, payload, msgLen);
-                        
-                        if (UInt32GetLE(&hash) != checksum) { // verify checksum
-                            peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
-                                     ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
-                            error = EPROTO;
-                        }
-                        else if (! _btcPeerAcceptMessage(peer, payload, msgLen, type)) error = EPROTO;
-                    }
-                }
-            }
-        }
-        
-        free(payload);
+    for (size_t i = array_count(_peers); i > 0; i--) {
+        if (_peers[i - 1] != ctx) continue;
+        array_rm(_peers, i - 1);
+        break;
     }
 
+    pthread_mutex_unlock(&_peersLock);
+
     pthread_mutex_lock(&ctx->lock);
     socket = ctx->socket;
+    ctx->socket = -1;
     ctx->status = BRPeerStatusDisconnected;
+    if (ctx->sendBuf) free(ctx->sendBuf);
+    ctx->sendBuf = NULL;
+    ctx->sendStart = ctx->sendEnd = ctx->sendCapacity = 0;
+    ctx->sendTimeout = DBL_MAX;
     pthread_mutex_unlock(&ctx->lock);
 
     if (socket >= 0) close(socket);
+    if (ctx->recvBuf) free(ctx->recvBuf);
+    ctx->recvBuf = NULL;
+    ctx->recvStart = ctx->recvEnd = ctx->recvCapacity = ctx->recvNeeded = 0;
+    ctx->msgTimeout = DBL_MAX;
+    ctx->connecting = 0;
     peer_log(peer, "disconnected");
     
     while (array_count(ctx->pongCallback) > 0) {
@@ -1101,10 +1420,153 @@ static void *_peerThreadRoutine(void *arg)
     if (ctx->mempoolCallback) ctx->mempoolCallback(ctx->mempoolInfo, 0);
     ctx->mempoolCallback = NULL;
     if (ctx->disconnected) ctx->disconnected(ctx->info, error);
-    pthread_cleanup_pop(1);
+    threadCleanup(info);
+}
+
+// wakes the network thread from poll(), so it services newly connecting or disconnected peers right away
+static void _btcPeerWakeNetworkThread(void)
+{
+    pthread_mutex_lock(&_peersLock);
+
+    // if the pipe is full, the thread is already being woken
+    if (_wakePipe[1] >= 0 && write(_wakePipe[1], "", 1) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        _peer_log("failed to wake network thread: %s\n", strerror(errno));
+    }
+
+    pthread_mutex_unlock(&_peersLock);
+}
+
+// the network thread services every connected peer, sleeping in poll() until a socket has data to read, or until the
+// next timeout, and accepts each message received on this thread, it exits once no peers are left
+static void *_btcPeerNetworkThreadRoutine(void *arg)
+{
+    BRBitcoinPeerContext **peers, *ctx;
+    struct pollfd *fds;
+    struct timeval tv;
+    double time, timeout;
+    uint8_t wake[64];
+    size_t i, count;
+
+    pthread_setname_brd(pthread_self(), "Core BTC Peers");
+    array_new(peers, 10);
+    array_new(fds, 10);
+    pthread_mutex_lock(&_peersLock);
+
+    while (array_count(_peers) > 0) {
+        count = array_count(_peers);
+        array_clear(peers);
+        array_add_array(peers, _peers, count);
+        array_clear(fds);
+        array_add(fds, ((struct pollfd) { _wakePipe[0], POLLIN, 0 }));
+        pthread_mutex_unlock(&_peersLock);
+
+        int errors[count];
+
+        gettimeofday(&tv, NULL);
+        time = tv.tv_sec + (double)tv.tv_usec/1000000;
+        timeout = PEER_POLL_TIMEOUT;
+
+        for (i = 0; i < count; i++) {
+            ctx = peers[i];
+            errors[i] = 0;
+
+            if (btcPeerConnectStatus(&ctx->peer) == BRPeerStatusDisconnected) { // btcPeerDisconnect() was called
+                errors[i] = ECONNRESET;
+                peer_log(&ctx->peer, "%s", strerror(errors[i]));
+            }
+            else if (_peerGetSocket(ctx) < 0) _btcPeerOpenSocket(&ctx->peer, PF_INET6, &errors[i]);
+
+            if (_peerGetDisconnectTime(ctx) - time < timeout) timeout = _peerGetDisconnectTime(ctx) - time;
+            if (_peerGetMempoolTime(ctx) - time < timeout) timeout = _peerGetMempoolTime(ctx) - time;
+            if (_peerGetSendTimeout(ctx) - time < timeout) timeout = _peerGetSendTimeout(ctx) - time;
+            if (ctx->msgTimeout - time < timeout) timeout = ctx->msgTimeout - time;
+            if (errors[i]) timeout = 0;
+            array_add(fds, ((struct pollfd) { (errors[i]) ? -1 : _peerGetSocket(ctx), (ctx->connecting) ? POLLOUT :
+                                              POLLIN | ((_peerHasQueuedSend(ctx)) ? POLLOUT : 0), 0 }));
+        }
+
+        if (poll(fds, array_count(fds), (timeout > 0) ? (int)(timeout*1000) + 1 : 0) < 0) {
+            for (i = 0; i < array_count(fds); i++) fds[i].revents = 0; // interrupted, check timeouts and poll again
+        }
+
+        if (fds[0].revents & POLLIN) while (read(fds[0].fd, wake, sizeof(wake)) > 0);
+        gettimeofday(&tv, NULL);
+        time = tv.tv_sec + (double)tv.tv_usec/1000000;
+
+        for (i = 0; i < count; i++) {
+            BRBitcoinPeer *peer = &peers[i]->peer;
+            short revents = fds[i + 1].revents;
+            int error = errors[i];
+
+            if (! error && peers[i]->connecting && revents) error = _btcPeerDidOpenSocket(peer, time);
+            else {
+                if (! error && (revents & POLLOUT) && (error = _btcPeerSend(peer, time)) != 0) {
+                    peer_log(peer, "%s", strerror(error));
+                }
+
+                if (! error && (revents & ~POLLOUT) && (error = _btcPeerReceive(peer, time)) != 0) {
+                    peer_log(peer, "%s", strerror(error));
+                }
+            }
+
+            if (! error && (error = _btcPeerCheckTimeouts(peer, time)) != 0) peer_log(peer, "%s", strerror(error));
+            if (error) _btcPeerDidDisconnect(peer, error);
+        }
+
+        pthread_mutex_lock(&_peersLock);
+    }
+
+    array_free(_peers);
+    _peers = NULL;
+    close(_wakePipe[0]);
+    close(_wakePipe[1]);
+    _wakePipe[0] = _wakePipe[1] = -1;
+    _networkThreadRunning = 0;
+    pthread_mutex_unlock(&_peersLock);
+    array_free(fds);
+    array_free(peers);
     return NULL; // detached threads don't need to return a value
 }
 
+// adds peer to those serviced by the network thread, starting the thread if it isn't running
+// returns true on success
+static int _btcPeerAddToNetworkThread(BRBitcoinPeer *peer)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int r = 1;
+
+    pthread_mutex_lock(&_peersLock);
+    if (! _peers) array_new(_peers, 10);
+
+    if (_wakePipe[0] < 0) {
+        if (pipe(_wakePipe) < 0) r = 0;
+        if (r && fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL, NULL) | O_NONBLOCK) < 0) r = 0;
+        if (r && fcntl(_wakePipe[1], F_SETFL, fcntl(_wakePipe[1], F_GETFL, NULL) | O_NONBLOCK) < 0) r = 0;
+    }
+
+    for (size_t i = array_count(_peers); r && i > 0; i--) {
+        if (_peers[i - 1] == (BRBitcoinPeerContext *)peer) r = 0; // still disconnecting
+    }
+
+    if (r && ! _networkThreadRunning) {
+        if (pthread_attr_init(&attr) != 0) r = 0;
+        else {
+            if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0 ||
+                pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE) != 0 ||
+                pthread_create(&thread, &attr, _btcPeerNetworkThreadRoutine, NULL) != 0) r = 0;
+            pthread_attr_destroy(&attr);
+        }
+
+        if (r) _networkThreadRunning = 1;
+    }
+
+    if (r) array_add(_peers, (BRBitcoinPeerContext *)peer);
+    pthread_mutex_unlock(&_peersLock);
+    if (r) _btcPeerWakeNetworkThread();
+    return r;
+}
+
 static void _dummyThreadCleanup(void *info)
 {
 }
@@ -1126,6 +1588,8 @@ BRBitcoinPeer *btcPeerNew(uint32_t magicNumber)
     ctx->pingTime = DBL_MAX;
     ctx->mempoolTime = DBL_MAX;
     ctx->disconnectTime = DBL_MAX;
+    ctx->msgTimeout = DBL_MAX;
+    ctx->sendTimeout = DBL_MAX;
     ctx->socket = -1;
     ctx->threadCleanup = _dummyThreadCleanup;
 
@@ -1151,7 +1615,7 @@ BRBitcoinPeer *btcPeerNew(uint32_t magicNumber)
 // void notfound(void *, const UInt256[], size_t, const UInt256[], size_t) - called when "notfound" message is received
 // BRBitcoinTransaction *requestedTx(void *, UInt256) - called when "getdata" message with tx hash is received from peer
 // int networkIsReachable(void *) - must return true when networking is available, false otherwise
-// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup
+// void threadCleanup(void *) - called on the network thread after disconnected, to faciliate any needed cleanup
 void btcPeerSetCallbacks(BRBitcoinPeer *peer, void *info,
                         void (*connected)(void *info),
                         void (*disconnected)(void *info, int error),
@@ -1184,6 +1648,38 @@ void btcPeerSetCallbacks(BRBitcoinPeer *peer, void *info,
     ctx->threadCleanup = (threadCleanup) ? threadCleanup : _dummyThreadCleanup;
 }
 
+// switches peer to compact block filter sync (BIP157), where full blocks are requested instead of filtered blocks, and
+// the remote peer's chain of headers is only followed on request
+void btcPeerSetCompactFilterCallbacks(BRBitcoinPeer *peer,
+                                      void (*relayedHeaders)(void *info, size_t headersCount),
+                                      void (*relayedCFHeaders)(void *info, uint8_t filterType, UInt256 stopHash,
+                                                               UInt256 prevFilterHeader, const UInt256 filterHashes[],
+                                                               size_t hashesCount),
+                                      void (*relayedCFilter)(void *info, BRBitcoinCompactFilter *filter),
+                                      void (*relayedFullBlock)(void *info, BRBitcoinMerkleBlock *block,
+                                                               BRBitcoinTransaction *txs[], size_t txCount),
+                                      void (*announcedBlocks)(void *info, const UInt256 blockHashes[],
+                                                              size_t blockCount))
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+
+    ctx->compactFilters = 1;
+    ctx->headersFirst = 1;
+    ctx->relayedHeaders = relayedHeaders;
+    ctx->relayedCFHeaders = relayedCFHeaders;
+    ctx->relayedCFilter = relayedCFilter;
+    ctx->relayedFullBlock = relayedFullBlock;
+    ctx->announcedBlocks = announcedBlocks;
+}
+
+void btcPeerSetHeadersFirst(BRBitcoinPeer *peer, void (*relayedHeaders)(void *info, size_t headersCount))
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+
+    ctx->headersFirst = 1;
+    ctx->relayedHeaders = relayedHeaders;
+}
+
 // set earliestKeyTime to wallet creation time in order to speed up initial sync
 void btcPeerSetEarliestKeyTime(BRBitcoinPeer *peer, uint32_t earliestKeyTime)
 {
@@ -1209,12 +1705,12 @@ BRBitcoinPeerStatus btcPeerConnectStatus(BRBitcoinPeer *peer)
     return status;
 }
 
-// open connection to peer and perform handshake
+// open connection to peer and perform handshake, all connected peers share a single network thread, which makes
+// the callbacks of every peer
 void btcPeerConnect(BRBitcoinPeer *peer)
 {
     BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
     struct timeval tv;
-    pthread_attr_t attr;
 
     pthread_mutex_lock(&ctx->lock);
     if (ctx->status == BRPeerStatusDisconnected || ctx->waitingForNetwork) {
@@ -1229,21 +1725,12 @@ void btcPeerConnect(BRBitcoinPeer *peer)
             ctx->waitingForNetwork = 0;
             gettimeofday(&tv, NULL);
 
-            // No race - set before the thread starts.
+            // No race - set before the network thread services the peer.
             ctx->disconnectTime = tv.tv_sec + (double)tv.tv_usec/1000000 + CONNECT_TIMEOUT;
 
-            if (pthread_attr_init(&attr) != 0) {
-                // error = ENOMEM;
-                peer_log(peer, "error creating thread");
-                ctx->status = BRPeerStatusDisconnected;
-                //if (ctx->disconnected) ctx->disconnected(ctx->info, error);
-            }
-            else if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0 ||
-                     pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE) != 0 ||
-                     pthread_create(&ctx->thread, &attr, _peerThreadRoutine, peer) != 0) {
+            if (! _btcPeerAddToNetworkThread(peer)) {
                 // error = EAGAIN;
                 peer_log(peer, "error creating thread");
-                pthread_attr_destroy(&attr);
                 ctx->status = BRPeerStatusDisconnected;
                 //if (ctx->disconnected) ctx->disconnected(ctx->info, error);
             }
@@ -1256,16 +1743,20 @@ void btcPeerConnect(BRBitcoinPeer *peer)
 void btcPeerDisconnect(BRBitcoinPeer *peer)
 {
     BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
-    int socket = -1;
+    int socket = -1, isServiced = 0;
 
-    if (_peerCheckAndGetSocket(ctx, &socket)) {
-        pthread_mutex_lock(&ctx->lock);
-        ctx->status = BRPeerStatusDisconnected;
-        pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_lock(&ctx->lock);
+    socket = ctx->socket;
 
-        if (shutdown(socket, SHUT_RDWR) < 0) peer_log(peer, "%s", strerror(errno));
-        close(socket);
+    // a peer with no socket yet is still serviced by the network thread, unless it's waiting for network reachability
+    if (socket >= 0 || (ctx->status == BRPeerStatusConnecting && ! ctx->waitingForNetwork)) {
+        ctx->status = BRPeerStatusDisconnected;
+        isServiced = 1;
     }
+
+    pthread_mutex_unlock(&ctx->lock);
+    if (socket >= 0 && shutdown(socket, SHUT_RDWR) < 0) peer_log(peer, "%s", strerror(errno));
+    if (isServiced) _btcPeerWakeNetworkThread(); // the network thread closes the socket
 }
 
 // call this to (re)schedule a disconnect in the given number of seconds, or < 0 to cancel (useful for sync timeout)
@@ -1338,11 +1829,8 @@ uint64_t btcPeerFeePerKb(BRBitcoinPeer *peer)
     return feePerKb;
 }
 
-#ifndef MSG_NOSIGNAL   // linux based systems have a MSG_NOSIGNAL send flag, useful for supressing SIGPIPE signals
-#define MSG_NOSIGNAL 0 // set to 0 if undefined (BSD has the SO_NOSIGPIPE sockopt, and windows has no signals at all)
-#endif
-
-// sends a bitcoin protocol message to peer
+// queues a bitcoin protocol message to peer, and sends as much of it as the socket takes without blocking, the network
+// thread sends the rest once the socket is writable, so a peer that stops reading can't stall other peers
 void btcPeerSendMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen, const char *type)
 {
     if (msgLen > MAX_MSG_LENGTH) {
@@ -1350,40 +1838,57 @@ void btcPeerSendMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen,
     }
     else {
         BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
-        uint8_t buf[HEADER_LENGTH + msgLen], hash[32];
-        size_t off = 0;
-        ssize_t n = 0;
+        size_t off, len = HEADER_LENGTH + msgLen;
+        uint8_t hash[32], *buf;
         struct timeval tv;
-        int socket, error = 0;
+        double time;
+        int isQueued = 0, error = 0;
         
-        UInt32SetLE(&buf[off], ctx->magicNumber);
-        off += sizeof(uint32_t);
-        strncpy((char *)&buf[off], type, 12);
-        off += 12;
-        UInt32SetLE(&buf[off], (uint32_t)msgLen);
-        off += sizeof(uint32_t);
-        BRSHA256_2(hash, msg, msgLen);
-        memcpy(&buf[off], hash, sizeof(uint32_t));
-        off += sizeof(uint32_t);
-        memcpy(&buf[off], msg, msgLen);
         peer_log(peer, "sending %s", type);
-        msgLen = 0;
-        socket = _peerGetSocket(ctx);
-        if (socket < 0) error = ENOTCONN;
-        
-        while (socket >= 0 && ! error && msgLen < sizeof(buf)) {
-            n = send(socket, &buf[msgLen], sizeof(buf) - msgLen, MSG_NOSIGNAL);
-            if (n >= 0) msgLen += (size_t) n;
-            if (n < 0 && errno != EWOULDBLOCK) error = errno;
-            gettimeofday(&tv, NULL);
-            if (! error && tv.tv_sec + (double)tv.tv_usec/1000000 >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
-            socket = _peerGetSocket(ctx);
+        BRSHA256_2(hash, msg, msgLen);
+        gettimeofday(&tv, NULL);
+        time = tv.tv_sec + (double)tv.tv_usec/1000000;
+        pthread_mutex_lock(&ctx->lock);
+
+        if (ctx->socket < 0) error = ENOTCONN;
+        else if (ctx->sendEnd - ctx->sendStart + len > MAX_SEND_LENGTH) error = ENOBUFS;
+        else {
+            if (ctx->sendStart > 0 && ctx->sendCapacity - ctx->sendEnd < len) { // move unsent bytes to the start
+                memmove(ctx->sendBuf, &ctx->sendBuf[ctx->sendStart], ctx->sendEnd - ctx->sendStart);
+                ctx->sendEnd -= ctx->sendStart;
+                ctx->sendStart = 0;
+            }
+
+            if (ctx->sendCapacity - ctx->sendEnd < len) {
+                ctx->sendCapacity = ctx->sendEnd + len;
+                ctx->sendBuf = realloc(ctx->sendBuf, ctx->sendCapacity);
+                assert(ctx->sendBuf != NULL);
+            }
+
+            buf = &ctx->sendBuf[ctx->sendEnd];
+            off = 0;
+            UInt32SetLE(&buf[off], ctx->magicNumber);
+            off += sizeof(uint32_t);
+            strncpy((char *)&buf[off], type, 12);
+            off += 12;
+            UInt32SetLE(&buf[off], (uint32_t)msgLen);
+            off += sizeof(uint32_t);
+            memcpy(&buf[off], hash, sizeof(uint32_t));
+            off += sizeof(uint32_t);
+            memcpy(&buf[off], msg, msgLen);
+            ctx->sendEnd += len;
+            if (ctx->sendTimeout == DBL_MAX) ctx->sendTimeout = time + MESSAGE_TIMEOUT;
+            error = _btcPeerFlushSend(ctx, time);
+            isQueued = (ctx->sendStart < ctx->sendEnd);
         }
-        
+
+        pthread_mutex_unlock(&ctx->lock);
+
         if (error) {
             peer_log(peer, "%s", strerror(error));
             btcPeerDisconnect(peer);
         }
+        else if (isQueued) _btcPeerWakeNetworkThread(); // poll for the socket to become writable
     }
 }
 
@@ -1445,6 +1950,17 @@ void btcPeerSendFilterload(BRBitcoinPeer *peer, const uint8_t *filter, size_t fi
     btcPeerSendMessage(peer, filter, filterLen, MSG_FILTERLOAD);
 }
 
+void btcPeerSendFilteradd(BRBitcoinPeer *peer, const uint8_t *data, size_t dataLen)
+{
+    uint8_t msg[BRVarIntSize(dataLen) + dataLen];
+    size_t off = BRVarIntSet(msg, sizeof(msg), dataLen);
+
+    assert(dataLen <= 520); // BIP37 limits filteradd data to the max script element size
+    ((BRBitcoinPeerContext *)peer)->sentMempool = 0;
+    memcpy(&msg[off], data, dataLen);
+    btcPeerSendMessage(peer, msg, off + dataLen, MSG_FILTERADD);
+}
+
 void btcPeerSendMempool(BRBitcoinPeer *peer, const UInt256 knownTxHashes[], size_t knownTxCount, void *info,
                         void (*completionCallback)(void *info, int success))
 {
@@ -1563,6 +2079,7 @@ void btcPeerSendGetdata(BRBitcoinPeer *peer, const UInt256 txHashes[], size_t tx
         size_t msgLen = BRVarIntSize(count) + (sizeof(uint32_t) + sizeof(UInt256))*(count);
         uint8_t msg[msgLen];
         uint32_t flag = ((peer->services & SERVICES_NODE_WITNESS) == SERVICES_NODE_WITNESS) ? WITNESS_FLAG : 0;
+        inv_type blockType = (((BRBitcoinPeerContext *)peer)->compactFilters) ? inv_block | flag : inv_filtered_block;
         
         off += BRVarIntSet(&msg[off], (off <= msgLen ? msgLen - off : 0), count);
         
@@ -1574,7 +2091,7 @@ void btcPeerSendGetdata(BRBitcoinPeer *peer, const UInt256 txHashes[], size_t tx
         }
         
         for (i = 0; i < blockCount; i++) {
-            UInt32SetLE(&msg[off], inv_filtered_block);
+            UInt32SetLE(&msg[off], blockType);
             off += sizeof(uint32_t);
             UInt256Set(&msg[off], blockHashes[i]);
             off += sizeof(UInt256);
@@ -1605,6 +2122,32 @@ void btcPeerSendPing(BRBitcoinPeer *peer, void *info, void (*pongCallback)(void
     btcPeerSendMessage(peer, msg, sizeof(msg), MSG_PING);
 }
 
+static void _btcPeerSendCFRequest(BRBitcoinPeer *peer, uint8_t filterType, uint32_t startHeight, UInt256 stopHash,
+                                  const char *type)
+{
+    uint8_t msg[sizeof(uint8_t) + sizeof(uint32_t) + sizeof(UInt256)];
+    size_t off = 0;
+
+    msg[off] = filterType;
+    off += sizeof(uint8_t);
+    UInt32SetLE(&msg[off], startHeight);
+    off += sizeof(uint32_t);
+    UInt256Set(&msg[off], stopHash);
+    off += sizeof(UInt256);
+    peer_log(peer, "calling %s from height %"PRIu32" to %s", type, startHeight, u256hex(stopHash));
+    btcPeerSendMessage(peer, msg, off, type);
+}
+
+void btcPeerSendGetcfheaders(BRBitcoinPeer *peer, uint8_t filterType, uint32_t startHeight, UInt256 stopHash)
+{
+    _btcPeerSendCFRequest(peer, filterType, startHeight, stopHash, MSG_GETCFHEADERS);
+}
+
+void btcPeerSendGetcfilters(BRBitcoinPeer *peer, uint8_t filterType, uint32_t startHeight, UInt256 stopHash)
+{
+    _btcPeerSendCFRequest(peer, filterType, startHeight, stopHash, MSG_GETCFILTERS);
+}
+
 // useful to get additional tx after a bloom filter update
 void btcPeerRerequestBlocks(BRBitcoinPeer *peer, UInt256 fromBlock)
 {
@@ -1631,6 +2174,8 @@ void btcPeerFree(BRBitcoinPeer *peer)
     if (ctx->knownTxHashSet) BRSetFree(ctx->knownTxHashSet);
     if (ctx->pongCallback) array_free(ctx->pongCallback);
     if (ctx->pongInfo) array_free(ctx->pongInfo);
+    if (ctx->recvBuf) free(ctx->recvBuf);
+    if (ctx->sendBuf) free(ctx->sendBuf);
     
     pthread_mutex_destroy(&ctx->lock);
     free(ctx);
@@ -1640,3 +2185,50 @@ void btcPeerAcceptMessageTest(BRBitcoinPeer *peer, const uint8_t *msg, size_t ms
 {
     _btcPeerAcceptMessage(peer, msg, msgLen, type);
 }
+
+int btcPeerReceiveTest(BRBitcoinPeer *peer, const uint8_t *buf, size_t bufLen)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+
+    _btcPeerReserveReceive(ctx, bufLen);
+    memcpy(&ctx->recvBuf[ctx->recvEnd], buf, bufLen);
+    ctx->recvEnd += bufLen;
+    return _btcPeerAcceptReceived(peer, 0);
+}
+
+// for testing, marks peer as connected without a socket, with the given last block
+void btcPeerSetConnectedTest(BRBitcoinPeer *peer, uint32_t lastBlock)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->status = BRPeerStatusConnected;
+    ctx->lastblock = lastBlock;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// for testing, accepts a pong in reply to peer's oldest ping, returns the number of pings still waiting for a pong
+size_t btcPeerPongTest(BRBitcoinPeer *peer)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    uint8_t msg[sizeof(uint64_t)];
+
+    UInt64SetLE(msg, ctx->nonce);
+    _btcPeerAcceptMessage(peer, msg, sizeof(msg), MSG_PONG);
+    return array_count(ctx->pongCallback);
+}
+
+// for testing, sets peer's socket, and sends its queued bytes as the network thread does once the socket is writable
+// returns the number of bytes still queued
+size_t btcPeerSendTest(BRBitcoinPeer *peer, int socket)
+{
+    BRBitcoinPeerContext *ctx = (BRBitcoinPeerContext *)peer;
+    size_t count;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->socket = socket;
+    if (socket >= 0) _btcPeerFlushSend(ctx, 0);
+    count = ctx->sendEnd - ctx->sendStart;
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
@@ -27,6 +27,7 @@
 
 #include "BRBitcoinTransaction.h"
 #include "BRBitcoinMerkleBlock.h"
+#include "BRBitcoinCompactFilter.h"
 #include "support/BRAddress.h"
 #include "support/BRInt.h"
 #include "support/BROSCompat.h"
@@ -57,6 +58,7 @@ extern "C" {
 #define SERVICES_NODE_BLOOM   0x04 // BIP111: https://github.com/bitcoin/bips/blob/master/bip-0111.mediawiki
 #define SERVICES_NODE_WITNESS 0x08 // BIP144: https://github.com/bitcoin/bips/blob/master/bip-0144.mediawiki
 #define SERVICES_NODE_BCASH   0x20 // https://github.com/Bitcoin-UAHF/spec/blob/master/uahf-technical-spec.md
+#define SERVICES_NODE_COMPACT_FILTERS 0x40 // BIP157: https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
     
 #define BR_VERSION "2.1"
 #define USER_AGENT "/bread:" BR_VERSION "/"
@@ -84,6 +86,10 @@ extern "C" {
 #define MSG_ALERT       "alert"
 #define MSG_REJECT      "reject"   // described in BIP61: https://github.com/bitcoin/bips/blob/master/bip-0061.mediawiki
 #define MSG_FEEFILTER   "feefilter"// described in BIP133 https://github.com/bitcoin/bips/blob/master/bip-0133.mediawiki
+#define MSG_GETCFILTERS  "getcfilters"  // described in BIP157 https://github.com/bitcoin/bips/blob/master/bip-0157.mediawiki
+#define MSG_CFILTER      "cfilter"
+#define MSG_GETCFHEADERS "getcfheaders"
+#define MSG_CFHEADERS    "cfheaders"
 
 #define REJECT_INVALID     0x10 // transaction is invalid for some reason (invalid signature, output value > input, etc)
 #define REJECT_SPENT       0x12 // an input is already spent
@@ -123,7 +129,7 @@ BRBitcoinPeer *btcPeerNew(uint32_t magicNumber);
 // void notfound(void *, const UInt256[], size_t, const UInt256[], size_t) - called when "notfound" message is received
 // BRBitcoinTransaction *requestedTx(void *, UInt256) - called when "getdata" message with a tx hash is received from peer
 // int networkIsReachable(void *) - must return true when networking is available, false otherwise
-// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup    
+// void threadCleanup(void *) - called on the network thread after disconnected, to faciliate any needed cleanup
 void btcPeerSetCallbacks(BRBitcoinPeer *peer, void *info,
                         void (*connected)(void *info),
                         void (*disconnected)(void *info, int error),
@@ -139,6 +145,32 @@ void btcPeerSetCallbacks(BRBitcoinPeer *peer, void *info,
                         int (*networkIsReachable)(void *info),
                         void (*threadCleanup)(void *info));
 
+// switches peer to compact block filter sync (BIP157), where full blocks are requested instead of filtered blocks, and
+// the remote peer's chain of headers is only followed on request
+// void relayedHeaders(void *, size_t) - called after the headers in a "headers" message are passed to relayedBlock()
+// void relayedCFHeaders(void *, uint8_t, UInt256, UInt256, const UInt256[], size_t) - called when a "cfheaders" message
+// - is received from peer, with the filter type, stop hash, previous filter header, and filter hashes
+// void relayedCFilter(void *, BRBitcoinCompactFilter *) - called when a "cfilter" message is received from peer
+// void relayedFullBlock(void *, BRBitcoinMerkleBlock *, BRBitcoinTransaction *[], size_t) - called when a "block"
+// - message is received, with a merkle block matching every tx in the block, and the tx, txs array is only valid
+// - during the call
+// void announcedBlocks(void *, const UInt256[], size_t) - called when an "inv" message with block hashes is received
+void btcPeerSetCompactFilterCallbacks(BRBitcoinPeer *peer,
+                                      void (*relayedHeaders)(void *info, size_t headersCount),
+                                      void (*relayedCFHeaders)(void *info, uint8_t filterType, UInt256 stopHash,
+                                                               UInt256 prevFilterHeader, const UInt256 filterHashes[],
+                                                               size_t hashesCount),
+                                      void (*relayedCFilter)(void *info, BRBitcoinCompactFilter *filter),
+                                      void (*relayedFullBlock)(void *info, BRBitcoinMerkleBlock *block,
+                                                               BRBitcoinTransaction *txs[], size_t txCount),
+                                      void (*announcedBlocks)(void *info, const UInt256 blockHashes[],
+                                                              size_t blockCount));
+
+// switches peer to headers-first sync, where a "headers" message isn't followed by a request for more headers or for
+// filtered blocks, and both are left to the caller
+// void relayedHeaders(void *, size_t) - called after the headers in a "headers" message are passed to relayedBlock()
+void btcPeerSetHeadersFirst(BRBitcoinPeer *peer, void (*relayedHeaders)(void *info, size_t headersCount));
+
 // set earliestKeyTime to wallet creation time in order to speed up initial sync
 void btcPeerSetEarliestKeyTime(BRBitcoinPeer *peer, uint32_t earliestKeyTime);
 
@@ -148,7 +180,8 @@ void btcPeerSetCurrentBlockHeight(BRBitcoinPeer *peer, uint32_t currentBlockHeig
 // current connection status
 BRBitcoinPeerStatus btcPeerConnectStatus(BRBitcoinPeer *peer);
 
-// open connection to peer and perform handshake
+// open connection to peer and perform handshake, all connected peers share a single network thread, which makes
+// the callbacks of every peer
 void btcPeerConnect(BRBitcoinPeer *peer);
 
 // close connection to peer
@@ -181,6 +214,7 @@ double btcPeerPingTime(BRBitcoinPeer *peer);
 // sends a bitcoin protocol message to peer
 void btcPeerSendMessage(BRBitcoinPeer *peer, const uint8_t *msg, size_t msgLen, const char *type);
 void btcPeerSendFilterload(BRBitcoinPeer *peer, const uint8_t *filter, size_t filterLen);
+void btcPeerSendFilteradd(BRBitcoinPeer *peer, const uint8_t *data, size_t dataLen); // dataLen must be 520 or less
 void btcPeerSendMempool(BRBitcoinPeer *peer, const UInt256 knownTxHashes[], size_t knownTxCount, void *info,
                         void (*completionCallback)(void *info, int success));
 void btcPeerSendGetheaders(BRBitcoinPeer *peer, const UInt256 locators[], size_t locatorsCount, UInt256 hashStop);
@@ -190,6 +224,8 @@ void btcPeerSendGetdata(BRBitcoinPeer *peer, const UInt256 txHashes[], size_t tx
                         size_t blockCount);
 void btcPeerSendGetaddr(BRBitcoinPeer *peer);
 void btcPeerSendPing(BRBitcoinPeer *peer, void *info, void (*pongCallback)(void *info, int success));
+void btcPeerSendGetcfheaders(BRBitcoinPeer *peer, uint8_t filterType, uint32_t startHeight, UInt256 stopHash);
+void btcPeerSendGetcfilters(BRBitcoinPeer *peer, uint8_t filterType, uint32_t startHeight, UInt256 stopHash);
 
 // useful to get additional tx after a bloom filter update
 void btcPeerRerequestBlocks(BRBitcoinPeer *peer, UInt256 fromBlock);
@@ -24,6 +24,7 @@
 
 #include "BRBitcoinPeerManager.h"
 #include "BRBitcoinBloomFilter.h"
+#include "BRBitcoinCompactFilter.h"
 #include "support/BRSet.h"
 #include "support/BRArray.h"
 #include "support/BRInt.h"
@@ -43,6 +44,13 @@
 #define MAX_CONNECT_FAILURES  20 // notify user of network problems after this many connect failures in a row
 #define PEER_FLAG_SYNCED      0x01
 #define PEER_FLAG_NEEDSUPDATE 0x02
+#define PEER_FLAG_FILTERED    0x04
+#define BLOCK_RANGE_SIZE      500 // merkle blocks requested at a time from each peer during a headers-first sync
+#define BLOCK_RANGE_WINDOW    40  // most block ranges requested ahead of the last one applied to the wallet
+#define MAX_PEER_RANGES       2   // most block ranges in flight to a single peer
+#define MAX_FILTERADD_FP_RATE (BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) // filters are rebuilt rather than grown past this
+#define TX_PEER_LIST_CAPACITY 10000 // most tx hashes tracked per list, the oldest are dropped first
+#define TX_PEER_LIST_MAX_AGE  (14*24*60*60) // peers drop unconfirmed tx from their mempools after two weeks
 
 #define genesis_block_hash(params) UInt256Reverse((params)->checkpoints[0].hash)
 
@@ -56,6 +64,7 @@ typedef struct {
     BRBitcoinPeer *peer;
     BRBitcoinPeerManager *manager;
     UInt256 hash;
+    int fromBlockRange; // relayed as part of a completed block range, rather than directly by peer
 } BRPeerCallbackInfo;
 
 typedef struct {
@@ -65,74 +74,214 @@ typedef struct {
 } BRPublishedTx;
 
 typedef struct {
-    UInt256 txHash;
+    UInt256 txHash; // must be first, lists are looked up by txHash
     BRBitcoinPeer *peers;
+    time_t timestamp; // when txHash was first tracked
 } BRTxPeerList;
 
+// BRTxPeerList items hashed by txHash, with bounded capacity and aging
+typedef struct {
+    BRSet *lists;
+    BRTxPeerList **order; // lists in the order they were added, oldest first from orderStart
+    size_t orderStart;
+} BRTxPeerIndex;
+
+typedef struct {
+    BRBitcoinMerkleBlock *block; // NULL for a tx, relayed before the merkle block that includes it
+    BRBitcoinTransaction *tx;
+} BRBlockRangeItem;
+
+// a range of consecutive blocks requested as merkle blocks from one peer during a headers-first sync
+typedef struct {
+    BRBitcoinPeer *peer; // NULL until the range is requested
+    uint32_t startHeight, requestSeq;
+    UInt256 *blockHashes;
+    size_t blockCount; // number of merkle blocks received
+    BRBlockRangeItem *items; // merkle blocks and tx, in the order peer relayed them
+    int isStale; // replies to the request are discarded, and the range is requested again
+} BRBlockRange;
+
+static BRBlockRange *_btcBlockRangeNew(uint32_t startHeight, const UInt256 blockHashes[], size_t count)
+{
+    BRBlockRange *range = calloc(1, sizeof(*range));
+
+    assert(range != NULL);
+    range->startHeight = startHeight;
+    array_new(range->blockHashes, count);
+    array_add_array(range->blockHashes, blockHashes, count);
+    array_new(range->items, count);
+    return range;
+}
+
+static int _btcBlockRangeIsComplete(const BRBlockRange *range)
+{
+    return (range->blockCount == array_count(range->blockHashes));
+}
+
+static void _btcBlockRangeClearItems(BRBlockRange *range)
+{
+    for (size_t i = array_count(range->items); i > 0; i--) {
+        if (range->items[i - 1].block) btcMerkleBlockFree(range->items[i - 1].block);
+        if (range->items[i - 1].tx) btcTransactionFree(range->items[i - 1].tx);
+    }
+
+    array_clear(range->items);
+}
+
+static void _btcBlockRangeFree(BRBlockRange *range)
+{
+    _btcBlockRangeClearItems(range);
+    array_free(range->items);
+    array_free(range->blockHashes);
+    free(range);
+}
+
+inline static size_t _BRTxPeerListHash(const void *list)
+{
+    return (size_t)((const BRTxPeerList *)list)->txHash.u32[0];
+}
+
+inline static int _BRTxPeerListEq(const void *list, const void *otherList)
+{
+    return UInt256Eq(((const BRTxPeerList *)list)->txHash, ((const BRTxPeerList *)otherList)->txHash);
+}
+
+static void _BRTxPeerIndexInit(BRTxPeerIndex *index)
+{
+    index->lists = BRSetNew(_BRTxPeerListHash, _BRTxPeerListEq, 100);
+    array_new(index->order, 100);
+    index->orderStart = 0;
+}
+
+static void _BRTxPeerIndexFree(BRTxPeerIndex *index)
+{
+    for (size_t i = array_count(index->order); i > index->orderStart; i--) {
+        array_free(index->order[i - 1]->peers);
+        free(index->order[i - 1]);
+    }
+
+    array_free(index->order);
+    BRSetFree(index->lists);
+}
+
+// drops the oldest lists while there are more than TX_PEER_LIST_CAPACITY, or they're older than TX_PEER_LIST_MAX_AGE
+static void _BRTxPeerIndexPrune(BRTxPeerIndex *index, time_t now)
+{
+    BRTxPeerList *list;
+
+    while (index->orderStart < array_count(index->order) &&
+           (array_count(index->order) - index->orderStart > TX_PEER_LIST_CAPACITY ||
+            index->order[index->orderStart]->timestamp + TX_PEER_LIST_MAX_AGE < now)) {
+        list = index->order[index->orderStart++];
+        BRSetRemove(index->lists, list);
+        array_free(list->peers);
+        free(list);
+    }
+
+    if (index->orderStart > 0 && index->orderStart*2 >= array_count(index->order)) { // reclaim the dropped slots
+        array_rm_range(index->order, 0, index->orderStart);
+        index->orderStart = 0;
+    }
+}
+
 // true if peer is contained in the list of peers associated with txHash
-static int _BRTxPeerListHasPeer(const BRTxPeerList *list, UInt256 txHash, const BRBitcoinPeer *peer)
+static int _BRTxPeerListHasPeer(const BRTxPeerIndex *index, UInt256 txHash, const BRBitcoinPeer *peer)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (! UInt256Eq(list[i - 1].txHash, txHash)) continue;
+    const BRTxPeerList *list = BRSetGet(index->lists, &txHash);
 
-        for (size_t j = array_count(list[i - 1].peers); j > 0; j--) {
-            if (btcPeerEq(&list[i - 1].peers[j - 1], peer)) return 1;
-        }
-        
-        break;
+    for (size_t i = (list) ? array_count(list->peers) : 0; i > 0; i--) {
+        if (btcPeerEq(&list->peers[i - 1], peer)) return 1;
     }
-    
+
     return 0;
 }
 
 // number of peers associated with txHash
-static size_t _BRTxPeerListCount(const BRTxPeerList *list, UInt256 txHash)
+static size_t _BRTxPeerListCount(const BRTxPeerIndex *index, UInt256 txHash)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (UInt256Eq(list[i - 1].txHash, txHash)) return array_count(list[i - 1].peers);
-    }
-    
-    return 0;
+    const BRTxPeerList *list = BRSetGet(index->lists, &txHash);
+
+    return (list) ? array_count(list->peers) : 0;
 }
 
 // adds peer to the list of peers associated with txHash and returns the new total number of peers
-static size_t _BRTxPeerListAddPeer(BRTxPeerList **list, UInt256 txHash, const BRBitcoinPeer *peer)
+static size_t _BRTxPeerListAddPeer(BRTxPeerIndex *index, UInt256 txHash, const BRBitcoinPeer *peer)
 {
-    for (size_t i = array_count(*list); i > 0; i--) {
-        if (! UInt256Eq((*list)[i - 1].txHash, txHash)) continue;
-        
-        for (size_t j = array_count((*list)[i - 1].peers); j > 0; j--) {
-            if (btcPeerEq(&(*list)[i - 1].peers[j - 1], peer)) return array_count((*list)[i - 1].peers);
-        }
-        
-        array_add((*list)[i - 1].peers, *peer);
-        return array_count((*list)[i - 1].peers);
+    BRTxPeerList *list = BRSetGet(index->lists, &txHash);
+
+    if (! list) {
+        list = calloc(1, sizeof(*list));
+        assert(list != NULL);
+        list->txHash = txHash;
+        list->timestamp = time(NULL);
+        array_new(list->peers, PEER_MAX_CONNECTIONS);
+        BRSetAdd(index->lists, list);
+        array_add(index->order, list);
+        _BRTxPeerIndexPrune(index, list->timestamp);
     }
 
-    array_add(*list, ((const BRTxPeerList) { txHash, NULL }));
-    array_new((*list)[array_count(*list) - 1].peers, PEER_MAX_CONNECTIONS);
-    array_add((*list)[array_count(*list) - 1].peers, *peer);
-    return 1;
+    for (size_t i = array_count(list->peers); i > 0; i--) {
+        if (btcPeerEq(&list->peers[i - 1], peer)) return array_count(list->peers);
+    }
+
+    array_add(list->peers, *peer);
+    return array_count(list->peers);
 }
 
 // removes peer from the list of peers associated with txHash, returns true if peer was found
-static int _BRTxPeerListRemovePeer(BRTxPeerList *list, UInt256 txHash, const BRBitcoinPeer *peer)
+static int _BRTxPeerListRemovePeer(BRTxPeerIndex *index, UInt256 txHash, const BRBitcoinPeer *peer)
 {
-    for (size_t i = array_count(list); i > 0; i--) {
-        if (! UInt256Eq(list[i - 1].txHash, txHash)) continue;
-        
-        for (size_t j = array_count(list[i - 1].peers); j > 0; j--) {
-            if (! btcPeerEq(&list[i - 1].peers[j - 1], peer)) continue;
-            array_rm(list[i - 1].peers, j - 1);
-            return 1;
-        }
-        
-        break;
+    BRTxPeerList *list = BRSetGet(index->lists, &txHash);
+
+    for (size_t i = (list) ? array_count(list->peers) : 0; i > 0; i--) {
+        if (! btcPeerEq(&list->peers[i - 1], peer)) continue;
+        array_rm(list->peers, i - 1);
+        return 1;
     }
-    
+
     return 0;
 }
 
+// removes peer from every list of peers in index
+static void _BRTxPeerIndexRemovePeer(BRTxPeerIndex *index, const BRBitcoinPeer *peer)
+{
+    BRTxPeerList *list;
+
+    for (size_t i = array_count(index->order); i > index->orderStart; i--) {
+        list = index->order[i - 1];
+
+        for (size_t j = array_count(list->peers); j > 0; j--) {
+            if (btcPeerEq(&list->peers[j - 1], peer)) array_rm(list->peers, j - 1);
+        }
+    }
+}
+
+// replays an inv stream of txHashes, each announced by every one of peers, through a tx peer index, for testing
+// returns the number of tx hashes still tracked, or SIZE_MAX if a lookup was inconsistent
+size_t btcPeerManagerTxPeerIndexTest(const UInt256 txHashes[], size_t txCount, const BRBitcoinPeer peers[],
+                                     size_t peersCount)
+{
+    BRTxPeerIndex index;
+    size_t count = 0;
+
+    _BRTxPeerIndexInit(&index);
+
+    for (size_t i = 0; count != SIZE_MAX && i < txCount; i++) {
+        for (size_t j = 0; count != SIZE_MAX && j < peersCount; j++) {
+            if (_BRTxPeerListHasPeer(&index, txHashes[i], &peers[j]) ||
+                _BRTxPeerListAddPeer(&index, txHashes[i], &peers[j]) != j + 1 ||
+                _BRTxPeerListCount(&index, txHashes[i]) != j + 1) count = SIZE_MAX;
+        }
+
+        if (count != SIZE_MAX && peersCount > 0 && (! _BRTxPeerListRemovePeer(&index, txHashes[i], &peers[0]) ||
+                                                    _BRTxPeerListHasPeer(&index, txHashes[i], &peers[0]))) count = SIZE_MAX;
+    }
+
+    if (count != SIZE_MAX) count = BRSetCount(index.lists);
+    _BRTxPeerIndexFree(&index);
+    return count;
+}
+
 // comparator for sorting peers by timestamp, most recent first
 inline static int _peerTimestampCompare(const void *peer, const void *otherPeer)
 {
@@ -174,10 +323,25 @@ struct BRBitcoinPeerManagerStruct {
     char downloadPeerName[INET6_ADDRSTRLEN + 6];
     uint32_t earliestKeyTime, syncStartHeight, filterUpdateHeight, estimatedHeight;
     BRBitcoinBloomFilter *bloomFilter;
+    int filterAddPending; // new wallet addresses are waiting to be added to the bloom filters
+    size_t filterChainCounts[2]; // wallet chain addresses every peer's bloom filter matches, by chain
+    BRSet *filterUTXOs; // wallet outputs every peer's bloom filter matches
     double fpRate, averageTxPerBlock;
+    BRBitcoinPeerManagerSyncMode syncMode;
+    uint32_t syncedHeight; // wallet tx are synced up to syncedHeight, headers above it haven't been scanned yet
+    int needsHeaders, headersPending;
+    BRBlockRange **blockRanges, **staleRanges; // block ranges in chain order, and requests whose replies are discarded
+    uint32_t rangesHeight, rangeRequestCount, rangeGeneration; // block ranges cover headers up to rangesHeight
+    int rangeSyncing, applyingRanges;
+    uint32_t cfBatchHeight; // the compact filter batch starts after syncedHeight
+    UInt256 cfHeader, cfBatchStop, cfBatchPrevHeader; // filter header at syncedHeight, zero if unknown
+    UInt256 *cfBatchHashes, *cfBatchBlocks; // filter hashes from cfheaders, and matched blocks not yet received
+    BRBitcoinCompactFilter **cfBatchFilters; // unmatched filters are kept in case new wallet addresses are generated
+    size_t cfBatchAddrsCount;
+    int cfSyncing;
     BRSet *blocks, *orphans, *checkpoints;
     BRBitcoinMerkleBlock *lastBlock, *lastOrphan;
-    BRTxPeerList *txRelays, *txRequests;
+    BRTxPeerIndex txRelays, txRequests;
     BRPublishedTx *publishedTx;
     UInt256 *publishedTxHashes;
     void *info;
@@ -268,6 +432,23 @@ static void _setApplyFreeBlock(void *info, void *block)
     btcMerkleBlockFree(block);
 }
 
+static void _setApplyFree(void *info, void *item)
+{
+    free(item);
+}
+
+// true if a connected peer other than peer has a bloom filter loaded
+static int _btcPeerManagerHasFilteredPeer(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRBitcoinPeer *p = manager->connectedPeers[i - 1];
+
+        if (p != peer && btcPeerConnectStatus(p) == BRPeerStatusConnected && (p->flags & PEER_FLAG_FILTERED)) return 1;
+    }
+
+    return 0;
+}
+
 static void _btcPeerManagerLoadBloomFilter(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
 {
     // every time a new wallet address is added, the bloom filter has to be rebuilt, and each address is only used
@@ -281,7 +462,10 @@ static void _btcPeerManagerLoadBloomFilter(BRBitcoinPeerManager *manager, BRBitc
     manager->lastOrphan = NULL;
     manager->filterUpdateHeight = manager->lastBlock->height;
     manager->fpRate = BLOOM_REDUCED_FALSEPOSITIVE_RATE;
-    
+    manager->filterAddPending = 0;
+
+    size_t externalCount = btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_EXTERNAL_CHAIN),
+           internalCount = btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_INTERNAL_CHAIN);
     size_t addrsCount = btcWalletAllAddrs(manager->wallet, NULL, 0);
     BRAddress *addrs = malloc(addrsCount*sizeof(*addrs));
     size_t utxosCount = btcWalletUTXOs(manager->wallet, NULL, 0);
@@ -316,8 +500,6 @@ static void _btcPeerManagerLoadBloomFilter(BRBitcoinPeerManager *manager, BRBitc
         UInt32SetLE(&o[sizeof(UInt256)], utxos[i].n);
         if (! btcBloomFilterContainsData(filter, o, sizeof(o))) btcBloomFilterInsertData(filter, o, sizeof(o));
     }
-    
-    free(utxos);
         
     for (size_t i = 0; i < txCount; i++) { // also add TXOs spent within the last 100 blocks
         if (btcWalletAmountSentByTx(manager->wallet, transactions[i]) > 0) {
@@ -332,12 +514,114 @@ static void _btcPeerManagerLoadBloomFilter(BRBitcoinPeerManager *manager, BRBitc
     free(transactions);
     if (manager->bloomFilter) btcBloomFilterFree(manager->bloomFilter);
     manager->bloomFilter = filter;
+
+    // other peers' filters, loaded earlier, have at most the addresses and outputs that are still in the wallet now
+    if (! _btcPeerManagerHasFilteredPeer(manager, peer)) {
+        manager->filterChainCounts[SEQUENCE_EXTERNAL_CHAIN] = externalCount;
+        manager->filterChainCounts[SEQUENCE_INTERNAL_CHAIN] = internalCount;
+        BRSetApply(manager->filterUTXOs, NULL, _setApplyFree);
+        BRSetClear(manager->filterUTXOs);
+
+        for (size_t i = 0; i < utxosCount; i++) {
+            BRBitcoinUTXO *utxo = malloc(sizeof(*utxo));
+
+            assert(utxo != NULL);
+            *utxo = utxos[i];
+            BRSetAdd(manager->filterUTXOs, utxo);
+        }
+    }
+
+    free(utxos);
     // TODO: XXX if already synced, recursively add inputs of unconfirmed receives
 
     uint8_t data[btcBloomFilterSerialize(filter, NULL, 0)];
     size_t len = btcBloomFilterSerialize(filter, data, sizeof(data));
     
     btcPeerSendFilterload(peer, data, len);
+    peer->flags |= PEER_FLAG_FILTERED;
+}
+
+// sends filteradd with data to each connected peer a bloom filter was loaded on
+static void _btcPeerManagerSendFilteradd(BRBitcoinPeerManager *manager, const uint8_t *data, size_t dataLen)
+{
+    BRBitcoinPeer *peer;
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        peer = manager->connectedPeers[i - 1];
+        if (btcPeerConnectStatus(peer) != BRPeerStatusConnected || (peer->flags & PEER_FLAG_FILTERED) == 0) continue;
+        btcPeerSendFilteradd(peer, data, dataLen);
+    }
+}
+
+// sends filteradd to connected peers for the wallet's unused addresses and unspent outputs that were added to the wallet
+// after the bloom filters were loaded, peers only add the outputs of tx they matched themselves, so outputs found through
+// another peer are sent to all of them, returns false without sending anything if the observed false positive rate, or
+// the filter's estimated rate with the new elements, is past MAX_FILTERADD_FP_RATE, in which case the filter has to be
+// rebuilt
+static int _btcPeerManagerExtendBloomFilter(BRBitcoinPeerManager *manager)
+{
+    const uint32_t chains[] = { SEQUENCE_EXTERNAL_CHAIN, SEQUENCE_INTERNAL_CHAIN };
+    UInt160 *pkhs[2] = { NULL, NULL };
+    size_t pkhsCount[2], utxosCount, count = 0, outCount = 0;
+    BRBitcoinUTXO *utxos, *utxo;
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+    int r = 0;
+
+    if (! manager->bloomFilter || manager->fpRate > MAX_FILTERADD_FP_RATE) return 0;
+    // generate the same spare addresses a rebuilt filter would include
+    btcWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN);
+    btcWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN);
+
+    for (size_t i = 0; i < 2; i++) { // chains only grow, the addresses past the counts loaded are new
+        pkhsCount[i] = btcWalletChainPKHs(manager->wallet, NULL, 0, chains[i]);
+        pkhs[i] = malloc(pkhsCount[i]*sizeof(*pkhs[i]));
+        assert(pkhs[i] != NULL || pkhsCount[i] == 0);
+        pkhsCount[i] = btcWalletChainPKHs(manager->wallet, pkhs[i], pkhsCount[i], chains[i]);
+        if (pkhsCount[i] < manager->filterChainCounts[chains[i]]) pkhsCount[i] = manager->filterChainCounts[chains[i]];
+        count += pkhsCount[i] - manager->filterChainCounts[chains[i]];
+    }
+
+    utxosCount = btcWalletUTXOs(manager->wallet, NULL, 0);
+    utxos = malloc(utxosCount*sizeof(*utxos));
+    assert(utxos != NULL);
+    utxosCount = btcWalletUTXOs(manager->wallet, utxos, utxosCount);
+
+    for (size_t i = 0; i < utxosCount; i++) { // keep the outputs the filters weren't loaded or extended with
+        if (! BRSetContains(manager->filterUTXOs, &utxos[i])) utxos[outCount++] = utxos[i];
+    }
+
+    // peers also add the outpoints of matched wallet outputs (BLOOM_UPDATE_ALL), so this is a slight underestimate
+    if (btcBloomFilterFalsePositiveRate(manager->bloomFilter, count + outCount) <= MAX_FILTERADD_FP_RATE) {
+        for (size_t i = 0; i < 2; i++) {
+            for (size_t j = manager->filterChainCounts[chains[i]]; j < pkhsCount[i]; j++) {
+                btcBloomFilterInsertData(manager->bloomFilter, pkhs[i][j].u8, sizeof(*pkhs[i]));
+                _btcPeerManagerSendFilteradd(manager, pkhs[i][j].u8, sizeof(*pkhs[i]));
+            }
+
+            manager->filterChainCounts[chains[i]] = pkhsCount[i];
+        }
+
+        for (size_t i = 0; i < outCount; i++) {
+            UInt256Set(o, utxos[i].hash);
+            UInt32SetLE(&o[sizeof(UInt256)], utxos[i].n);
+            btcBloomFilterInsertData(manager->bloomFilter, o, sizeof(o));
+            _btcPeerManagerSendFilteradd(manager, o, sizeof(o));
+            utxo = malloc(sizeof(*utxo));
+            assert(utxo != NULL);
+            *utxo = utxos[i];
+            BRSetAdd(manager->filterUTXOs, utxo);
+        }
+
+        _peer_log("BPM: added %zu wallet addresses and %zu outputs to bloom filters, estimated false positive rate: "
+                  "%f\n", count, outCount, btcBloomFilterFalsePositiveRate(manager->bloomFilter, 0));
+        manager->filterAddPending = 0;
+        r = 1;
+    }
+
+    free(utxos);
+    free(pkhs[0]);
+    free(pkhs[1]);
+    return r;
 }
 
 static void _updateFilterRerequestDone(void *info, int success)
@@ -398,30 +682,40 @@ static void _updateFilterPingDone(void *info, int success)
     BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPeerCallbackInfo *peerInfo;
+    int isExtended;
     
     if (success) {
         pthread_mutex_lock(&manager->lock);
         peer_log(peer, "updating filter with newly created wallet addresses");
-        if (manager->bloomFilter) btcBloomFilterFree(manager->bloomFilter);
-        manager->bloomFilter = NULL;
+        // if the filter has room, new addresses are added with filteradd, otherwise the filter is rebuilt
+        isExtended = (manager->filterAddPending && _btcPeerManagerExtendBloomFilter(manager));
+
+        if (! isExtended) {
+            if (manager->bloomFilter) btcBloomFilterFree(manager->bloomFilter);
+            manager->bloomFilter = NULL;
+        }
 
         if (manager->lastBlock->height < manager->estimatedHeight) { // if we're syncing, only update download peer
             if (manager->downloadPeer) {
-                _btcPeerManagerLoadBloomFilter(manager, manager->downloadPeer);
+                if (! isExtended) _btcPeerManagerLoadBloomFilter(manager, manager->downloadPeer);
                 btcPeerSendPing(manager->downloadPeer, info, _updateFilterLoadDone); // wait for pong so filter is loaded
             }
             else free(info);
         }
         else {
             free(info);
-            
+
+            for (size_t i = array_count(manager->connectedPeers); ! isExtended && i > 0; i--) {
+                manager->connectedPeers[i - 1]->flags &= ~PEER_FLAG_FILTERED; // every filter is reloaded below
+            }
+
             for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
                 if (btcPeerConnectStatus(manager->connectedPeers[i - 1]) != BRPeerStatusConnected) continue;
                 peerInfo = calloc(1, sizeof(*peerInfo));
                 assert(peerInfo != NULL);
                 peerInfo->peer = manager->connectedPeers[i - 1];
                 peerInfo->manager = manager;
-                _btcPeerManagerLoadBloomFilter(manager, peerInfo->peer);
+                if (! isExtended) _btcPeerManagerLoadBloomFilter(manager, peerInfo->peer);
                 btcPeerSendPing(peerInfo->peer, peerInfo, _updateFilterLoadDone); // wait for pong so filter is loaded
             }
         }
@@ -486,13 +780,13 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
                     manager->publishedTx[j - 1].callback != NULL) isPublishing = 1;
             }
             
-            if (! isPublishing && _BRTxPeerListCount(manager->txRelays, hash) == 0 &&
-                _BRTxPeerListCount(manager->txRequests, hash) == 0) {
+            if (! isPublishing && _BRTxPeerListCount(&manager->txRelays, hash) == 0 &&
+                _BRTxPeerListCount(&manager->txRequests, hash) == 0) {
                 peer_log(peer, "removing tx unconfirmed at: %d, txHash: %s", manager->lastBlock->height, u256hex(hash));
                 assert(tx[i - 1]->blockHeight == TX_UNCONFIRMED);
                 btcWalletRemoveTransaction(manager->wallet, hash);
             }
-            else if (! isPublishing && _BRTxPeerListCount(manager->txRelays, hash) < manager->maxConnectCount) {
+            else if (! isPublishing && _BRTxPeerListCount(&manager->txRelays, hash) < manager->maxConnectCount) {
                 // set timestamp 0 to mark as unverified
                 btcWalletUpdateTransactions(manager->wallet, &hash, 1, TX_UNCONFIRMED, 0);
             }
@@ -512,8 +806,8 @@ static void _btcPeerManagerRequestUnrelayedTx(BRBitcoinPeerManager *manager, BRB
     txCount = btcWalletTxUnconfirmedBefore(manager->wallet, tx, txCount, TX_UNCONFIRMED);
     
     for (size_t i = 0; i < txCount; i++) {
-        if (! _BRTxPeerListHasPeer(manager->txRelays, tx[i]->txHash, peer) &&
-            ! _BRTxPeerListHasPeer(manager->txRequests, tx[i]->txHash, peer)) {
+        if (! _BRTxPeerListHasPeer(&manager->txRelays, tx[i]->txHash, peer) &&
+            ! _BRTxPeerListHasPeer(&manager->txRequests, tx[i]->txHash, peer)) {
             txHashes[hashCount++] = tx[i]->txHash;
             _BRTxPeerListAddPeer(&manager->txRequests, tx[i]->txHash, peer);
         }
@@ -576,46 +870,552 @@ static void _loadBloomFilterDone(void *info, int success)
     BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
     pthread_mutex_lock(&manager->lock);
-    
-    if (success) {
-        btcPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
-                          _mempoolDone);
-        pthread_mutex_unlock(&manager->lock);
+    
+    if (success) {
+        btcPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
+                          _mempoolDone);
+        pthread_mutex_unlock(&manager->lock);
+    }
+    else {
+        free(info);
+        
+        if (peer == manager->downloadPeer) {
+            peer_log(peer, "sync succeeded");
+            _btcPeerManagerSyncStopped(manager);
+            pthread_mutex_unlock(&manager->lock);
+            if (manager->syncStopped) manager->syncStopped(manager->info, 0);
+        }
+        else pthread_mutex_unlock(&manager->lock);
+    }
+}
+
+static void _btcPeerManagerLoadMempools(BRBitcoinPeerManager *manager)
+{
+    // after syncing, load filters and get mempools from other peers
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        BRBitcoinPeer *peer = manager->connectedPeers[i - 1];
+        BRPeerCallbackInfo *info;
+
+        if (btcPeerConnectStatus(peer) != BRPeerStatusConnected) continue;
+        info = calloc(1, sizeof(*info));
+        assert(info != NULL);
+        info->peer = peer;
+        info->manager = manager;
+        
+        if (manager->syncMode == BRPeerManagerSyncModeCompactFilter) { // without a bloom filter, there's no mempool
+            _btcPeerManagerPublishPendingTx(manager, peer);
+            btcPeerSendPing(peer, info, _mempoolDone);
+        }
+        else if (peer != manager->downloadPeer || manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) {
+            _btcPeerManagerLoadBloomFilter(manager, peer);
+            _btcPeerManagerPublishPendingTx(manager, peer);
+            btcPeerSendPing(peer, info, _loadBloomFilterDone); // load mempool after updating bloomfilter
+        }
+        else btcPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
+                               _mempoolDone);
+    }
+}
+
+// frees the compact filters of the pending cfilter batch and forgets its requested block hashes
+static void _btcPeerManagerClearFilterBatch(BRBitcoinPeerManager *manager)
+{
+    for (size_t i = array_count(manager->cfBatchFilters); i > 0; i--) {
+        if (manager->cfBatchFilters[i - 1]) btcCompactFilterFree(manager->cfBatchFilters[i - 1]);
+    }
+
+    array_clear(manager->cfBatchFilters);
+    array_clear(manager->cfBatchHashes);
+    array_clear(manager->cfBatchBlocks);
+    manager->cfBatchStop = UINT256_ZERO;
+}
+
+// headers above syncedHeight aren't saved until their blocks have been scanned, so when syncedHeight passes a
+// difficulty transition, save the transition block
+static void _btcPeerManagerSetSyncedHeight(BRBitcoinPeerManager *manager, BRBitcoinMerkleBlock *block)
+{
+    BRBitcoinMerkleBlock *b = block;
+
+    while (b && b->height > manager->syncedHeight && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0) {
+        b = BRSetGet(manager->blocks, &b->prevBlock);
+    }
+
+    if (b && b->height > manager->syncedHeight && b->height + 100 < manager->estimatedHeight && manager->saveBlocks) {
+        manager->saveBlocks(manager->info, 0, &b, 1);
+    }
+
+    manager->syncedHeight = block->height;
+}
+
+// matches the wallet's pay-to-pubkey-hash and pay-to-witness-pubkey-hash scripts against the filters in the current
+// batch, and requests the full blocks for those that match, matched filters are dropped from the batch
+// returns the number of blocks requested
+static size_t _btcPeerManagerMatchFilterBatch(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    size_t i, count = 0, internalCount = btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_INTERNAL_CHAIN),
+           pkhsCount = internalCount + btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+    UInt160 *pkhs = malloc(pkhsCount*sizeof(*pkhs));
+    uint8_t *scripts = malloc(pkhsCount*(25 + 22));
+    const uint8_t **items = malloc(pkhsCount*2*sizeof(*items));
+    size_t *itemLens = malloc(pkhsCount*2*sizeof(*itemLens));
+    UInt256 blockHashes[array_count(manager->cfBatchFilters)];
+
+    assert(pkhs != NULL || pkhsCount == 0);
+    assert(scripts != NULL || pkhsCount == 0);
+    assert(items != NULL || pkhsCount == 0);
+    assert(itemLens != NULL || pkhsCount == 0);
+    internalCount = btcWalletChainPKHs(manager->wallet, pkhs, internalCount, SEQUENCE_INTERNAL_CHAIN);
+    pkhsCount = internalCount + btcWalletChainPKHs(manager->wallet, &pkhs[internalCount], pkhsCount - internalCount,
+                                                   SEQUENCE_EXTERNAL_CHAIN);
+    manager->cfBatchAddrsCount = pkhsCount;
+
+    for (i = 0; i < pkhsCount; i++) {
+        uint8_t *p2pkh = &scripts[i*(25 + 22)], *p2wpkh = &p2pkh[25];
+
+        p2pkh[0] = OP_DUP, p2pkh[1] = OP_HASH160, p2pkh[2] = 20;
+        UInt160Set(&p2pkh[3], pkhs[i]);
+        p2pkh[23] = OP_EQUALVERIFY, p2pkh[24] = OP_CHECKSIG;
+        p2wpkh[0] = OP_0, p2wpkh[1] = 20;
+        UInt160Set(&p2wpkh[2], pkhs[i]);
+        items[i*2] = p2pkh, itemLens[i*2] = 25;
+        items[i*2 + 1] = p2wpkh, itemLens[i*2 + 1] = 22;
+    }
+
+    for (i = 0; i < array_count(manager->cfBatchFilters); i++) {
+        if (! manager->cfBatchFilters[i] ||
+            ! btcCompactFilterMatchAny(manager->cfBatchFilters[i], items, itemLens, pkhsCount*2)) continue;
+        blockHashes[count++] = manager->cfBatchFilters[i]->blockHash;
+        array_add(manager->cfBatchBlocks, manager->cfBatchFilters[i]->blockHash);
+        btcCompactFilterFree(manager->cfBatchFilters[i]);
+        manager->cfBatchFilters[i] = NULL;
+    }
+
+    free(itemLens);
+    free(items);
+    free(scripts);
+    free(pkhs);
+
+    if (count > 0) {
+        peer_log(peer, "compact filters matched %zu block(s)", count);
+        btcPeerSendGetdata(peer, NULL, 0, blockHashes, count);
+    }
+
+    return count;
+}
+
+// saves the blocks needed to verify the difficulty of the next blocks when a sync completes
+static void _btcPeerManagerSaveSyncedBlocks(BRBitcoinPeerManager *manager)
+{
+    size_t i, saveCount = (manager->lastBlock->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
+    BRBitcoinMerkleBlock *b, *saveBlocks[saveCount];
+
+    for (i = 0, b = manager->lastBlock; b && i < saveCount; i++) {
+        saveBlocks[i] = b;
+        b = BRSetGet(manager->blocks, &b->prevBlock);
+    }
+
+    // make sure the set of blocks to be saved starts at a difficulty interval
+    while (i > 0 && (saveBlocks[i - 1]->height % BLOCK_DIFFICULTY_INTERVAL) != 0) i--;
+    if (i > 0 && manager->saveBlocks) manager->saveBlocks(manager->info, (i > 1 ? 1 : 0), saveBlocks, i);
+}
+
+// the block range peer's next merkle blocks are replies to, or NULL if it has none in flight
+static BRBlockRange *_btcPeerManagerPeerRange(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    BRBlockRange *r, *range = NULL;
+
+    for (size_t i = array_count(manager->blockRanges) + array_count(manager->staleRanges); i > 0; i--) {
+        r = (i > array_count(manager->blockRanges)) ? manager->staleRanges[i - 1 - array_count(manager->blockRanges)] :
+            manager->blockRanges[i - 1];
+        if (r->peer != peer || _btcBlockRangeIsComplete(r)) continue;
+        if (! range || r->requestSeq < range->requestSeq) range = r;
+    }
+
+    return range;
+}
+
+// reschedules peer's timeout while it has block ranges or headers in flight, and otherwise cancels it, unless there's a
+// pending tx publish callback
+static void _btcPeerManagerScheduleRangeTimeout(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    if (_btcPeerManagerPeerRange(manager, peer) || (peer == manager->downloadPeer && manager->headersPending)) {
+        btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
+    }
+    else {
+        for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
+            if (manager->publishedTx[i - 1].callback != NULL) return;
+        }
+
+        btcPeerScheduleDisconnect(peer, -1);
+    }
+}
+
+// replies already in flight for the range at index i are discarded, and the range is requested again
+static void _btcPeerManagerRequeueBlockRange(BRBitcoinPeerManager *manager, size_t i)
+{
+    BRBlockRange *range = manager->blockRanges[i];
+
+    _btcBlockRangeClearItems(range);
+
+    if (! _btcBlockRangeIsComplete(range)) {
+        range->isStale = 1;
+        array_add(manager->staleRanges, range);
+        manager->blockRanges[i] = _btcBlockRangeNew(range->startHeight, range->blockHashes,
+                                                    array_count(range->blockHashes));
+    }
+    else range->peer = NULL, range->blockCount = 0;
+}
+
+// drops all block ranges, after the chain they were split from changes, or the download peer disconnects
+static void _btcPeerManagerResetBlockRanges(BRBitcoinPeerManager *manager)
+{
+    for (size_t i = array_count(manager->blockRanges); i > 0; i--) {
+        if (manager->blockRanges[i - 1]->peer) _btcPeerManagerRequeueBlockRange(manager, i - 1);
+        _btcBlockRangeFree(manager->blockRanges[i - 1]);
+    }
+
+    array_clear(manager->blockRanges);
+    manager->rangesHeight = manager->syncedHeight;
+    manager->rangeGeneration++;
+}
+
+// requests the block ranges in flight to a disconnected peer from other peers
+static void _btcPeerManagerRemovePeerRanges(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    for (size_t i = array_count(manager->blockRanges); i > 0; i--) {
+        BRBlockRange *range = manager->blockRanges[i - 1];
+
+        if (range->peer != peer || _btcBlockRangeIsComplete(range)) continue;
+        _btcBlockRangeClearItems(range);
+        range->peer = NULL, range->blockCount = 0;
+    }
+
+    for (size_t i = array_count(manager->staleRanges); i > 0; i--) {
+        if (manager->staleRanges[i - 1]->peer != peer) continue;
+        _btcBlockRangeFree(manager->staleRanges[i - 1]);
+        array_rm(manager->staleRanges, i - 1);
+    }
+}
+
+// holds a merkle block relayed by peer in reply to a block range request, until the range can be applied in order
+// returns true if block was a reply to a block range request
+static int _btcPeerManagerAddRangeBlock(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer,
+                                        BRBitcoinMerkleBlock *block)
+{
+    BRBlockRange *range = _btcPeerManagerPeerRange(manager, peer);
+
+    if (! range || ! UInt256Eq(range->blockHashes[range->blockCount], block->blockHash)) return 0;
+    range->blockCount++;
+
+    if (range->isStale) {
+        btcMerkleBlockFree(block);
+
+        for (size_t i = array_count(manager->staleRanges); _btcBlockRangeIsComplete(range) && i > 0; i--) {
+            if (manager->staleRanges[i - 1] != range) continue;
+            array_rm(manager->staleRanges, i - 1);
+            _btcBlockRangeFree(range);
+            break;
+        }
+    }
+    else array_add(range->items, ((const BRBlockRangeItem) { block, NULL }));
+
+    _btcPeerManagerScheduleRangeTimeout(manager, peer);
+    return 1;
+}
+
+// holds a tx relayed by peer while it has a block range in flight, so wallet tx are registered in chain order, no matter
+// which peer's range completes first
+// returns true if tx is held
+static int _btcPeerManagerAddRangeTx(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer, BRBitcoinTransaction *tx)
+{
+    BRBlockRange *range = _btcPeerManagerPeerRange(manager, peer);
+
+    for (size_t i = array_count(manager->publishedTxHashes); range && i > 0; i--) {
+        if (UInt256Eq(manager->publishedTxHashes[i - 1], tx->txHash)) return 0; // let publish callbacks complete
+    }
+
+    if (! range) return 0;
+    if (range->isStale) btcTransactionFree(tx);
+    else array_add(range->items, ((const BRBlockRangeItem) { NULL, tx }));
+    return 1;
+}
+
+// blocks above height in ranges already requested were filtered without the wallet outputs and addresses of tx just
+// received, and may be missing tx spending them, so update the filters and request those ranges again
+// if extend is true, new wallet addresses and outputs are added with filteradd when the filters have room for them
+static void _btcPeerManagerReloadBloomFilters(BRBitcoinPeerManager *manager, uint32_t height, int extend)
+{
+    for (size_t i = array_count(manager->blockRanges); i > 0; i--) {
+        BRBlockRange *range = manager->blockRanges[i - 1];
+
+        if (range->startHeight + array_count(range->blockHashes) <= height + 1) break; // ranges are in chain order
+        if (range->peer) _btcPeerManagerRequeueBlockRange(manager, i - 1);
+    }
+
+    if (extend && _btcPeerManagerExtendBloomFilter(manager)) return; // sent before any further getdata
+
+    // every filter is reloaded, so the first one loaded doesn't have to share elements with the old ones
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        manager->connectedPeers[i - 1]->flags &= ~PEER_FLAG_FILTERED;
+    }
+
+    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
+        if (btcPeerConnectStatus(manager->connectedPeers[i - 1]) != BRPeerStatusConnected) continue;
+        _btcPeerManagerLoadBloomFilter(manager, manager->connectedPeers[i - 1]); // sent before any further getdata
+    }
+}
+
+// requests what a headers-first sync needs next: ranges of merkle blocks for the headers we have, spread over all
+// connected peers, and more headers from the download peer, or if every block up to the download peer's last block has
+// been scanned, completes the sync
+static void _btcPeerManagerSyncBlockRanges(BRBitcoinPeerManager *manager)
+{
+    BRBitcoinPeer *p, *peer = manager->downloadPeer;
+    BRBitcoinMerkleBlock *b, *skip = NULL;
+    uint32_t height = (manager->rangesHeight > manager->syncedHeight) ? manager->rangesHeight : manager->syncedHeight;
+    size_t i, j, n, count;
+
+    if (! peer || ! manager->rangeSyncing) return;
+
+    if (manager->lastBlock->height > height) { // split new headers into block ranges
+        UInt256 *hashes = malloc((manager->lastBlock->height - height)*sizeof(*hashes));
+
+        assert(hashes != NULL);
+
+        for (i = count = manager->lastBlock->height - height, b = manager->lastBlock; b && i > 0; i--) {
+            // there can't be wallet tx in blocks older than a week before earliestKeyTime
+            if (! skip && b->timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT < manager->earliestKeyTime) skip = b;
+            hashes[i - 1] = b->blockHash;
+            b = BRSetGet(manager->blocks, &b->prevBlock);
+        }
+
+        if (i > 0) peer_log(peer, "missing block at height %"PRIu32", can't request block ranges", height + (uint32_t)i);
+        else {
+            if (skip && height == manager->syncedHeight) { // no block ranges are pending
+                _btcPeerManagerSetSyncedHeight(manager, skip);
+                i = skip->height - height;
+            }
+
+            for (; i < count; i += n) {
+                n = (count - i < BLOCK_RANGE_SIZE) ? count - i : BLOCK_RANGE_SIZE;
+                array_add(manager->blockRanges, _btcBlockRangeNew(height + 1 + (uint32_t)i, &hashes[i], n));
+            }
+
+            manager->rangesHeight = manager->lastBlock->height;
+        }
+
+        free(hashes);
+    }
+
+    for (i = array_count(manager->connectedPeers); i > 0; i--) {
+        p = manager->connectedPeers[i - 1];
+        if (btcPeerConnectStatus(p) != BRPeerStatusConnected) continue;
+        n = 0;
+
+        for (j = array_count(manager->blockRanges) + array_count(manager->staleRanges); j > 0; j--) {
+            BRBlockRange *r = (j > array_count(manager->blockRanges)) ?
+                manager->staleRanges[j - 1 - array_count(manager->blockRanges)] : manager->blockRanges[j - 1];
+
+            if (r->peer == p && ! _btcBlockRangeIsComplete(r)) n++;
+        }
+
+        for (j = 0; n < MAX_PEER_RANGES && j < array_count(manager->blockRanges) && j < BLOCK_RANGE_WINDOW; j++) {
+            BRBlockRange *range = manager->blockRanges[j];
+
+            if (range->peer) continue;
+            if (p != peer && btcPeerLastBlock(p) + 1 < range->startHeight + array_count(range->blockHashes)) break;
+            if ((p->flags & PEER_FLAG_FILTERED) == 0) _btcPeerManagerLoadBloomFilter(manager, p);
+            range->peer = p;
+            range->requestSeq = ++manager->rangeRequestCount;
+            btcPeerSendGetdata(p, NULL, 0, range->blockHashes, array_count(range->blockHashes));
+            btcPeerScheduleDisconnect(p, PROTOCOL_TIMEOUT); // schedule block range timeout
+            n++;
+        }
+    }
+
+    // headers stay at most a window of block ranges ahead of the synced height, and more are requested as ranges apply
+    if (! manager->headersPending &&
+        manager->lastBlock->height <= manager->syncedHeight + BLOCK_RANGE_WINDOW*BLOCK_RANGE_SIZE &&
+        (manager->needsHeaders || manager->lastBlock->height < btcPeerLastBlock(peer))) {
+        size_t   count    = _btcPeerManagerBlockLocators(manager, NULL, 0);
+        UInt256 *locators = calloc (count, sizeof(UInt256));
+
+        _btcPeerManagerBlockLocators (manager, locators, count);
+        manager->needsHeaders = 0;
+        manager->headersPending = 1;
+        btcPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
+        btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule sync timeout
+        if (locators) free (locators);
+    }
+    else if (! manager->headersPending && ! manager->applyingRanges && array_count(manager->blockRanges) == 0 &&
+             manager->syncedHeight >= manager->lastBlock->height) { // chain download is complete
+        manager->rangeSyncing = 0;
+        manager->connectFailureCount = 0;
+        if (manager->syncStartHeight > 0) _btcPeerManagerSaveSyncedBlocks(manager);
+        _btcPeerManagerLoadMempools(manager);
+    }
+}
+
+static void _filterBatchDone(void *info, int success);
+
+// requests what the compact filter sync needs next from the download peer: the next batch of filters for headers we
+// have, more headers, or if the filters have caught up with the chain, completes the sync
+static void _btcPeerManagerSyncCompactFilters(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    BRBitcoinMerkleBlock *stop = NULL;
+    BRPeerCallbackInfo *info;
+    uint32_t stopHeight;
+
+    while (! stop && manager->syncedHeight < manager->lastBlock->height) {
+        stopHeight = (manager->lastBlock->height - manager->syncedHeight > CFILTER_MAX_FILTERS) ?
+                     manager->syncedHeight + CFILTER_MAX_FILTERS : manager->lastBlock->height;
+        stop = manager->lastBlock;
+        while (stop && stop->height > stopHeight) stop = BRSetGet(manager->blocks, &stop->prevBlock);
+
+        if (! stop) { // filters can only be requested by the hash of a block we have
+            peer_log(peer, "missing block at height %"PRIu32", skipping compact filters", stopHeight);
+            manager->syncedHeight = stopHeight;
+            manager->cfHeader = UINT256_ZERO;
+        }
+        else if (stop->timestamp + 7*24*60*60 + BLOCK_MAX_TIME_DRIFT < manager->earliestKeyTime) {
+            _btcPeerManagerSetSyncedHeight(manager, stop); // skip blocks older than earliestKeyTime
+            manager->cfHeader = UINT256_ZERO;
+            stop = NULL;
+        }
+    }
+
+    manager->cfSyncing = 1;
+    if (manager->syncStartHeight > 0) btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
+
+    if (stop) {
+        info = calloc(1, sizeof(*info));
+        assert(info != NULL);
+        info->peer = peer;
+        info->manager = manager;
+        manager->cfBatchHeight = manager->syncedHeight + 1;
+        manager->cfBatchStop = stop->blockHash;
+        btcPeerSendGetcfheaders(peer, CFILTER_TYPE_BASIC, manager->cfBatchHeight, stop->blockHash);
+        btcPeerSendGetcfilters(peer, CFILTER_TYPE_BASIC, manager->cfBatchHeight, stop->blockHash);
+        btcPeerSendPing(peer, info, _filterBatchDone); // wait for pong so we're sure all the filters have arrived
+    }
+    else if (manager->needsHeaders || manager->lastBlock->height < btcPeerLastBlock(peer)) {
+        size_t   count    = _btcPeerManagerBlockLocators(manager, NULL, 0);
+        UInt256 *locators = calloc (count, sizeof(UInt256));
+
+        _btcPeerManagerBlockLocators (manager, locators, count);
+        manager->needsHeaders = 0;
+        btcPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
+        if (locators) free (locators);
+    }
+    else {
+        manager->cfSyncing = 0;
+
+        if (manager->syncStartHeight > 0) { // chain download is complete
+            manager->connectFailureCount = 0;
+            _btcPeerManagerSaveSyncedBlocks(manager);
+            _btcPeerManagerLoadMempools(manager);
+        }
+    }
+}
+
+// the filters of the current batch have been matched, and the matching blocks received
+static void _btcPeerManagerFilterBatchSynced(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    BRBitcoinMerkleBlock *block = BRSetGet(manager->blocks, &manager->cfBatchStop);
+    UInt256 header = manager->cfBatchPrevHeader;
+
+    for (size_t i = 0; i < array_count(manager->cfBatchHashes); i++) {
+        header = btcCompactFilterHeader(manager->cfBatchHashes[i], header);
+    }
+
+    _btcPeerManagerClearFilterBatch(manager);
+    if (block) {
+        _btcPeerManagerSetSyncedHeight(manager, block);
+        manager->cfHeader = header;
+    }
+    _btcPeerManagerSyncCompactFilters(manager, peer);
+}
+
+static void _filterBlocksDone(void *info, int success)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    size_t addrsCount;
+
+    if (! success) {
+        free(info);
+        return;
+    }
+
+    pthread_mutex_lock(&manager->lock);
+    addrsCount = btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_INTERNAL_CHAIN) +
+                 btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_EXTERNAL_CHAIN);
+
+    if (peer != manager->downloadPeer) free(info);
+    else if (UInt256IsZero(manager->cfBatchStop)) { // batch was dropped by a chain reorganization
+        free(info);
+        _btcPeerManagerSyncCompactFilters(manager, peer);
+    }
+    else if (array_count(manager->cfBatchBlocks) > 0) {
+        peer_log(peer, "%zu block(s) matching compact filters weren't relayed", array_count(manager->cfBatchBlocks));
+        free(info);
+        _btcPeerManagerPeerMisbehavin(manager, peer);
+    }
+    else if (addrsCount > manager->cfBatchAddrsCount && _btcPeerManagerMatchFilterBatch(manager, peer) > 0) {
+        btcPeerSendPing(peer, info, _filterBlocksDone); // blocks matching newly generated wallet addresses
+    }
+    else {
+        free(info);
+        _btcPeerManagerFilterBatchSynced(manager, peer);
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+}
+
+static void _filterBatchDone(void *info, int success)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    BRBitcoinCompactFilter **filters;
+    BRBitcoinMerkleBlock *b;
+    size_t i, count;
+    int valid;
+
+    if (! success) {
+        free(info);
+        return;
+    }
+
+    pthread_mutex_lock(&manager->lock);
+    filters = manager->cfBatchFilters;
+    count = array_count(filters);
+    b = BRSetGet(manager->blocks, &manager->cfBatchStop);
+    valid = (b && count == array_count(manager->cfBatchHashes) && count == b->height + 1 - manager->cfBatchHeight);
+
+    for (i = count; valid && i > 0; i--) { // filters arrive in chain order, ending with the stop block
+        if (! b || ! UInt256Eq(b->blockHash, filters[i - 1]->blockHash) ||
+            ! UInt256Eq(btcCompactFilterHash(filters[i - 1]), manager->cfBatchHashes[i - 1])) valid = 0;
+        else b = BRSetGet(manager->blocks, &b->prevBlock);
+    }
+
+    if (peer != manager->downloadPeer) free(info);
+    else if (UInt256IsZero(manager->cfBatchStop)) { // batch was dropped by a chain reorganization
+        free(info);
+        _btcPeerManagerSyncCompactFilters(manager, peer);
+    }
+    else if (! valid) {
+        peer_log(peer, "relayed %zu compact filter(s) that don't match their cfheaders", count);
+        free(info);
+        _btcPeerManagerPeerMisbehavin(manager, peer);
+    }
+    else if (_btcPeerManagerMatchFilterBatch(manager, peer) > 0) {
+        btcPeerSendPing(peer, info, _filterBlocksDone); // wait for pong so we're sure all the blocks have arrived
     }
     else {
         free(info);
-        
-        if (peer == manager->downloadPeer) {
-            peer_log(peer, "sync succeeded");
-            _btcPeerManagerSyncStopped(manager);
-            pthread_mutex_unlock(&manager->lock);
-            if (manager->syncStopped) manager->syncStopped(manager->info, 0);
-        }
-        else pthread_mutex_unlock(&manager->lock);
+        _btcPeerManagerFilterBatchSynced(manager, peer);
     }
-}
-
-static void _btcPeerManagerLoadMempools(BRBitcoinPeerManager *manager)
-{
-    // after syncing, load filters and get mempools from other peers
-    for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
-        BRBitcoinPeer *peer = manager->connectedPeers[i - 1];
-        BRPeerCallbackInfo *info;
 
-        if (btcPeerConnectStatus(peer) != BRPeerStatusConnected) continue;
-        info = calloc(1, sizeof(*info));
-        assert(info != NULL);
-        info->peer = peer;
-        info->manager = manager;
-        
-        if (peer != manager->downloadPeer || manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) {
-            _btcPeerManagerLoadBloomFilter(manager, peer);
-            _btcPeerManagerPublishPendingTx(manager, peer);
-            btcPeerSendPing(peer, info, _loadBloomFilterDone); // load mempool after updating bloomfilter
-        }
-        else btcPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
-                               _mempoolDone);
-    }
+    pthread_mutex_unlock(&manager->lock);
 }
 
 // returns a UINT128_ZERO terminated array of addresses for hostname that must be freed, or NULL if lookup failed
@@ -674,7 +1474,9 @@ static void *_findPeersThreadRoutine(void *arg)
 // DNS peer discovery
 static void _btcPeerManagerFindPeers(BRBitcoinPeerManager *manager)
 {
-    uint64_t services = SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM | manager->params->services;
+    uint64_t services = SERVICES_NODE_NETWORK | manager->params->services |
+                        ((manager->syncMode == BRPeerManagerSyncModeCompactFilter) ? SERVICES_NODE_COMPACT_FILTERS :
+                         SERVICES_NODE_BLOOM);
     time_t now = time(NULL);
     struct timespec ts;
     pthread_t thread;
@@ -741,24 +1543,41 @@ static void _peerConnected(void *info)
         peer_log(peer, "node isn't synced");
         btcPeerDisconnect(peer);
     }
-    else if (btcPeerVersion(peer) >= 70011 && (peer->services & SERVICES_NODE_BLOOM) != SERVICES_NODE_BLOOM) {
+    else if (manager->syncMode == BRPeerManagerSyncModeCompactFilter &&
+             (peer->services & SERVICES_NODE_COMPACT_FILTERS) != SERVICES_NODE_COMPACT_FILTERS) {
+        peer_log(peer, "node doesn't serve compact filters");
+        btcPeerDisconnect(peer);
+    }
+    else if (manager->syncMode == BRPeerManagerSyncModeBloomFilter && btcPeerVersion(peer) >= 70011 &&
+             (peer->services & SERVICES_NODE_BLOOM) != SERVICES_NODE_BLOOM) {
         peer_log(peer, "node doesn't support SPV mode");
         btcPeerDisconnect(peer);
     }
     else if (manager->downloadPeer && // check if we should stick with the existing download peer
              (btcPeerLastBlock(manager->downloadPeer) >= btcPeerLastBlock(peer) ||
               manager->lastBlock->height >= btcPeerLastBlock(peer))) {
-        if (manager->lastBlock->height >= btcPeerLastBlock(peer)) { // only load bloom filter if we're done syncing
+        if (manager->syncedHeight >= btcPeerLastBlock(peer) &&
+            ! manager->rangeSyncing && ! manager->cfSyncing) { // only load bloom filter if we're done syncing
             manager->connectFailureCount = 0; // also reset connect failure count if we're already synced
-            _btcPeerManagerLoadBloomFilter(manager, peer);
-            _btcPeerManagerPublishPendingTx(manager, peer);
             peerInfo = calloc(1, sizeof(*peerInfo));
             assert(peerInfo != NULL);
             peerInfo->peer = peer;
             peerInfo->manager = manager;
-            btcPeerSendPing(peer, peerInfo, _loadBloomFilterDone);
+
+            if (manager->syncMode == BRPeerManagerSyncModeCompactFilter) {
+                _btcPeerManagerPublishPendingTx(manager, peer);
+                btcPeerSendPing(peer, peerInfo, _mempoolDone);
+            }
+            else {
+                _btcPeerManagerLoadBloomFilter(manager, peer);
+                _btcPeerManagerPublishPendingTx(manager, peer);
+                btcPeerSendPing(peer, peerInfo, _loadBloomFilterDone);
+            }
+        }
+        else {
+            btcPeerSendPing(peer, NULL, NULL);
+            _btcPeerManagerSyncBlockRanges(manager); // request block ranges from the new peer
         }
-        else btcPeerSendPing(peer, NULL, NULL);
     }
     else { // select the peer with the lowest ping time to download the chain from if we're behind
         // BUG: XXX a malicious peer can report a higher lastblock to make us select them as the download peer, if
@@ -779,30 +1598,19 @@ static void _peerConnected(void *info)
         manager->downloadPeer = peer;
         manager->isConnected = 1;
         manager->estimatedHeight = btcPeerLastBlock(peer);
-        _btcPeerManagerLoadBloomFilter(manager, peer);
+        _btcPeerManagerClearFilterBatch(manager); // drop requests made to the old download peer
+        manager->headersPending = 0;
+        if (manager->syncMode == BRPeerManagerSyncModeBloomFilter) _btcPeerManagerLoadBloomFilter(manager, peer);
         btcPeerSetCurrentBlockHeight(peer, manager->lastBlock->height);
         _btcPeerManagerPublishPendingTx(manager, peer);
             
-        if (manager->lastBlock->height < btcPeerLastBlock(peer)) { // start blockchain sync
-            size_t   count    = _btcPeerManagerBlockLocators(manager, NULL, 0);
-            UInt256 *locators = calloc (count, sizeof(UInt256)); // Okay if NULL
-            
-            _btcPeerManagerBlockLocators (manager, locators, count);
-            
-            btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule sync timeout
-
-            // request just block headers up to a week before earliestKeyTime, and then merkleblocks after that
-            // we do not reset connect failure count yet incase this request times out
-            if (manager->lastBlock->timestamp + 7*24*60*60 >= manager->earliestKeyTime) {
-                btcPeerSendGetblocks(peer, locators, count, UINT256_ZERO);
-            }
-            else btcPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
-
-            if (locators) free (locators);
+        if (manager->syncMode == BRPeerManagerSyncModeCompactFilter) { // headers, then filters, then matched blocks
+            _btcPeerManagerSyncCompactFilters(manager, peer);
         }
-        else { // we're already synced
-            manager->connectFailureCount = 0; // reset connect failure count
-            _btcPeerManagerLoadMempools(manager);
+        else { // headers, then merkle blocks in ranges spread over all connected peers
+            // we do not reset connect failure count until the sync completes, in case the requests time out
+            manager->rangeSyncing = 1;
+            _btcPeerManagerSyncBlockRanges(manager);
         }
     }
 
@@ -813,7 +1621,6 @@ static void _peerDisconnected(void *info, int error)
 {
     BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
-    BRTxPeerList *peerList;
     int willSave = 0, willReconnect = 0, txError = 0;
     size_t txCount = 0;
     
@@ -838,17 +1645,14 @@ static void _peerDisconnected(void *info, int error)
                                    array_count(manager->connectedPeers) == 1)) txError = ETIMEDOUT;
     }
     
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
-        peerList = &manager->txRelays[i - 1];
-
-        for (size_t j = array_count(peerList->peers); j > 0; j--) {
-            if (btcPeerEq(&peerList->peers[j - 1], peer)) array_rm(peerList->peers, j - 1);
-        }
-    }
+    _BRTxPeerIndexRemovePeer(&manager->txRelays, peer);
 
     if (peer == manager->downloadPeer) { // download peer disconnected
         manager->isConnected = 0;
         manager->downloadPeer = NULL;
+        _btcPeerManagerClearFilterBatch(manager);
+        _btcPeerManagerResetBlockRanges(manager);
+        manager->cfSyncing = manager->rangeSyncing = manager->headersPending = 0;
         if (manager->connectFailureCount > MAX_CONNECT_FAILURES) manager->connectFailureCount = MAX_CONNECT_FAILURES;
     }
 
@@ -879,6 +1683,8 @@ static void _peerDisconnected(void *info, int error)
         break;
     }
 
+    _btcPeerManagerRemovePeerRanges(manager, peer);
+    _btcPeerManagerSyncBlockRanges(manager); // request the peer's block ranges from the remaining peers
     btcPeerFree(peer);
     pthread_mutex_unlock(&manager->lock);
     
@@ -933,6 +1739,11 @@ static void _peerRelayedTx(void *info, BRBitcoinTransaction *tx)
     
     pthread_mutex_lock(&manager->lock);
     peer_log(peer, "relayed tx: %s", u256hex(tx->txHash));
+
+    if (! ((BRPeerCallbackInfo *)info)->fromBlockRange && _btcPeerManagerAddRangeTx(manager, peer, tx)) {
+        pthread_mutex_unlock(&manager->lock); // tx is applied along with its block range
+        return;
+    }
     
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) { // see if tx is in list of published tx
         if (UInt256Eq(manager->publishedTxHashes[i - 1], tx->txHash)) {
@@ -946,7 +1757,8 @@ static void _peerRelayedTx(void *info, BRBitcoinTransaction *tx)
     }
 
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (manager->rangeSyncing) _btcPeerManagerScheduleRangeTimeout(manager, peer); // unless block ranges are in flight
+    else if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
         btcPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
@@ -973,24 +1785,22 @@ static void _peerRelayedTx(void *info, BRBitcoinTransaction *tx)
         // (we only need to track this after syncing is complete)
         if (manager->syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, tx->txHash, peer);
         
-        _BRTxPeerListRemovePeer(manager->txRequests, tx->txHash, peer);
+        _BRTxPeerListRemovePeer(&manager->txRequests, tx->txHash, peer);
         
-        if (manager->bloomFilter != NULL) { // check if bloom filter is already being updated
-            BRAddress addrs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
-            UInt160 hash;
-
+        // check if filter is already being updated, during a headers-first sync, filters are reloaded once the block
+        // range with the tx is applied
+        if (manager->bloomFilter != NULL && ! manager->filterAddPending && ! manager->rangeSyncing) {
             // the transaction likely consumed one or more wallet addresses, so check that at least the next <gap limit>
-            // unused addresses are still matched by the bloom filter
-            btcWalletUnusedAddrs(manager->wallet, addrs, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
-            btcWalletUnusedAddrs(manager->wallet, addrs + SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
-
-            for (size_t i = 0; i < SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL; i++) {
-                if (! BRAddressHash160(&hash, manager->params->addrParams, addrs[i].s) ||
-                    btcBloomFilterContainsData(manager->bloomFilter, hash.u8, sizeof(hash))) continue;
-                if (manager->bloomFilter) btcBloomFilterFree(manager->bloomFilter);
-                manager->bloomFilter = NULL; // reset bloom filter so it's recreated with new wallet addresses
+            // unused addresses are still matched by the bloom filters, they are if the chains didn't grow past them
+            btcWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
+            btcWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
+
+            if (btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_EXTERNAL_CHAIN) >
+                    manager->filterChainCounts[SEQUENCE_EXTERNAL_CHAIN] ||
+                btcWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_INTERNAL_CHAIN) >
+                    manager->filterChainCounts[SEQUENCE_INTERNAL_CHAIN]) {
+                manager->filterAddPending = 1; // new wallet addresses are added once the download peer sends pong
                 _btcPeerManagerUpdateFilter(manager);
-                break;
             }
         }
     }
@@ -1029,7 +1839,8 @@ static void _peerHasTx(void *info, UInt256 txHash)
     }
     
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (manager->rangeSyncing) _btcPeerManagerScheduleRangeTimeout(manager, peer); // unless block ranges are in flight
+    else if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
         btcPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
@@ -1051,7 +1862,7 @@ static void _peerHasTx(void *info, UInt256 txHash)
             btcWalletUpdateTransactions(manager->wallet, &txHash, 1, TX_UNCONFIRMED, (uint32_t)time(NULL));
         }
 
-        _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
+        _BRTxPeerListRemovePeer(&manager->txRequests, txHash, peer);
     }
     
     pthread_mutex_unlock(&manager->lock);
@@ -1067,10 +1878,10 @@ static void _peerRejectedTx(void *info, UInt256 txHash, uint8_t code)
     pthread_mutex_lock(&manager->lock);
     peer_log(peer, "rejected tx: %s", u256hex(txHash));
     tx = btcWalletTransactionForHash(manager->wallet, txHash);
-    _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
+    _BRTxPeerListRemovePeer(&manager->txRequests, txHash, peer);
 
     if (tx) {
-        if (_BRTxPeerListRemovePeer(manager->txRelays, txHash, peer) && tx->blockHeight == TX_UNCONFIRMED) {
+        if (_BRTxPeerListRemovePeer(&manager->txRelays, txHash, peer) && tx->blockHeight == TX_UNCONFIRMED) {
             // set timestamp 0 to mark tx as unverified
             btcWalletUpdateTransactions(manager->wallet, &txHash, 1, TX_UNCONFIRMED, 0);
         }
@@ -1117,7 +1928,8 @@ static int _btcPeerManagerVerifyBlock(BRBitcoinPeerManager *manager, BRBitcoinMe
             b = BRSetGet(manager->blocks, &prevBlock);
             if (b) prevBlock = b->prevBlock;
 
-            if (b && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0) {
+            // headers that haven't been scanned yet are kept for requesting their blocks
+            if (b && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0 && b->height <= manager->syncedHeight) {
                 BRSetRemove(manager->blocks, b);
                 btcMerkleBlockFree(b);
             }
@@ -1154,6 +1966,8 @@ static void _peerRelayedBlockFailed (BRBitcoinMerkleBlock *blockToFree, BRBitcoi
     assert (0);
 }
 
+static void _btcPeerManagerApplyBlockRanges(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer);
+
 static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
 {
     if (NULL == info || NULL == block) {
@@ -1163,6 +1977,7 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
 
     BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    int fromBlockRange = ((BRPeerCallbackInfo *)info)->fromBlockRange;
     size_t i, j, fpCount = 0, saveCount = 0;
     BRBitcoinMerkleBlock orphan, *b, *b2, *prev, *next = NULL;
     uint32_t txTime = 0;
@@ -1176,7 +1991,7 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
     if (NULL == manager->blocks ||
         NULL == manager->wallet ||
         NULL == manager->lastBlock ||
-        NULL == manager->downloadPeer) {
+        (NULL == manager->downloadPeer && ! fromBlockRange)) {
         _peerRelayedBlockFailed (block, peer, "missed 'manager' fields");
         return;
     }
@@ -1195,6 +2010,14 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
     txCount = btcMerkleBlockTxHashes(block, txHashes, txCount);
 
     pthread_mutex_lock(&manager->lock);
+
+    if (! fromBlockRange && _btcPeerManagerAddRangeBlock(manager, peer, block)) { // applied once its range is complete
+        pthread_mutex_unlock(&manager->lock);
+        if (txHashes != _txHashes) free(txHashes);
+        _btcPeerManagerApplyBlockRanges(manager, peer);
+        return;
+    }
+
     prev = BRSetGet(manager->blocks, &block->prevBlock);
 
     if (prev) {
@@ -1202,8 +2025,10 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
         block->height = prev->height + 1;
     }
     
-    // track the observed bloom filter false positive rate using a low pass filter to smooth out variance
-    if (peer == manager->downloadPeer && block->totalTx > 0) {
+    // track the observed bloom filter false positive rate using a low pass filter to smooth out variance, during a
+    // headers-first sync, over the blocks applied from block ranges
+    if (manager->syncMode == BRPeerManagerSyncModeBloomFilter && block->totalTx > 0 &&
+        (fromBlockRange || (peer == manager->downloadPeer && ! manager->rangeSyncing))) {
         for (i = 0; i < txCount; i++) { // wallet tx are not false-positives
             if (! btcWalletTransactionForHash(manager->wallet, txHashes[i])) fpCount++;
         }
@@ -1222,18 +2047,20 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
                      manager->fpRate, manager->lastBlock->height + 1 - manager->filterUpdateHeight);
             btcPeerDisconnect(peer);
         }
-        else if (manager->lastBlock->height + 500 < btcPeerLastBlock(peer) &&
+        else if (fromBlockRange && manager->syncedHeight + BLOCK_RANGE_SIZE < manager->lastBlock->height &&
+                 manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*10.0) {
+            _btcPeerManagerReloadBloomFilters(manager, manager->syncedHeight, 0); // rebuild degraded bloom filters
+        }
+        else if (! fromBlockRange && manager->lastBlock->height + 500 < btcPeerLastBlock(peer) &&
                  manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*10.0) {
             _btcPeerManagerUpdateFilter(manager); // rebuild bloom filter when it starts to degrade
         }
     }
 
-    // ignore block headers that are newer than one week before earliestKeyTime (it's a header if it has 0 totalTx)
-    if (block->totalTx == 0 && block->timestamp + 7*24*60*60 - 2*60*60 > manager->earliestKeyTime) {
-        btcMerkleBlockFree(block);
-        block = NULL;
-    }
-    else if (manager->bloomFilter == NULL) { // ingore potentially incomplete blocks when a filter update is pending
+    // headers are kept for every block, and merkle blocks are requested for them in block ranges
+    if (manager->syncMode == BRPeerManagerSyncModeBloomFilter && block->totalTx > 0 && ! fromBlockRange &&
+        (manager->bloomFilter == NULL || manager->filterAddPending)) {
+        // ingore potentially incomplete blocks when a filter update is pending
         btcMerkleBlockFree(block);
         block = NULL;
 
@@ -1290,13 +2117,14 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
             manager->connectFailureCount = 0; // reset failure count once we know our initial request didn't timeout
         }
         
-        if ((block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && block->height + 100 < manager->estimatedHeight) {
-            saveCount = 1; // save transition blocks immediately
-        }
-        
-        if (block->height == manager->estimatedHeight) { // chain download is complete
-            saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
-            _btcPeerManagerLoadMempools(manager);
+        // headers are saved once their blocks have been scanned, a merkle block extending the chain was scanned already
+        if (manager->syncMode == BRPeerManagerSyncModeBloomFilter && block->totalTx > 0 &&
+            manager->syncedHeight + 1 == block->height) {
+            manager->syncedHeight = block->height;
+            
+            if (! manager->rangeSyncing && block->height == manager->estimatedHeight) {
+                saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
+            }
         }
     }
     else if (BRSetContains(manager->blocks, block)) { // we already have the block (or at least the header)
@@ -1349,6 +2177,17 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
         
             btcWalletSetTxUnconfirmedAfter(manager->wallet, b->height); // mark tx after the join point as unconfirmed
 
+            if (manager->syncMode == BRPeerManagerSyncModeBloomFilter && block->totalTx > 0 &&
+                manager->syncedHeight >= manager->lastBlock->height) { // the fork was relayed as merkle blocks
+                manager->syncedHeight = block->height;
+            }
+            else if (b->height < manager->syncedHeight) { // scan the new main chain from the join point
+                _btcPeerManagerClearFilterBatch(manager);
+                _btcPeerManagerResetBlockRanges(manager);
+                manager->syncedHeight = b->height;
+                manager->cfHeader = UINT256_ZERO;
+            }
+
             b = block;
         
             while (b && b2 && b->height > b2->height) { // set transaction heights for new main chain
@@ -1372,11 +2211,6 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
             }
         
             manager->lastBlock = block;
-            
-            if (block->height == manager->estimatedHeight) { // chain download is complete
-                saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
-                _btcPeerManagerLoadMempools(manager);
-            }
         }
     }
    
@@ -1419,6 +2253,202 @@ static void _peerRelayedBlock(void *info, BRBitcoinMerkleBlock *block)
     if (next) _peerRelayedBlock(info, next);
 }
 
+// applies completed block ranges to the wallet in chain order, as if relayed by the peer each range was requested from,
+// or by peer if that one has since disconnected, stopping after a block with a tx that receives to the wallet, since the
+// blocks after it were filtered without the wallet addresses that tx used up
+static void _btcPeerManagerApplyBlockRanges(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    BRPeerCallbackInfo info = { peer, manager, UINT256_ZERO, 1 };
+    BRBlockRange *range;
+    BRBlockRangeItem item;
+    BRBitcoinMerkleBlock *b;
+    size_t i, blockCount;
+    uint32_t generation;
+    int hasReceive;
+
+    pthread_mutex_lock(&manager->lock);
+
+    if (manager->applyingRanges) { // ranges are already being applied further up the stack
+        pthread_mutex_unlock(&manager->lock);
+        return;
+    }
+
+    manager->applyingRanges = 1;
+
+    while (array_count(manager->blockRanges) > 0 && _btcBlockRangeIsComplete(manager->blockRanges[0])) {
+        range = manager->blockRanges[0];
+        array_rm(manager->blockRanges, 0);
+        generation = manager->rangeGeneration;
+        info.peer = peer;
+
+        for (i = array_count(manager->connectedPeers); i > 0; i--) { // txRelays and publish callbacks need the relayer
+            if (manager->connectedPeers[i - 1] == range->peer) info.peer = range->peer;
+        }
+
+        pthread_mutex_unlock(&manager->lock); // wallet callbacks are made without the lock held
+
+        for (i = 0, blockCount = 0, hasReceive = 0; i < array_count(range->items); i++) {
+            item = range->items[i];
+            range->items[i] = (const BRBlockRangeItem) { NULL, NULL };
+
+            if (item.tx) {
+                if (! btcWalletTransactionForHash(manager->wallet, item.tx->txHash) &&
+                    btcWalletAmountReceivedFromTx(manager->wallet, item.tx) > 0) hasReceive = 1;
+                _peerRelayedTx(&info, item.tx);
+            }
+            else {
+                _peerRelayedBlock(&info, item.block);
+                blockCount++;
+                if (hasReceive) break;
+            }
+        }
+
+        pthread_mutex_lock(&manager->lock);
+        b = (blockCount > 0) ? BRSetGet(manager->blocks, &range->blockHashes[blockCount - 1]) : NULL;
+
+        if (b && generation == manager->rangeGeneration) { // the chain range was split from hasn't changed
+            if (b->height > manager->syncedHeight) _btcPeerManagerSetSyncedHeight(manager, b);
+
+            if (blockCount < array_count(range->blockHashes)) { // request the rest with updated filters
+                array_insert(manager->blockRanges, 0, _btcBlockRangeNew(range->startHeight + (uint32_t)blockCount,
+                                                                        &range->blockHashes[blockCount],
+                                                                        array_count(range->blockHashes) - blockCount));
+            }
+
+            if (hasReceive) _btcPeerManagerReloadBloomFilters(manager, b->height, 1); // only blocks after b missed tx
+        }
+
+        _btcBlockRangeFree(range);
+    }
+
+    manager->applyingRanges = 0;
+    _btcPeerManagerScheduleRangeTimeout(manager, peer);
+    _btcPeerManagerSyncBlockRanges(manager);
+    pthread_mutex_unlock(&manager->lock);
+}
+
+static void _peerRelayedHeaders(void *info, size_t headersCount)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+
+    pthread_mutex_lock(&manager->lock);
+
+    if (peer != manager->downloadPeer) {
+        // headers are only requested from the download peer
+    }
+    else if (manager->syncMode == BRPeerManagerSyncModeBloomFilter) { // request merkle blocks for the new headers
+        manager->headersPending = 0;
+        if (headersCount >= 2000) manager->needsHeaders = 1;
+        _btcPeerManagerScheduleRangeTimeout(manager, peer);
+        _btcPeerManagerSyncBlockRanges(manager);
+    }
+    else if (UInt256IsZero(manager->cfBatchStop)) {
+        // match filters for the headers we have, before requesting more, so none are dropped by _btcPeerManagerVerifyBlock
+        if (headersCount >= 2000) manager->needsHeaders = 1;
+        _btcPeerManagerSyncCompactFilters(manager, peer);
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+}
+
+static void _peerRelayedCFHeaders(void *info, uint8_t filterType, UInt256 stopHash, UInt256 prevFilterHeader,
+                                  const UInt256 filterHashes[], size_t hashesCount)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+
+    pthread_mutex_lock(&manager->lock);
+
+    if (peer != manager->downloadPeer || filterType != CFILTER_TYPE_BASIC ||
+        ! UInt256Eq(stopHash, manager->cfBatchStop) || array_count(manager->cfBatchHashes) > 0) {
+        peer_log(peer, "ignoring unrequested cfheaders with stop hash: %s", u256hex(stopHash));
+    }
+    else if (! UInt256IsZero(manager->cfHeader) && ! UInt256Eq(prevFilterHeader, manager->cfHeader)) {
+        peer_log(peer, "relayed cfheaders that don't extend the filter header chain");
+        _btcPeerManagerPeerMisbehavin(manager, peer);
+    }
+    else {
+        manager->cfBatchPrevHeader = prevFilterHeader;
+        array_add_array(manager->cfBatchHashes, filterHashes, hashesCount);
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+}
+
+static void _peerRelayedCFilter(void *info, BRBitcoinCompactFilter *filter)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+
+    pthread_mutex_lock(&manager->lock);
+
+    if (peer == manager->downloadPeer && ! UInt256IsZero(manager->cfBatchStop) && filter->type == CFILTER_TYPE_BASIC &&
+        array_count(manager->cfBatchFilters) < CFILTER_MAX_FILTERS) {
+        array_add(manager->cfBatchFilters, filter);
+        if (manager->syncStartHeight > 0) btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
+        filter = NULL;
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+    if (filter) btcCompactFilterFree(filter);
+}
+
+static void _peerRelayedFullBlock(void *info, BRBitcoinMerkleBlock *block, BRBitcoinTransaction *txs[], size_t txCount)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+    size_t i, count = btcMerkleBlockTxHashes(block, NULL, 0);
+    UInt256 *txHashes = malloc(count*sizeof(*txHashes));
+    uint8_t *matches = calloc(count, sizeof(*matches));
+
+    assert(txHashes != NULL || count == 0);
+    assert(matches != NULL || count == 0);
+    count = btcMerkleBlockTxHashes(block, txHashes, count);
+
+    for (i = 0; i < txCount; i++) { // in block order, so a wallet tx spent later in the same block is recognized
+        if (btcWalletContainsTransaction(manager->wallet, txs[i])) _peerRelayedTx(info, txs[i]);
+        else btcTransactionFree(txs[i]);
+    }
+
+    pthread_mutex_lock(&manager->lock);
+
+    for (i = array_count(manager->cfBatchBlocks); i > 0; i--) {
+        if (UInt256Eq(manager->cfBatchBlocks[i - 1], block->blockHash)) array_rm(manager->cfBatchBlocks, i - 1);
+    }
+
+    if (manager->syncStartHeight > 0 && peer == manager->downloadPeer) {
+        btcPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+
+    // keep only the wallet tx in the merkle tree, as if a bloom filter had matched just those
+    for (i = 0; i < count; i++) matches[i] = (btcWalletTransactionForHash(manager->wallet, txHashes[i]) != NULL);
+    btcMerkleBlockSetMatchedTxHashes(block, txHashes, matches, count);
+    if (matches) free(matches);
+    if (txHashes) free(txHashes);
+    _peerRelayedBlock(info, block);
+}
+
+static void _peerAnnouncedBlocks(void *info, const UInt256 blockHashes[], size_t blockCount)
+{
+    BRBitcoinPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
+    BRBitcoinPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
+
+    pthread_mutex_lock(&manager->lock);
+
+    for (size_t i = 0; peer == manager->downloadPeer && i < blockCount; i++) {
+        if (! BRSetContains(manager->blocks, &blockHashes[i])) manager->needsHeaders = 1;
+    }
+
+    if (peer == manager->downloadPeer && manager->needsHeaders && ! manager->cfSyncing) {
+        _btcPeerManagerSyncCompactFilters(manager, peer);
+    }
+
+    pthread_mutex_unlock(&manager->lock);
+}
+
 static void _peerDataNotfound(void *info, const UInt256 txHashes[], size_t txCount,
                              const UInt256 blockHashes[], size_t blockCount)
 {
@@ -1428,8 +2458,8 @@ static void _peerDataNotfound(void *info, const UInt256 txHashes[], size_t txCou
     pthread_mutex_lock(&manager->lock);
 
     for (size_t i = 0; i < txCount; i++) {
-        _BRTxPeerListRemovePeer(manager->txRelays, txHashes[i], peer);
-        _BRTxPeerListRemovePeer(manager->txRequests, txHashes[i], peer);
+        _BRTxPeerListRemovePeer(&manager->txRelays, txHashes[i], peer);
+        _BRTxPeerListRemovePeer(&manager->txRequests, txHashes[i], peer);
     }
 
     pthread_mutex_unlock(&manager->lock);
@@ -1477,7 +2507,8 @@ static BRBitcoinTransaction *_peerRequestedTx(void *info, UInt256 txHash)
     }
 
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (manager->rangeSyncing) _btcPeerManagerScheduleRangeTimeout(manager, peer); // unless block ranges are in flight
+    else if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
         btcPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
@@ -1511,6 +2542,101 @@ static void _dummyThreadCleanup(void *info)
 {
 }
 
+// for testing, adds peer, which must report it's connected, to manager's connected peers and calls its connected
+// callback, the first peer becomes the download peer of a headers-first sync, peer is freed along with manager
+void btcPeerManagerPeerConnectedTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer)
+{
+    BRPeerCallbackInfo info = { peer, manager, UINT256_ZERO, 0 };
+
+    pthread_mutex_lock(&manager->lock);
+    array_add(manager->connectedPeers, peer);
+    if (manager->syncStartHeight == 0) manager->syncStartHeight = manager->lastBlock->height + 1;
+    pthread_mutex_unlock(&manager->lock);
+    _peerConnected(&info);
+}
+
+// for testing, calls manager's callbacks for headers relayed by peer in reply to getheaders
+void btcPeerManagerRelayedHeadersTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer,
+                                      BRBitcoinMerkleBlock *headers[], size_t headersCount)
+{
+    BRPeerCallbackInfo info = { peer, manager, UINT256_ZERO, 0 };
+
+    for (size_t i = 0; i < headersCount; i++) _peerRelayedBlock(&info, headers[i]);
+    _peerRelayedHeaders(&info, headersCount);
+}
+
+// for testing, calls manager's callbacks for a merkle block relayed by peer, preceded by the matched tx in it
+void btcPeerManagerRelayedBlockTest(BRBitcoinPeerManager *manager, BRBitcoinPeer *peer,
+                                    BRBitcoinTransaction *txs[], size_t txCount, BRBitcoinMerkleBlock *block)
+{
+    BRPeerCallbackInfo info = { peer, manager, UINT256_ZERO, 0 };
+
+    for (size_t i = 0; i < txCount; i++) _peerRelayedTx(&info, txs[i]);
+    _peerRelayedBlock(&info, block);
+}
+
+// for testing, writes the start height of each pending block range, and the peer it's requested from or NULL, to
+// startHeights and peers, and the number of stale ranges and the synced height to staleCount and syncedHeight
+// returns the number of pending block ranges
+size_t btcPeerManagerBlockRangesTest(BRBitcoinPeerManager *manager, uint32_t startHeights[], BRBitcoinPeer *peers[],
+                                     size_t count, size_t *staleCount, uint32_t *syncedHeight)
+{
+    size_t rangesCount;
+
+    pthread_mutex_lock(&manager->lock);
+    rangesCount = array_count(manager->blockRanges);
+
+    for (size_t i = 0; i < rangesCount && i < count; i++) {
+        startHeights[i] = manager->blockRanges[i]->startHeight;
+        peers[i] = manager->blockRanges[i]->peer;
+    }
+
+    *staleCount = array_count(manager->staleRanges);
+    *syncedHeight = manager->syncedHeight;
+    pthread_mutex_unlock(&manager->lock);
+    return rangesCount;
+}
+
+// for testing, returns true if manager is waiting on the download peer for headers
+int btcPeerManagerHeadersPendingTest(BRBitcoinPeerManager *manager)
+{
+    int r;
+
+    pthread_mutex_lock(&manager->lock);
+    r = manager->headersPending;
+    pthread_mutex_unlock(&manager->lock);
+    return r;
+}
+
+// for testing, returns true if every peer's bloom filter was loaded with or sent data, a wallet address pubKey hash or
+// outpoint, and the last filter loaded matches it
+int btcPeerManagerBloomFilterContainsTest(BRBitcoinPeerManager *manager, const uint8_t *data, size_t dataLen)
+{
+    const uint32_t chains[] = { SEQUENCE_EXTERNAL_CHAIN, SEQUENCE_INTERNAL_CHAIN };
+    int r = 0;
+
+    pthread_mutex_lock(&manager->lock);
+
+    if (dataLen == sizeof(UInt160)) {
+        for (size_t i = 0; ! r && i < 2; i++) {
+            size_t count = manager->filterChainCounts[chains[i]];
+            UInt160 pkhs[count + 1];
+
+            count = btcWalletChainPKHs(manager->wallet, pkhs, count, chains[i]);
+            for (size_t j = 0; ! r && j < count; j++) r = (memcmp(pkhs[j].u8, data, dataLen) == 0);
+        }
+    }
+    else if (dataLen == sizeof(UInt256) + sizeof(uint32_t)) {
+        BRBitcoinUTXO utxo = { UInt256Get(data), UInt32GetLE(&data[sizeof(UInt256)]) };
+
+        r = BRSetContains(manager->filterUTXOs, &utxo);
+    }
+
+    r = (r && manager->bloomFilter && btcBloomFilterContainsData(manager->bloomFilter, data, dataLen));
+    pthread_mutex_unlock(&manager->lock);
+    return r;
+}
+
 // returns a newly allocated BRPeerManager struct that must be freed by calling btcPeerManagerFree()
 BRBitcoinPeerManager *btcPeerManagerNew(const BRBitcoinChainParams *params, BRBitcoinWallet *wallet, uint32_t earliestKeyTime,
                                 BRBitcoinMerkleBlock *blocks[], size_t blocksCount, const BRBitcoinPeer peers[], size_t peersCount)
@@ -1536,6 +2662,7 @@ BRBitcoinPeerManager *btcPeerManagerNew(const BRBitcoinChainParams *params, BRBi
     manager->blocks = BRSetNew(btcMerkleBlockHash, btcMerkleBlockEq, blocksCount);
     manager->orphans = BRSetNew(_BRPrevBlockHash, _BRPrevBlockEq, blocksCount); // orphans are indexed by prevBlock
     manager->checkpoints = BRSetNew(_BRBlockHeightHash, _BRBlockHeightEq, 100); // checkpoints are indexed by height
+    manager->filterUTXOs = BRSetNew(btcUTXOHash, btcUTXOEq, 100);
 
     for (size_t i = 0; i < manager->params->checkpointsCount; i++) {
         block = btcMerkleBlockNew();
@@ -1571,9 +2698,15 @@ BRBitcoinPeerManager *btcPeerManagerNew(const BRBitcoinChainParams *params, BRBi
     }
 
     _peer_log("BPM: initialized with %u last block height\n", manager->lastBlock->height);
-
-    array_new(manager->txRelays, 10);
-    array_new(manager->txRequests, 10);
+    manager->syncedHeight = manager->rangesHeight = manager->lastBlock->height;
+    array_new(manager->blockRanges, BLOCK_RANGE_WINDOW);
+    array_new(manager->staleRanges, 10);
+    array_new(manager->cfBatchHashes, CFILTER_MAX_FILTERS);
+    array_new(manager->cfBatchBlocks, 10);
+    array_new(manager->cfBatchFilters, CFILTER_MAX_FILTERS);
+
+    _BRTxPeerIndexInit(&manager->txRelays);
+    _BRTxPeerIndexInit(&manager->txRequests);
     array_new(manager->publishedTx, 10);
     array_new(manager->publishedTxHashes, 10);
     pthread_mutex_init(&manager->lock, NULL);
@@ -1612,6 +2745,13 @@ void btcPeerManagerSetCallbacks(BRBitcoinPeerManager *manager, void *info,
     manager->threadCleanup = (threadCleanup) ? threadCleanup : _dummyThreadCleanup;
 }
 
+// not thread-safe, set the sync mode once before calling btcPeerManagerConnect(), the default is bloom filter sync
+void btcPeerManagerSetSyncMode(BRBitcoinPeerManager *manager, BRBitcoinPeerManagerSyncMode syncMode)
+{
+    assert(manager != NULL);
+    manager->syncMode = syncMode;
+}
+
 // specifies a single fixed peer to use when connecting to the bitcoin network
 // set address to UINT128_ZERO to revert to default behavior
 void btcPeerManagerSetFixedPeer(BRBitcoinPeerManager *manager, UInt128 address, uint16_t port)
@@ -1710,6 +2850,13 @@ void btcPeerManagerConnect(BRBitcoinPeerManager *manager)
                                    _peerRelayedTx, _peerHasTx, _peerRejectedTx, _peerRelayedBlock, _peerDataNotfound,
                                    _peerSetFeePerKb, _peerRequestedTx, _peerNetworkIsReachable, _peerThreadCleanup);
                 btcPeerSetEarliestKeyTime(info->peer, manager->earliestKeyTime);
+
+                if (manager->syncMode == BRPeerManagerSyncModeCompactFilter) {
+                    btcPeerSetCompactFilterCallbacks(info->peer, _peerRelayedHeaders, _peerRelayedCFHeaders,
+                                                     _peerRelayedCFilter, _peerRelayedFullBlock, _peerAnnouncedBlocks);
+                }
+                else btcPeerSetHeadersFirst(info->peer, _peerRelayedHeaders);
+
                 btcPeerConnect(info->peer);
 
                 if (btcPeerConnectStatus(info->peer) == BRPeerStatusDisconnected) {
@@ -1777,6 +2924,13 @@ static int _btcPeerManagerRescan(BRBitcoinPeerManager *manager, BRBitcoinMerkleB
     manager->lastBlock = newLastBlock;
     _peer_log("BPM: rescanning with %u last block height", manager->lastBlock->height);
 
+    if (manager->syncedHeight > manager->lastBlock->height) {
+        manager->syncedHeight = manager->lastBlock->height;
+        manager->cfHeader = UINT256_ZERO;
+    }
+
+    _btcPeerManagerResetBlockRanges(manager);
+
     if (manager->downloadPeer) { // disconnect the current download peer so a new random one will be selected
         for (size_t i = array_count(manager->peers); i > 0; i--) {
             if (btcPeerEq(&manager->peers[i - 1], manager->downloadPeer)) array_rm(manager->peers, i - 1);
@@ -1924,17 +3078,24 @@ uint32_t btcPeerManagerLastBlockTimestamp(BRBitcoinPeerManager *manager)
 double btcPeerManagerSyncProgress(BRBitcoinPeerManager *manager, uint32_t startHeight)
 {
     double progress;
+    uint32_t height;
     
     assert(manager != NULL);
     pthread_mutex_lock(&manager->lock);
     if (startHeight == 0) startHeight = manager->syncStartHeight;
+    height = manager->lastBlock->height;
+
+    // headers are downloaded first, and blocks aren't synced until they've been scanned for wallet tx
+    if (manager->syncedHeight < height) {
+        height = manager->syncedHeight;
+    }
     
     if (! manager->downloadPeer && manager->syncStartHeight == 0) {
         progress = 0.0;
     }
-    else if (! manager->downloadPeer || manager->lastBlock->height < manager->estimatedHeight) {
-        if (manager->lastBlock->height > startHeight && manager->estimatedHeight > startHeight) {
-            progress = 0.1 + 0.9*(manager->lastBlock->height - startHeight)/(manager->estimatedHeight - startHeight);
+    else if (! manager->downloadPeer || height < manager->estimatedHeight) {
+        if (height > startHeight && manager->estimatedHeight > startHeight) {
+            progress = 0.1 + 0.9*(height - startHeight)/(manager->estimatedHeight - startHeight);
         }
         else progress = 0.05;
     }
@@ -2053,12 +3214,7 @@ size_t btcPeerManagerRelayCount(BRBitcoinPeerManager *manager, UInt256 txHash)
     assert(! UInt256IsZero(txHash));
     pthread_mutex_lock(&manager->lock);
     
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
-        if (! UInt256Eq(manager->txRelays[i - 1].txHash, txHash)) continue;
-        count = array_count(manager->txRelays[i - 1].peers);
-        break;
-    }
-    
+    count = _BRTxPeerListCount(&manager->txRelays, txHash);
     pthread_mutex_unlock(&manager->lock);
     return count;
 }
@@ -2082,10 +3238,8 @@ void btcPeerManagerFree(BRBitcoinPeerManager *manager)
     BRSetApply(manager->orphans, NULL, _setApplyFreeBlock);
     BRSetFree(manager->orphans);
     BRSetFree(manager->checkpoints);
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) array_free(manager->txRelays[i - 1].peers);
-    array_free(manager->txRelays);
-    for (size_t i = array_count(manager->txRequests); i > 0; i--) array_free(manager->txRequests[i - 1].peers);
-    array_free(manager->txRequests);
+    _BRTxPeerIndexFree(&manager->txRelays);
+    _BRTxPeerIndexFree(&manager->txRequests);
 
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         tx = manager->publishedTx[i - 1].tx;
@@ -2093,6 +3247,16 @@ void btcPeerManagerFree(BRBitcoinPeerManager *manager)
     }
 
     if (manager->bloomFilter) btcBloomFilterFree(manager->bloomFilter);
+    BRSetApply(manager->filterUTXOs, NULL, _setApplyFree);
+    BRSetFree(manager->filterUTXOs);
+    _btcPeerManagerClearFilterBatch(manager);
+    array_free(manager->cfBatchFilters);
+    array_free(manager->cfBatchBlocks);
+    array_free(manager->cfBatchHashes);
+    for (size_t i = array_count(manager->blockRanges); i > 0; i--) _btcBlockRangeFree(manager->blockRanges[i - 1]);
+    array_free(manager->blockRanges);
+    for (size_t i = array_count(manager->staleRanges); i > 0; i--) _btcBlockRangeFree(manager->staleRanges[i - 1]);
+    array_free(manager->staleRanges);
 
     array_free(manager->publishedTx);
     array_free(manager->publishedTxHashes);
@@ -41,6 +41,11 @@ extern "C" {
 
 typedef struct BRBitcoinPeerManagerStruct BRBitcoinPeerManager;
 
+typedef enum {
+    BRPeerManagerSyncModeBloomFilter = 0, // BIP37 filtered blocks, from peers matching a bloom filter of wallet data
+    BRPeerManagerSyncModeCompactFilter    // BIP157/158 compact block filters, matched locally against wallet scripts
+} BRBitcoinPeerManagerSyncMode;
+
 // returns a newly allocated BRPeerManager struct that must be freed by calling btcPeerManagerFree()
 BRBitcoinPeerManager *btcPeerManagerNew(const BRBitcoinChainParams *params, BRBitcoinWallet *wallet, uint32_t earliestKeyTime,
                                 BRBitcoinMerkleBlock *blocks[], size_t blocksCount, const BRBitcoinPeer peers[], size_t peersCount);
@@ -65,6 +70,11 @@ void btcPeerManagerSetCallbacks(BRBitcoinPeerManager *manager, void *info,
                                int (*networkIsReachable)(void *info),
                                void (*threadCleanup)(void *info));
 
+// not thread-safe, set the sync mode once before calling btcPeerManagerConnect(), the default is bloom filter sync
+// in compact filter mode only peers serving compact filters are used, and no mempool is requested, so incoming
+// unconfirmed transactions aren't seen until they're in a block
+void btcPeerManagerSetSyncMode(BRBitcoinPeerManager *manager, BRBitcoinPeerManagerSyncMode syncMode);
+
 // specifies a single fixed peer to use when connecting to the bitcoin network
 // set address to UINT128_ZERO to revert to default behavior
 void btcPeerManagerSetFixedPeer(BRBitcoinPeerManager *manager, UInt128 address, uint16_t port);
@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define TX_VERSION           0x00000001
 #define TX_LOCKTIME          0x00000000
@@ -36,6 +38,11 @@
 #define SIGHASH_ANYONECANPAY 0x80 // let other people add inputs, I don't care where the rest of the bitcoins come from
 #define SIGHASH_FORKID       0x40 // use BIP143 digest method (for b-cash/b-gold signatures)
 
+#define BTC_TX_INPUT_SIGNATURE_SIZE   (1 + 73 + 1 + 65) // push of a DER signature plus hash type, push of a pubkey
+#define BTC_TX_SIGN_MAX_THREADS       (16)
+#define BTC_TX_SIGN_MIN_THREAD_INPUTS (8)           // fewer inputs per thread and thread startup outweighs signing
+#define BTC_TX_SIGN_STACK_SIZE        (1024 * 1024) // sighash data for legacy inputs is on the stack, and grows with tx
+
 size_t btcTxInputAddress(const BRBitcoinTxInput *input, char *address, size_t addrLen, BRAddressParams params)
 {
     size_t r = BRAddressFromScriptPubKey(address, addrLen, params, input->script, input->scriptLen);
@@ -184,41 +191,100 @@ static size_t _btcTransactionOutputData(const BRBitcoinTransaction *tx, uint8_t
     return (! data || off <= dataLen) ? off : 0;
 }
 
+// BIP143 hashes of the prevouts, sequences and outputs, which are the same for every SIGHASH_ALL input of a tx, so
+// they're computed once per signing rather than once per input (which made signing quadratic in the input count)
+typedef struct {
+    UInt256 prevoutsHash;
+    UInt256 sequenceHash;
+    UInt256 outputsHash;
+} BRBitcoinSigHashCache;
+
+static UInt256 _btcTransactionPrevoutsHash(const BRBitcoinTransaction *tx)
+{
+    size_t bufLen = (sizeof(UInt256) + sizeof(uint32_t))*tx->inCount;
+    uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
+    UInt256 md;
+
+    for (size_t i = 0; i < tx->inCount; i++) {
+        UInt256Set(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i], tx->inputs[i].txHash);
+        UInt32SetLE(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i + sizeof(UInt256)], tx->inputs[i].index);
+    }
+
+    BRSHA256_2(&md, buf, bufLen);
+    if (buf != _buf) free(buf);
+    return md;
+}
+
+static UInt256 _btcTransactionSequenceHash(const BRBitcoinTransaction *tx)
+{
+    size_t bufLen = sizeof(uint32_t)*tx->inCount;
+    uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
+    UInt256 md;
+
+    for (size_t i = 0; i < tx->inCount; i++) UInt32SetLE(&buf[sizeof(uint32_t)*i], tx->inputs[i].sequence);
+    BRSHA256_2(&md, buf, bufLen);
+    if (buf != _buf) free(buf);
+    return md;
+}
+
+// hash of all outputs if index is SIZE_MAX, otherwise of the output at index
+static UInt256 _btcTransactionOutputsHash(const BRBitcoinTransaction *tx, size_t index)
+{
+    size_t bufLen = _btcTransactionOutputData(tx, NULL, 0, index);
+    uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
+    UInt256 md;
+
+    bufLen = _btcTransactionOutputData(tx, buf, bufLen, index);
+    BRSHA256_2(&md, buf, bufLen);
+    if (buf != _buf) free(buf);
+    return md;
+}
+
+// computes the hashes on first use, as a tx with only legacy inputs doesn't need them
+static const BRBitcoinSigHashCache *_btcSigHashCacheGet(BRBitcoinSigHashCache *cache, int *cached,
+                                                        const BRBitcoinTransaction *tx)
+{
+    if (! *cached) {
+        cache->prevoutsHash = _btcTransactionPrevoutsHash(tx);
+        cache->sequenceHash = _btcTransactionSequenceHash(tx);
+        cache->outputsHash = _btcTransactionOutputsHash(tx, SIZE_MAX);
+        *cached = 1;
+    }
+
+    return cache;
+}
+
 // writes the BIP143 witness program data that needs to be hashed and signed for the tx input at index
 // https://github.com/bitcoin/bips/blob/master/bip-0143.mediawiki
+// cache, if not NULL, holds the tx hashes to use for a SIGHASH_ALL hashType
 // returns number of bytes written, or total len needed if data is NULL
 static size_t _btcTransactionWitnessData(const BRBitcoinTransaction *tx, uint8_t *data, size_t dataLen, size_t index,
-                                        int hashType)
+                                        int hashType, const BRBitcoinSigHashCache *cache)
 {
     BRBitcoinTxInput input;
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f);
-    size_t i, off = 0;
+    size_t off = 0;
     uint8_t scriptCode[] = { OP_DUP, OP_HASH160, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                              0, 0, 0, 0, 0, 0, 0, 0, 0, OP_EQUALVERIFY, OP_CHECKSIG };
 
     if (index >= tx->inCount) return 0;
+    if (anyoneCanPay || sigHash != SIGHASH_ALL) cache = NULL;
     if (data && off + sizeof(uint32_t) <= dataLen) UInt32SetLE(&data[off], tx->version); // tx version
     off += sizeof(uint32_t);
     
     if (! anyoneCanPay) {
-        uint8_t buf[(sizeof(UInt256) + sizeof(uint32_t))*tx->inCount];
-        
-        for (i = 0; i < tx->inCount; i++) {
-            UInt256Set(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i], tx->inputs[i].txHash);
-            UInt32SetLE(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i + sizeof(UInt256)], tx->inputs[i].index);
+        if (data && off + sizeof(UInt256) <= dataLen) { // inputs hash
+            UInt256Set(&data[off], (cache) ? cache->prevoutsHash : _btcTransactionPrevoutsHash(tx));
         }
-        
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // inputs hash
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // anyone-can-pay
     
     off += sizeof(UInt256);
     
     if (! anyoneCanPay && sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
-        uint8_t buf[sizeof(uint32_t)*tx->inCount];
-        
-        for (i = 0; i < tx->inCount; i++) UInt32SetLE(&buf[sizeof(uint32_t)*i], tx->inputs[i].sequence);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // sequence hash
+        if (data && off + sizeof(UInt256) <= dataLen) { // sequence hash
+            UInt256Set(&data[off], (cache) ? cache->sequenceHash : _btcTransactionSequenceHash(tx));
+        }
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO);
     
@@ -236,18 +302,14 @@ static size_t _btcTransactionWitnessData(const BRBitcoinTransaction *tx, uint8_t
     off += _btcTxInputData(&input, (data ? &data[off] : NULL), (off <= dataLen ? dataLen - off : 0));
     
     if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
-        size_t bufLen = _btcTransactionOutputData(tx, NULL, 0, SIZE_MAX);
-        uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
-        
-        bufLen = _btcTransactionOutputData(tx, buf, bufLen, SIZE_MAX);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); // SIGHASH_ALL outputs hash
-        if (buf != _buf) free(buf);
+        if (data && off + sizeof(UInt256) <= dataLen) { // SIGHASH_ALL outputs hash
+            UInt256Set(&data[off], (cache) ? cache->outputsHash : _btcTransactionOutputsHash(tx, SIZE_MAX));
+        }
     }
     else if (sigHash == SIGHASH_SINGLE && index < tx->outCount) {
-        uint8_t buf[_btcTransactionOutputData(tx, NULL, 0, index)];
-        size_t bufLen = _btcTransactionOutputData(tx, buf, sizeof(buf), index);
-        
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); //SIGHASH_SINGLE outputs hash
+        if (data && off + sizeof(UInt256) <= dataLen) { // SIGHASH_SINGLE outputs hash
+            UInt256Set(&data[off], _btcTransactionOutputsHash(tx, index));
+        }
     }
     else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // SIGHASH_NONE
     
@@ -261,14 +323,16 @@ static size_t _btcTransactionWitnessData(const BRBitcoinTransaction *tx, uint8_t
 
 // writes the data that needs to be hashed and signed for the tx input at index
 // an index of SIZE_MAX will write the entire signed transaction
+// cache, if not NULL, holds the BIP143 tx hashes to use for a SIGHASH_FORKID hashType
 // returns number of bytes written, or total dataLen needed if data is NULL
-static size_t _btcTransactionData(const BRBitcoinTransaction *tx, uint8_t *data, size_t dataLen, size_t index, int hashType)
+static size_t _btcTransactionData(const BRBitcoinTransaction *tx, uint8_t *data, size_t dataLen, size_t index, int hashType,
+                                  const BRBitcoinSigHashCache *cache)
 {
     BRBitcoinTxInput input;
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f), witnessFlag = 0;
     size_t i, count, len, woff, off = 0;
     
-    if (hashType & SIGHASH_FORKID) return _btcTransactionWitnessData(tx, data, dataLen, index, hashType);
+    if (hashType & SIGHASH_FORKID) return _btcTransactionWitnessData(tx, data, dataLen, index, hashType, cache);
     if (anyoneCanPay && index >= tx->inCount) return 0;
     
     for (i = 0; index == SIZE_MAX && ! witnessFlag && i < tx->inCount; i++) {
@@ -501,7 +565,7 @@ BRBitcoinTransaction *btcTransactionParse(const uint8_t *buf, size_t bufLen)
 size_t btcTransactionSerialize(const BRBitcoinTransaction *tx, uint8_t *buf, size_t bufLen)
 {
     assert(tx != NULL);
-    return (tx) ? _btcTransactionData(tx, buf, bufLen, SIZE_MAX, SIGHASH_ALL) : 0;
+    return (tx) ? _btcTransactionData(tx, buf, bufLen, SIZE_MAX, SIGHASH_ALL, NULL) : 0;
 }
 
 // adds an input to tx
@@ -638,13 +702,93 @@ int btcTransactionIsSigned(const BRBitcoinTransaction *tx)
     return (tx) ? 1 : 0;
 }
 
+// index of the key whose hash matches the pubkey hash in the script of input, or keysCount if there is none
+static size_t _btcTxInputKeyIndex(const BRBitcoinTxInput *input, const UInt160 pkh[], size_t keysCount)
+{
+    const uint8_t *hash = BRScriptPKH(input->script, input->scriptLen);
+    size_t j = 0;
+
+    while (j < keysCount && (! hash || ! UInt160Eq(pkh[j], UInt160Get(hash)))) j++;
+    return j;
+}
+
+// signs the tx input at index with key, writing the signature script to script, or to the witness if *isWitness is set
+// on return, and returns the script length
+// key must already have its pubKey, so that no shared state is written and inputs can be signed on separate threads
+static size_t _btcTransactionSignInput(const BRBitcoinTransaction *tx, size_t index, int forkId, BRKey *key,
+                                       BRBitcoinSigHashCache *cache, int *cached,
+                                       uint8_t script[BTC_TX_INPUT_SIGNATURE_SIZE], int *isWitness)
+{
+    const BRBitcoinTxInput *input = &tx->inputs[index];
+    const uint8_t *elems[BRScriptElements(NULL, 0, input->script, input->scriptLen)];
+    size_t elemsCount = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), input->script, input->scriptLen);
+    uint8_t pubKey[BRKeyPubKey(key, NULL, 0)];
+    size_t pkLen = BRKeyPubKey(key, pubKey, sizeof(pubKey));
+    uint8_t sig[73];
+    size_t sigLen, scriptLen;
+    UInt256 md = UINT256_ZERO;
+
+    *isWitness = 0;
+
+    if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) { // pay-to-witness-pubkey-hash
+        uint8_t data[_btcTransactionWitnessData(tx, NULL, 0, index, forkId | SIGHASH_ALL, NULL)];
+        size_t dataLen = _btcTransactionWitnessData(tx, data, sizeof(data), index, forkId | SIGHASH_ALL,
+                                                    _btcSigHashCacheGet(cache, cached, tx));
+
+        BRSHA256_2(&md, data, dataLen);
+        *isWitness = 1;
+    }
+    else { // pay-to-pubkey-hash, or pay-to-pubkey
+        uint8_t data[_btcTransactionData(tx, NULL, 0, index, forkId | SIGHASH_ALL, NULL)];
+        size_t dataLen = _btcTransactionData(tx, data, sizeof(data), index, forkId | SIGHASH_ALL,
+                                             (forkId) ? _btcSigHashCacheGet(cache, cached, tx) : NULL);
+
+        BRSHA256_2(&md, data, dataLen);
+    }
+
+    sigLen = BRKeySign(key, sig, sizeof(sig) - 1, md);
+    sig[sigLen++] = forkId | SIGHASH_ALL;
+    scriptLen = BRScriptPushData(script, BTC_TX_INPUT_SIGNATURE_SIZE, sig, sigLen);
+
+    if (*isWitness || (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY)) { // not pay-to-pubkey
+        scriptLen += BRScriptPushData(&script[scriptLen], BTC_TX_INPUT_SIGNATURE_SIZE - scriptLen, pubKey, pkLen);
+    }
+
+    return scriptLen;
+}
+
+static void _btcTxInputSetSignatureScript(BRBitcoinTxInput *input, const uint8_t *script, size_t scriptLen,
+                                          int isWitness)
+{
+    btcTxInputSetSignature(input, script, (isWitness) ? 0 : scriptLen);
+    btcTxInputSetWitness(input, script, (isWitness) ? scriptLen : 0);
+}
+
+// updates the hashes of tx once all its inputs are signed, and returns true if they are
+static int _btcTransactionSignFinish(BRBitcoinTransaction *tx)
+{
+    if (tx && btcTransactionIsSigned(tx)) {
+        uint8_t data[btcTransactionSerialize(tx, NULL, 0)];
+        size_t len = btcTransactionSerialize(tx, data, sizeof(data));
+        BRBitcoinTransaction *t = btcTransactionParse(data, len);
+        
+        if (t) tx->txHash = t->txHash, tx->wtxHash = t->wtxHash;
+        if (t) btcTransactionFree(t);
+        return 1;
+    }
+    else return 0;
+}
+
 // adds signatures to any inputs with NULL signatures that can be signed with any keys
 // forkId is 0 for bitcoin, 0x40 for b-cash, 0x4f for b-gold
 // returns true if tx is signed
 int btcTransactionSign(BRBitcoinTransaction *tx, int forkId, BRKey keys[], size_t keysCount)
 {
     UInt160 pkh[keysCount];
-    size_t i, j;
+    BRBitcoinSigHashCache cache;
+    int cached = 0, isWitness;
+    uint8_t script[BTC_TX_INPUT_SIGNATURE_SIZE];
+    size_t i, j, scriptLen;
     
     assert(tx != NULL);
     assert(keys != NULL || keysCount == 0);
@@ -654,68 +798,115 @@ int btcTransactionSign(BRBitcoinTransaction *tx, int forkId, BRKey keys[], size_
     }
     
     for (i = 0; tx && i < tx->inCount; i++) {
-        BRBitcoinTxInput *input = &tx->inputs[i];
-        const uint8_t *hash = BRScriptPKH(input->script, input->scriptLen);
-        
-        j = 0;
-        while (j < keysCount && (! hash || ! UInt160Eq(pkh[j], UInt160Get(hash)))) j++;
+        j = _btcTxInputKeyIndex(&tx->inputs[i], pkh, keysCount);
         if (j >= keysCount) continue;
-        
-        const uint8_t *elems[BRScriptElements(NULL, 0, input->script, input->scriptLen)];
-        size_t elemsCount = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), input->script, input->scriptLen);
-        uint8_t pubKey[BRKeyPubKey(&keys[j], NULL, 0)];
-        size_t pkLen = BRKeyPubKey(&keys[j], pubKey, sizeof(pubKey));
-        uint8_t sig[73], script[1 + sizeof(sig) + 1 + sizeof(pubKey)];
-        size_t sigLen, scriptLen;
-        UInt256 md = UINT256_ZERO;
-        
-        if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) { // pay-to-witness-pubkey-hash
-            uint8_t data[_btcTransactionWitnessData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _btcTransactionWitnessData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-            
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
-            scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
-            btcTxInputSetSignature(input, script, 0);
-            btcTxInputSetWitness(input, script, scriptLen);
-        }
-        else if (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY) { // pay-to-pubkey-hash
-            uint8_t data[_btcTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _btcTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-            
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
-            scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
-            btcTxInputSetSignature(input, script, scriptLen);
-            btcTxInputSetWitness(input, script, 0);
-        }
-        else { // pay-to-pubkey
-            uint8_t data[_btcTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _btcTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
-            btcTxInputSetSignature(input, script, scriptLen);
-            btcTxInputSetWitness(input, script, 0);
-        }
+        scriptLen = _btcTransactionSignInput(tx, i, forkId, &keys[j], &cache, &cached, script, &isWitness);
+        _btcTxInputSetSignatureScript(&tx->inputs[i], script, scriptLen, isWitness);
     }
     
-    if (tx && btcTransactionIsSigned(tx)) {
-        uint8_t data[btcTransactionSerialize(tx, NULL, 0)];
-        size_t len = btcTransactionSerialize(tx, data, sizeof(data));
-        BRBitcoinTransaction *t = btcTransactionParse(data, len);
-        
-        if (t) tx->txHash = t->txHash, tx->wtxHash = t->wtxHash;
-        if (t) btcTransactionFree(t);
-        return 1;
+    return _btcTransactionSignFinish(tx);
+}
+
+typedef struct {
+    const BRBitcoinTransaction *tx;
+    int forkId;
+    BRKey *keys;
+    const size_t *keyIndexes; // per input, keysCount if the input isn't signed
+    size_t keysCount;
+    BRBitcoinSigHashCache *cache;
+    size_t begin, end; // inputs signed by this worker
+    uint8_t (*scripts)[BTC_TX_INPUT_SIGNATURE_SIZE];
+    size_t *scriptLens;
+    int *isWitness;
+} BRBitcoinTxSignWork;
+
+static void *_btcTransactionSignWorker(void *info)
+{
+    BRBitcoinTxSignWork *work = info;
+    int cached = 1; // filled in before any worker starts, so workers only read it
+
+    for (size_t i = work->begin; i < work->end; i++) {
+        if (work->keyIndexes[i] >= work->keysCount) continue;
+        work->scriptLens[i] = _btcTransactionSignInput(work->tx, i, work->forkId, &work->keys[work->keyIndexes[i]],
+                                                       work->cache, &cached, work->scripts[i], &work->isWitness[i]);
     }
-    else return 0;
+
+    return NULL;
+}
+
+// same as btcTransactionSign(), with the same signatures, but computing them on up to threadCount threads (including
+// the calling thread); a threadCount of 0 uses one thread per online processor
+// worthwhile for transactions with many inputs, such as sweeps and UTXO consolidations
+int btcTransactionSignParallel(BRBitcoinTransaction *tx, int forkId, BRKey keys[], size_t keysCount,
+                               size_t threadCount)
+{
+    UInt160 pkh[keysCount];
+    BRBitcoinSigHashCache cache;
+    int cached = 0;
+    size_t i, started = 0;
+    
+    assert(tx != NULL);
+    assert(keys != NULL || keysCount == 0);
+
+    if (threadCount == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = (cpus > 0) ? (size_t)cpus : 1;
+    }
+
+    if (threadCount > BTC_TX_SIGN_MAX_THREADS) threadCount = BTC_TX_SIGN_MAX_THREADS;
+    if (tx && threadCount > tx->inCount/BTC_TX_SIGN_MIN_THREAD_INPUTS) {
+        threadCount = tx->inCount/BTC_TX_SIGN_MIN_THREAD_INPUTS;
+    }
+
+    if (! tx || threadCount <= 1) return btcTransactionSign(tx, forkId, keys, keysCount);
+
+    // everything the workers share is computed up front: key hashes (which also caches each key's pubKey), the key for
+    // each input and the sighash cache
+    for (i = 0; i < keysCount; i++) pkh[i] = BRKeyHash160(&keys[i]);
+    _btcSigHashCacheGet(&cache, &cached, tx);
+
+    size_t *keyIndexes = calloc(tx->inCount, sizeof(*keyIndexes)), *scriptLens = calloc(tx->inCount, sizeof(size_t));
+    uint8_t (*scripts)[BTC_TX_INPUT_SIGNATURE_SIZE] = calloc(tx->inCount, sizeof(*scripts));
+    int *isWitness = calloc(tx->inCount, sizeof(*isWitness));
+    BRBitcoinTxSignWork work[threadCount];
+    pthread_t threads[threadCount];
+    pthread_attr_t attr;
+
+    assert(keyIndexes != NULL && scriptLens != NULL && scripts != NULL && isWitness != NULL);
+    for (i = 0; i < tx->inCount; i++) keyIndexes[i] = _btcTxInputKeyIndex(&tx->inputs[i], pkh, keysCount);
+
+    for (i = 0; i < threadCount; i++) {
+        work[i] = (BRBitcoinTxSignWork) { tx, forkId, keys, keyIndexes, keysCount, &cache,
+                                          tx->inCount*i/threadCount, tx->inCount*(i + 1)/threadCount,
+                                          scripts, scriptLens, isWitness };
+    }
+
+    if (pthread_attr_init(&attr) == 0) {
+        if (pthread_attr_setstacksize(&attr, BTC_TX_SIGN_STACK_SIZE) == 0) {
+            while (started + 1 < threadCount && // the calling thread signs the first shard
+                   pthread_create(&threads[started], &attr, _btcTransactionSignWorker, &work[started + 1]) == 0) {
+                started++;
+            }
+        }
+
+        pthread_attr_destroy(&attr);
+    }
+
+    _btcTransactionSignWorker(&work[0]);
+    for (i = started + 1; i < threadCount; i++) _btcTransactionSignWorker(&work[i]); // shards without a thread
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    for (i = 0; i < tx->inCount; i++) {
+        if (keyIndexes[i] >= keysCount) continue;
+        _btcTxInputSetSignatureScript(&tx->inputs[i], scripts[i], scriptLens[i], isWitness[i]);
+    }
+
+    mem_clean(scripts, tx->inCount*sizeof(*scripts));
+    free(isWitness);
+    free(scripts);
+    free(scriptLens);
+    free(keyIndexes);
+    return _btcTransactionSignFinish(tx);
 }
 
 // true if tx meets IsStandard() rules: https://bitcoin.org/en/developer-guide#standard-transactions
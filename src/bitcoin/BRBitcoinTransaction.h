@@ -135,6 +135,12 @@ int btcTransactionIsSigned(const BRBitcoinTransaction *tx);
 // returns true if tx is signed
 int btcTransactionSign(BRBitcoinTransaction *tx, int forkId, BRKey keys[], size_t keysCount);
 
+// same as btcTransactionSign(), with identical signatures, but signing inputs on up to threadCount threads (including
+// the calling thread); use threadCount 0 for one thread per online processor
+// for transactions with many inputs, such as sweeps and UTXO consolidations; small transactions are signed in place
+int btcTransactionSignParallel(BRBitcoinTransaction *tx, int forkId, BRKey keys[], size_t keysCount,
+                               size_t threadCount);
+
 // true if tx meets IsStandard() rules: https://bitcoin.org/en/developer-guide#standard-transactions
 int btcTransactionIsStandard(const BRBitcoinTransaction *tx);
 
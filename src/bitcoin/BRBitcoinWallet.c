@@ -34,6 +34,8 @@
 #include <pthread.h>
 #include <assert.h>
 
+#define CHAIN_MATCH_SAMPLE_COUNT 6 // chain pubKey hashes checked against mpk when seeding a wallet with saved chains
+
 inline static size_t _pkhHash(const void *pkh)
 {
     return (size_t)UInt32GetLE(pkh);
@@ -70,12 +72,12 @@ inline static size_t _txChainIndex(const BRBitcoinTransaction *tx, const UInt160
 struct BRBitcoinWalletStruct {
     uint64_t balance, totalSent, totalReceived, feePerKb, *balanceHist;
     uint32_t blockHeight;
-    BRBitcoinUTXO *utxos;
+    BRBitcoinUTXO *utxos, *newlySpent;
     BRBitcoinTransaction **transactions;
     BRMasterPubKey masterPubKey;
     BRAddressParams addrParams;
     UInt160 *internalChain, *externalChain;
-    BRSet *allTx, *invalidTx, *pendingTx, *spentOutputs, *usedPKH, *allPKH;
+    BRSet *allTx, *invalidTx, *pendingTx, *spentOutputs, *unspentOutputs, *usedPKH, *allPKH;
     void *callbackInfo;
     void (*balanceChanged)(void *info, uint64_t balance);
     void (*txAdded)(void *info, BRBitcoinTransaction *tx);
@@ -119,19 +121,56 @@ inline static int _btcWalletTxCompare(BRBitcoinWallet *wallet, const BRBitcoinTr
     return 0;
 }
 
-// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first (insertion sort)
-inline static void _btcWalletInsertTx(BRBitcoinWallet *wallet, BRBitcoinTransaction *tx)
+// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first, returns tx's index
+// wallet->transactions is always ordered by blockHeight, so a binary search finds the transactions at the same height as
+// tx, and only those need an insertion sort to put parents before children (a tx can't spend one from a later block)
+inline static size_t _btcWalletInsertTx(BRBitcoinWallet *wallet, BRBitcoinTransaction *tx)
 {
-    size_t i = array_count(wallet->transactions);
-    
-    array_set_count(wallet->transactions, i + 1);
-    
-    while (i > 0 && _btcWalletTxCompare(wallet, wallet->transactions[i - 1], tx) > 0) {
-        wallet->transactions[i] = wallet->transactions[i - 1];
-        i--;
+    size_t lo = 0, hi = array_count(wallet->transactions), mid, i, j;
+
+    while (lo < hi) { // find the end of the run of transactions with blockHeight <= tx->blockHeight
+        mid = lo + (hi - lo)/2;
+        if (wallet->transactions[mid]->blockHeight > tx->blockHeight) hi = mid;
+        else lo = mid + 1;
     }
-    
-    wallet->transactions[i] = tx;
+
+    for (i = lo; i > 0 && wallet->transactions[i - 1]->blockHeight == tx->blockHeight; i--) {
+        if (_btcWalletTxCompare(wallet, wallet->transactions[i - 1], tx) <= 0) break;
+    }
+
+    // a child that arrived before tx may sit behind unrelated transactions, so tx must also precede the earliest one
+    for (j = i; j > 0 && wallet->transactions[j - 1]->blockHeight == tx->blockHeight; j--) {
+        if (_btcWalletTxIsAscending(wallet, wallet->transactions[j - 1], tx)) i = j - 1;
+    }
+
+    array_insert(wallet->transactions, i, tx);
+    return i;
+}
+
+typedef struct {
+    BRBitcoinTransaction *tx;
+    size_t index;
+} BRBitcoinWalletTxRef;
+
+inline static int _btcWalletTxRefCompare(const void *ref1, const void *ref2)
+{
+    const BRBitcoinWalletTxRef *r1 = ref1, *r2 = ref2;
+
+    if (r1->tx->blockHeight != r2->tx->blockHeight) return (r1->tx->blockHeight < r2->tx->blockHeight) ? -1 : 1;
+    return (r1->index < r2->index) ? -1 : (r1->index > r2->index) ? 1 : 0; // keep the given order within a block
+}
+
+// inserts transactions into wallet->transactions, sorted by blockHeight first so each insert lands at the end of
+// wallet->transactions and only has to order tx among the transactions from its own block
+static void _btcWalletInsertTxs(BRBitcoinWallet *wallet, BRBitcoinTransaction *transactions[], size_t txCount)
+{
+    BRBitcoinWalletTxRef *refs = (txCount > 0) ? calloc(txCount, sizeof(*refs)) : NULL;
+
+    assert(refs != NULL || txCount == 0);
+    for (size_t i = 0; i < txCount; i++) refs[i] = (BRBitcoinWalletTxRef) { transactions[i], i };
+    if (txCount > 0) qsort(refs, txCount, sizeof(*refs), _btcWalletTxRefCompare);
+    for (size_t i = 0; i < txCount; i++) _btcWalletInsertTx(wallet, refs[i].tx);
+    if (refs) free(refs);
 }
 
 // non-threadsafe version of btcWalletContainsTransaction()
@@ -164,141 +203,262 @@ static int _btcWalletContainsTx(BRBitcoinWallet *wallet, const BRBitcoinTransact
     return r;
 }
 
-static void _btcWalletUpdateBalance(BRBitcoinWallet *wallet)
+// true if the reasons any pending tx is pending may lapse with time or new blocks (a lockTime not yet reached)
+static int _btcWalletPendingMayLapse(BRBitcoinWallet *wallet)
+{
+    BRBitcoinTransaction *tx = NULL;
+
+    while ((tx = BRSetIterate(wallet->pendingTx, tx)) != NULL) {
+        for (size_t j = 0; j < tx->inCount; j++) {
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > 0) return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void _setApplyFreeUTXO(void *info, void *utxo)
+{
+    free(utxo);
+}
+
+// removes wallet->utxos entries that are no longer in wallet->unspentOutputs, keeping wallet->utxos in order
+static void _btcWalletCompactUTXOs(BRBitcoinWallet *wallet)
 {
-    int isInvalid, isPending;
-    uint64_t balance = 0, prevBalance = 0;
-    time_t now = time(NULL);
     size_t i, j;
-    BRBitcoinTransaction *tx, *t;
+
+    if (array_count(wallet->utxos) == BRSetCount(wallet->unspentOutputs)) return;
+
+    for (i = 0, j = 0; i < array_count(wallet->utxos); i++) {
+        if (BRSetContains(wallet->unspentOutputs, &wallet->utxos[i])) wallet->utxos[j++] = wallet->utxos[i];
+    }
+
+    array_set_count(wallet->utxos, j);
+}
+
+// applies the effects of tx, which must be the last of wallet->transactions applied so far, to the balance, UTXOs,
+// spent outputs, invalid and pending tx; call _btcWalletCompactUTXOs() once all tx are applied
+static void _btcWalletApplyTx(BRBitcoinWallet *wallet, BRBitcoinTransaction *tx, time_t now)
+{
+    int isInvalid, isPending;
+    uint64_t balance = wallet->balance, prevBalance = wallet->balance;
+    size_t j, utxosCount;
+    BRBitcoinTransaction *t;
+    BRBitcoinUTXO *o;
     const uint8_t *pkh;
-    
+
+    // check if any inputs are invalid or already spent
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
+            if (BRSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
+                BRSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
+        }
+
+        if (isInvalid) {
+            BRSetAdd(wallet->invalidTx, tx);
+            array_add(wallet->balanceHist, balance);
+            return;
+        }
+    }
+
+    // add inputs to spent output set, and to those yet to be removed from the UTXO set
+    for (j = 0; j < tx->inCount; j++) {
+        BRSetAdd(wallet->spentOutputs, &tx->inputs[j]);
+        array_add(wallet->newlySpent, ((const BRBitcoinUTXO) { tx->inputs[j].txHash, tx->inputs[j].index }));
+    }
+
+    // check if tx is pending
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        isPending = (btcTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
+
+        for (j = 0; ! isPending && j < tx->outCount; j++) {
+            if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
+        }
+
+        for (j = 0; ! isPending && j < tx->inCount; j++) {
+            if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
+                tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
+            if (BRSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
+            // TODO: XXX handle BIP68 check lock time verify rules
+        }
+
+        if (isPending) {
+            BRSetAdd(wallet->pendingTx, tx);
+            array_add(wallet->balanceHist, balance);
+            return;
+        }
+    }
+
+    // add outputs to UTXO set
+    // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
+    // TODO: don't add coin generation outputs < 100 blocks deep
+    // NOTE: balance/UTXOs will then need to be recalculated when last block changes
+    utxosCount = array_count(wallet->utxos);
+
+    for (j = 0; j < tx->outCount; j++) {
+        pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+
+        if (pkh && BRSetContains(wallet->allPKH, pkh)) {
+            BRSetAdd(wallet->usedPKH, (void *)pkh);
+            array_add(wallet->utxos, ((const BRBitcoinUTXO) { tx->txHash, (uint32_t)j }));
+            o = malloc(sizeof(*o));
+            assert(o != NULL);
+            *o = wallet->utxos[array_count(wallet->utxos) - 1];
+            BRSetAdd(wallet->unspentOutputs, o);
+            balance += tx->outputs[j].amount;
+        }
+    }
+
+    // transaction ordering is not guaranteed, so the new outputs may already be in the spent output set; otherwise,
+    // as no UTXO was in the spent output set before, only the newly spent outputs need be removed from the UTXO set
+    for (j = utxosCount; j < array_count(wallet->utxos); j++) {
+        if (! BRSetContains(wallet->spentOutputs, &wallet->utxos[j])) continue;
+        o = BRSetRemove(wallet->unspentOutputs, &wallet->utxos[j]);
+        balance -= tx->outputs[o->n].amount;
+        free(o);
+    }
+
+    for (j = 0; j < array_count(wallet->newlySpent); j++) {
+        o = BRSetRemove(wallet->unspentOutputs, &wallet->newlySpent[j]);
+        if (! o) continue;
+        t = BRSetGet(wallet->allTx, &o->hash);
+        balance -= t->outputs[o->n].amount;
+        free(o);
+    }
+
+    array_clear(wallet->newlySpent);
+
+    if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
+    if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
+    array_add(wallet->balanceHist, balance);
+    wallet->balance = balance;
+}
+
+// rebuilds the balance, UTXOs, spent outputs, invalid and pending tx by applying every tx in wallet->transactions
+static void _btcWalletUpdateBalance(BRBitcoinWallet *wallet)
+{
+    time_t now = time(NULL);
+
     array_clear(wallet->utxos);
     array_clear(wallet->balanceHist);
+    array_clear(wallet->newlySpent);
+    BRSetApply(wallet->unspentOutputs, NULL, _setApplyFreeUTXO);
+    BRSetClear(wallet->unspentOutputs);
     BRSetClear(wallet->spentOutputs);
     BRSetClear(wallet->invalidTx);
     BRSetClear(wallet->pendingTx);
     BRSetClear(wallet->usedPKH);
+    wallet->balance = 0;
     wallet->totalSent = 0;
     wallet->totalReceived = 0;
 
-    for (i = 0; i < array_count(wallet->transactions); i++) {
-        tx = wallet->transactions[i];
+    for (size_t i = 0; i < array_count(wallet->transactions); i++) {
+        _btcWalletApplyTx(wallet, wallet->transactions[i], now);
+    }
 
-        // check if any inputs are invalid or already spent
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
-                if (BRSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
-                    BRSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
-            }
-        
-            if (isInvalid) {
-                BRSetAdd(wallet->invalidTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
-            }
-        }
+    _btcWalletCompactUTXOs(wallet);
+    assert(array_count(wallet->balanceHist) == array_count(wallet->transactions));
+}
 
-        // add inputs to spent output set
-        for (j = 0; j < tx->inCount; j++) {
-            BRSetAdd(wallet->spentOutputs, &tx->inputs[j]);
-        }
+// updates the balance, UTXOs, etc. for tx, newly inserted into wallet->transactions; applies just tx if it was
+// inserted last, and if no earlier pending tx might have lapsed, and otherwise rebuilds everything
+static void _btcWalletUpdateBalanceForTx(BRBitcoinWallet *wallet, BRBitcoinTransaction *tx)
+{
+    size_t txCount = array_count(wallet->transactions);
 
-        // check if tx is pending
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            isPending = (btcTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
-            
-            for (j = 0; ! isPending && j < tx->outCount; j++) {
-                if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
-            }
+    if (txCount > 0 && wallet->transactions[txCount - 1] == tx &&
+        array_count(wallet->balanceHist) == txCount - 1 && ! _btcWalletPendingMayLapse(wallet)) {
+        _btcWalletApplyTx(wallet, tx, time(NULL));
+        _btcWalletCompactUTXOs(wallet);
+    }
+    else _btcWalletUpdateBalance(wallet);
+}
 
-            for (j = 0; ! isPending && j < tx->inCount; j++) {
-                if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
-                    tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
-                if (BRSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
-                // TODO: XXX handle BIP68 check lock time verify rules
-            }
-            
-            if (isPending) {
-                BRSetAdd(wallet->pendingTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
-            }
-        }
+// true if pkhs, a chain previously generated for mpk, still matches mpk at its last index
+// true if the pubKey hashes at the first and last indexes of the chain, and at a few random ones in between, match mpk
+static int _btcWalletChainMatches(BRMasterPubKey mpk, uint32_t internal, const UInt160 pkhs[], size_t pkhsCount)
+{
+    uint8_t pubKey[33];
+    UInt160 pkh;
+    uint32_t n;
 
-        // add outputs to UTXO set
-        // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
-        // TODO: don't add coin generation outputs < 100 blocks deep
-        // NOTE: balance/UTXOs will then need to be recalculated when last block changes
-        for (j = 0; j < tx->outCount; j++) {
-            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+    if (pkhsCount == 0 || pkhsCount > BIP32_HARD) return 0;
 
-            if (pkh && BRSetContains(wallet->allPKH, pkh)) {
-                BRSetAdd(wallet->usedPKH, (void *)pkh);
-                array_add(wallet->utxos, ((const BRBitcoinUTXO) { tx->txHash, (uint32_t)j }));
-                balance += tx->outputs[j].amount;
-            }
-        }
-
-        // transaction ordering is not guaranteed, so check the entire UTXO set against the entire spent output set
-        for (j = array_count(wallet->utxos); j > 0; j--) {
-            if (! BRSetContains(wallet->spentOutputs, &wallet->utxos[j - 1])) continue;
-            t = BRSetGet(wallet->allTx, &wallet->utxos[j - 1].hash);
-            balance -= t->outputs[wallet->utxos[j - 1].n].amount;
-            array_rm(wallet->utxos, j - 1);
-        }
-        
-        if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
-        if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
-        array_add(wallet->balanceHist, balance);
-        prevBalance = balance;
+    for (size_t i = 0; i < CHAIN_MATCH_SAMPLE_COUNT; i++) {
+        n = (i == 0) ? 0 : (i == 1) ? (uint32_t)(pkhsCount - 1) : BRRand((uint32_t)pkhsCount);
+        if (BRBIP32PubKey(pubKey, mpk, internal, n) != sizeof(pubKey)) return 0;
+        BRHash160(&pkh, pubKey, sizeof(pubKey));
+        if (! UInt160Eq(pkh, pkhs[n])) return 0;
     }
 
-    assert(array_count(wallet->balanceHist) == array_count(wallet->transactions));
-    wallet->balance = balance;
+    return 1;
 }
 
 // allocates and populates a BRBitcoinWallet struct which must be freed by calling btcWalletFree()
 BRBitcoinWallet *btcWalletNew(BRAddressParams addrParams, BRBitcoinTransaction *transactions[], size_t txCount,
                               BRMasterPubKey mpk)
+{
+    return btcWalletNewWithChains(addrParams, transactions, txCount, mpk, NULL, 0, NULL, 0);
+}
+
+// like btcWalletNew(), but seeds the internal and external chains with pubKey hashes previously generated for mpk, as
+// returned by btcWalletChainPKHs(), so that only addresses past the end of each chain need to be derived
+// a chain whose first, last, or a few randomly sampled pubKey hashes don't match mpk is ignored and derived in full
+BRBitcoinWallet *btcWalletNewWithChains(BRAddressParams addrParams, BRBitcoinTransaction *transactions[],
+                                        size_t txCount, BRMasterPubKey mpk,
+                                        const UInt160 internalChain[], size_t internalCount,
+                                        const UInt160 externalChain[], size_t externalCount)
 {
     BRBitcoinWallet *wallet = NULL;
-    BRBitcoinTransaction *tx;
+    BRBitcoinTransaction *tx, **txs = NULL;
     const uint8_t *pkh;
+    size_t i;
 
     assert(transactions != NULL || txCount == 0);
     wallet = calloc(1, sizeof(*wallet));
     assert(wallet != NULL);
     array_new(wallet->utxos, 100);
+    array_new(wallet->newlySpent, 100);
     array_new(wallet->transactions, txCount + 100);
     wallet->feePerKb = DEFAULT_FEE_PER_KB;
     wallet->masterPubKey = mpk;
     wallet->addrParams = addrParams;
-    array_new(wallet->internalChain, 100);
-    array_new(wallet->externalChain, 100);
+    if (! _btcWalletChainMatches(mpk, SEQUENCE_INTERNAL_CHAIN, internalChain, internalCount)) internalCount = 0;
+    if (! _btcWalletChainMatches(mpk, SEQUENCE_EXTERNAL_CHAIN, externalChain, externalCount)) externalCount = 0;
+    array_new(wallet->internalChain, internalCount + 100);
+    array_new(wallet->externalChain, externalCount + 100);
+    if (internalCount > 0) array_add_array(wallet->internalChain, internalChain, internalCount);
+    if (externalCount > 0) array_add_array(wallet->externalChain, externalChain, externalCount);
     array_new(wallet->balanceHist, txCount + 100);
     wallet->allTx = BRSetNew(btcTransactionHash, btcTransactionEq, txCount + 100);
     wallet->invalidTx = BRSetNew(btcTransactionHash, btcTransactionEq, 10);
     wallet->pendingTx = BRSetNew(btcTransactionHash, btcTransactionEq, 10);
     wallet->spentOutputs = BRSetNew(btcUTXOHash, btcUTXOEq, txCount + 100);
+    wallet->unspentOutputs = BRSetNew(btcUTXOHash, btcUTXOEq, 100);
     wallet->usedPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
-    wallet->allPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
+    wallet->allPKH = BRSetNew(_pkhHash, _pkhEq, internalCount + externalCount + txCount + 100);
     pthread_mutex_init(&wallet->lock, NULL);
+    for (i = 0; i < internalCount; i++) BRSetAdd(wallet->allPKH, &wallet->internalChain[i]);
+    for (i = 0; i < externalCount; i++) BRSetAdd(wallet->allPKH, &wallet->externalChain[i]);
+    array_new(txs, txCount);
 
-    for (size_t i = 0; transactions && i < txCount; i++) {
+    for (i = 0; transactions && i < txCount; i++) {
         tx = transactions[i];
         if (! btcTransactionIsSigned(tx) || BRSetContains(wallet->allTx, tx)) continue;
         BRSetAdd(wallet->allTx, tx);
-        _btcWalletInsertTx(wallet, tx);
+        array_add(txs, tx);
 
         for (size_t j = 0; j < tx->outCount; j++) {
             pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
             if (pkh) BRSetAdd(wallet->usedPKH, (void *)pkh);
         }
     }
-    
+
+    _btcWalletInsertTxs(wallet, txs, array_count(txs));
+    array_free(txs);
+
     btcWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN);
     btcWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN);
 
@@ -358,15 +518,26 @@ size_t btcWalletUnusedAddrs(BRBitcoinWallet *wallet, BRAddress addrs[], uint32_t
     // keep only the trailing contiguous block of addresses with no transactions
     while (i > 0 && ! BRSetContains(wallet->usedPKH, &chain[i - 1])) i--;
     
-    while (i + gapLimit > count) { // generate new addresses up to gapLimit
-        BRKey key;
-        uint8_t pubKey[33];
-        size_t len = BRBIP32PubKey(pubKey, wallet->masterPubKey, internal, (uint32_t)count);
+    while (i + gapLimit > count) { // generate new addresses up to gapLimit, deriving each shortfall in one batch
+        size_t n = i + gapLimit - count, k;
+        BRECPoint *pubKeys = malloc(n*sizeof(*pubKeys));
+        UInt160 pkh;
+
+        assert(pubKeys != NULL);
         
-        if (! BRKeySetPubKey(&key, pubKey, len)) break;
-        array_add(chain, BRKeyHash160(&key));
-        count++;
-        if (BRSetContains(wallet->usedPKH, &chain[array_count(chain) - 1])) i = count;
+        if (! BRBIP32PubKeyRange(pubKeys, n, wallet->masterPubKey, internal, (uint32_t)count)) {
+            free(pubKeys);
+            break; // don't add addresses for keys that failed to derive, addrs is left unwritten
+        }
+
+        for (k = 0; k < n; k++) {
+            BRHash160(&pkh, &pubKeys[k], sizeof(pubKeys[k]));
+            array_add(chain, pkh);
+            count++;
+            if (BRSetContains(wallet->usedPKH, &chain[array_count(chain) - 1])) i = count;
+        }
+
+        free(pubKeys);
     }
 
     if (addrs && i + gapLimit <= count) {
@@ -549,6 +720,24 @@ BRAddress btcWalletAddressToLegacy (BRBitcoinWallet *wallet, BRAddress *addrPtr)
     return addr;
 }
 
+// writes the pubKey hashes of the internal or external chain, in chain order, as generated by btcWalletUnusedAddrs()
+// returns the number of pubKey hashes written, or the chain length if pkhs is NULL
+size_t btcWalletChainPKHs(BRBitcoinWallet *wallet, UInt160 pkhs[], size_t pkhsCount, uint32_t internal)
+{
+    const UInt160 *chain = NULL;
+    size_t count;
+
+    assert(wallet != NULL);
+    pthread_mutex_lock(&wallet->lock);
+    if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
+    if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
+    assert(chain != NULL);
+    count = (! pkhs || array_count(chain) < pkhsCount) ? array_count(chain) : pkhsCount;
+    if (pkhs && count > 0) memcpy(pkhs, chain, count*sizeof(*chain));
+    pthread_mutex_unlock(&wallet->lock);
+    return count;
+}
+
 // writes all addresses previously genereated with btcWalletUnusedAddrs() to addrs
 // returns the number addresses written, or total number available if addrs is NULL
 size_t btcWalletAllAddrs(BRBitcoinWallet *wallet, BRAddress addrs[], size_t addrsCount)
@@ -652,10 +841,38 @@ BRBitcoinTransaction *btcWalletCreateTxForOutputs(BRBitcoinWallet *wallet, const
 BRBitcoinTransaction *btcWalletCreateTxForOutputsWithFeePerKb(BRBitcoinWallet *wallet, uint64_t feePerKb,
                                                               const BRBitcoinTxOutput outputs[], size_t outCount)
 {
-    BRBitcoinTransaction *tx, *transaction = btcTransactionNew();
-    uint64_t feeAmount, amount = 0, balance = 0, minAmount;
-    size_t i, cpfpSize = 0;
-    BRBitcoinUTXO *o;
+    return btcWalletCreateTxForOutputsWithCoinSelection(wallet, feePerKb, BTC_COIN_SELECTION_WALLET_ORDER,
+                                                        outputs, outCount);
+}
+
+typedef struct {
+    BRBitcoinWallet *wallet;
+    uint64_t feePerKb, amount;
+} BRBitcoinWalletFeeInfo;
+
+static uint64_t _btcWalletCoinSelectionFee(void *info, size_t vsize)
+{
+    BRBitcoinWalletFeeInfo *feeInfo = info;
+    uint64_t balance = feeInfo->wallet->balance, fee = _txFee(feeInfo->feePerKb, vsize);
+
+    // increase fee to round off remaining wallet balance to nearest 100 satoshi
+    if (balance > feeInfo->amount + fee) fee += (balance - (feeInfo->amount + fee)) % 100;
+    return fee;
+}
+
+// returns an unsigned transaction that satisifes the given transaction outputs, spending the UTXOs chosen by strategy
+// result must be freed using btcTransactionFree()
+// use feePerKb UINT64_MAX to indicate that the wallet feePerKb should be used
+BRBitcoinTransaction *btcWalletCreateTxForOutputsWithCoinSelection(BRBitcoinWallet *wallet, uint64_t feePerKb,
+                                                                   BRBitcoinCoinSelectionStrategy strategy,
+                                                                   const BRBitcoinTxOutput outputs[], size_t outCount)
+{
+    BRBitcoinTransaction *tx, *transaction = btcTransactionNew(), **inTxs = NULL;
+    BRBitcoinCoinSelectionInput *inputs = NULL;
+    BRBitcoinWalletFeeInfo feeInfo = { wallet, 0, 0 };
+    uint64_t feeAmount = 0, amount = 0, balance = 0, minAmount;
+    size_t i, inCount, *selected = NULL;
+    BRBitcoinUTXO *o, *utxos = NULL;
     BRAddress addr = BR_ADDRESS_NONE;
     
     assert(wallet != NULL);
@@ -669,8 +886,11 @@ BRBitcoinTransaction *btcWalletCreateTxForOutputsWithFeePerKb(BRBitcoinWallet *w
     
     minAmount = btcWalletMinOutputAmountWithFeePerKb(wallet, feePerKb);
     pthread_mutex_lock(&wallet->lock);
-    feePerKb = UINT64_MAX == feePerKb ? wallet->feePerKb : feePerKb;
-    feeAmount = _txFee(feePerKb, btcTransactionVSize(transaction) + TX_OUTPUT_SIZE);
+    feeInfo.feePerKb = UINT64_MAX == feePerKb ? wallet->feePerKb : feePerKb;
+    feeInfo.amount = amount;
+    array_new(utxos, array_count(wallet->utxos));
+    array_new(inTxs, array_count(wallet->utxos));
+    array_new(inputs, array_count(wallet->utxos));
     
     // TODO: use up all UTXOs for all used addresses to avoid leaving funds in addresses whose public key is revealed
     // TODO: avoid combining addresses in a single transaction when possible to reduce information leakage
@@ -680,25 +900,32 @@ BRBitcoinTransaction *btcWalletCreateTxForOutputsWithFeePerKb(BRBitcoinWallet *w
         o = &wallet->utxos[i];
         tx = BRSetGet(wallet->allTx, o);
         if (! tx || o->n >= tx->outCount) continue;
+        array_add(utxos, *o);
+        array_add(inTxs, tx);
+        array_add(inputs, btcCoinSelectionInput(tx->outputs[o->n].amount, tx->outputs[o->n].script,
+                                                tx->outputs[o->n].scriptLen));
+    }
+
+    selected = calloc(array_count(inputs) + 1, sizeof(*selected));
+    assert(selected != NULL);
+    // _txFee() never charges less than TX_FEE_PER_KB, so the selector estimates input costs at that rate at least
+    inCount = btcCoinSelect(strategy, transaction, inputs, array_count(inputs), minAmount,
+                            (feeInfo.feePerKb > TX_FEE_PER_KB) ? feeInfo.feePerKb : TX_FEE_PER_KB,
+                            &feeInfo, _btcWalletCoinSelectionFee, selected, &feeAmount);
+
+    for (i = 0; i < inCount; i++) {
+        o = &utxos[selected[i]];
+        tx = inTxs[selected[i]];
         btcTransactionAddInput(transaction, tx->txHash, o->n, tx->outputs[o->n].amount,
                               tx->outputs[o->n].script, tx->outputs[o->n].scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
         balance += tx->outputs[o->n].amount;
-        
-//        // size of unconfirmed, non-change inputs for child-pays-for-parent fee
-//        // don't include parent tx with more than 10 inputs or 10 outputs
-//        if (tx->blockHeight == TX_UNCONFIRMED && tx->inCount <= 10 && tx->outCount <= 10 &&
-//            ! _btcWalletTxIsSend(wallet, tx)) cpfpSize += btcTransactionVSize(tx);
-
-        // fee amount after adding a change output
-        feeAmount = _txFee(feePerKb, btcTransactionVSize(transaction) + TX_OUTPUT_SIZE + cpfpSize);
-
-        // increase fee to round off remaining wallet balance to nearest 100 satoshi
-        if (wallet->balance > amount + feeAmount) feeAmount += (wallet->balance - (amount + feeAmount)) % 100;
-        
-        if (balance == amount + feeAmount || balance >= amount + feeAmount + minAmount) break;
     }
     
     pthread_mutex_unlock(&wallet->lock);
+    free(selected);
+    array_free(inputs);
+    array_free(inTxs);
+    array_free(utxos);
     
     if (transaction && balance > amount + feeAmount + minAmount) { // add change output
         btcWalletUnusedAddrs(wallet, &addr, 1, 1);
@@ -709,7 +936,7 @@ BRBitcoinTransaction *btcWalletCreateTxForOutputsWithFeePerKb(BRBitcoinWallet *w
         btcTransactionShuffleOutputs(transaction);
     }
 
-    if (transaction && (outCount < 1 || balance < amount + feeAmount ||
+    if (transaction && (outCount < 1 || inCount == 0 || balance < amount + feeAmount ||
                         btcTransactionVSize(transaction) > TX_MAX_SIZE)) { // no outputs/insufficient funds/too large
         btcTransactionFree(transaction);
         transaction = NULL;
@@ -794,7 +1021,7 @@ int btcWalletRegisterTransaction(BRBitcoinWallet *wallet, BRBitcoinTransaction *
                 //       (for now, replacements appear invalid until confirmation)
                 BRSetAdd(wallet->allTx, tx);
                 _btcWalletInsertTx(wallet, tx);
-                _btcWalletUpdateBalance(wallet);
+                _btcWalletUpdateBalanceForTx(wallet, tx);
                 wasAdded = 1;
             }
             else { // keep track of unconfirmed non-wallet tx for invalid tx checks and child-pays-for-parent fees
@@ -1076,7 +1303,7 @@ void btcWalletUpdateTransactions(BRBitcoinWallet *wallet, const UInt256 txHashes
             for (k = array_count(wallet->transactions); k > 0; k--) { // remove and re-insert tx to keep wallet sorted
                 if (! btcTransactionEq(wallet->transactions[k - 1], tx)) continue;
                 array_rm(wallet->transactions, k - 1);
-                _btcWalletInsertTx(wallet, tx);
+                if (_btcWalletInsertTx(wallet, tx) != k - 1) needsUpdate = 1; // balanceHist follows the tx order
                 break;
             }
             
@@ -1109,12 +1336,20 @@ void btcWalletSetTxUnconfirmedAfter(BRBitcoinWallet *wallet, uint32_t blockHeigh
 
     UInt256 hashesBuf[4096];
     UInt256 *hashes = (count <= 4096 ? hashesBuf : calloc (count, sizeof (UInt256)));
+    BRBitcoinTransaction **transactions = (count > 0) ? malloc(count*sizeof(*transactions)) : NULL;
+
+    assert(transactions != NULL || count == 0);
 
     for (j = 0; j < count; j++) {
-        wallet->transactions[i + j]->blockHeight = TX_UNCONFIRMED;
-        hashes[j] = wallet->transactions[i + j]->txHash;
+        transactions[j] = wallet->transactions[i + j];
+        transactions[j]->blockHeight = TX_UNCONFIRMED;
+        hashes[j] = transactions[j]->txHash;
     }
-    
+
+    // re-insert the now unconfirmed transactions, so they're ordered among the others as if they'd never confirmed
+    if (count > 0) array_rm_range(wallet->transactions, i, count);
+    _btcWalletInsertTxs(wallet, transactions, count);
+    if (transactions) free(transactions);
     if (count > 0) _btcWalletUpdateBalance(wallet);
     pthread_mutex_unlock(&wallet->lock);
     if (count > 0 && wallet->txUpdated) wallet->txUpdated(wallet->callbackInfo, hashes, count, TX_UNCONFIRMED, 0);
@@ -1344,11 +1579,14 @@ void btcWalletFree(BRBitcoinWallet *wallet)
     BRSetApply(wallet->allTx, NULL, _setApplyFreeTx);
     BRSetFree(wallet->allTx);
     BRSetFree(wallet->spentOutputs);
+    BRSetApply(wallet->unspentOutputs, NULL, _setApplyFreeUTXO);
+    BRSetFree(wallet->unspentOutputs);
     array_free(wallet->internalChain);
     array_free(wallet->externalChain);
     array_free(wallet->balanceHist);
     array_free(wallet->transactions);
     array_free(wallet->utxos);
+    array_free(wallet->newlySpent);
     pthread_mutex_unlock(&wallet->lock);
     pthread_mutex_destroy(&wallet->lock);
     free(wallet);
@@ -26,6 +26,7 @@
 #define BRWallet_h
 
 #include "BRBitcoinTransaction.h"
+#include "BRBitcoinCoinSelection.h"
 #include "support/BRAddress.h"
 #include "support/BRBIP32Sequence.h"
 #include "support/BRInt.h"
@@ -63,6 +64,14 @@ typedef struct BRBitcoinWalletStruct BRBitcoinWallet;
 BRBitcoinWallet *btcWalletNew(BRAddressParams addrParams, BRBitcoinTransaction *transactions[], size_t txCount,
                               BRMasterPubKey mpk);
 
+// like btcWalletNew(), but seeds the internal and external chains with pubKey hashes previously generated for mpk, as
+// returned by btcWalletChainPKHs(), so that only addresses past the end of each chain need to be derived
+// a chain whose first, last, or a few randomly sampled pubKey hashes don't match mpk is ignored and derived in full
+BRBitcoinWallet *btcWalletNewWithChains(BRAddressParams addrParams, BRBitcoinTransaction *transactions[],
+                                        size_t txCount, BRMasterPubKey mpk,
+                                        const UInt160 internalChain[], size_t internalCount,
+                                        const UInt160 externalChain[], size_t externalCount);
+
 // not thread-safe, set callbacks once after btcWalletNew(), before calling other BRBitcoinWallet functions
 // info is a void pointer that will be passed along with each callback call
 // void balanceChanged(void *, uint64_t) - called when the wallet balance changes
@@ -96,6 +105,10 @@ BRAddress btcWalletLegacyAddress(BRBitcoinWallet *wallet);
 // return the legacy address for `addr`
 BRAddress btcWalletAddressToLegacy (BRBitcoinWallet *wallet, BRAddress *addr);
 
+// writes the pubKey hashes of the internal or external chain, in chain order, as generated by btcWalletUnusedAddrs()
+// returns the number of pubKey hashes written, or the chain length if pkhs is NULL
+size_t btcWalletChainPKHs(BRBitcoinWallet *wallet, UInt160 pkhs[], size_t pkhsCount, uint32_t internal);
+
 // writes all addresses previously genereated with btcWalletUnusedAddrs() to addrs
 // returns the number addresses written, or total number available if addrs is NULL
 size_t btcWalletAllAddrs(BRBitcoinWallet *wallet, BRAddress addrs[], size_t addrsCount);
@@ -161,6 +174,14 @@ BRBitcoinTransaction *btcWalletCreateTxForOutputs(BRBitcoinWallet *wallet, const
 BRBitcoinTransaction *btcWalletCreateTxForOutputsWithFeePerKb(BRBitcoinWallet *wallet, uint64_t feePerKb,
                                                               const BRBitcoinTxOutput outputs[], size_t outCount);
 
+// returns an unsigned transaction that satisifes the given transaction outputs, spending the UTXOs chosen by strategy
+// (BTC_COIN_SELECTION_WALLET_ORDER is what the functions above use)
+// result must be freed using btcTransactionFree()
+// use feePerKb UINT64_MAX to indicate that the wallet feePerKb should be used
+BRBitcoinTransaction *btcWalletCreateTxForOutputsWithCoinSelection(BRBitcoinWallet *wallet, uint64_t feePerKb,
+                                                                   BRBitcoinCoinSelectionStrategy strategy,
+                                                                   const BRBitcoinTxOutput outputs[], size_t outCount);
+
 // signs any inputs in tx that can be signed using private keys from the wallet
 // forkId is 0 for bitcoin, 0x40 for b-cash
 // seed is the master private key (wallet seed) corresponding to the master public key given when the wallet was created
@@ -142,6 +142,60 @@ ethSignatureExtractAddress(const BREthereumSignature signature,
             : ethAddressCreateKey(&key));
 }
 
+extern size_t
+ethSignatureExtractAddressMany (const BREthereumSignature *signatures,
+                                const uint8_t *const *bytes,
+                                const size_t *bytesCounts,
+                                size_t count,
+                                BREthereumAddress *addresses,
+                                int *successes) {
+    UInt256 *digests     = calloc (count, sizeof (UInt256));
+    uint8_t *compactSigs = calloc (count, 65);
+    BRKey   *keys        = calloc (count, sizeof (BRKey));
+    int     *recovered   = calloc (count, sizeof (int));
+    size_t  *indexes     = calloc (count, sizeof (size_t));
+    size_t   recoverCount = 0, successCount;
+
+    // Both signature types as the 'v'-first compact signature of BRKeyRecoverPubKey(); an RSV
+    // signature's 'v' is without the 0x1b offset and anything above 3 can't be recovered.
+    for (size_t index = 0; index < count; index++) {
+        successes[index] = 0;
+        addresses[index] = (BREthereumAddress) ETHEREUM_EMPTY_ADDRESS_INIT;
+
+        uint8_t *compactSig = &compactSigs[65 * recoverCount];
+        switch (signatures[index].type) {
+            case SIGNATURE_TYPE_RECOVERABLE_VRS_EIP:
+                memcpy (compactSig, &signatures[index].sig.vrs, 65);
+                break;
+            case SIGNATURE_TYPE_RECOVERABLE_RSV:
+                if (signatures[index].sig.rsv.v > 3) continue;
+                compactSig[0] = 0x1b + signatures[index].sig.rsv.v;
+                memcpy (&compactSig[1], signatures[index].sig.rsv.r, 32);
+                memcpy (&compactSig[33], signatures[index].sig.rsv.s, 32);
+                break;
+        }
+
+        BRKeccak256 (&digests[recoverCount], bytes[index], bytesCounts[index]);
+        indexes[recoverCount++] = index;
+    }
+
+    successCount = BRKeyRecoverPubKeyMany (keys, digests, compactSigs, recovered, recoverCount, 0);
+
+    for (size_t index = 0; index < recoverCount; index++) {
+        if (!recovered[index]) continue;
+        successes[indexes[index]] = 1;
+        addresses[indexes[index]] = ethAddressCreateKey (&keys[index]);
+    }
+
+    free (indexes);
+    free (recovered);
+    free (keys);
+    free (compactSigs);
+    free (digests);
+
+    return successCount;
+}
+
 extern void
 ethSignatureClear (BREthereumSignature *s,
                    BREthereumSignatureType type) {
@@ -101,6 +101,19 @@ ethSignatureExtractAddress (const BREthereumSignature signature,
                             size_t bytesCount,
                             int *success);
 
+/**
+ * Extract the addresses of `count` signatures, of bytes[i] with bytesCounts[i] bytes each, as
+ * `ethSignatureExtractAddress()` does but with the public key recoveries spread across the
+ * available processors.  Fills `addresses` and `successes` and returns the number extracted.
+ */
+extern size_t
+ethSignatureExtractAddressMany (const BREthereumSignature *signatures,
+                                const uint8_t *const *bytes,
+                                const size_t *bytesCounts,
+                                size_t count,
+                                BREthereumAddress *addresses,
+                                int *successes);
+
 extern BREthereumBoolean
 ethSignatureEqual (BREthereumSignature s1, BREthereumSignature s2);
 
@@ -422,11 +422,12 @@ ethTransactionRlpEncode(BREthereumTransaction transaction,
 //
 // Tranaction RLP Decode
 //
-extern BREthereumTransaction
-ethTransactionRlpDecode (BRRlpItem item,
-                      BREthereumNetwork network,
-                      BREthereumRlpType type,
-                      BRRlpCoder coder) {
+static BREthereumTransaction
+ethTransactionRlpDecodeInternal (BRRlpItem item,
+                                 BREthereumNetwork network,
+                                 BREthereumRlpType type,
+                                 BRRlpCoder coder,
+                                 int extractSource) {
     
     BREthereumTransaction transaction = calloc (1, sizeof(struct BREthereumTransactionRecord));
     
@@ -495,7 +496,8 @@ ethTransactionRlpDecode (BRRlpItem item,
             transaction->hash = ethHashCreateFromData(result);
 
             // :fingers-crossed:
-            transaction->sourceAddress = ethTransactionExtractAddress (transaction, network, coder);
+            if (extractSource)
+                transaction->sourceAddress = ethTransactionExtractAddress (transaction, network, coder);
             break;
         }
 
@@ -508,6 +510,72 @@ ethTransactionRlpDecode (BRRlpItem item,
     return transaction;
 }
 
+extern BREthereumTransaction
+ethTransactionRlpDecode (BRRlpItem item,
+                      BREthereumNetwork network,
+                      BREthereumRlpType type,
+                      BRRlpCoder coder) {
+    return ethTransactionRlpDecodeInternal (item, network, type, coder, 1);
+}
+
+extern BRArrayOf(BREthereumTransaction)
+ethTransactionRlpDecodeMany (const BRRlpItem *items,
+                             size_t itemsCount,
+                             BREthereumNetwork network,
+                             BREthereumRlpType type,
+                             BRRlpCoder coder) {
+    BRArrayOf(BREthereumTransaction) transactions;
+    array_new (transactions, itemsCount);
+
+    for (size_t index = 0; index < itemsCount; index++)
+        array_add (transactions, ethTransactionRlpDecodeInternal (items[index], network, type, coder, 0));
+
+    if (RLP_TYPE_TRANSACTION_SIGNED != type) return transactions;
+
+    // Recover the source addresses together; each one is an ECDSA public key recovery.
+    BREthereumSignature *signatures = calloc (itemsCount, sizeof (BREthereumSignature));
+    BRRlpData *datas = calloc (itemsCount, sizeof (BRRlpData));
+    const uint8_t **bytes = calloc (itemsCount, sizeof (uint8_t *));
+    size_t *bytesCounts = calloc (itemsCount, sizeof (size_t));
+    BREthereumAddress *addresses = calloc (itemsCount, sizeof (BREthereumAddress));
+    int *successes = calloc (itemsCount, sizeof (int));
+    size_t signedCount = 0;
+
+    for (size_t index = 0; index < itemsCount; index++) {
+        BREthereumTransaction transaction = transactions[index];
+        if (ETHEREUM_BOOLEAN_IS_FALSE (ethTransactionIsSigned (transaction))) continue;
+
+        BRRlpItem item = ethTransactionRlpEncode (transaction, network, RLP_TYPE_TRANSACTION_UNSIGNED, coder);
+        datas[signedCount] = rlpItemGetData (coder, item);
+        rlpItemRelease (coder, item);
+
+        signatures[signedCount]  = transaction->signature;
+        bytes[signedCount]       = datas[signedCount].bytes;
+        bytesCounts[signedCount] = datas[signedCount].bytesCount;
+        signedCount++;
+    }
+
+    ethSignatureExtractAddressMany (signatures, bytes, bytesCounts, signedCount, addresses, successes);
+
+    for (size_t index = 0, signedIndex = 0; index < itemsCount; index++) {
+        BREthereumTransaction transaction = transactions[index];
+        if (ETHEREUM_BOOLEAN_IS_FALSE (ethTransactionIsSigned (transaction))) continue;
+
+        transaction->sourceAddress = addresses[signedIndex];
+        rlpDataRelease (datas[signedIndex]);
+        signedIndex++;
+    }
+
+    free (successes);
+    free (addresses);
+    free (bytesCounts);
+    free (bytes);
+    free (datas);
+    free (signatures);
+
+    return transactions;
+}
+
 extern BRRlpData
 ethTransactionGetRlpData (BREthereumTransaction transaction,
                        BREthereumNetwork network,
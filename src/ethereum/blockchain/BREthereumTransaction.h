@@ -188,6 +188,18 @@ ethTransactionRlpDecode (BRRlpItem item,
                       BREthereumRlpType type,
                       BRRlpCoder coder);
 
+/**
+ * RLP decode `itemsCount` transactions, as `ethTransactionRlpDecode()` does for each item, but
+ * for RLP_TYPE_TRANSACTION_SIGNED recover the source addresses of all transactions in one batch,
+ * spread across the available processors.
+ */
+extern BRArrayOf(BREthereumTransaction)
+ethTransactionRlpDecodeMany (const BRRlpItem *items,
+                             size_t itemsCount,
+                             BREthereumNetwork network,
+                             BREthereumRlpType type,
+                             BRRlpCoder coder);
+
 /**
  * RLP encode transaction for the provided network with the specified type.  Different networks
  * have different RLP encodings - notably the network's chainId is part of the encoding.
@@ -25,6 +25,7 @@
 #include "BRBIP32Sequence.h"
 #include "BRCrypto.h"
 #include "BRBase58.h"
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -49,7 +50,8 @@
 // - In case parse256(IL) >= n or ki = 0, the resulting key is invalid, and one should proceed with the next value for i
 //   (Note: this has probability lower than 1 in 2^127.)
 //
-static void _CKDpriv(UInt256 *k, UInt256 *c, uint32_t i)
+// ctx is the HMAC-SHA512 key state for c, for deriving several children of the same parent
+static void _CKDprivCtx(UInt256 *k, UInt256 *c, const BRHMACCtx *ctx, uint32_t i)
 {
     uint8_t buf[sizeof(BRECPoint) + sizeof(i)];
     UInt512 I;
@@ -62,7 +64,7 @@ static void _CKDpriv(UInt256 *k, UInt256 *c, uint32_t i)
     
     UInt32SetBE(&buf[sizeof(BRECPoint)], i);
     
-    BRHMAC(&I, BRSHA512, sizeof(UInt512), c, sizeof(*c), buf, sizeof(buf)); // I = HMAC-SHA512(c, k|P(k) || i)
+    BRHMACCtxMac(&I, ctx, buf, sizeof(buf)); // I = HMAC-SHA512(c, k|P(k) || i)
     
     BRSecp256k1ModAdd(k, (UInt256 *)&I); // k = IL + k (mod n)
     *c = *(UInt256 *)&I.u8[sizeof(UInt256)]; // c = IR
@@ -71,6 +73,15 @@ static void _CKDpriv(UInt256 *k, UInt256 *c, uint32_t i)
     mem_clean(buf, sizeof(buf));
 }
 
+static void _CKDpriv(UInt256 *k, UInt256 *c, uint32_t i)
+{
+    BRHMACCtx ctx;
+
+    BRHMACCtxInit(&ctx, BRSHA512, sizeof(UInt512), c, sizeof(*c));
+    _CKDprivCtx(k, c, &ctx, i);
+    var_clean(&ctx);
+}
+
 // Public parent key -> public child key
 //
 // CKDpub((Kpar, cpar), i) -> (Ki, ci) computes a child extended public key from the parent extended public key.
@@ -85,7 +96,8 @@ static void _CKDpriv(UInt256 *k, UInt256 *c, uint32_t i)
 // - In case parse256(IL) >= n or Ki is the point at infinity, the resulting key is invalid, and one should proceed with
 //   the next value for i.
 //
-static void _CKDpub(BRECPoint *K, UInt256 *c, uint32_t i)
+// ctx is the HMAC-SHA512 key state for c, for deriving several children of the same parent
+static void _CKDpubCtx(BRECPoint *K, UInt256 *c, const BRHMACCtx *ctx, uint32_t i)
 {
     uint8_t buf[sizeof(*K) + sizeof(i)];
     UInt512 I;
@@ -94,7 +106,7 @@ static void _CKDpub(BRECPoint *K, UInt256 *c, uint32_t i)
         *(BRECPoint *)buf = *K;
         UInt32SetBE(&buf[sizeof(*K)], i);
     
-        BRHMAC(&I, BRSHA512, sizeof(UInt512), c, sizeof(*c), buf, sizeof(buf)); // I = HMAC-SHA512(c, P(K) || i)
+        BRHMACCtxMac(&I, ctx, buf, sizeof(buf)); // I = HMAC-SHA512(c, P(K) || i)
         
         *c = *(UInt256 *)&I.u8[sizeof(UInt256)]; // c = IR
         BRSecp256k1PointAdd(K, (UInt256 *)&I); // K = P(IL) + K
@@ -104,6 +116,15 @@ static void _CKDpub(BRECPoint *K, UInt256 *c, uint32_t i)
     }
 }
 
+static void _CKDpub(BRECPoint *K, UInt256 *c, uint32_t i)
+{
+    BRHMACCtx ctx;
+
+    BRHMACCtxInit(&ctx, BRSHA512, sizeof(UInt512), c, sizeof(*c));
+    _CKDpubCtx(K, c, &ctx, i);
+    var_clean(&ctx);
+}
+
 // returns the master public key for the default BIP32 wallet layout - derivation path N(m/0H)
 BRMasterPubKey BRBIP32MasterPubKey(const void *seed, size_t seedLen)
 {
@@ -188,6 +209,44 @@ size_t BRBIP32PubKey(uint8_t pubKey[33], BRMasterPubKey mpk, uint32_t chain, uin
     return sizeof(BRECPoint);
 }
 
+// writes the public keys for paths N(mpk/chain/from) through N(mpk/chain/from + count - 1) to pubKeys, deriving the
+// chain's extended key once and the keys' points together
+// returns true on success, pubKeys is unspecified on failure
+int BRBIP32PubKeyRange(BRECPoint pubKeys[], size_t count, BRMasterPubKey mpk, uint32_t chain, uint32_t from)
+{
+    UInt256 chainCode = mpk.chainCode, *IL = (count > 0) ? malloc(count*sizeof(*IL)) : NULL;
+    BRECPoint K = *(BRECPoint *)mpk.pubKey;
+    uint8_t buf[sizeof(K) + sizeof(uint32_t)];
+    BRHMACCtx ctx;
+    UInt512 I;
+    size_t i;
+    int r;
+
+    assert(memcmp(&mpk, &BR_MASTER_PUBKEY_NONE, sizeof(mpk)) != 0);
+    assert(pubKeys != NULL || count == 0);
+    assert(IL != NULL || count == 0);
+    
+    _CKDpub(&K, &chainCode, chain); // path N(mpk/chain)
+    BRHMACCtxInit(&ctx, BRSHA512, sizeof(UInt512), &chainCode, sizeof(chainCode));
+    *(BRECPoint *)buf = K;
+
+    for (i = 0; i < count; i++) { // as _CKDpubCtx(), without the chain codes, and IL zero for hardened children
+        UInt32SetBE(&buf[sizeof(K)], from + (uint32_t)i);
+        if (((from + (uint32_t)i) & BIP32_HARD) == BIP32_HARD) IL[i] = UINT256_ZERO;
+        else BRHMACCtxMac(&I, &ctx, buf, sizeof(buf)), IL[i] = *(UInt256 *)&I; // I = HMAC-SHA512(c, P(K) || i)
+    }
+
+    r = BRSecp256k1PointAddMany(pubKeys, &K, IL, count); // K = P(IL) + K
+
+    if (IL) mem_clean(IL, count*sizeof(*IL));
+    free(IL);
+    var_clean(&chainCode);
+    var_clean(&I);
+    var_clean(&ctx);
+    mem_clean(buf, sizeof(buf));
+    return r;
+}
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index)
 {
@@ -200,6 +259,7 @@ void BRBIP32PrivKeyList(BRKey keys[], size_t keysCount, const void *seed, size_t
 {
     UInt512 I;
     UInt256 secret, chainCode, s, c;
+    BRHMACCtx ctx;
     int i;
     
     assert(keys != NULL || keysCount == 0);
@@ -217,15 +277,17 @@ void BRBIP32PrivKeyList(BRKey keys[], size_t keysCount, const void *seed, size_t
         }
 
         _CKDpriv(&secret, &chainCode, chain); // path m/child[0]/child[1]...child[depth - 1]/chain
+        BRHMACCtxInit(&ctx, BRSHA512, sizeof(UInt512), &chainCode, sizeof(chainCode));
     
         for (i = 0; i < keysCount; i++) {
             s = secret;
             c = chainCode;
-            _CKDpriv(&s, &c, indexes[i]); // index'th key in chain
+            _CKDprivCtx(&s, &c, &ctx, indexes[i]); // index'th key in chain
             BRKeySetSecret(&keys[i], &s, 1);
         }
         
         var_clean(&secret, &chainCode, &c, &s);
+        var_clean(&ctx);
     }
 }
 
@@ -85,6 +85,11 @@ BRMasterPubKey BRBIP32MasterPubKeyPath(const void *seed, size_t seedLen, int dep
 // returns number of bytes written, maximum is 33
 size_t BRBIP32PubKey(uint8_t pubKey[33], BRMasterPubKey mpk, uint32_t chain, uint32_t index);
 
+// writes the public keys for paths N(mpk/chain/from) through N(mpk/chain/from + count - 1) to pubKeys, much faster
+// than count calls to BRBIP32PubKey()
+// returns true on success, pubKeys is unspecified on failure
+int BRBIP32PubKeyRange(BRECPoint pubKeys[], size_t count, BRMasterPubKey mpk, uint32_t chain, uint32_t from);
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index);
 
@@ -27,6 +27,20 @@
 #include <string.h>
 #include <assert.h>
 
+// sha-256 hardware acceleration, x86 backends are selected at runtime, keccak-256 batches also use the x86 avx2
+// backend, the armv8 crypto extensions backend is opt-in with -DBR_SHA256_ENABLE_ARMV8 when compiled for them, until
+// it has been built and passed BRHashTests on arm64
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BR_SHA256_X86 1
+#include <pthread.h>
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(BR_SHA256_ENABLE_ARMV8) && defined(__aarch64__) && \
+      (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define BR_SHA256_ARMV8 1
+#include <arm_neon.h>
+#endif
+
 // endian swapping
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
 #define be32(x) (x)
@@ -110,19 +124,24 @@ void BRSHA1(void *md20, const void *data, size_t dataLen)
 #define s2(x) (ror32((x), 7) ^ ror32((x), 18) ^ ((x) >> 3))
 #define s3(x) (ror32((x), 17) ^ ror32((x), 19) ^ ((x) >> 10))
 
-static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
+static const uint32_t _BRSHA256K[] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t _BRSHA256IV[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                        0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
+
+#if ! BR_SHA256_ARMV8
+static void _BRSHA256CompressGeneric(uint32_t *r, const uint32_t *x)
 {
-    static const uint32_t k[] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
+    const uint32_t *k = _BRSHA256K;
     int i;
     uint32_t a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[64];
     
@@ -139,40 +158,276 @@ static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
     var_clean(&a, &b, &c, &d, &e, &f, &g, &h, &t1, &t2);
     mem_clean(w, sizeof(w));
 }
+#endif
 
-void BRSHA224(void *md28, const void *data, size_t dataLen) {
-    size_t i;
-    uint32_t x[16], buf[] = { 0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511,
-                              0x64f98fa7, 0xbefa4fa4 }; // initial buffer values
+#if BR_SHA256_X86
 
-    assert(md28 != NULL);
-    assert(data != NULL || dataLen == 0);
+// x86 sha extensions, four rounds per pair of sha256rnds2, state kept as ABEF/CDGH
+#define BR_SHANI_TARGET __attribute__((target("sha,sse4.1")))
 
-    for (i = 0; i < dataLen; i += 64) { // process data in 64 byte blocks
-        memcpy(x, (const uint8_t *)data + i, (i + 64 < dataLen) ? 64 : dataLen - i);
-        if (i + 64 > dataLen) break;
-        _BRSHA256Compress(buf, x);
+BR_SHANI_TARGET
+static inline void _BRSHA256SHANILoad(const uint32_t *r, __m128i *abef, __m128i *cdgh)
+{
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[0]), 0xb1); // CDAB
+
+    *cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[4]), 0x1b); // EFGH
+    *abef = _mm_alignr_epi8(t, *cdgh, 8); // ABEF
+    *cdgh = _mm_blend_epi16(*cdgh, t, 0xf0); // CDGH
+}
+
+BR_SHANI_TARGET
+static inline void _BRSHA256SHANIStore(uint32_t *r, __m128i abef, __m128i cdgh)
+{
+    __m128i t = _mm_shuffle_epi32(abef, 0x1b); // FEBA
+
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1); // DCHG
+    _mm_storeu_si128((__m128i *)&r[0], _mm_blend_epi16(t, cdgh, 0xf0)); // DCBA
+    _mm_storeu_si128((__m128i *)&r[4], _mm_alignr_epi8(cdgh, t, 8)); // HGFE
+}
+
+// rounds 4*i...4*i + 3, w[i & 3] is set to message words 4*i...4*i + 3
+BR_SHANI_TARGET
+static inline void _BRSHA256SHANIRounds(__m128i *abef, __m128i *cdgh, __m128i *w, const uint32_t *x, int i)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i msg;
+
+    if (i < 4) w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[4*i]), mask);
+    else {
+        msg = _mm_add_epi32(_mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]),
+                            _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+        w[i & 3] = _mm_sha256msg2_epu32(msg, w[(i + 3) & 3]);
+    }
+
+    msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *)&_BRSHA256K[4*i]));
+    *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, msg);
+    *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+BR_SHANI_TARGET
+static void _BRSHA256CompressSHANI(uint32_t *r, const uint32_t *x)
+{
+    __m128i abef, cdgh, abefSave, cdghSave, w[4];
+    int i;
+
+    _BRSHA256SHANILoad(r, &abef, &cdgh);
+    abefSave = abef, cdghSave = cdgh;
+    for (i = 0; i < 16; i++) _BRSHA256SHANIRounds(&abef, &cdgh, w, x, i);
+    _BRSHA256SHANIStore(r, _mm_add_epi32(abef, abefSave), _mm_add_epi32(cdgh, cdghSave));
+}
+
+// compresses one block of each of two messages with their rounds interleaved, since a single message is limited by the
+// latency of sha256rnds2 rather than its throughput
+BR_SHANI_TARGET
+static void _BRSHA256CompressSHANIx2(uint32_t *r0, uint32_t *r1, const uint32_t *x0, const uint32_t *x1)
+{
+    __m128i abef0, cdgh0, abef1, cdgh1, abefSave0, cdghSave0, abefSave1, cdghSave1, w0[4], w1[4];
+    int i;
+
+    _BRSHA256SHANILoad(r0, &abef0, &cdgh0);
+    _BRSHA256SHANILoad(r1, &abef1, &cdgh1);
+    abefSave0 = abef0, cdghSave0 = cdgh0, abefSave1 = abef1, cdghSave1 = cdgh1;
+
+    for (i = 0; i < 16; i++) {
+        _BRSHA256SHANIRounds(&abef0, &cdgh0, w0, x0, i);
+        _BRSHA256SHANIRounds(&abef1, &cdgh1, w1, x1, i);
+    }
+
+    _BRSHA256SHANIStore(r0, _mm_add_epi32(abef0, abefSave0), _mm_add_epi32(cdgh0, cdghSave0));
+    _BRSHA256SHANIStore(r1, _mm_add_epi32(abef1, abefSave1), _mm_add_epi32(cdgh1, cdghSave1));
+}
+
+// basic sha256 functions on eight independent messages, one per 32bit lane
+#define ror32x8(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define chx8(x, y, z) _mm256_xor_si256(_mm256_and_si256((x), (y)), _mm256_andnot_si256((x), (z)))
+#define majx8(x, y, z) _mm256_or_si256(_mm256_and_si256((x), (y)), _mm256_and_si256((z), _mm256_or_si256((x), (y))))
+#define s0x8(x) _mm256_xor_si256(_mm256_xor_si256(ror32x8((x), 2), ror32x8((x), 13)), ror32x8((x), 22))
+#define s1x8(x) _mm256_xor_si256(_mm256_xor_si256(ror32x8((x), 6), ror32x8((x), 11)), ror32x8((x), 25))
+#define s2x8(x) _mm256_xor_si256(_mm256_xor_si256(ror32x8((x), 7), ror32x8((x), 18)), _mm256_srli_epi32((x), 3))
+#define s3x8(x) _mm256_xor_si256(_mm256_xor_si256(ror32x8((x), 17), ror32x8((x), 19)), _mm256_srli_epi32((x), 10))
+
+// compresses one block of each of eight messages, w holds the message words (native endian) and is overwritten
+__attribute__((target("avx2")))
+static void _BRSHA256CompressAVX2x8(__m256i *r, __m256i *w)
+{
+    __m256i a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2;
+    int i;
+
+    for (i = 0; i < 64; i++) {
+        if (i >= 16) {
+            w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(s3x8(w[(i - 2) & 15]), w[(i - 7) & 15]),
+                                         _mm256_add_epi32(s2x8(w[(i - 15) & 15]), w[i & 15]));
+        }
+
+        t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1x8(e)), _mm256_add_epi32(chx8(e, f, g), w[i & 15]));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32((int)_BRSHA256K[i]));
+        t2 = _mm256_add_epi32(s0x8(a), majx8(a, b, c));
+        h = g, g = f, f = e, e = _mm256_add_epi32(d, t1), d = c, c = b, b = a, a = _mm256_add_epi32(t1, t2);
+    }
+
+    r[0] = _mm256_add_epi32(r[0], a), r[1] = _mm256_add_epi32(r[1], b), r[2] = _mm256_add_epi32(r[2], c);
+    r[3] = _mm256_add_epi32(r[3], d), r[4] = _mm256_add_epi32(r[4], e), r[5] = _mm256_add_epi32(r[5], f);
+    r[6] = _mm256_add_epi32(r[6], g), r[7] = _mm256_add_epi32(r[7], h);
+}
+
+// writes block n of the padded sha-256 message of dataLen bytes to x
+static void _BRSHA256PadBlock(uint32_t *x, const uint8_t *data, size_t dataLen, size_t n)
+{
+    size_t i = n*64, len = (i < dataLen) ? dataLen - i : 0;
+
+    memset(x, 0, 64);
+    if (len > 0) memcpy(x, data + i, (len < 64) ? len : 64);
+    if (len < 64 && i <= dataLen) ((uint8_t *)x)[len] = 0x80; // append padding
+    if (n == (dataLen + 8)/64) x[14] = be32((uint32_t)(dataLen >> 29)), x[15] = be32((uint32_t)(dataLen << 3));
+}
+
+// double-sha-256 of eight messages of dataLen bytes each, stored one after the other in data
+__attribute__((target("avx2")))
+static void _BRSHA256_2AVX2x8(uint8_t *md32s, const uint8_t *data, size_t dataLen)
+{
+    __m256i r[8], w[16];
+    uint32_t x[8][16], u[8];
+    size_t i, j, n;
+
+    for (i = 0; i < 8; i++) r[i] = _mm256_set1_epi32((int)_BRSHA256IV[i]);
+
+    for (n = 0; n <= (dataLen + 8)/64; n++) { // process each message in lockstep, one 64 byte block at a time
+        for (j = 0; j < 8; j++) _BRSHA256PadBlock(x[j], data + j*dataLen, dataLen, n);
+
+        for (i = 0; i < 16; i++) {
+            w[i] = _mm256_setr_epi32((int)be32(x[0][i]), (int)be32(x[1][i]), (int)be32(x[2][i]), (int)be32(x[3][i]),
+                                     (int)be32(x[4][i]), (int)be32(x[5][i]), (int)be32(x[6][i]), (int)be32(x[7][i]));
+        }
+
+        _BRSHA256CompressAVX2x8(r, w);
+    }
+
+    for (i = 0; i < 8; i++) w[i] = r[i], r[i] = _mm256_set1_epi32((int)_BRSHA256IV[i]); // hash the 32 byte digests
+    w[8] = _mm256_set1_epi32((int)0x80000000); // append padding
+    for (i = 9; i < 15; i++) w[i] = _mm256_setzero_si256();
+    w[15] = _mm256_set1_epi32(32*8); // append length in bits
+    _BRSHA256CompressAVX2x8(r, w);
+
+    for (i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *)u, r[i]);
+        for (j = 0; j < 8; j++) u[j] = be32(u[j]); // endian swap
+        for (j = 0; j < 8; j++) memcpy(md32s + j*32 + i*sizeof(uint32_t), &u[j], sizeof(uint32_t));
     }
 
-    memset((uint8_t *)x + (dataLen - i), 0, 64 - (dataLen - i)); // clear remainder of x
-    ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
-    if (dataLen - i >= 56) _BRSHA256Compress(buf, x), memset(x, 0, 64); // length goes to next block
-    x[14] = be32((uint32_t)(dataLen >> 29)), x[15] = be32((uint32_t)(dataLen << 3)); // append length in bits
-    _BRSHA256Compress(buf, x); // finalize
-    for (i = 0; i < 7; i++) buf[i] = be32(buf[i]); // endian swap
-    memcpy(md28, buf, 28); // write to md
     mem_clean(x, sizeof(x));
-    mem_clean(buf, sizeof(buf));
 }
 
-void BRSHA256(void *md32, const void *data, size_t dataLen)
+// double-sha-256 of two messages of dataLen bytes each, stored one after the other in data
+BR_SHANI_TARGET
+static void _BRSHA256_2SHANIx2(uint8_t *md32s, const uint8_t *data, size_t dataLen)
 {
-    size_t i;
-    uint32_t x[16], buf[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
-                              0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
-    
-    assert(md32 != NULL);
-    assert(data != NULL || dataLen == 0);
+    uint32_t r[2][8], x[2][16];
+    const uint32_t *p[2];
+    size_t i, j, n;
+
+    for (j = 0; j < 2; j++) memcpy(r[j], _BRSHA256IV, sizeof(r[j]));
+
+    for (n = 0; n <= (dataLen + 8)/64; n++) { // process both messages in lockstep, one 64 byte block at a time
+        for (j = 0; j < 2; j++) {
+            if ((n + 1)*64 <= dataLen) p[j] = (const uint32_t *)(data + j*dataLen + n*64); // loaded unaligned
+            else _BRSHA256PadBlock(x[j], data + j*dataLen, dataLen, n), p[j] = x[j];
+        }
+
+        _BRSHA256CompressSHANIx2(r[0], r[1], p[0], p[1]);
+    }
+
+    for (j = 0; j < 2; j++) { // hash the 32 byte digests
+        for (i = 0; i < 8; i++) x[j][i] = be32(r[j][i]);
+        memset(&x[j][8], 0, 32);
+        ((uint8_t *)x[j])[32] = 0x80; // append padding
+        x[j][15] = be32(32*8); // append length in bits
+        memcpy(r[j], _BRSHA256IV, sizeof(r[j]));
+    }
+
+    _BRSHA256CompressSHANIx2(r[0], r[1], x[0], x[1]);
+
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < 8; i++) r[j][i] = be32(r[j][i]); // endian swap
+        memcpy(md32s + j*32, r[j], 32);
+    }
+
+    mem_clean(x, sizeof(x));
+}
+
+#define BR_SHA256_X86_SHANI 0x01
+#define BR_SHA256_X86_AVX2  0x02
+
+static int _BRSHA256X86Features(void)
+{
+    unsigned a, b, c, d, lo = 0, hi = 0;
+    int features = 0;
+
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid(1, a, b, c, d);
+    if ((c & (1u << 27)) && (c & (1u << 28))) __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0)); // osxsave, avx
+    if ((c & (1u << 9)) && (c & (1u << 19))) features |= BR_SHA256_X86_SHANI; // ssse3, sse4.1, checked for sha below
+    __cpuid_count(7, 0, a, b, c, d);
+    if (! (b & (1u << 29))) features &= ~BR_SHA256_X86_SHANI; // sha
+    if ((b & (1u << 5)) && (lo & 0x06) == 0x06) features |= BR_SHA256_X86_AVX2; // avx2, os saves xmm/ymm state
+    return features;
+}
+
+static pthread_once_t _BRSHA256Once = PTHREAD_ONCE_INIT;
+static int _BRSHA256Features = 0;
+static void (*_BRSHA256CompressX86)(uint32_t *r, const uint32_t *x) = _BRSHA256CompressGeneric;
+
+static void _BRSHA256Init(void)
+{
+    _BRSHA256Features = _BRSHA256X86Features();
+    if (_BRSHA256Features & BR_SHA256_X86_SHANI) _BRSHA256CompressX86 = _BRSHA256CompressSHANI;
+}
+
+static int _BRSHA256GetFeatures(void)
+{
+    pthread_once(&_BRSHA256Once, _BRSHA256Init);
+    return _BRSHA256Features;
+}
+
+static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
+{
+    pthread_once(&_BRSHA256Once, _BRSHA256Init);
+    _BRSHA256CompressX86(r, x);
+}
+
+#elif BR_SHA256_ARMV8
+
+// armv8 crypto extensions, four rounds per sha256h/sha256h2 pair
+static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
+{
+    uint32x4_t abcd = vld1q_u32(&r[0]), efgh = vld1q_u32(&r[4]), abcdSave = abcd, efghSave = efgh, msg, t, w[4];
+    int i;
+
+    for (i = 0; i < 16; i++) { // w[i & 3] holds message words 4*i...4*i + 3
+        if (i < 4) w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8((const uint8_t *)&x[4*i])));
+        else w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]), w[(i + 2) & 3], w[(i + 3) & 3]);
+
+        msg = vaddq_u32(w[i & 3], vld1q_u32(&_BRSHA256K[4*i]));
+        t = abcd;
+        abcd = vsha256hq_u32(abcd, efgh, msg);
+        efgh = vsha256h2q_u32(efgh, t, msg);
+    }
+
+    vst1q_u32(&r[0], vaddq_u32(abcd, abcdSave));
+    vst1q_u32(&r[4], vaddq_u32(efgh, efghSave));
+}
+
+#else
+
+#define _BRSHA256Compress _BRSHA256CompressGeneric
+
+#endif
+
+// sha-256 of data, continuing from buf with prefixLen bytes of preceding input already compressed into it (prefixLen
+// must be a multiple of 64), writes mdLen bytes of the final buffer to md
+static void _BRSHA256(void *md, size_t mdLen, uint32_t *buf, size_t prefixLen, const void *data, size_t dataLen)
+{
+    size_t i, len = prefixLen + dataLen;
+    uint32_t x[16];
 
     for (i = 0; i < dataLen; i += 64) { // process data in 64 byte blocks
         memcpy(x, (const uint8_t *)data + i, (i + 64 < dataLen) ? 64 : dataLen - i);
@@ -183,11 +438,31 @@ void BRSHA256(void *md32, const void *data, size_t dataLen)
     memset((uint8_t *)x + (dataLen - i), 0, 64 - (dataLen - i)); // clear remainder of x
     ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
     if (dataLen - i >= 56) _BRSHA256Compress(buf, x), memset(x, 0, 64); // length goes to next block
-    x[14] = be32((uint32_t)(dataLen >> 29)), x[15] = be32((uint32_t)(dataLen << 3)); // append length in bits
+    x[14] = be32((uint32_t)(len >> 29)), x[15] = be32((uint32_t)(len << 3)); // append length in bits
     _BRSHA256Compress(buf, x); // finalize
-    for (i = 0; i < 8; i++) buf[i] = be32(buf[i]); // endian swap
-    memcpy(md32, buf, 32); // write to md
+    for (i = 0; i < mdLen/sizeof(*buf); i++) buf[i] = be32(buf[i]); // endian swap
+    memcpy(md, buf, mdLen); // write to md
     mem_clean(x, sizeof(x));
+}
+
+void BRSHA224(void *md28, const void *data, size_t dataLen) {
+    uint32_t buf[] = { 0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511, 0x64f98fa7,
+                       0xbefa4fa4 }; // initial buffer values
+
+    assert(md28 != NULL);
+    assert(data != NULL || dataLen == 0);
+    _BRSHA256(md28, 28, buf, 0, data, dataLen);
+    mem_clean(buf, sizeof(buf));
+}
+
+void BRSHA256(void *md32, const void *data, size_t dataLen)
+{
+    uint32_t buf[8];
+    
+    memcpy(buf, _BRSHA256IV, sizeof(buf));
+    assert(md32 != NULL);
+    assert(data != NULL || dataLen == 0);
+    _BRSHA256(md32, 32, buf, 0, data, dataLen);
     mem_clean(buf, sizeof(buf));
 }
 
@@ -202,6 +477,30 @@ void BRSHA256_2(void *md32, const void *data, size_t dataLen)
     BRSHA256(md32, t, sizeof(t));
 }
 
+// double-sha-256 of count messages of dataLen bytes each, stored one after the other in data
+void BRSHA256_2Many(void *md32s, const void *data, size_t dataLen, size_t count)
+{
+    size_t i = 0;
+
+    assert(md32s != NULL || count == 0);
+    assert(data != NULL || dataLen == 0 || count == 0);
+
+#if BR_SHA256_X86
+    if (_BRSHA256GetFeatures() & BR_SHA256_X86_SHANI) {
+        for (; i + 2 <= count; i += 2) {
+            _BRSHA256_2SHANIx2((uint8_t *)md32s + i*32, (const uint8_t *)data + i*dataLen, dataLen);
+        }
+    }
+    else if (_BRSHA256GetFeatures() & BR_SHA256_X86_AVX2) {
+        for (; i + 8 <= count; i += 8) {
+            _BRSHA256_2AVX2x8((uint8_t *)md32s + i*32, (const uint8_t *)data + i*dataLen, dataLen);
+        }
+    }
+#endif
+
+    for (; i < count; i++) BRSHA256_2((uint8_t *)md32s + i*32, (const uint8_t *)data + i*dataLen, dataLen);
+}
+
 // bitwise right rotation
 #define ror64(a, b) (((a) >> (b)) | ((a) << (64 - (b))))
 
@@ -249,14 +548,12 @@ static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
     mem_clean(w, sizeof(w));
 }
 
-void BRSHA384(void *md48, const void *data, size_t dataLen)
+// sha-512 of data, continuing from buf with prefixLen bytes of preceding input already compressed into it (prefixLen
+// must be a multiple of 128), writes mdLen bytes of the final buffer to md
+static void _BRSHA512(void *md, size_t mdLen, uint64_t *buf, size_t prefixLen, const void *data, size_t dataLen)
 {
-    size_t i;
-    uint64_t x[16], buf[] = { 0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
-                              0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4 };
-    
-    assert(md48 != NULL);
-    assert(data != NULL || dataLen == 0);
+    size_t i, len = prefixLen + dataLen;
+    uint64_t x[16];
 
     for (i = 0; i < dataLen; i += 128) { // process data in 128 byte blocks
         memcpy(x, (const uint8_t *)data + i, (i + 128 < dataLen) ? 128 : dataLen - i);
@@ -267,37 +564,36 @@ void BRSHA384(void *md48, const void *data, size_t dataLen)
     memset((uint8_t *)x + (dataLen - i), 0, 128 - (dataLen - i)); // clear remainder of x
     ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
     if (dataLen - i >= 112) _BRSHA512Compress(buf, x), memset(x, 0, 128); // length goes to next block
-    x[14] = 0, x[15] = be64((uint64_t)dataLen*8); // append length in bits
+    x[14] = 0, x[15] = be64((uint64_t)len*8); // append length in bits
     _BRSHA512Compress(buf, x); // finalize
-    for (i = 0; i < 6; i++) buf[i] = be64(buf[i]); // endian swap
-    memcpy(md48, buf, 48); // write to md
+    for (i = 0; i < mdLen/sizeof(*buf); i++) buf[i] = be64(buf[i]); // endian swap
+    memcpy(md, buf, mdLen); // write to md
     mem_clean(x, sizeof(x));
+}
+
+void BRSHA384(void *md48, const void *data, size_t dataLen)
+{
+    uint64_t buf[] = { 0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+                       0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4 };
+    
+    assert(md48 != NULL);
+    assert(data != NULL || dataLen == 0);
+    _BRSHA512(md48, 48, buf, 0, data, dataLen);
     mem_clean(buf, sizeof(buf));
 }
 
+static const uint64_t _BRSHA512IV[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+                                        0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b,
+                                        0x5be0cd19137e2179 }; // initial buffer values
+
 void BRSHA512(void *md64, const void *data, size_t dataLen)
 {
-    size_t i;
-    uint64_t x[16], buf[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
-                              0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179 };
+    uint64_t buf[8];
     
+    memcpy(buf, _BRSHA512IV, sizeof(buf));
     assert(md64 != NULL);
     assert(data != NULL || dataLen == 0);
-
-    for (i = 0; i < dataLen; i += 128) { // process data in 128 byte blocks
-        memcpy(x, (const uint8_t *)data + i, (i + 128 < dataLen) ? 128 : dataLen - i);
-        if (i + 128 > dataLen) break;
-        _BRSHA512Compress(buf, x);
-    }
-    
-    memset((uint8_t *)x + (dataLen - i), 0, 128 - (dataLen - i)); // clear remainder of x
-    ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
-    if (dataLen - i >= 112) _BRSHA512Compress(buf, x), memset(x, 0, 128); // length goes to next block
-    x[14] = 0, x[15] = be64((uint64_t)dataLen*8); // append length in bits
-    _BRSHA512Compress(buf, x); // finalize
-    for (i = 0; i < 8; i++) buf[i] = be64(buf[i]); // endian swap
-    memcpy(md64, buf, 64); // write to md
-    mem_clean(x, sizeof(x));
+    _BRSHA512(md64, 64, buf, 0, data, dataLen);
     mem_clean(buf, sizeof(buf));
 }
 
@@ -399,55 +695,160 @@ void BRHash160(void *md20, const void *data, size_t datalen)
 // bitwise left rotation
 #define rol64(a, b) ((a) << (b) ^ ((a) >> (64 - (b))))
 
+// keccak lane operations
+#define xor64(x, y) ((x) ^ (y))
+#define andn64(x, y) (~(x) & (y))
+
+static const uint64_t _BRKeccakRC[] = { // keccak round constants
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
+    0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
+    0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+};
+
+// one keccak-f[1600] round on the lanes a00...a24 (lane x + 5*y), with iota constant rc and the lane operations
+// xor(x, y), andn(x, y) = ~x & y and rol(x, n), using b00...b24, c0...c4 and d0...d4 as temporaries
+#define _BRKeccakRound(xor, andn, rol, rc) do {\
+    c0 = xor(xor(xor(xor(a00, a05), a10), a15), a20);\
+    c1 = xor(xor(xor(xor(a01, a06), a11), a16), a21);\
+    c2 = xor(xor(xor(xor(a02, a07), a12), a17), a22);\
+    c3 = xor(xor(xor(xor(a03, a08), a13), a18), a23);\
+    c4 = xor(xor(xor(xor(a04, a09), a14), a19), a24);\
+    d0 = xor(c4, rol(c1, 1));\
+    d1 = xor(c0, rol(c2, 1));\
+    d2 = xor(c1, rol(c3, 1));\
+    d3 = xor(c2, rol(c4, 1));\
+    d4 = xor(c3, rol(c0, 1));\
+    b00 = xor(a00, d0), b10 = rol(xor(a01, d1), 1), b20 = rol(xor(a02, d2), 62);\
+    b05 = rol(xor(a03, d3), 28), b15 = rol(xor(a04, d4), 27);\
+    b16 = rol(xor(a05, d0), 36), b01 = rol(xor(a06, d1), 44), b11 = rol(xor(a07, d2), 6);\
+    b21 = rol(xor(a08, d3), 55), b06 = rol(xor(a09, d4), 20);\
+    b07 = rol(xor(a10, d0), 3), b17 = rol(xor(a11, d1), 10), b02 = rol(xor(a12, d2), 43);\
+    b12 = rol(xor(a13, d3), 25), b22 = rol(xor(a14, d4), 39);\
+    b23 = rol(xor(a15, d0), 41), b08 = rol(xor(a16, d1), 45), b18 = rol(xor(a17, d2), 15);\
+    b03 = rol(xor(a18, d3), 21), b13 = rol(xor(a19, d4), 8);\
+    b14 = rol(xor(a20, d0), 18), b24 = rol(xor(a21, d1), 2), b09 = rol(xor(a22, d2), 61);\
+    b19 = rol(xor(a23, d3), 56), b04 = rol(xor(a24, d4), 14);\
+    a00 = xor(b00, andn(b01, b02)), a01 = xor(b01, andn(b02, b03)), a02 = xor(b02, andn(b03, b04));\
+    a03 = xor(b03, andn(b04, b00)), a04 = xor(b04, andn(b00, b01));\
+    a05 = xor(b05, andn(b06, b07)), a06 = xor(b06, andn(b07, b08)), a07 = xor(b07, andn(b08, b09));\
+    a08 = xor(b08, andn(b09, b05)), a09 = xor(b09, andn(b05, b06));\
+    a10 = xor(b10, andn(b11, b12)), a11 = xor(b11, andn(b12, b13)), a12 = xor(b12, andn(b13, b14));\
+    a13 = xor(b13, andn(b14, b10)), a14 = xor(b14, andn(b10, b11));\
+    a15 = xor(b15, andn(b16, b17)), a16 = xor(b16, andn(b17, b18)), a17 = xor(b17, andn(b18, b19));\
+    a18 = xor(b18, andn(b19, b15)), a19 = xor(b19, andn(b15, b16));\
+    a20 = xor(b20, andn(b21, b22)), a21 = xor(b21, andn(b22, b23)), a22 = xor(b22, andn(b23, b24));\
+    a23 = xor(b23, andn(b24, b20)), a24 = xor(b24, andn(b20, b21));\
+    a00 = xor(a00, (rc));\
+} while (0)
+
+// keccak-f[1600] permutation of the 25 lane state s, lanes are native endian (the permutation is invertible, so its
+// temporaries reveal nothing beyond s and are not cleaned here)
+void BRKeccakF1600(uint64_t *s)
+{
+    uint64_t a00, a01, a02, a03, a04, a05, a06, a07, a08, a09, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19,
+             a20, a21, a22, a23, a24, b00, b01, b02, b03, b04, b05, b06, b07, b08, b09, b10, b11, b12, b13, b14,
+             b15, b16, b17, b18, b19, b20, b21, b22, b23, b24, c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
+    int i;
+
+    assert(s != NULL);
+    a00 = s[0], a01 = s[1], a02 = s[2], a03 = s[3], a04 = s[4];
+    a05 = s[5], a06 = s[6], a07 = s[7], a08 = s[8], a09 = s[9];
+    a10 = s[10], a11 = s[11], a12 = s[12], a13 = s[13], a14 = s[14];
+    a15 = s[15], a16 = s[16], a17 = s[17], a18 = s[18], a19 = s[19];
+    a20 = s[20], a21 = s[21], a22 = s[22], a23 = s[23], a24 = s[24];
+
+    for (i = 0; i < 24; i++) _BRKeccakRound(xor64, andn64, rol64, _BRKeccakRC[i]);
+
+    s[0] = a00, s[1] = a01, s[2] = a02, s[3] = a03, s[4] = a04;
+    s[5] = a05, s[6] = a06, s[7] = a07, s[8] = a08, s[9] = a09;
+    s[10] = a10, s[11] = a11, s[12] = a12, s[13] = a13, s[14] = a14;
+    s[15] = a15, s[16] = a16, s[17] = a17, s[18] = a18, s[19] = a19;
+    s[20] = a20, s[21] = a21, s[22] = a22, s[23] = a23, s[24] = a24;
+}
+
 static void _BRSHA3Compress(uint64_t *r, const uint64_t *x, size_t blockSize)
 {
-    static const uint64_t k[] = { // keccak round constants
-        0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
-        0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
-        0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
-        0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
-        0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
-    };
-    
-    size_t i, j;
-    uint64_t a[5], b[5], r0, r1;
-    
+    size_t i;
+
     for (i = 0; i < blockSize/sizeof(uint64_t); i++) r[i] ^= le64(x[i]);
-    
-    for (i = 0; i < 24; i++) { // permute r
-        // theta(r)
-        for (j = 0; j < 5; j++) a[j] = r[j] ^ r[j + 5] ^ r[j + 10] ^ r[j + 15] ^ r[j + 20];
-        b[0] = rol64(a[1], 1) ^ a[4], b[1] = rol64(a[2], 1) ^ a[0], b[2] = rol64(a[3], 1) ^ a[1];
-        b[3] = rol64(a[4], 1) ^ a[2], b[4] = rol64(a[0], 1) ^ a[3];
-        for (j = 0; j < 5; j++) r[j] ^= b[j], r[j + 5] ^= b[j], r[j + 10] ^= b[j], r[j + 15] ^= b[j], r[j + 20] ^= b[j];
-        
-        // rho(r)
-        r[1] = rol64(r[1], 1), r[2] = rol64(r[2], 62), r[3] = rol64(r[3], 28), r[4] = rol64(r[4], 27);
-        r[5] = rol64(r[5], 36), r[6] = rol64(r[6], 44), r[7] = rol64(r[7], 6), r[8] = rol64(r[8], 55);
-        r[9] = rol64(r[9], 20), r[10] = rol64(r[10], 3), r[11] = rol64(r[11], 10), r[12] = rol64(r[12], 43);
-        r[13] = rol64(r[13], 25), r[14] = rol64(r[14], 39), r[15] = rol64(r[15], 41), r[16] = rol64(r[16], 45);
-        r[17] = rol64(r[17], 15), r[18] = rol64(r[18], 21), r[19] = rol64(r[19], 8), r[20] = rol64(r[20], 18);
-        r[21] = rol64(r[21], 2), r[22] = rol64(r[22], 61), r[23] = rol64(r[23], 56), r[24] = rol64(r[24], 14);
-        
-        // pi(r)
-        r1 = r[1], r[1] = r[6], r[6] = r[9], r[9] = r[22], r[22] = r[14], r[14] = r[20], r[20] = r[2], r[2] = r[12],
-        r[12] = r[13], r[13] = r[19], r[19] = r[23], r[23] = r[15], r[15] = r[4], r[4] = r[24], r[24] = r[21];
-        r[21] = r[8], r[8] = r[16], r[16] = r[5], r[5] = r[3], r[3] = r[18], r[18] = r[17], r[17] = r[11], r[11] = r[7];
-        r[7] = r[10], r[10] = r1; // r[0] left as is
-        
-        for (j = 0; j < 25; j += 5) { // chi(r)
-            r0 = r[0 + j], r1 = r[1 + j], r[0 + j] ^= ~r1 & r[2 + j], r[1 + j] ^= ~r[2 + j] & r[3 + j];
-            r[2 + j] ^= ~r[3 + j] & r[4 + j], r[3 + j] ^= ~r[4 + j] & r0, r[4 + j] ^= ~r0 & r1;
+    BRKeccakF1600(r);
+}
+
+#if BR_SHA256_X86
+
+// avx2 keccak lane operations, each vector holds the same lane of four independent states
+#define xor64x4(x, y) _mm256_xor_si256((x), (y))
+#define andn64x4(x, y) _mm256_andnot_si256((x), (y))
+#define rol64x4(x, n) _mm256_or_si256(_mm256_slli_epi64((x), (n)), _mm256_srli_epi64((x), 64 - (n)))
+
+// keccak-f[1600] permutation of four states, s[i] holds lane i of each
+__attribute__((target("avx2")))
+static void _BRKeccakF1600AVX2x4(__m256i *s)
+{
+    __m256i a00, a01, a02, a03, a04, a05, a06, a07, a08, a09, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19,
+            a20, a21, a22, a23, a24, b00, b01, b02, b03, b04, b05, b06, b07, b08, b09, b10, b11, b12, b13, b14,
+            b15, b16, b17, b18, b19, b20, b21, b22, b23, b24, c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
+    int i;
+
+    a00 = s[0], a01 = s[1], a02 = s[2], a03 = s[3], a04 = s[4];
+    a05 = s[5], a06 = s[6], a07 = s[7], a08 = s[8], a09 = s[9];
+    a10 = s[10], a11 = s[11], a12 = s[12], a13 = s[13], a14 = s[14];
+    a15 = s[15], a16 = s[16], a17 = s[17], a18 = s[18], a19 = s[19];
+    a20 = s[20], a21 = s[21], a22 = s[22], a23 = s[23], a24 = s[24];
+
+    for (i = 0; i < 24; i++) {
+        _BRKeccakRound(xor64x4, andn64x4, rol64x4, _mm256_set1_epi64x((long long)_BRKeccakRC[i]));
+    }
+
+    s[0] = a00, s[1] = a01, s[2] = a02, s[3] = a03, s[4] = a04;
+    s[5] = a05, s[6] = a06, s[7] = a07, s[8] = a08, s[9] = a09;
+    s[10] = a10, s[11] = a11, s[12] = a12, s[13] = a13, s[14] = a14;
+    s[15] = a15, s[16] = a16, s[17] = a17, s[18] = a18, s[19] = a19;
+    s[20] = a20, s[21] = a21, s[22] = a22, s[23] = a23, s[24] = a24;
+}
+
+// keccak-256 of four messages of dataLen bytes each, stored one after the other in data
+__attribute__((target("avx2")))
+static void _BRKeccak256AVX2x4(uint8_t *md32s, const uint8_t *data, size_t dataLen)
+{
+    __m256i s[25];
+    uint64_t x[4][17], u[4];
+    size_t i, j, n, len;
+
+    for (i = 0; i < 25; i++) s[i] = _mm256_setzero_si256();
+
+    for (n = 0; n <= dataLen/136; n++) { // absorb the messages in lockstep, one 136 byte block at a time
+        len = (n*136 + 136 <= dataLen) ? 136 : dataLen - n*136;
+
+        for (j = 0; j < 4; j++) {
+            memcpy(x[j], data + j*dataLen + n*136, len);
+            if (len == 136) continue;
+            memset((uint8_t *)x[j] + len, 0, 136 - len); // clear remainder of x
+            ((uint8_t *)x[j])[len] |= 0x01; // append padding
+            ((uint8_t *)x[j])[135] |= 0x80;
         }
-        
-        *r ^= k[i]; // iota(r, i)
+
+        for (i = 0; i < 17; i++) {
+            s[i] = _mm256_xor_si256(s[i], _mm256_setr_epi64x((long long)le64(x[0][i]), (long long)le64(x[1][i]),
+                                                             (long long)le64(x[2][i]), (long long)le64(x[3][i])));
+        }
+
+        _BRKeccakF1600AVX2x4(s);
     }
-    
-    mem_clean(a, sizeof(a));
-    mem_clean(b, sizeof(b));
-    var_clean(&r0, &r1);
+
+    for (i = 0; i < 4; i++) {
+        _mm256_storeu_si256((__m256i *)u, s[i]);
+        for (j = 0; j < 4; j++) u[j] = le64(u[j]); // endian swap
+        for (j = 0; j < 4; j++) memcpy(md32s + j*32 + i*sizeof(uint64_t), &u[j], sizeof(uint64_t));
+    }
+
+    mem_clean(x, sizeof(x));
 }
 
+#endif
+
 // sha3-256: http://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.202.pdf
 void BRSHA3_256(void *md32, const void *data, size_t dataLen)
 {
@@ -498,6 +899,25 @@ void BRKeccak256(void *md32, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
+// keccak-256 of count messages of dataLen bytes each, stored one after the other in data
+void BRKeccak256Many(void *md32s, const void *data, size_t dataLen, size_t count)
+{
+    size_t i = 0;
+
+    assert(md32s != NULL || count == 0);
+    assert(data != NULL || dataLen == 0 || count == 0);
+
+#if BR_SHA256_X86
+    if (_BRSHA256GetFeatures() & BR_SHA256_X86_AVX2) {
+        for (; i + 4 <= count; i += 4) {
+            _BRKeccak256AVX2x4((uint8_t *)md32s + i*32, (const uint8_t *)data + i*dataLen, dataLen);
+        }
+    }
+#endif
+
+    for (; i < count; i++) BRKeccak256((uint8_t *)md32s + i*32, (const uint8_t *)data + i*dataLen, dataLen);
+}
+
 // basic md5 functions
 #define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
 #define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
@@ -660,6 +1080,72 @@ void BRHMAC(void *mac, void (*hash)(void *, const void *, size_t), size_t hashLe
     mem_clean(kopad, blockLen);
 }
 
+// caches the hash states after the (key xor ipad) and (key xor opad) blocks, so each mac under the same key saves two
+// block compressions, hash functions other than sha-256 and sha-512 fall back to BRHMAC() with the saved key
+void BRHMACCtxInit(BRHMACCtx *ctx, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key,
+                   size_t keyLen)
+{
+    size_t i, blockLen = (hashLen > 32) ? 128 : 64;
+    union { uint32_t u32[32]; uint64_t u64[16]; } kpad;
+
+    assert(ctx != NULL);
+    assert(hash != NULL);
+    assert(hashLen > 0 && (hashLen % 4) == 0 && hashLen <= sizeof(ctx->key));
+    assert(key != NULL || keyLen == 0);
+
+    ctx->hash = hash;
+    ctx->hashLen = hashLen;
+    if (keyLen > blockLen) hash(ctx->key, key, keyLen), keyLen = hashLen;
+    else if (keyLen > 0) memcpy(ctx->key, key, keyLen);
+    ctx->keyLen = keyLen;
+
+    if ((hash == BRSHA256 && hashLen == 32) || (hash == BRSHA512 && hashLen == 64)) {
+        memset(&kpad, 0, blockLen);
+        memcpy(&kpad, ctx->key, keyLen);
+        for (i = 0; i < blockLen/sizeof(uint64_t); i++) kpad.u64[i] ^= 0x3636363636363636;
+
+        if (hash == BRSHA256) memcpy(ctx->inner.u32, _BRSHA256IV, 32), _BRSHA256Compress(ctx->inner.u32, kpad.u32);
+        else memcpy(ctx->inner.u64, _BRSHA512IV, 64), _BRSHA512Compress(ctx->inner.u64, kpad.u64);
+
+        for (i = 0; i < blockLen/sizeof(uint64_t); i++) kpad.u64[i] ^= 0x3636363636363636 ^ 0x5c5c5c5c5c5c5c5c;
+
+        if (hash == BRSHA256) memcpy(ctx->outer.u32, _BRSHA256IV, 32), _BRSHA256Compress(ctx->outer.u32, kpad.u32);
+        else memcpy(ctx->outer.u64, _BRSHA512IV, 64), _BRSHA512Compress(ctx->outer.u64, kpad.u64);
+
+        mem_clean(ctx->key, sizeof(ctx->key)); // only the hash states are needed
+        ctx->keyLen = 0;
+        mem_clean(&kpad, sizeof(kpad));
+    }
+}
+
+// writes HMAC(key, data) to mac using the key state in ctx, mac may point to data
+void BRHMACCtxMac(void *mac, const BRHMACCtx *ctx, const void *data, size_t dataLen)
+{
+    union { uint32_t u32[8]; uint64_t u64[8]; } buf;
+    uint8_t md[64];
+
+    assert(mac != NULL);
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+
+    if (ctx->hash == BRSHA256 && ctx->hashLen == 32) {
+        memcpy(buf.u32, ctx->inner.u32, 32);
+        _BRSHA256(md, 32, buf.u32, 64, data, dataLen); // hash((key xor ipad) || data)
+        memcpy(buf.u32, ctx->outer.u32, 32);
+        _BRSHA256(mac, 32, buf.u32, 64, md, 32); // hash((key xor opad) || hash((key xor ipad) || data))
+    }
+    else if (ctx->hash == BRSHA512 && ctx->hashLen == 64) {
+        memcpy(buf.u64, ctx->inner.u64, 64);
+        _BRSHA512(md, 64, buf.u64, 128, data, dataLen); // hash((key xor ipad) || data)
+        memcpy(buf.u64, ctx->outer.u64, 64);
+        _BRSHA512(mac, 64, buf.u64, 128, md, 64); // hash((key xor opad) || hash((key xor ipad) || data))
+    }
+    else BRHMAC(mac, ctx->hash, ctx->hashLen, ctx->key, ctx->keyLen, data, dataLen);
+
+    mem_clean(&buf, sizeof(buf));
+    mem_clean(md, sizeof(md));
+}
+
 // hmac-drbg with no prediction resistance or additional input
 // K and V must point to buffers of size hashLen, and ps (personalization string) may be NULL
 // to generate additional drbg output, use K and V from the previous call, and set seed, nonce and ps to NULL
@@ -668,6 +1154,7 @@ void BRHMACDRBG(void *out, size_t outLen, void *K, void *V, void (*hash)(void *,
 {
     size_t i, bufLen = hashLen + 1 + seedLen + nonceLen + psLen;
     uint8_t buf[bufLen];
+    BRHMACCtx ctx;
     
     assert(out != NULL || outLen == 0);
     assert(K != NULL);
@@ -687,22 +1174,27 @@ void BRHMACDRBG(void *out, size_t outLen, void *K, void *V, void (*hash)(void *,
     memcpy(&buf[hashLen + 1], seed, seedLen);
     memcpy(&buf[hashLen + 1 + seedLen], nonce, nonceLen);
     memcpy(&buf[hashLen + 1 + seedLen + nonceLen], ps, psLen);
-    BRHMAC(K, hash, hashLen, K, hashLen, buf, bufLen); // K = HMAC(K, V || 0x00 || entropy || nonce || ps)
-    BRHMAC(V, hash, hashLen, K, hashLen, V, hashLen);  // V = HMAC(K, V)
+    BRHMACCtxInit(&ctx, hash, hashLen, K, hashLen);
+    BRHMACCtxMac(K, &ctx, buf, bufLen); // K = HMAC(K, V || 0x00 || entropy || nonce || ps)
+    BRHMACCtxInit(&ctx, hash, hashLen, K, hashLen);
+    BRHMACCtxMac(V, &ctx, V, hashLen);  // V = HMAC(K, V)
     
     if (seed || nonce || ps) {
         memcpy(buf, V, hashLen);
         buf[hashLen] = 0x01;
-        BRHMAC(K, hash, hashLen, K, hashLen, buf, bufLen); // K = HMAC(K, V || 0x01 || entropy || nonce || ps)
-        BRHMAC(V, hash, hashLen, K, hashLen, V, hashLen);  // V = HMAC(K, V)
+        BRHMACCtxMac(K, &ctx, buf, bufLen); // K = HMAC(K, V || 0x01 || entropy || nonce || ps)
+        BRHMACCtxInit(&ctx, hash, hashLen, K, hashLen);
+        BRHMACCtxMac(V, &ctx, V, hashLen);  // V = HMAC(K, V)
     }
     
     mem_clean(buf, bufLen);
     
     for (i = 0; i*hashLen < outLen; i++) {
-        BRHMAC(V, hash, hashLen, K, hashLen, V, hashLen); // V = HMAC(K, V)
+        BRHMACCtxMac(V, &ctx, V, hashLen); // V = HMAC(K, V)
         memcpy((uint8_t *)out + i*hashLen, V, (i*hashLen + hashLen <= outLen) ? hashLen : outLen % hashLen);
     }
+
+    var_clean(&ctx);
 }
 
 static void _BRPoly1305Compress(uint32_t h[5], const void *key32, const void *data, size_t dataLen, int final)
@@ -1109,6 +1601,7 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
 {
     uint8_t s[saltLen + sizeof(uint32_t)];
     uint32_t i, j, U[hashLen/sizeof(uint32_t)], T[hashLen/sizeof(uint32_t)];
+    BRHMACCtx ctx;
     
     assert(dk != NULL || dkLen == 0);
     assert(hash != NULL);
@@ -1118,15 +1611,16 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
     assert(rounds > 0);
     
     memcpy(s, salt, saltLen);
+    BRHMACCtxInit(&ctx, hash, hashLen, pw, pwLen);
     
     for (i = 0; i < (dkLen + hashLen - 1)/hashLen; i++) {
         j = be32(i + 1);
         memcpy(s + saltLen, &j, sizeof(j));
-        BRHMAC(U, hash, hashLen, pw, pwLen, s, sizeof(s)); // U1 = hmac_hash(pw, salt || be32(i))
+        BRHMACCtxMac(U, &ctx, s, sizeof(s)); // U1 = hmac_hash(pw, salt || be32(i))
         memcpy(T, U, sizeof(U));
         
         for (unsigned r = 1; r < rounds; r++) {
-            BRHMAC(U, hash, hashLen, pw, pwLen, U, sizeof(U)); // Urounds = hmac_hash(pw, Urounds-1)
+            BRHMACCtxMac(U, &ctx, U, sizeof(U)); // Urounds = hmac_hash(pw, Urounds-1)
             for (j = 0; j < hashLen/sizeof(uint32_t); j++) T[j] ^= U[j]; // Ti = U1 ^ U2 ^ ... ^ Urounds
         }
         
@@ -1137,6 +1631,7 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
     mem_clean(s, sizeof(s));
     mem_clean(U, sizeof(U));
     mem_clean(T, sizeof(T));
+    var_clean(&ctx);
 }
 
 // salsa20/8 stream cipher: http://cr.yp.to/snuffle.html
@@ -1224,3 +1719,18 @@ void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *
     mem_clean(v, 128*r*n);
     free(v);
 }
+
+// limits the sha-256 backends used to those of the given x86 features that the cpu supports, 0x01 sha-ni and 0x02
+// avx2, or all of them for -1, returns the features now in use, always 0 on other architectures
+int BRSHA256SetFeaturesTest(int features)
+{
+#if BR_SHA256_X86
+    pthread_once(&_BRSHA256Once, _BRSHA256Init);
+    _BRSHA256Features = _BRSHA256X86Features() & features;
+    _BRSHA256CompressX86 = (_BRSHA256Features & BR_SHA256_X86_SHANI) ? _BRSHA256CompressSHANI :
+                           _BRSHA256CompressGeneric;
+    return _BRSHA256Features;
+#else
+    return 0;
+#endif
+}
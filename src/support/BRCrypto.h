@@ -44,6 +44,10 @@ void BRSHA224(void *md28, const void *data, size_t dataLen);
 // double-sha-256 = sha-256(sha-256(x))
 void BRSHA256_2(void *md32, const void *data, size_t dataLen);
 
+// double-sha-256 of count messages of dataLen bytes each, stored one after the other in data, writes count 32 byte
+// digests to md32s, md32s may point to data if dataLen is at least 32
+void BRSHA256_2Many(void *md32s, const void *data, size_t dataLen, size_t count);
+
 void BRSHA384(void *md48, const void *data, size_t dataLen);
 
 void BRSHA512(void *md64, const void *data, size_t dataLen);
@@ -60,6 +64,13 @@ void BRSHA3_256(void *md32, const void *data, size_t dataLen);
 // keccak-256: https://keccak.team/files/Keccak-submission-3.pdf
 void BRKeccak256(void *md32, const void *data, size_t dataLen);
 
+// keccak-256 of count messages of dataLen bytes each, stored one after the other in data, writes count 32 byte digests
+// to md32s, md32s may point to data if dataLen is at least 32
+void BRKeccak256Many(void *md32s, const void *data, size_t dataLen, size_t count);
+
+// keccak-f[1600] permutation of the 25 lane state s, lanes are native endian
+void BRKeccakF1600(uint64_t *s);
+
 // md5 - for non-cryptographic use only
 void BRMD5(void *md16, const void *data, size_t dataLen);
 
@@ -72,6 +83,22 @@ uint64_t BRSip64(const void *key16, const void *data, size_t dataLen);
 void BRHMAC(void *mac, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key, size_t keyLen,
             const void *data, size_t dataLen);
 
+// hmac key state, for computing many macs under the same key
+typedef struct {
+    void (*hash)(void *, const void *, size_t);
+    size_t hashLen;
+    union { uint32_t u32[8]; uint64_t u64[8]; } inner, outer; // sha-256/sha-512 states after (key xor ipad/opad)
+    uint8_t key[128]; // key, for other hash functions
+    size_t keyLen;
+} BRHMACCtx;
+
+// ctx should be cleaned with var_clean() when no longer needed
+void BRHMACCtxInit(BRHMACCtx *ctx, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key,
+                   size_t keyLen);
+
+// writes HMAC(key, data) to mac using the key state in ctx, mac may point to data
+void BRHMACCtxMac(void *mac, const BRHMACCtx *ctx, const void *data, size_t dataLen);
+
 // hmac-drbg with no prediction resistance or additional input
 // K and V must point to buffers of size hashLen, and ps (personalization string) may be NULL
 // to generate additional drbg output, use K and V from the previous call, and set seed, nonce and ps to NULL
@@ -46,19 +46,35 @@ typedef int sqlite3_status_code;
 "CREATE TABLE IF NOT EXISTS Entity(     \n\
   Type      CHAR(64)    NOT NULL,       \n\
   Hash      CHAR(64)    NOT NULL,       \n\
-  Data      TEXT        NOT NULL,       \n\
+  Data      BLOB        NOT NULL,       \n\
   PRIMARY KEY (Type, Hash));"
 
 typedef char FileServiceSQL[1024];
 
 #define FILE_SERVICE_SDB_INSERT_ENTITY    \
-"INSERT OR REPLACE INTO Entity (Type, Hash, Data) VALUES (?, ?, ?);"
+"INSERT OR REPLACE INTO Entity (Type, Hash, Data, SortKey) VALUES (?, ?, ?, ?);"
 
 #define FILE_SERVICE_SDB_QUERY_ENTITY     \
 "SELECT Data FROM Entity WHERE Type = ? AND Hash = ?;"
 
 #define FILE_SERVICE_SDB_QUERY_ALL_ENTITY     \
-"SELECT Hash, Data FROM Entity WHERE Type = ?;"
+"SELECT Data FROM Entity WHERE Type = ?;"
+
+#define FILE_SERVICE_SDB_QUERY_CHUNK_ENTITY     \
+"SELECT rowid, SortKey, Data FROM Entity WHERE Type = ? AND rowid > ? AND rowid <= ? ORDER BY rowid LIMIT ?;"
+
+#define FILE_SERVICE_SDB_QUERY_SORTED_CHUNK_ENTITY     \
+"SELECT rowid, SortKey, Data FROM Entity WHERE Type = ? AND (SortKey, rowid) > (?, ?) AND rowid <= ? \
+ORDER BY SortKey, rowid LIMIT ?;"
+
+#define FILE_SERVICE_SDB_QUERY_UNSORTED_ENTITY     \
+"SELECT rowid, Data FROM Entity WHERE Type = ? AND SortKey IS NULL;"
+
+#define FILE_SERVICE_SDB_QUERY_MAX_ROWID     \
+"SELECT IFNULL(MAX(rowid), 0) FROM Entity;"
+
+#define FILE_SERVICE_SDB_UPDATE_SORT_KEY     \
+"UPDATE Entity SET SortKey = ? WHERE rowid = ?;"
 
 #define FILE_SERVICE_SDB_UPDATE_ENTITY     \
 "UPDATE Entity SET Data = ? WHERE Type = ? AND Hash = ?;"
@@ -72,6 +88,21 @@ typedef char FileServiceSQL[1024];
 #define FILE_SERVICE_SDB_DELETE_ALL_ENTITY     \
 "DELETE FROM Entity;"
 
+#define FILE_SERVICE_SDB_QUERY_FORMAT     \
+"PRAGMA user_version;"
+
+#define FILE_SERVICE_SDB_UPDATE_FORMAT     \
+"PRAGMA user_version = %d;"
+
+#define FILE_SERVICE_SDB_MIGRATE_HEX_TO_BLOB     \
+"UPDATE Entity SET Data = fileServiceHexDecode(Data) WHERE typeof(Data) = 'text';"
+
+#define FILE_SERVICE_SDB_MIGRATE_ADD_SORT_KEY     \
+"ALTER TABLE Entity ADD COLUMN SortKey INTEGER;"
+
+#define FILE_SERVICE_SDB_SORT_KEY_INDEX     \
+"CREATE INDEX IF NOT EXISTS EntityTypeSortKey ON Entity (Type, SortKey);"
+
 #if defined(DEBUG)
 static int needSQLiteCompileOptions = 1;
 #endif
@@ -80,9 +111,6 @@ static int needSQLiteCompileOptions = 1;
 // Convert a char into uint8_t (decode)
 #define decodeChar(c)           ((uint8_t) _hexu(c))
 
-// Convert a uint8_t into a char (encode)
-#define encodeChar(u)           ((char)    _hexc(u))
-
 static void
 hexDecode (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen) {
     //
@@ -94,17 +122,6 @@ hexDecode (uint8_t *target, size_t targetLen, const char *source, size_t sourceL
     }
 }
 
-static void
-hexEncode (char *target, size_t targetLen, const uint8_t *source, size_t sourceLen) {
-    assert (targetLen == 2 * sourceLen  + 1);
-
-    for (int i = 0; i < sourceLen; i++) {
-        target[2*i + 0] = encodeChar (source[i] >> 4);
-        target[2*i + 1] = encodeChar (source[i]);
-    }
-    target[2*sourceLen] = '\0';
-}
-
 /** Forward Declarations */
 static int
 fileServiceFailedSDB (BRFileService fs,
@@ -127,6 +144,19 @@ typedef enum {
 
 static BRFileServiceHeaderFormatVersion currentHeaderFormatVersion = HEADER_FORMAT_1;
 
+// The storage format of the 'Data' column; recorded in the SQLite 'user_version'.  A new DB has a
+// 'user_version' of zero and thus starts out, trivially, as SDB_FORMAT_HEX.
+typedef enum {
+    SDB_FORMAT_HEX,                 // header + entity bytes, hex-encoded as TEXT
+    SDB_FORMAT_BLOB,                // header + entity bytes, as a BLOB
+    SDB_FORMAT_SORT_KEY             // ... with an indexed, nullable 'SortKey' column
+} BRFileServiceSDBFormatVersion;
+
+static BRFileServiceSDBFormatVersion currentSDBFormatVersion = SDB_FORMAT_SORT_KEY;
+
+// The number of entities read from the DB, with the lock held, by `fileServiceLoadIterate()`
+#define FILE_SERVICE_LOAD_ITERATE_CHUNK_COUNT     (64)
+
 ///
 /// The handlers for a particular entity's version
 ///
@@ -145,6 +175,12 @@ typedef struct {
     char *type;
     BRFileServiceVersion currentVersion;
     BRArrayOf(BRFileServiceEntityHandler) handlers;
+
+    // The optional sort key; `sortKeyFilled` once every stored entity has one.
+    BRFileServiceContext sortKeyContext;
+    BRFileServiceSortKey sortKey;
+    BRFileServiceRelease release;
+    bool sortKeyFilled;
 } BRFileServiceEntityType;
 
 static void
@@ -193,6 +229,12 @@ struct BRFileServiceRecord {
     sqlite3_stmt *sdbDeleteStmt;
     sqlite3_stmt *sdbDeleteAllTypeStmt;
     sqlite3_stmt *sdbDeleteAllStmt;
+    sqlite3_stmt *sdbSelectChunkStmt;
+    sqlite3_stmt *sdbSelectSortedChunkStmt;
+    sqlite3_stmt *sdbSelectUnsortedStmt;
+    sqlite3_stmt *sdbSelectMaxRowidStmt;
+    sqlite3_stmt *sdbUpdateSortKeyStmt;
+    size_t sdbBatchDepth;
     bool  sdbClosed;
 #endif
 
@@ -224,10 +266,174 @@ fileServiceCreateFilePath (const char *basePath,
     return sdbPath;
 }
 
+/// MARK: - Durability Profile
+
+const BRFileServiceDurabilityProfile fileServiceDurabilityProfileDefault = {
+    false,
+    FILE_SERVICE_SYNCHRONOUS_FULL,
+    0,
+    0
+};
+
+const BRFileServiceDurabilityProfile fileServiceDurabilityProfileWAL = {
+    true,
+    FILE_SERVICE_SYNCHRONOUS_NORMAL,
+    8 * 1024,                   // 8 MiB
+    64 * 1024 * 1024            // 64 MiB
+};
+
+#if !defined(NEUTER_FILE_SERVICE)
+static sqlite3_status_code
+fileServiceSDBApplyProfile (BRFileService fs,
+                            const BRFileServiceDurabilityProfile *profile) {
+    sqlite3_status_code status;
+    FileServiceSQL sql;
+
+    if (profile->walMode) {
+        status = sqlite3_exec (fs->sdb, "PRAGMA journal_mode = WAL;", NULL, NULL, NULL);
+        if (SQLITE_OK != status) return status;
+    }
+
+    const char *synchronous = NULL;
+    switch (profile->synchronous) {
+        case FILE_SERVICE_SYNCHRONOUS_OFF:    synchronous = "OFF";    break;
+        case FILE_SERVICE_SYNCHRONOUS_NORMAL: synchronous = "NORMAL"; break;
+        case FILE_SERVICE_SYNCHRONOUS_FULL:   synchronous = "FULL";   break;
+    }
+    assert (NULL != synchronous);
+
+    sprintf (sql, "PRAGMA synchronous = %s;", synchronous);
+    status = sqlite3_exec (fs->sdb, sql, NULL, NULL, NULL);
+    if (SQLITE_OK != status) return status;
+
+    if (0 != profile->cacheSizeInKB) {
+        // A negative value is interpreted by SQLite as a size in KiB (not as a page count)
+        sprintf (sql, "PRAGMA cache_size = -%" PRIu32 ";", profile->cacheSizeInKB);
+        status = sqlite3_exec (fs->sdb, sql, NULL, NULL, NULL);
+        if (SQLITE_OK != status) return status;
+    }
+
+    if (0 != profile->mmapSizeInBytes) {
+        sprintf (sql, "PRAGMA mmap_size = %" PRIu64 ";", profile->mmapSizeInBytes);
+        status = sqlite3_exec (fs->sdb, sql, NULL, NULL, NULL);
+        if (SQLITE_OK != status) return status;
+    }
+
+    return SQLITE_OK;
+}
+
+/// An SQL function, `fileServiceHexDecode(Data)`, producing a BLOB from hex-encoded TEXT
+static void
+fileServiceSDBHexDecode (sqlite3_context *context,
+                         int argc,
+                         sqlite3_value **argv) {
+    assert (1 == argc);
+
+    const char *source = (const char *) sqlite3_value_text (argv[0]);
+    size_t sourceLen   = (size_t) sqlite3_value_bytes (argv[0]);
+
+    if (NULL == source || 0 != sourceLen % 2) {
+        sqlite3_result_error (context, "fileServiceHexDecode: invalid hex", -1);
+        return;
+    }
+
+    size_t   targetLen = sourceLen / 2;
+    uint8_t *target    = sqlite3_malloc64 (0 == targetLen ? 1 : targetLen);
+    if (NULL == target) {
+        sqlite3_result_error_nomem (context);
+        return;
+    }
+
+    hexDecode (target, targetLen, source, sourceLen);
+    sqlite3_result_blob64 (context, target, targetLen, sqlite3_free);
+}
+
+static sqlite3_status_code
+fileServiceSDBQueryFormat (BRFileService fs, int *format) {
+    sqlite3_stmt *sdbFormatStmt;
+
+    sqlite3_status_code status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_FORMAT, -1, &sdbFormatStmt, NULL);
+    if (SQLITE_OK != status) return status;
+
+    *format = SDB_FORMAT_HEX;
+    if (SQLITE_ROW == sqlite3_step (sdbFormatStmt))
+        *format = sqlite3_column_int (sdbFormatStmt, 0);
+    sqlite3_finalize (sdbFormatStmt);
+
+    return SQLITE_OK;
+}
+
+///
+/// Migrate the DB to `currentSDBFormatVersion`.  The migration is done in place, in one DB
+/// transaction.  The SDB_FORMAT_HEX to SDB_FORMAT_BLOB migration decodes TEXT values; the
+/// SDB_FORMAT_BLOB to SDB_FORMAT_SORT_KEY migration adds the 'SortKey' column, with NULL values.
+/// The format is re-read once the DB is locked; thus a concurrent migration by another connection
+/// is harmless.
+///
+static sqlite3_status_code
+fileServiceSDBMigrate (BRFileService fs) {
+    sqlite3_status_code status;
+    int format;
+
+    status = fileServiceSDBQueryFormat (fs, &format);
+    if (SQLITE_OK != status) return status;
+
+    if (format >= (int) currentSDBFormatVersion) return SQLITE_OK;
+
+    status = sqlite3_create_function (fs->sdb, "fileServiceHexDecode", 1,
+                                      SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                      NULL, fileServiceSDBHexDecode, NULL, NULL);
+    if (SQLITE_OK != status) return status;
+
+    FileServiceSQL sql;
+    sprintf (sql, FILE_SERVICE_SDB_UPDATE_FORMAT, (int) currentSDBFormatVersion);
+
+    status = sqlite3_exec (fs->sdb, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+    if (SQLITE_OK != status) return status;
+
+    int migratedCount = 0;
+
+    status = fileServiceSDBQueryFormat (fs, &format);
+
+    if (SQLITE_OK == status && format < SDB_FORMAT_BLOB) {
+        status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_MIGRATE_HEX_TO_BLOB, NULL, NULL, NULL);
+        migratedCount = sqlite3_changes (fs->sdb);
+    }
+
+    if (SQLITE_OK == status && format < SDB_FORMAT_SORT_KEY)
+        status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_MIGRATE_ADD_SORT_KEY, NULL, NULL, NULL);
+
+    if (SQLITE_OK == status)
+        status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_SORT_KEY_INDEX, NULL, NULL, NULL);
+
+    if (SQLITE_OK == status)
+        status = sqlite3_exec (fs->sdb, sql, NULL, NULL, NULL);
+
+    if (SQLITE_OK != status) {
+        sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+        return status;
+    }
+
+    status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+    if (SQLITE_OK != status) {
+        sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+        return status;
+    }
+
+    // Return the space freed by the decoding to the file system.  This is an optimization only;
+    // a failure (such as SQLITE_BUSY from another connection) is not an error.
+    if (migratedCount > 0)
+        sqlite3_exec (fs->sdb, "VACUUM", NULL, NULL, NULL);
+
+    return SQLITE_OK;
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
 extern BRFileService
 fileServiceCreate (const char *basePath,
                    const char *currency,
                    const char *network,
+                   const BRFileServiceDurabilityProfile *profile,
                    BRFileServiceContext context,
                    BRFileServiceErrorHandler handler) {
     if (NULL == basePath || 0 == strlen(basePath)) return NULL;
@@ -281,6 +487,14 @@ fileServiceCreate (const char *basePath,
     // Allow an absurdly long timeout for DB creation
     sqlite3_busy_timeout (fs->sdb, 10 * 1000); // 10 seconds
 
+    // Configure journaling, syncing and caching
+    status = fileServiceSDBApplyProfile (fs, (NULL != profile ? profile : &fileServiceDurabilityProfileDefault));
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
     // Create the SQLite 'Entity' Table
     sqlite3_stmt *sdbCreateTableStmt;
     status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_ENTITY_TABLE, -1, &sdbCreateTableStmt, NULL);
@@ -297,6 +511,14 @@ fileServiceCreate (const char *basePath,
         });
     sqlite3_finalize(sdbCreateTableStmt);
 
+    // Migrate any existing 'Entity' Table to the current storage format
+    status = fileServiceSDBMigrate (fs);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
     // Create the SQLITE 'Insert into Entity' Statement
     status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_INSERT_ENTITY, -1, &fs->sdbInsertStmt, NULL);
     if (SQLITE_OK != status)
@@ -342,6 +564,42 @@ fileServiceCreate (const char *basePath,
             { .sdb = { status }}
         });
 
+    // Create the SQLITE statements for iterating over entities, in chunks.
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_CHUNK_ENTITY, -1, &fs->sdbSelectChunkStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_SORTED_CHUNK_ENTITY, -1, &fs->sdbSelectSortedChunkStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_UNSORTED_ENTITY, -1, &fs->sdbSelectUnsortedStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_MAX_ROWID, -1, &fs->sdbSelectMaxRowidStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_UPDATE_SORT_KEY, -1, &fs->sdbUpdateSortKeyStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
 #  if defined(DEBUG)
     if (needSQLiteCompileOptions) {
         needSQLiteCompileOptions = 0;
@@ -379,6 +637,13 @@ _fileServiceCloseInternal (BRFileService fs) {
     if (fs->sdbClosed) return;
 
     fs->sdbClosed = true;
+
+    // Commit any batch left open.
+    if (0 != fs->sdbBatchDepth) {
+        sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+        fs->sdbBatchDepth = 0;
+    }
+
     _fileServiceFinalizeStmt (fs, &fs->sdbInsertStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbSelectStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbSelectAllStmt);
@@ -386,6 +651,11 @@ _fileServiceCloseInternal (BRFileService fs) {
     _fileServiceFinalizeStmt (fs, &fs->sdbDeleteStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbDeleteAllTypeStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbDeleteAllStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbSelectChunkStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbSelectSortedChunkStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbSelectUnsortedStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbSelectMaxRowidStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbUpdateSortKeyStmt);
 
     if (NULL != fs->sdb) sqlite3_close (fs->sdb);
     fs->sdb = NULL;
@@ -455,7 +725,11 @@ fileServiceAddType (const BRFileService fs,
     BRFileServiceEntityType entityType = {
         strdup (type),
         version,
-        NULL
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        false
     };
     array_new (entityType.handlers, FILE_SERVICE_INITIAL_HANDLER_COUNT);
 
@@ -555,6 +829,43 @@ fileServiceFailedEntity(BRFileService fs,
                                       });
 }
 
+/// MARK: - Sort Key
+
+#if !defined(NEUTER_FILE_SERVICE)
+// SQLite INTEGERs are signed; map a sort key onto them while preserving the sort order.
+static sqlite3_int64
+fileServiceSortKeyToSDB (uint64_t sortKey) {
+    return (sortKey > (uint64_t) INT64_MAX
+            ? (sqlite3_int64) (sortKey - (uint64_t) INT64_MAX - 1)
+            : (sqlite3_int64) sortKey - INT64_MAX - 1);
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+/// MARK: - Transaction
+
+// Each multi-statement operation runs within a SAVEPOINT, rather than a BEGIN/COMMIT, so that it
+// composes with an enclosing batch (see `fileServiceBeginBatch()`).  Called while locked.
+
+static sqlite3_status_code
+_fileServiceSavepointBegin (BRFileService fs) {
+    return sqlite3_exec (fs->sdb, "SAVEPOINT fileService", NULL, NULL, NULL);
+}
+
+static sqlite3_status_code
+_fileServiceSavepointEnd (BRFileService fs, bool commit) {
+    sqlite3_status_code status = SQLITE_OK;
+
+    if (commit) {
+        status = sqlite3_exec (fs->sdb, "RELEASE fileService", NULL, NULL, NULL);
+        if (SQLITE_OK == status) return status;
+    }
+
+    // Rollback on failure, returning the original failure status (if any).
+    sqlite3_exec (fs->sdb, "ROLLBACK TO fileService", NULL, NULL, NULL);
+    sqlite3_exec (fs->sdb, "RELEASE fileService", NULL, NULL, NULL);
+    return status;
+}
+
 /// MARK: - Save
 
 static int
@@ -598,11 +909,9 @@ _fileServiceSave (BRFileService fs,
     memcpy (&bytes[offset], entityBytes, entityBytesCount);
     free (entityBytes);
 
-    // Nex encode bytes
-    size_t dataCount = 2 * bytesCount + 1;
-    char *data = malloc (dataCount);
-    hexEncode (data, dataCount, bytes, bytesCount);
-    free (bytes);
+    uint64_t sortKey = (NULL != entityType->sortKey
+                        ? entityType->sortKey (entityType->sortKeyContext, fs, entity)
+                        : 0);
 
     // Fill out the SQL statement
     sqlite3_status_code status;
@@ -611,38 +920,36 @@ _fileServiceSave (BRFileService fs,
         pthread_mutex_lock (&fs->lock);
 
     if (fs->sdbClosed)
-        return fileServiceFailedImpl (fs, needLock, NULL, NULL, "closed");
+        return fileServiceFailedImpl (fs, needLock, bytes, NULL, "closed");
 
     sqlite3_reset (fs->sdbInsertStmt);
     sqlite3_clear_bindings(fs->sdbInsertStmt);
 
     status = sqlite3_bind_text (fs->sdbInsertStmt, 1, type, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
-    }
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDBWithBufferFree (fs, needLock, bytes, status);
 
     status = sqlite3_bind_text (fs->sdbInsertStmt, 2, hash, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
-    }
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDBWithBufferFree (fs, needLock, bytes, status);
 
-    status = sqlite3_bind_text (fs->sdbInsertStmt, 3, data, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
-    }
+    status = sqlite3_bind_blob (fs->sdbInsertStmt, 3, bytes, (int) bytesCount, SQLITE_STATIC);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDBWithBufferFree (fs, needLock, bytes, status);
+
+    status = (NULL != entityType->sortKey
+              ? sqlite3_bind_int64 (fs->sdbInsertStmt, 4, fileServiceSortKeyToSDB (sortKey))
+              : sqlite3_bind_null  (fs->sdbInsertStmt, 4));
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDBWithBufferFree (fs, needLock, bytes, status);
 
     status = sqlite3_step (fs->sdbInsertStmt);
     if (SQLITE_DONE != status) {
         int retries = 3;
         while (retries-- > 0 && status != SQLITE_DONE && status != SQLITE_BUSY)
             status = sqlite3_step (fs->sdbInsertStmt);
-        if (0 == retries) {
-            free (data);
-            return fileServiceFailedSDB (fs, needLock, status);
-        }
+        if (0 == retries)
+            return fileServiceFailedSDBWithBufferFree (fs, needLock, bytes, status);
     }
 
     // Ensure the 'implicit DB transaction' is committed.
@@ -651,7 +958,7 @@ _fileServiceSave (BRFileService fs,
     if (needLock)
         pthread_mutex_unlock (&fs->lock);
 
-    free (data);
+    free (bytes);
 #endif // !defined(NEUTER_FILE_SERVICE)
 
     return 1;
@@ -664,8 +971,171 @@ fileServiceSave (BRFileService fs,
     return _fileServiceSave (fs, type, entity, 1);
 }
 
+extern int
+fileServiceSaveMany (BRFileService fs,
+                     const char *type,
+                     const void **entities,
+                     size_t entitiesCount) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType)
+        return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    if (0 == entitiesCount) return 1;
+
+#if !defined(NEUTER_FILE_SERVICE)
+    sqlite3_status_code status;
+
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    status = _fileServiceSavepointBegin (fs);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    for (size_t index = 0; index < entitiesCount; index++)
+        if (0 == _fileServiceSave (fs, type, entities[index], 0)) {
+            // The failure has been reported and the lock remains held (`needLock` was 0).
+            _fileServiceSavepointEnd (fs, false);
+            pthread_mutex_unlock (&fs->lock);
+            return 0;
+        }
+
+    status = _fileServiceSavepointEnd (fs, true);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    pthread_mutex_unlock (&fs->lock);
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+    return 1;
+}
+
+/// MARK: - Batch
+
+extern int
+fileServiceBeginBatch (BRFileService fs) {
+    if (NULL == fs) return 0;
+
+#if !defined(NEUTER_FILE_SERVICE)
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    if (0 == fs->sdbBatchDepth) {
+        sqlite3_status_code status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
+        if (SQLITE_OK != status)
+            return fileServiceFailedSDB (fs, 1, status);
+    }
+    fs->sdbBatchDepth += 1;
+
+    pthread_mutex_unlock (&fs->lock);
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+    return 1;
+}
+
+extern int
+fileServiceCommitBatch (BRFileService fs) {
+    if (NULL == fs) return 0;
+
+#if !defined(NEUTER_FILE_SERVICE)
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    if (0 == fs->sdbBatchDepth)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "missed batch");
+
+    fs->sdbBatchDepth -= 1;
+    if (0 == fs->sdbBatchDepth) {
+        sqlite3_status_code status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+        if (SQLITE_OK != status) {
+            sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+            return fileServiceFailedSDB (fs, 1, status);
+        }
+    }
+
+    pthread_mutex_unlock (&fs->lock);
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+    return 1;
+}
+
 /// MARK: - Load
 
+#if !defined(NEUTER_FILE_SERVICE)
+///
+/// Read an entity from `dataBytes`, the header and entity bytes of one 'Data' value.  If the
+/// entity is not stored in the current header format and version, `needUpdate` is set.  On
+/// failure, report it and return NULL.
+///
+static void *
+_fileServiceReadEntity (BRFileService fs,
+                        int releaseLock,
+                        BRFileServiceEntityType *entityType,
+                        const uint8_t *dataBytes,
+                        size_t dataBytesCount,
+                        bool *needUpdate) {
+    size_t offset = 0;
+    BRFileServiceVersion version;
+    uint32_t  entityBytesCount;
+    uint8_t  *entityBytes;
+
+    if (0 == dataBytesCount)
+        return (fileServiceFailedImpl (fs, releaseLock, NULL, NULL, "missed header"), NULL);
+
+    BRFileServiceHeaderFormatVersion headerVersion = dataBytes[offset];
+    offset += 1;
+
+    switch (headerVersion) {
+        case HEADER_FORMAT_1:
+            if (offset + 1 + sizeof (uint32_t) > dataBytesCount)
+                return (fileServiceFailedImpl (fs, releaseLock, NULL, NULL, "missed header"), NULL);
+
+            version = dataBytes[offset];
+            offset += 1;
+
+            entityBytesCount = UInt32GetBE (&dataBytes[offset]);
+            offset += sizeof (uint32_t);
+
+            break;
+
+        default:
+            return (fileServiceFailedImpl (fs, releaseLock, NULL, NULL, "missed header format"), NULL);
+    }
+
+    // Assert entityBytesCount remain in dataBytes
+    if (offset + entityBytesCount > dataBytesCount) {
+        assert (0); // In DEBUG builds.
+        return (fileServiceFailedImpl (fs, releaseLock, NULL, NULL, "missed bytes count"), NULL);
+    }
+
+    entityBytes = (uint8_t *) &dataBytes[offset];
+
+    switch (headerVersion) {
+        case HEADER_FORMAT_1:
+            // compute then compare checksum
+            break;
+    }
+
+    // Look up the entity handler
+    BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, version);
+    if (NULL == handler)
+        return (fileServiceFailedImpl (fs, releaseLock, NULL, NULL, "missed type handler"), NULL);
+
+    // Read the entity from buffer
+    void *entity = handler->reader (handler->context, fs, entityBytes, entityBytesCount);
+    if (NULL == entity)
+        return (fileServiceFailedEntity (fs, releaseLock, NULL, NULL, entityType->type, "reader"), NULL);
+
+    *needUpdate = (version       != entityType->currentVersion ||
+                   headerVersion != currentHeaderFormatVersion);
+
+    return entity;
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
 extern int
 fileServiceLoad (BRFileService fs,
                  BRSet *results,
@@ -691,83 +1161,19 @@ fileServiceLoad (BRFileService fs,
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
-    uint8_t  dataBytesBuffer[8196];
-    uint8_t *dataBytes = dataBytesBuffer;
-    size_t   dataBytesCount = 8196;
-
-    // Zero out the dataByte memory to avoid subsequent Clang Static Analysis errors releted
-    // to dereferencing uninitialized memory.  We accept this minimal, extraneous function call.
-    memset(dataBytes, 0, dataBytesCount);
-
     BRArrayOf(void*) entitiesToSave = NULL;
 
     while (SQLITE_ROW == sqlite3_step(fs->sdbSelectAllStmt)) {
-        const char *hash = (const char *) sqlite3_column_text (fs->sdbSelectAllStmt, 0);
-        const char *data = (const char *) sqlite3_column_text (fs->sdbSelectAllStmt, 1);
-
-        if (NULL == hash || NULL == data)
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed query `hash` or `data`");
-
-        assert (64 == strlen (hash));
-        
-        // Ensure `dataBytes` is large enough for hex-decoded `data`
-        size_t dataCount = strlen (data);
-        assert (0 == dataCount % 2);  // Surely 'even'
-        if ((dataCount/2) > dataBytesCount) {
-            if (dataBytes != dataBytesBuffer) free (dataBytes);
-            dataBytesCount = dataCount/2;
-            dataBytes = malloc (dataBytesCount);
-        }
+        // Read the entity straight out of the BLOB; valid until the next step (or reset).
+        const uint8_t *dataBytes = (const uint8_t *) sqlite3_column_blob (fs->sdbSelectAllStmt, 0);
+        size_t dataBytesCount    = (size_t) sqlite3_column_bytes (fs->sdbSelectAllStmt, 0);
 
-        // Actually decode `data` into `dataBytes`
-        hexDecode (dataBytes, dataCount/2, data, dataCount);
+        if (NULL == dataBytes || SQLITE_BLOB != sqlite3_column_type (fs->sdbSelectAllStmt, 0))
+            return fileServiceFailedImpl (fs, 1, NULL, NULL, "missed query `data`");
 
-        size_t offset = 0;
-        BRFileServiceVersion version;
-        uint32_t  entityBytesCount;
-        uint8_t  *entityBytes;
-
-        BRFileServiceHeaderFormatVersion headerVersion = dataBytes[offset];
-        offset += 1;
-
-        switch (headerVersion) {
-            case HEADER_FORMAT_1:
-                version = dataBytes[offset];
-                offset += 1;
-
-                entityBytesCount = UInt32GetBE (&dataBytes[offset]);
-                offset += sizeof (uint32_t);
-
-                break;
-        }
-
-        // Assert entityBytesCount remain in dataBytes
-        if (offset + entityBytesCount > dataBytesCount) {
-            assert (0); // In DEBUG builds.
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed bytes count");
-        }
-
-        entityBytes = &dataBytes[offset];
-
-        switch (headerVersion) {
-            case HEADER_FORMAT_1:
-                // compute then compare checksum
-                break;
-        }
-
-        // Look up the entity handler
-        BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, version);
-        if (NULL == handler)
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed type handler");
-
-        // Read the entity from buffer and add to results.
-        void *entity = handler->reader (handler->context, fs, entityBytes, entityBytesCount);
-        if (NULL == entity)
-            return fileServiceFailedEntity (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                            type, "reader");
+        bool needUpdate = false;
+        void *entity = _fileServiceReadEntity (fs, 1, entityType, dataBytes, dataBytesCount, &needUpdate);
+        if (NULL == entity) return 0;
 
         // Update results with the newly restored entity
         void *oldEntity = BRSetAdd (results, entity);
@@ -776,14 +1182,11 @@ fileServiceLoad (BRFileService fs,
         if (NULL != oldEntity) {
             assert (true);  // DEBUG builds
             // TODO: Is this too harsh?
-            return fileServiceFailedEntity (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                            type, "duplicate set entry");
+            return fileServiceFailedEntity (fs, 1, NULL, NULL, type, "duplicate set entry");
         }
 
         // If the read version is not the current version, update
-        if (updateVersion &&
-            (version != entityType->currentVersion ||
-             headerVersion != currentHeaderFormatVersion)) {
+        if (updateVersion && needUpdate) {
             if (NULL == entitiesToSave) array_new (entitiesToSave, 100);
             array_add (entitiesToSave, entity);
         }
@@ -803,8 +1206,240 @@ fileServiceLoad (BRFileService fs,
     }
 
     pthread_mutex_unlock (&fs->lock);
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+    return 1;
+}
 
-    if (dataBytes != dataBytesBuffer) free (dataBytes);
+#if !defined(NEUTER_FILE_SERVICE)
+typedef struct {
+    sqlite3_int64 rowid;
+    sqlite3_int64 sortKey;
+} BRFileServiceSortKeyUpdate;
+
+///
+/// Fill in the sort key of every entity of `entityType` saved before the sort key was defined.
+/// This reads (and releases) each such entity, once; the updates are applied together.
+///
+static int
+_fileServiceFillSortKeys (BRFileService fs,
+                          BRFileServiceEntityType *entityType) {
+    sqlite3_status_code status;
+
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    // Another iteration may have filled in the sort keys while we waited.
+    if (entityType->sortKeyFilled) {
+        pthread_mutex_unlock (&fs->lock);
+        return 1;
+    }
+
+    sqlite3_reset (fs->sdbSelectUnsortedStmt);
+    sqlite3_clear_bindings (fs->sdbSelectUnsortedStmt);
+
+    status = sqlite3_bind_text (fs->sdbSelectUnsortedStmt, 1, entityType->type, -1, SQLITE_STATIC);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    // Collect the updates; don't update the index being queried.
+    BRArrayOf(BRFileServiceSortKeyUpdate) updates;
+    array_new (updates, 100);
+
+    while (SQLITE_ROW == (status = sqlite3_step (fs->sdbSelectUnsortedStmt))) {
+        const uint8_t *dataBytes = (const uint8_t *) sqlite3_column_blob (fs->sdbSelectUnsortedStmt, 1);
+        size_t dataBytesCount    = (size_t) sqlite3_column_bytes (fs->sdbSelectUnsortedStmt, 1);
+
+        if (NULL == dataBytes || SQLITE_BLOB != sqlite3_column_type (fs->sdbSelectUnsortedStmt, 1)) {
+            sqlite3_reset (fs->sdbSelectUnsortedStmt);
+            array_free (updates);
+            return fileServiceFailedImpl (fs, 1, NULL, NULL, "missed query `data`");
+        }
+
+        bool needUpdate = false;
+        void *entity = _fileServiceReadEntity (fs, 0, entityType, dataBytes, dataBytesCount, &needUpdate);
+        if (NULL == entity) {
+            // The failure has been reported and the lock remains held (`releaseLock` was 0).
+            sqlite3_reset (fs->sdbSelectUnsortedStmt);
+            array_free (updates);
+            pthread_mutex_unlock (&fs->lock);
+            return 0;
+        }
+
+        BRFileServiceSortKeyUpdate update = {
+            sqlite3_column_int64 (fs->sdbSelectUnsortedStmt, 0),
+            fileServiceSortKeyToSDB (entityType->sortKey (entityType->sortKeyContext, fs, entity))
+        };
+        array_add (updates, update);
+
+        entityType->release (entityType->sortKeyContext, fs, entity);
+    }
+    sqlite3_reset (fs->sdbSelectUnsortedStmt);
+
+    if (SQLITE_DONE != status) {
+        array_free (updates);
+        return fileServiceFailedSDB (fs, 1, status);
+    }
+
+    status = _fileServiceSavepointBegin (fs);
+    for (size_t index = 0; SQLITE_OK == status && index < array_count (updates); index++) {
+        sqlite3_reset (fs->sdbUpdateSortKeyStmt);
+        sqlite3_clear_bindings (fs->sdbUpdateSortKeyStmt);
+
+        status = sqlite3_bind_int64 (fs->sdbUpdateSortKeyStmt, 1, updates[index].sortKey);
+        if (SQLITE_OK == status)
+            status = sqlite3_bind_int64 (fs->sdbUpdateSortKeyStmt, 2, updates[index].rowid);
+        if (SQLITE_OK == status && SQLITE_DONE != (status = sqlite3_step (fs->sdbUpdateSortKeyStmt)))
+            break;
+
+        status = SQLITE_OK;
+    }
+    sqlite3_reset (fs->sdbUpdateSortKeyStmt);
+    status = _fileServiceSavepointEnd (fs, SQLITE_OK == status);
+
+    array_free (updates);
+
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    entityType->sortKeyFilled = true;
+
+    pthread_mutex_unlock (&fs->lock);
+    return 1;
+}
+
+typedef struct {
+    uint8_t *bytes;
+    size_t   bytesCount;
+} BRFileServiceLoadChunkRow;
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+extern int
+fileServiceLoadIterate (BRFileService fs,
+                        const char *type,
+                        int updateVersion,
+                        BRFileServiceContext context,
+                        BRFileServiceLoadHandler handler) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
+    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  0, NULL, NULL, "missed type handler");
+
+#if !defined(NEUTER_FILE_SERVICE)
+    sqlite3_status_code status;
+
+    bool sorted = (NULL != entityType->sortKey);
+
+    if (sorted && !entityType->sortKeyFilled && 1 != _fileServiceFillSortKeys (fs, entityType))
+        return 0;
+
+    // Bound the iteration by the current largest rowid.  Saving an entity, such as when updating
+    // its version, replaces its row with one having a larger rowid; it won't be revisited.
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    sqlite3_reset (fs->sdbSelectMaxRowidStmt);
+    status = sqlite3_step (fs->sdbSelectMaxRowidStmt);
+    if (SQLITE_ROW != status) {
+        sqlite3_reset (fs->sdbSelectMaxRowidStmt);
+        return fileServiceFailedSDB (fs, 1, status);
+    }
+    sqlite3_int64 rowidLimit = sqlite3_column_int64 (fs->sdbSelectMaxRowidStmt, 0);
+    sqlite3_reset (fs->sdbSelectMaxRowidStmt);
+
+    pthread_mutex_unlock (&fs->lock);
+
+    sqlite3_stmt *stmt = (sorted ? fs->sdbSelectSortedChunkStmt : fs->sdbSelectChunkStmt);
+
+    // The (SortKey, rowid) of the last row read; the next chunk starts after it.
+    sqlite3_int64 rowidLast   = INT64_MIN;
+    sqlite3_int64 sortKeyLast = INT64_MIN;
+
+    BRFileServiceLoadChunkRow rows[FILE_SERVICE_LOAD_ITERATE_CHUNK_COUNT];
+    int more = 1;
+
+    while (more) {
+        size_t rowsCount = 0;
+        int    bind = 1;
+
+        pthread_mutex_lock (&fs->lock);
+        if (fs->sdbClosed)
+            return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+        sqlite3_reset (stmt);
+        sqlite3_clear_bindings (stmt);
+
+        status = sqlite3_bind_text (stmt, bind++, type, -1, SQLITE_STATIC);
+        if (SQLITE_OK == status && sorted)
+            status = sqlite3_bind_int64 (stmt, bind++, sortKeyLast);
+        if (SQLITE_OK == status)
+            status = sqlite3_bind_int64 (stmt, bind++, rowidLast);
+        if (SQLITE_OK == status)
+            status = sqlite3_bind_int64 (stmt, bind++, rowidLimit);
+        if (SQLITE_OK == status)
+            status = sqlite3_bind_int (stmt, bind++, FILE_SERVICE_LOAD_ITERATE_CHUNK_COUNT);
+        if (SQLITE_OK != status)
+            return fileServiceFailedSDB (fs, 1, status);
+
+        // Copy out the chunk's 'Data' values; the entities are read without the lock.
+        while (rowsCount < FILE_SERVICE_LOAD_ITERATE_CHUNK_COUNT &&
+               SQLITE_ROW == (status = sqlite3_step (stmt))) {
+            const uint8_t *dataBytes = (const uint8_t *) sqlite3_column_blob (stmt, 2);
+            size_t dataBytesCount    = (size_t) sqlite3_column_bytes (stmt, 2);
+
+            if (NULL == dataBytes || SQLITE_BLOB != sqlite3_column_type (stmt, 2)) {
+                status = SQLITE_MISMATCH;
+                break;
+            }
+
+            rows[rowsCount].bytes      = malloc (dataBytesCount);
+            rows[rowsCount].bytesCount = dataBytesCount;
+            memcpy (rows[rowsCount].bytes, dataBytes, dataBytesCount);
+            rowsCount += 1;
+
+            rowidLast   = sqlite3_column_int64 (stmt, 0);
+            sortKeyLast = sqlite3_column_int64 (stmt, 1);
+        }
+        sqlite3_reset (stmt);
+
+        if (SQLITE_ROW != status && SQLITE_DONE != status) {
+            for (size_t index = 0; index < rowsCount; index++)
+                free (rows[index].bytes);
+            return (SQLITE_MISMATCH == status
+                    ? fileServiceFailedImpl (fs, 1, NULL, NULL, "missed query `data`")
+                    : fileServiceFailedSDB (fs, 1, status));
+        }
+
+        pthread_mutex_unlock (&fs->lock);
+
+        int failed = 0, stopped = 0;
+
+        for (size_t index = 0; index < rowsCount; index++) {
+            // Once failed or stopped, just free the remaining rows.
+            if (!failed && !stopped) {
+                bool needUpdate = false;
+                void *entity = _fileServiceReadEntity (fs, 0, entityType, rows[index].bytes, rows[index].bytesCount, &needUpdate);
+
+                if (NULL == entity) failed = 1;
+                else {
+                    // If the read version is not the current version, update.  As with
+                    // `fileServiceLoad()` a failure is reported but otherwise ignored.
+                    if (updateVersion && needUpdate)
+                        _fileServiceSave (fs, type, entity, 1);
+
+                    stopped = !handler (context, fs, type, entity);
+                }
+            }
+            free (rows[index].bytes);
+        }
+
+        if (failed) return 0;
+
+        more = (!stopped && FILE_SERVICE_LOAD_ITERATE_CHUNK_COUNT == rowsCount);
+    }
 #endif // !defined(NEUTER_FILE_SERVICE)
 
     return 1;
@@ -919,6 +1554,9 @@ fileServiceClearAll (BRFileService fs) {
 
 static int
 fileServiceReplaceFailed (BRFileService fs, int needUnlock) {
+#if !defined(NEUTER_FILE_SERVICE)
+    _fileServiceSavepointEnd (fs, false);
+#endif
     if (needUnlock) pthread_mutex_unlock (&fs->lock);
     return 0;
 }
@@ -939,7 +1577,7 @@ fileServiceReplace (BRFileService fs,
     if (fs->sdbClosed)
         return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
 
-    status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
+    status = _fileServiceSavepointBegin (fs);
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
@@ -950,7 +1588,7 @@ fileServiceReplace (BRFileService fs,
         if (0 == _fileServiceSave (fs, type, entities[index], 0))
             return fileServiceReplaceFailed (fs, 1);
 
-    status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+    status = _fileServiceSavepointEnd (fs, true);
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
@@ -1016,15 +1654,17 @@ fileServicePurge (BRFileService fs) {
     if (fs->sdbClosed)
         return fileServiceFailedImpl (fs, 1, sql, NULL, "closed");
 
-    status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
+    status = _fileServiceSavepointBegin (fs);
     if (SQLITE_OK != status)
         return fileServiceFailedSDBWithBufferFree (fs, 1, sql, status);
 
     status = sqlite3_exec(fs->sdb, sql, NULL, NULL, NULL);
-    if (SQLITE_OK != status)
+    if (SQLITE_OK != status) {
+        _fileServiceSavepointEnd (fs, false);
         return fileServiceFailedSDBWithBufferFree (fs, 1, sql, status);
+    }
 
-    status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+    status = _fileServiceSavepointEnd (fs, true);
     if (SQLITE_OK != status)
         return fileServiceFailedSDBWithBufferFree (fs, 1, sql, status);
 
@@ -1048,6 +1688,17 @@ fileServiceWipe (const char *basePath,
     // Remove it.
     result  = (0 == remove (sdbPath) ? 0 : errno);
     free (sdbPath);
+
+    // Remove any WAL journal files too; these need not exist.
+    const char *sdbJournalFilenames[] = {
+        FILE_SERVICE_SDB_FILENAME "-wal",
+        FILE_SERVICE_SDB_FILENAME "-shm"
+    };
+    for (size_t index = 0; index < sizeof (sdbJournalFilenames) / sizeof (char *); index++) {
+        sdbPath = fileServiceCreateFilePath (basePath, currency, network, sdbJournalFilenames[index]);
+        remove (sdbPath);
+        free (sdbPath);
+    }
 #endif
 
     return result;
@@ -1130,10 +1781,32 @@ fileServiceDefineCurrentVersion (BRFileService fs,
     return 1;
 }
 
+extern int
+fileServiceDefineSortKey (BRFileService fs,
+                          const char *type,
+                          BRFileServiceContext context,
+                          BRFileServiceSortKey sortKey,
+                          BRFileServiceRelease release) {
+    // Find the entityType for `type`
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    // Filling in the sort key of existing entities requires releasing them.
+    if (NULL != sortKey && NULL == release) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type release");
+
+    entityType->sortKeyContext = context;
+    entityType->sortKey        = sortKey;
+    entityType->release        = release;
+    entityType->sortKeyFilled  = false;
+
+    return 1;
+}
+
 extern BRFileService
 fileServiceCreateFromTypeSpecifications(const char *basePath,
                                         const char *currency,
                                         const char *network,
+                                        const BRFileServiceDurabilityProfile *profile,
                                         BRFileServiceContext context,
                                         BRFileServiceErrorHandler handler,
                                         size_t specificationsCount,
@@ -1143,6 +1816,7 @@ fileServiceCreateFromTypeSpecifications(const char *basePath,
     BRFileService fileService = fileServiceCreate (basePath,
                                                    currency,
                                                    network,
+                                                   profile,
                                                    context,
                                                    handler);
     if (NULL == fileService) return NULL;
@@ -1164,6 +1838,14 @@ fileServiceCreateFromTypeSpecifications(const char *basePath,
                                                     specification->type,
                                                     specification->defaultVersion);
         if (!success) break;
+
+        if (NULL != specification->sortKey)
+            success &= fileServiceDefineSortKey (fileService,
+                                                 specification->type,
+                                                 context,
+                                                 specification->sortKey,
+                                                 specification->release);
+        if (!success) break;
     }
 
     if (success) return fileService;
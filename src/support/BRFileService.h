@@ -84,11 +84,45 @@ typedef void
 /// This *must* be the same fixed size type forever.  It is uint8_t.
 typedef uint8_t BRFileServiceVersion;
 
+/// The SQLite `synchronous` setting; see https://sqlite.org/pragma.html#pragma_synchronous
+typedef enum {
+    FILE_SERVICE_SYNCHRONOUS_OFF,
+    FILE_SERVICE_SYNCHRONOUS_NORMAL,
+    FILE_SERVICE_SYNCHRONOUS_FULL
+} BRFileServiceSynchronous;
+
+/**
+ * The durability/throughput tradeoff for the file service's DB.
+ */
+typedef struct {
+    /// If true, use WAL journaling; readers then don't block the writer (and vice versa).  If
+    /// false, the DB's journal mode is left unchanged (WAL is persistent once set).
+    bool walMode;
+
+    /// When to sync to storage.  With `walMode`, NORMAL is durable except on power loss.
+    BRFileServiceSynchronous synchronous;
+
+    /// The page cache size, in KiB; 0 for the SQLite default.
+    uint32_t cacheSizeInKB;
+
+    /// The maximum size, in bytes, of memory-mapped I/O; 0 to disable.
+    uint64_t mmapSizeInBytes;
+} BRFileServiceDurabilityProfile;
+
+/// Rollback journal and FULL synchronous (the SQLite defaults).
+extern const BRFileServiceDurabilityProfile fileServiceDurabilityProfileDefault;
+
+/// WAL journal, NORMAL synchronous, an enlarged page cache and memory-mapped I/O.
+extern const BRFileServiceDurabilityProfile fileServiceDurabilityProfileWAL;
+
 /// TODO: There are limitations on `currency`, `network`, and `type`.
+///
+/// If `profile` is NULL then `fileServiceDurabilityProfileDefault` is used.
 extern BRFileService
 fileServiceCreate (const char *basePath,
                    const char *currency,
                    const char *network,
+                   const BRFileServiceDurabilityProfile *profile,
                    BRFileServiceContext context,
                    BRFileServiceErrorHandler handler);
 
@@ -129,11 +163,72 @@ fileServiceLoad (BRFileService fs,
                  const char *type,   /* blocks, peers, transactions, logs, ... */
                  int updateVersion);
 
+/**
+ * A function type invoked, by `fileServiceLoadIterate()`, with each loaded entity.  You own the
+ * entity.  Return true (1) to continue the iteration, false (0) to stop it.
+ */
+typedef int
+(*BRFileServiceLoadHandler) (BRFileServiceContext context,
+                             BRFileService fs,
+                             const char *type,
+                             void *entity);
+
+/**
+ * Load all entities of `type` passing each, in turn, to `handler`.  Unlike `fileServiceLoad()`
+ * the entities are not accumulated; they are read from the DB in small chunks and the
+ * fileService's lock is not held while `handler` is invoked (thus `handler` may use `fs`).  If
+ * `type` has a sort key (see `fileServiceDefineSortKey()`) the entities are loaded in order of
+ * increasing sort key; otherwise in an unspecified, but stable, order.
+ *
+ * Entities saved or replaced while the iteration is in progress are not visited.  If there is an
+ * error then the fileServices' error handler is invoked and 0 is returned.
+ *
+ * @param fs The fileService
+ * @param type The type to restore
+ * @param updateVersion If true (1) update old versions with newer ones.
+ * @param context An arbitrary value passed to `handler`
+ * @param handler The function invoked with each entity
+ *
+ * @return true (1) if success, false (0) otherwise;
+ */
+extern int
+fileServiceLoadIterate (BRFileService fs,
+                        const char *type,
+                        int updateVersion,
+                        BRFileServiceContext context,
+                        BRFileServiceLoadHandler handler);
+
 extern int  // 1 -> success, 0 -> failure
 fileServiceSave (BRFileService fs,
                  const char *type,  /* block, peers, transactions, logs, ... */
                  const void *entity);     /* BRMerkleBlock*, BRTransaction, BREthereumTransaction, ... */
 
+/**
+ * Save `entitiesCount` entities of `type`, all within a single DB transaction.  On any failure
+ * none of the entities are saved.
+ *
+ * @return true (1) if success, false (0) otherwise;
+ */
+extern int  // 1 -> success, 0 -> failure
+fileServiceSaveMany (BRFileService fs,
+                     const char *type,
+                     const void **entities,
+                     size_t entitiesCount);
+
+/**
+ * Begin a batch.  Until the matching `fileServiceCommitBatch()` all saves, removes, replaces and
+ * clears, of any type, are committed to the DB together, in a single DB transaction.  Batches
+ * nest; only the outermost commit writes to the DB.
+ */
+extern int  // 1 -> success, 0 -> failure
+fileServiceBeginBatch (BRFileService fs);
+
+/**
+ * Commit a batch begun with `fileServiceBeginBatch()`.
+ */
+extern int  // 1 -> success, 0 -> failure
+fileServiceCommitBatch (BRFileService fs);
+
 extern int  // 1 -> success, 0 -> failure
 fileServiceRemove (BRFileService fs,
                    const char *type,
@@ -190,6 +285,23 @@ typedef uint8_t*
                         const void* entity,
                         uint32_t *bytesCount);
 
+/**
+ * A function type to produce a sort key from an entity.  Entities of a type with a sort key are
+ * loaded, by `fileServiceLoadIterate()`, in order of increasing sort key (such as a block height).
+ */
+typedef uint64_t
+(*BRFileServiceSortKey) (BRFileServiceContext context,
+                         BRFileService fs,
+                         const void* entity);
+
+/**
+ * A function type to release an entity produced by a `BRFileServiceReader`.
+ */
+typedef void
+(*BRFileServiceRelease) (BRFileServiceContext context,
+                         BRFileService fs,
+                         void* entity);
+
 /// TODO: There is a limitation on `type`.
 
 /**
@@ -220,6 +332,26 @@ fileServiceDefineCurrentVersion (BRFileService fs,
                                  const char *type,
                                  BRFileServiceVersion version);
 
+/**
+ * Define the sort key for a 'type'.  The sort key is stored, indexed, with each saved entity.
+ * Entities saved before the sort key was defined are read (and then released with `release`) on
+ * the first `fileServiceLoadIterate()` of `type` to fill in their sort key.
+ *
+ * @param fs the file service
+ * @param type the type, previously defined with `fileServiceDefineType()`
+ * @param context an arbitrary value to be passed to `sortKey` and `release`
+ * @param sortKey the function that produces the sort key
+ * @param release the function that releases an entity
+ *
+ * @return true (1) if success, false (0) otherwise
+ */
+extern int
+fileServiceDefineSortKey (BRFileService fs,
+                          const char *type,
+                          BRFileServiceContext context,
+                          BRFileServiceSortKey sortKey,
+                          BRFileServiceRelease release);
+
 // Version limit can increase with maximum number of version, historically.
 #define FILE_SERVICE_TYPE_SPECIFICATION_NUMBER_OF_VERSION_LIMIT   (5)
 
@@ -233,12 +365,15 @@ typedef struct {
         BRFileServiceReader reader;
         BRFileServiceWriter writer;
     } versions [FILE_SERVICE_TYPE_SPECIFICATION_NUMBER_OF_VERSION_LIMIT];
+    BRFileServiceSortKey sortKey;   // optional
+    BRFileServiceRelease release;   // required with `sortKey`
 } BRFileServiceTypeSpecification;
 
 extern BRFileService
 fileServiceCreateFromTypeSpecifications(const char *basePath,
                                         const char *currency,
                                         const char *network,
+                                        const BRFileServiceDurabilityProfile *profile,
                                         BRFileServiceContext context,
                                         BRFileServiceErrorHandler handler,
                                         size_t specificationsCount,
@@ -28,7 +28,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include <unistd.h>             // getpid()
+#include <stdlib.h>
+#include <unistd.h>             // getpid(), sysconf()
 #include <pthread.h>
 
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) ||\
@@ -36,9 +37,19 @@
 #define WORDS_BIGENDIAN        1
 #endif
 #define DETERMINISTIC          1
-#define USE_BASIC_CONFIG       1
 #define ENABLE_MODULE_RECOVERY 1
 
+// secp256k1 precomputation table sizes, may be set at build time: a window of w bits uses 2^(w - 1) * 64 bytes for
+// verification and recovery, and g bits of signing precomputation use 2^g * 256/g * 64 bytes, both per context
+#ifndef BR_SECP256K1_ECMULT_WINDOW_SIZE
+#define BR_SECP256K1_ECMULT_WINDOW_SIZE    15 // 1MB
+#endif
+#ifndef BR_SECP256K1_ECMULT_GEN_PREC_BITS
+#define BR_SECP256K1_ECMULT_GEN_PREC_BITS  4  // 64KB
+#endif
+#define ECMULT_WINDOW_SIZE     BR_SECP256K1_ECMULT_WINDOW_SIZE
+#define ECMULT_GEN_PREC_BITS   BR_SECP256K1_ECMULT_GEN_PREC_BITS
+
 #pragma clang diagnostic push
 #pragma GCC diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -49,7 +60,6 @@
 #ifndef __clang__
 #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 #endif
-#include "secp256k1/src/basic-config.h"
 #include "secp256k1/src/secp256k1.c"
 #pragma clang diagnostic pop
 #pragma GCC diagnostic pop
@@ -77,6 +87,9 @@ uint32_t BRRand(uint32_t upperBound)
 }
 
 
+#define BR_KEY_BATCH_MAX_THREADS      (16)
+#define BR_KEY_BATCH_MIN_THREAD_ITEMS (16) // fewer signatures per thread and thread startup outweighs the ecdsa work
+
 static secp256k1_context *_ctx = NULL;
 static pthread_once_t _ctx_once = PTHREAD_ONCE_INIT;
 
@@ -126,6 +139,52 @@ int BRSecp256k1PointAdd(BRECPoint *p, const UInt256 *i)
             secp256k1_ec_pubkey_serialize(_ctx, (unsigned char *)p, &pLen, &pubkey, SECP256K1_EC_COMPRESSED));
 }
 
+// multiplies secp256k1 generator by each of count 256bit big endian ints i and adds the result to ec-point p, storing
+// the sums in ps, with p decompressed once and the sums converted to affine coordinates together
+// returns true on success, on failure for an i the corresponding sum is left as p
+int BRSecp256k1PointAddMany(BRECPoint ps[], const BRECPoint *p, const UInt256 i[], size_t count)
+{
+    secp256k1_pubkey pubkey;
+    secp256k1_ge pt, *sums;
+    secp256k1_gej ptj, *sumsj;
+    secp256k1_scalar zero, tweak;
+    size_t j, pLen;
+    int overflow, r = 1;
+
+    assert(ps != NULL || count == 0);
+    assert(p != NULL);
+    assert(i != NULL || count == 0);
+    pthread_once(&_ctx_once, _ctx_init);
+    if (! secp256k1_ec_pubkey_parse(_ctx, &pubkey, (const unsigned char *)p, sizeof(*p)) ||
+        ! secp256k1_pubkey_load(_ctx, &pt, &pubkey)) return 0;
+    if (count == 0) return r;
+
+    sums = malloc(count*sizeof(*sums));
+    sumsj = malloc(count*sizeof(*sumsj));
+    assert(sums != NULL && sumsj != NULL);
+    secp256k1_gej_set_ge(&ptj, &pt);
+    secp256k1_scalar_set_int(&zero, 0);
+
+    for (j = 0; j < count; j++) { // sumsj[j] = i[j]*G + p, in jacobian coordinates
+        secp256k1_scalar_set_b32(&tweak, i[j].u8, &overflow);
+        if (! overflow) secp256k1_ecmult(&_ctx->ecmult_ctx, &sumsj[j], &ptj, &zero, &tweak);
+        if (! overflow) secp256k1_gej_add_ge_var(&sumsj[j], &sumsj[j], &pt, NULL);
+        if (overflow || secp256k1_gej_is_infinity(&sumsj[j])) sumsj[j] = ptj, r = 0;
+    }
+
+    secp256k1_ge_set_all_gej_var(sums, sumsj, count); // one field inversion for all of the sums
+
+    for (j = 0; j < count; j++) {
+        pLen = sizeof(ps[j]);
+        secp256k1_eckey_pubkey_serialize(&sums[j], (unsigned char *)&ps[j], &pLen, 1);
+    }
+
+    secp256k1_scalar_clear(&tweak);
+    free(sumsj);
+    free(sums);
+    return r;
+}
+
 // multiplies secp256k1 ec-point p by 256bit big endian int i and stores the result in p
 // returns true on success
 int BRSecp256k1PointMul(BRECPoint *p, const UInt256 *i)
@@ -464,6 +523,87 @@ int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen)
     return r;
 }
 
+typedef struct {
+    BRKey *keys;
+    const UInt256 *mds;
+    const void *const *sigs;    // DER signatures, for verifying
+    const size_t *sigLens;
+    const uint8_t *compactSigs; // 65 byte compact signatures one after the other, for recovering
+    int *results;
+    size_t begin, end;          // items handled by this worker
+} BRKeyBatchWork;
+
+static void *_BRKeyVerifyWorker(void *info)
+{
+    BRKeyBatchWork *work = info;
+
+    for (size_t i = work->begin; i < work->end; i++) {
+        work->results[i] = BRKeyVerify(&work->keys[i], work->mds[i], work->sigs[i], work->sigLens[i]);
+    }
+
+    return NULL;
+}
+
+// runs worker over count items on up to threadCount threads (including the calling thread), returns the number of
+// non-zero results
+static size_t _BRKeyBatchRun(void *(*worker)(void *), BRKeyBatchWork *proto, size_t count, size_t threadCount)
+{
+    size_t i, r = 0, started = 0;
+
+    if (threadCount == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = (cpus > 0) ? (size_t)cpus : 1;
+    }
+
+    if (threadCount > BR_KEY_BATCH_MAX_THREADS) threadCount = BR_KEY_BATCH_MAX_THREADS;
+    if (threadCount > count/BR_KEY_BATCH_MIN_THREAD_ITEMS) threadCount = count/BR_KEY_BATCH_MIN_THREAD_ITEMS;
+    if (threadCount < 1) threadCount = 1;
+
+    BRKeyBatchWork work[threadCount];
+    pthread_t threads[threadCount];
+
+    for (i = 0; i < threadCount; i++) {
+        work[i] = *proto;
+        work[i].begin = count*i/threadCount, work[i].end = count*(i + 1)/threadCount;
+    }
+
+    while (started + 1 < threadCount && // the calling thread handles the first shard
+           pthread_create(&threads[started], NULL, worker, &work[started + 1]) == 0) {
+        started++;
+    }
+
+    worker(&work[0]);
+    for (i = started + 1; i < threadCount; i++) worker(&work[i]); // shards without a thread
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    for (i = 0; i < count; i++) if (proto->results[i]) r++;
+    return r;
+}
+
+// verifies count DER-encoded signatures, sigs[i] of sigLens[i] bytes for mds[i] by keys[i], on up to threadCount
+// threads (including the calling thread); a threadCount of 0 uses one thread per online processor
+// writes each result to verified[i] if verified is not NULL, and returns the number of signatures verified
+size_t BRKeyVerifyMany(BRKey keys[], const UInt256 mds[], const void *const sigs[], const size_t sigLens[],
+                       int verified[], size_t count, size_t threadCount)
+{
+    int *results = (verified) ? verified : calloc(count, sizeof(*results));
+    size_t i, r;
+
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(sigs != NULL || count == 0);
+    assert(sigLens != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    pthread_once(&_ctx_once, _ctx_init);
+
+    // workers only read keys, so any pubKey not yet derived from a secret is derived up front
+    for (i = 0; i < count; i++) BRKeyPubKey(&keys[i], NULL, 0);
+
+    r = _BRKeyBatchRun(_BRKeyVerifyWorker, &(BRKeyBatchWork) { keys, mds, sigs, sigLens, NULL, results, 0, count },
+                       count, threadCount);
+    if (! verified) free(results);
+    return r;
+}
+
 // wipes key material from key
 void BRKeyClean(BRKey *key)
 {
@@ -527,6 +667,40 @@ int BRKeyRecoverPubKey(BRKey *key, UInt256 md, const void *compactSig, size_t si
     return r;
 }
 
+static void *_BRKeyRecoverWorker(void *info)
+{
+    BRKeyBatchWork *work = info;
+
+    for (size_t i = work->begin; i < work->end; i++) {
+        work->results[i] = BRKeyRecoverPubKey(&work->keys[i], work->mds[i], &work->compactSigs[i*65], 65);
+    }
+
+    return NULL;
+}
+
+// as BRKeyRecoverPubKey() for count keys, from the 65 byte compact signatures stored one after the other in
+// compactSigs, on up to threadCount threads (including the calling thread); a threadCount of 0 uses one thread per
+// online processor, keys that can't be recovered are left empty
+// writes each result to recovered[i] if recovered is not NULL, and returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyMany(BRKey keys[], const UInt256 mds[], const void *compactSigs, int recovered[],
+                              size_t count, size_t threadCount)
+{
+    int *results = (recovered) ? recovered : calloc(count, sizeof(*results));
+    size_t r;
+
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(compactSigs != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    pthread_once(&_ctx_once, _ctx_init);
+    if (count > 0) memset(keys, 0, count*sizeof(*keys));
+
+    r = _BRKeyBatchRun(_BRKeyRecoverWorker, &(BRKeyBatchWork) { keys, mds, NULL, NULL, compactSigs, results, 0, count },
+                       count, threadCount);
+    if (! recovered) free(results);
+    return r;
+}
+
 // Compact Signature (w/o 'v' encoding)
 
 // Pieter Wuille's compact signature encoding used for bitcoin message signing
@@ -59,6 +59,11 @@ int BRSecp256k1PointGen(BRECPoint *p, const UInt256 *i);
 // returns true on success
 int BRSecp256k1PointAdd(BRECPoint *p, const UInt256 *i);
 
+// multiplies secp256k1 generator by each of count 256bit big endian ints i and adds the result to ec-point p, storing
+// the sums in ps
+// returns true on success, on failure for an i the corresponding sum is left as p
+int BRSecp256k1PointAddMany(BRECPoint ps[], const BRECPoint *p, const UInt256 i[], size_t count);
+
 // multiplies secp256k1 ec-point p by 256bit big endian int i and stores the result in p
 // returns true on success
 int BRSecp256k1PointMul(BRECPoint *p, const UInt256 *i);
@@ -123,6 +128,12 @@ size_t BRKeySign(const BRKey *key, void *sig, size_t sigLen, UInt256 md);
 // returns true if the DER-encoded signature for md is verified to have been made by key
 int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen);
 
+// verifies count DER-encoded signatures, sigs[i] of sigLens[i] bytes for mds[i] by keys[i], on up to threadCount
+// threads (including the calling thread); a threadCount of 0 uses one thread per online processor
+// writes each result to verified[i] if verified is not NULL, and returns the number of signatures verified
+size_t BRKeyVerifyMany(BRKey keys[], const UInt256 mds[], const void *const sigs[], const size_t sigLens[],
+                       int verified[], size_t count, size_t threadCount);
+
 // wipes key material from key
 void BRKeyClean(BRKey *key);
 
@@ -133,6 +144,13 @@ size_t BRKeyCompactSign(const BRKey *key, void *compactSig, size_t sigLen, UInt2
 // assigns pubKey recovered from compactSig to key and returns true on success
 int BRKeyRecoverPubKey(BRKey *key, UInt256 md, const void *compactSig, size_t sigLen);
 
+// as BRKeyRecoverPubKey() for count keys, from the 65 byte compact signatures stored one after the other in
+// compactSigs, on up to threadCount threads (including the calling thread); a threadCount of 0 uses one thread per
+// online processor, keys that can't be recovered are left empty
+// writes each result to recovered[i] if recovered is not NULL, and returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyMany(BRKey keys[], const UInt256 mds[], const void *compactSigs, int recovered[],
+                              size_t count, size_t threadCount);
+
 // write a 'shared secret' for key w/ pubKey to out32
 void BRKeyECDH(const BRKey *privKey, uint8_t *out32, BRKey *pubKey);
 
@@ -71,11 +71,12 @@ struct BREventHandlerRecord {
     pthread_mutex_t *lockOnDispatch;
 };
 
-extern BREventHandler
-eventHandlerCreate (const char *name,
-                    const BREventType *types[],
-                    size_t typesCount,
-                    pthread_mutex_t *lockOnDispatch) {
+static BREventHandler
+eventHandlerCreateInternal (const char *name,
+                            const BREventType *types[],
+                            size_t typesCount,
+                            pthread_mutex_t *lockOnDispatch,
+                            int lockFree) {
     BREventHandler handler = calloc (1, sizeof (struct BREventHandlerRecord));
 
     // Fill in the timeout event.  Leave the dispatcher NULL until the dispatcher is provided.
@@ -107,11 +108,29 @@ eventHandlerCreate (const char *name,
     handler->thread = PTHREAD_NULL;
 
     handler->scratch = (BREvent*) calloc (1, handler->eventSize);
-    handler->queue = eventQueueCreate (handler->eventSize);
+    handler->queue = (lockFree
+                      ? eventQueueCreateLockFree (handler->eventSize)
+                      : eventQueueCreate (handler->eventSize));
 
     return handler;
 }
 
+extern BREventHandler
+eventHandlerCreate (const char *name,
+                    const BREventType *types[],
+                    size_t typesCount,
+                    pthread_mutex_t *lockOnDispatch) {
+    return eventHandlerCreateInternal (name, types, typesCount, lockOnDispatch, 0);
+}
+
+extern BREventHandler
+eventHandlerCreateLockFree (const char *name,
+                            const BREventType *types[],
+                            size_t typesCount,
+                            pthread_mutex_t *lockOnDispatch) {
+    return eventHandlerCreateInternal (name, types, typesCount, lockOnDispatch, 1);
+}
+
 extern void
 eventHandlerSetTimeoutDispatcher (BREventHandler handler,
                                   unsigned int timeInMilliseconds,
@@ -113,6 +113,17 @@ eventHandlerCreate (const char *name,
                     size_t typesCount,
                     pthread_mutex_t *lock);
 
+/**
+ * Create an event handler, like `eventHandlerCreate()`, whose queue doesn't lock on
+ * `eventHandlerSignalEvent()` while the handler is busy; for events signalled from many threads.
+ * See `eventQueueCreateLockFree()`.
+ */
+extern BREventHandler
+eventHandlerCreateLockFree (const char *name,
+                            const BREventType *types[],
+                            size_t typesCount,
+                            pthread_mutex_t *lock);
+
 /**
  * Optional specify a periodic TimeoutDispatcher.  The `dispatcher` will run every
  * `timeInMilliseconds` (and will be passed a NULL event).  The event will be delivered OOB (out-of-band)
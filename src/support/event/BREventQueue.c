@@ -11,6 +11,7 @@
 
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include "support/BROSCompat.h"
 
 #include "BREventQueue.h"
@@ -21,6 +22,21 @@ struct BREventQueueRecord {
     // A linked-list (through event->next) of pending events.
     BREvent *pending;
 
+    // The last pending event, for constant time tail enqueues.
+    BREvent *pendingLast;
+
+    // If lock-free, a stack (through event->next, newest first) of events enqueued at the tail
+    // without the lock.  These follow all `pending` events and are moved, in order, onto `pending`
+    // by the dequeuing thread.
+    _Atomic(BREvent *) incoming;
+
+    // If lock-free, the number of threads waiting on `cond`; producers only take the lock, to
+    // signal, when there is a waiter.
+    atomic_uint waiters;
+
+    // If lock-free, tail enqueues avoid `lock`.
+    int lockFree;
+
     // A linked-list (through event->next) of available events
     BREvent *available;
 
@@ -37,14 +53,20 @@ struct BREventQueueRecord {
     size_t size;
 };
 
-extern BREventQueue
-eventQueueCreate (size_t size) {
+static BREventQueue
+eventQueueCreateInternal (size_t size,
+                          int lockFree) {
     BREventQueue queue = calloc (1, sizeof (struct BREventQueueRecord));
 
     queue->pending = NULL;
+    queue->pendingLast = NULL;
     queue->available = NULL;
     queue->abort = 0;
     queue->size  = size;
+    queue->lockFree = lockFree;
+
+    atomic_init (&queue->incoming, NULL);
+    atomic_init (&queue->waiters, 0);
 
     for (int i = 0; i < EVENT_QUEUE_DEFAULT_INITIAL_CAPACITY; i++) {
         BREvent *event = calloc (1, queue->size);
@@ -66,6 +88,16 @@ eventQueueCreate (size_t size) {
     return queue;
 }
 
+extern BREventQueue
+eventQueueCreate (size_t size) {
+    return eventQueueCreateInternal (size, 0);
+}
+
+extern BREventQueue
+eventQueueCreateLockFree (size_t size) {
+    return eventQueueCreateInternal (size, 1);
+}
+
 static void
 eventFreeAll (BREvent *event,
               int destroy) {
@@ -89,9 +121,11 @@ eventQueueClear (BREventQueue queue) {
     pthread_mutex_lock(&queue->lock);
 
     eventFreeAll(queue->pending, 1);
+    eventFreeAll(atomic_exchange (&queue->incoming, NULL), 1);
     eventFreeAll(queue->available, 0);
 
     queue->pending = NULL;
+    queue->pendingLast = NULL;
     queue->available = NULL;
 
     pthread_mutex_unlock(&queue->lock);
@@ -109,11 +143,39 @@ eventQueueDestroy (BREventQueue queue) {
     free (queue);
 }
 
+static void
+eventQueueEnqueueLockFree (BREventQueue queue,
+                           const BREvent *event,
+                           int signal) {
+    // Without the lock, the `available` events can't be used; the dequeue will free `this`.
+    BREvent *this = (BREvent*) calloc (1, queue->size);
+    memcpy (this, event, event->type->eventSize);
+
+    // Push `this` onto `incoming`
+    BREvent *next = atomic_load (&queue->incoming);
+    do {
+        this->next = next;
+    } while (!atomic_compare_exchange_weak (&queue->incoming, &next, this));
+
+    // A waiter counts itself, then checks `incoming`, before waiting; either it sees `this` or
+    // we see it and signal, with the lock held so that the signal can't precede the wait.
+    if (signal && 0 != atomic_load (&queue->waiters)) {
+        pthread_mutex_lock (&queue->lock);
+        pthread_cond_signal (&queue->cond);
+        pthread_mutex_unlock (&queue->lock);
+    }
+}
+
 static void
 eventQueueEnqueue (BREventQueue queue,
                    const BREvent *event,
                    int tail,
                    int signal) {
+    if (queue->lockFree && tail) {
+        eventQueueEnqueueLockFree (queue, event, signal);
+        return;
+    }
+
     pthread_mutex_lock(&queue->lock);
 
     // Get the next available event
@@ -131,12 +193,10 @@ eventQueueEnqueue (BREventQueue queue,
 
     // Nothing pending, simply add.
     if (NULL == queue->pending)
-        queue->pending = this;
+        queue->pending = queue->pendingLast = this;
     else if (tail) {
-        // Find the last event
-        BREvent *last = queue->pending;
-        while (NULL != last->next) last = last->next;
-        last->next = this;
+        queue->pendingLast->next = this;
+        queue->pendingLast = this;
     }
     else /* (head) */ {
         this->next = queue->pending;
@@ -170,10 +230,34 @@ eventQueueEnqueueHeadSignal (BREventQueue queue,
     eventQueueEnqueue (queue, event, 0, 1);
 }
 
+// Move the `incoming` events, oldest first, to the end of `pending`.  Requires `lock`.
+static void
+_eventQueueTakeIncoming (BREventQueue queue) {
+    BREvent *incoming = atomic_exchange (&queue->incoming, NULL);
+    if (NULL == incoming) return;
+
+    // `incoming` is newest first; reverse it.  The newest becomes the last.
+    BREvent *last  = incoming;
+    BREvent *first = NULL;
+    while (NULL != incoming) {
+        BREvent *next = incoming->next;
+        incoming->next = first;
+        first = incoming;
+        incoming = next;
+    }
+
+    if (NULL == queue->pending) queue->pending = first;
+    else queue->pendingLast->next = first;
+    queue->pendingLast = last;
+}
+
 static int
 _eventQueueDequeue (BREventQueue queue,
                     BREvent *event) {
     // Get the next pending event
+    if (NULL == queue->pending && queue->lockFree)
+        _eventQueueTakeIncoming (queue);
+
     BREvent *this = queue->pending;
 
     // if there is one, process it
@@ -181,14 +265,18 @@ _eventQueueDequeue (BREventQueue queue,
 
     // Remove `this` from the pending list.
     queue->pending = this->next;
+    if (NULL == queue->pending) queue->pendingLast = NULL;
 
     // Fill in the provided event;
     this->next = NULL;
     memcpy (event, this, queue->size);
 
-    // Return `this` to the available list.
-    this->next = queue->available;
-    queue->available = this;
+    // Return `this` to the available list; if lock-free, producers allocate their own.
+    if (queue->lockFree) free (this);
+    else {
+        this->next = queue->available;
+        queue->available = this;
+    }
 
     return 1;
 }
@@ -217,11 +305,21 @@ eventQueueDequeueWait (BREventQueue queue,
     BREventStatus status = EVENT_STATUS_SUCCESS;
 
     pthread_mutex_lock (&queue->lock);
-    while (!queue->abort && !_eventQueueDequeue (queue, event))
-        if (0 != pthread_cond_wait (&queue->cond, &queue->lock)) {
+    while (!queue->abort && !_eventQueueDequeue (queue, event)) {
+        int error = 0;
+
+        // If lock-free, count ourself as a waiter and then recheck for an event enqueued before
+        // the producer could have seen the count.
+        if (queue->lockFree) atomic_fetch_add (&queue->waiters, 1);
+        if (!queue->lockFree || NULL == atomic_load (&queue->incoming))
+            error = pthread_cond_wait (&queue->cond, &queue->lock);
+        if (queue->lockFree) atomic_fetch_sub (&queue->waiters, 1);
+
+        if (0 != error) {
             status = EVENT_STATUS_WAIT_ERROR;
             break; /* from while */
         }
+    }
     if (queue->abort) status = EVENT_STATUS_WAIT_ABORT;
     pthread_mutex_unlock(&queue->lock);
 
@@ -248,7 +346,7 @@ extern int
 eventQueueHasPending (BREventQueue queue) {
     int pending = 0;
     pthread_mutex_lock(&queue->lock);
-    pending = NULL != queue->pending;
+    pending = NULL != queue->pending || NULL != atomic_load (&queue->incoming);
     pthread_mutex_unlock(&queue->lock);
     return pending;
 }
@@ -27,6 +27,15 @@ typedef struct BREventQueueRecord *BREventQueue;
 extern BREventQueue
 eventQueueCreate (size_t size);
 
+/**
+ * Create an Event Queue, like `eventQueueCreate()`, where tail enqueues from any number of
+ * producer threads don't take the queue's lock, unless the dequeuing thread is waiting and must
+ * be signalled.  Use when many threads enqueue while events are being handled, such as
+ * peer callbacks.  Head enqueues and dequeues still take the lock; events keep the same order.
+ */
+extern BREventQueue
+eventQueueCreateLockFree (size_t size);
+
 extern void
 eventQueueDestroy (BREventQueue queue);
 
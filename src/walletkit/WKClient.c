@@ -682,8 +682,7 @@ wkClientHandleTransactions (OwnershipKept WKWalletManager manager,
             size_t bundlesCount = array_count(bundles);
 
             // Save the transaction bundles immediately
-            for (size_t index = 0; index < bundlesCount; index++)
-                wkWalletManagerSaveTransactionBundle(manager, bundles[index]);
+            wkWalletManagerSaveTransactionBundles (manager, bundles);
 
             // Sort bundles to have the lowest blocknumber first.  Use of `mergesort` is
             // appropriate given that the bundles are likely already ordered.  This minimizes
@@ -822,8 +821,8 @@ wkClientHandleTransfers (OwnershipKept WKWalletManager manager,
         if (NULL == error) {
             size_t bundlesCount = array_count(bundles);
 
-            for (size_t index = 0; index < bundlesCount; index++)
-                wkWalletManagerSaveTransferBundle(manager, bundles[index]);
+            // Save the transfer bundles immediately
+            wkWalletManagerSaveTransferBundles (manager, bundles);
 
             // Sort bundles to have the lowest blocknumber first.  Use of `mergesort` is
             // appropriate given that the bundles are likely already ordered.  This minimizes
@@ -833,8 +832,7 @@ wkClientHandleTransfers (OwnershipKept WKWalletManager manager,
                            wkClientTransferBundleCompareForSort);
 
             // Recover transfers from each bundle
-            for (size_t index = 0; index < bundlesCount; index++)
-                wkWalletManagerRecoverTransferFromTransferBundle (manager, bundles[index]);
+            wkWalletManagerRecoverTransfersFromTransferBundles (manager, bundles);
 
             WKWallet wallet = wkWalletManagerGetWallet(manager);
 
@@ -1089,6 +1087,10 @@ wkClientHandleSubmit (OwnershipKept WKWalletManager manager,
         WKBoolean hashChanged = wkTransferSetHash (transfer, hash);
 
         if (WK_TRUE == hashChanged) {
+            wkWalletUpdTransferIndex (wallet, transfer);
+            if (wallet != manager->wallet)
+                wkWalletUpdTransferIndex (manager->wallet, transfer);
+
             WKTransferState state = wkTransferGetState(transfer);
 
             wkTransferGenerateEvent (transfer, (WKTransferEvent) {
@@ -93,6 +93,23 @@ wkFileServiceTypeTransferV1Writer (BRFileServiceContext context,
     return data.bytes;
 }
 
+private_extern uint64_t
+wkFileServiceTypeTransferSortKey (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  const void *entity) {
+    WKClientTransferBundle bundle = (WKClientTransferBundle) entity;
+
+    // Pending transfers, with BLOCK_HEIGHT_UNBOUND, sort last.
+    return bundle->blockNumber;
+}
+
+private_extern void
+wkFileServiceTypeTransferRelease (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  void *entity) {
+    wkClientTransferBundleRelease ((WKClientTransferBundle) entity);
+}
+
 // MARK: - Client Transaction Bundle
 
 private_extern UInt256
@@ -148,6 +165,23 @@ wkFileServiceTypeTransactionV1Writer (BRFileServiceContext context,
     return data.bytes;
 }
 
+private_extern uint64_t
+wkFileServiceTypeTransactionSortKey (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     const void *entity) {
+    WKClientTransactionBundle bundle = (WKClientTransactionBundle) entity;
+
+    // Pending transactions, with BLOCK_HEIGHT_UNBOUND, sort last.
+    return bundle->blockHeight;
+}
+
+private_extern void
+wkFileServiceTypeTransactionRelease (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     void *entity) {
+    wkClientTransactionBundleRelease ((WKClientTransactionBundle) entity);
+}
+
 BRFileServiceTypeSpecification wkFileServiceSpecifications[] = {
     {
         WK_FILE_SERVICE_TYPE_TRANSFER,
@@ -167,7 +201,9 @@ BRFileServiceTypeSpecification wkFileServiceSpecifications[] = {
                 wkFileServiceTypeTransferV2Reader,
                 wkFileServiceTypeTransferV1Writer
             },
-        }
+        },
+        wkFileServiceTypeTransferSortKey,
+        wkFileServiceTypeTransferRelease
     },
 
     {
@@ -181,7 +217,9 @@ BRFileServiceTypeSpecification wkFileServiceSpecifications[] = {
                 wkFileServiceTypeTransactionV1Reader,
                 wkFileServiceTypeTransactionV1Writer
             },
-        }
+        },
+        wkFileServiceTypeTransactionSortKey,
+        wkFileServiceTypeTransactionRelease
     }
 };
 size_t wkFileServiceSpecificationsCount = (sizeof (wkFileServiceSpecifications) / sizeof (BRFileServiceTypeSpecification));
@@ -49,6 +49,16 @@ wkFileServiceTypeTransferV1Writer (BRFileServiceContext context,
                                  const void* entity,
                                  uint32_t *bytesCount);
 
+private_extern uint64_t
+wkFileServiceTypeTransferSortKey (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  const void *entity);
+
+private_extern void
+wkFileServiceTypeTransferRelease (BRFileServiceContext context,
+                                  BRFileService fs,
+                                  void *entity);
+
 
 #define WK_FILE_SERVICE_TYPE_TRANSACTION      "crypto_transactions"
 
@@ -73,6 +83,16 @@ wkFileServiceTypeTransactionV1Writer (BRFileServiceContext context,
                                     const void* entity,
                                     uint32_t *bytesCount);
 
+private_extern uint64_t
+wkFileServiceTypeTransactionSortKey (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     const void *entity);
+
+private_extern void
+wkFileServiceTypeTransactionRelease (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     void *entity);
+
 extern BRFileServiceTypeSpecification wkFileServiceSpecifications[];
 extern size_t wkFileServiceSpecificationsCount;
 
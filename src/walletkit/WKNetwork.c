@@ -127,6 +127,74 @@ wkCurrencyAssociationRelease (WKCurrencyAssociation association) {
     wkUnitGiveAll (association.units);
     array_free (association.units);
 }
+
+/// An entry in the network's association indexes: a key, owned by the association's currency, and
+/// the association's index in `associations`.
+struct WKCurrencyAssociationEntryRecord {
+    const char *key;
+    size_t index;
+};
+
+static size_t
+wkCurrencyAssociationEntryHash (const void *entry) {
+    // FNV-1a
+    size_t hash = 0x811c9dc5;
+    for (const char *key = ((WKCurrencyAssociationEntry) entry)->key; '\0' != *key; key++)
+        hash = (hash ^ (uint8_t) *key) * 0x01000193;
+    return hash;
+}
+
+static int
+wkCurrencyAssociationEntryIsEqual (const void *entry1, const void *entry2) {
+    return 0 == strcmp (((WKCurrencyAssociationEntry) entry1)->key, ((WKCurrencyAssociationEntry) entry2)->key);
+}
+
+static size_t
+wkCurrencyAssociationEntryHashIgnoringCase (const void *entry) {
+    size_t hash = 0x811c9dc5;
+    for (const char *key = ((WKCurrencyAssociationEntry) entry)->key; '\0' != *key; key++)
+        hash = (hash ^ (uint8_t) tolower ((unsigned char) *key)) * 0x01000193;
+    return hash;
+}
+
+static int
+wkCurrencyAssociationEntryIsEqualIgnoringCase (const void *entry1, const void *entry2) {
+    return 0 == strcasecmp (((WKCurrencyAssociationEntry) entry1)->key, ((WKCurrencyAssociationEntry) entry2)->key);
+}
+
+// An issuer, such as an ERC20 contract address, is keyed by its hex digits: without a '0x' prefix
+// and ignoring case, so that checksummed, lowercase and unprefixed forms of an address match.
+static const char *
+wkCurrencyAssociationIssuerDigits (const char *issuer) {
+    return ('0' == issuer[0] && ('x' == issuer[1] || 'X' == issuer[1])) ? &issuer[2] : issuer;
+}
+
+static size_t
+wkCurrencyAssociationEntryHashAsIssuer (const void *entry) {
+    struct WKCurrencyAssociationEntryRecord digits = {
+        wkCurrencyAssociationIssuerDigits (((WKCurrencyAssociationEntry) entry)->key), 0 };
+    return wkCurrencyAssociationEntryHashIgnoringCase (&digits);
+}
+
+static int
+wkCurrencyAssociationEntryIsEqualAsIssuer (const void *entry1, const void *entry2) {
+    return 0 == strcasecmp (wkCurrencyAssociationIssuerDigits (((WKCurrencyAssociationEntry) entry1)->key),
+                            wkCurrencyAssociationIssuerDigits (((WKCurrencyAssociationEntry) entry2)->key));
+}
+
+// Index `key` to the association at `index` unless, as in a linear search, an earlier one has it.
+static void
+wkCurrencyAssociationsIndexKey (BRSetOf(WKCurrencyAssociationEntry) entries,
+                                const char *key,
+                                size_t index) {
+    struct WKCurrencyAssociationEntryRecord probe = { key, index };
+    if (NULL == key || BRSetContains (entries, &probe)) return;
+
+    WKCurrencyAssociationEntry entry = malloc (sizeof (struct WKCurrencyAssociationEntryRecord));
+    *entry = probe;
+    BRSetAdd (entries, entry);
+}
+
 /// MARK: - Network
 
 #define WK_NETWORK_DEFAULT_CURRENCY_ASSOCIATIONS        (2)
@@ -167,6 +235,15 @@ wkNetworkAllocAndInit (size_t sizeInBytes,
     network->height    = 0;
 
     array_new (network->associations, WK_NETWORK_DEFAULT_CURRENCY_ASSOCIATIONS);
+    network->associationsByUids   = BRSetNew (wkCurrencyAssociationEntryHashIgnoringCase,
+                                              wkCurrencyAssociationEntryIsEqualIgnoringCase,
+                                              WK_NETWORK_DEFAULT_CURRENCY_ASSOCIATIONS);
+    network->associationsByIssuer = BRSetNew (wkCurrencyAssociationEntryHashAsIssuer,
+                                              wkCurrencyAssociationEntryIsEqualAsIssuer,
+                                              WK_NETWORK_DEFAULT_CURRENCY_ASSOCIATIONS);
+    network->associationsByCode   = BRSetNew (wkCurrencyAssociationEntryHash,
+                                              wkCurrencyAssociationEntryIsEqual,
+                                              WK_NETWORK_DEFAULT_CURRENCY_ASSOCIATIONS);
     array_new (network->fees, WK_NETWORK_DEFAULT_FEES);
 
     network->confirmationPeriodInSeconds = confirmationPeriodInSeconds;
@@ -200,6 +277,9 @@ wkNetworkRelease (WKNetwork network) {
 
     wkHashGive (network->verifiedBlockHash);
 
+    BRSetFreeAll (network->associationsByUids,   free);
+    BRSetFreeAll (network->associationsByIssuer, free);
+    BRSetFreeAll (network->associationsByCode,   free);
     array_free_all (network->associations, wkCurrencyAssociationRelease);
 
     for (size_t index = 0; index < array_count (network->fees); index++) {
@@ -334,14 +414,56 @@ wkNetworkGetCurrencyAt (WKNetwork network,
     return currency;
 }
 
+static WKCurrencyAssociation *
+wkNetworkLookupCurrencyAssociationByKey (WKNetwork network,
+                                         BRSetOf(WKCurrencyAssociationEntry) entries,
+                                         const char *key) {
+    // lock is not held for this static method; caller must hold it
+    struct WKCurrencyAssociationEntryRecord probe = { key, 0 };
+    WKCurrencyAssociationEntry entry = (NULL == key ? NULL : BRSetGet (entries, &probe));
+    return (NULL == entry ? NULL : &network->associations[entry->index]);
+}
+
+static WKCurrencyAssociation *
+wkNetworkLookupCurrencyAssociationByUids (WKNetwork network,
+                                              const char *uids) {
+    // lock is not held for this static method; caller must hold it
+    WKCurrencyAssociation *association = wkNetworkLookupCurrencyAssociationByKey (network, network->associationsByUids, uids);
+
+    // The index ignores case but `uids` must match exactly; search if the indexed one differs.
+    if (NULL == association || wkCurrencyHasUids (association->currency, uids))
+        return association;
+
+    for (size_t index = 0; index < array_count(network->associations); index++) {
+        if (wkCurrencyHasUids (network->associations[index].currency, uids))
+            return &network->associations[index];
+    }
+    return NULL;
+}
+
+static WKCurrencyAssociation *
+wkNetworkLookupCurrencyAssociation (WKNetwork network,
+                                        WKCurrency currency) {
+    // lock is not held for this static method; caller must hold it
+    return wkNetworkLookupCurrencyAssociationByUids (network, wkCurrencyGetUids (currency));
+}
+
+// Index the association at `index`; the lock must be held.
+static void
+wkNetworkIndexCurrencyAssociation (WKNetwork network,
+                                   size_t index) {
+    WKCurrency currency = network->associations[index].currency;
+
+    wkCurrencyAssociationsIndexKey (network->associationsByUids,   wkCurrencyGetUids   (currency), index);
+    wkCurrencyAssociationsIndexKey (network->associationsByIssuer, wkCurrencyGetIssuer (currency), index);
+    wkCurrencyAssociationsIndexKey (network->associationsByCode,   wkCurrencyGetCode   (currency), index);
+}
+
 extern WKBoolean
 wkNetworkHasCurrency (WKNetwork network,
                           WKCurrency currency) {
-    WKBoolean r = WK_FALSE;
     pthread_mutex_lock (&network->lock);
-    for (size_t index = 0; index < array_count(network->associations) && WK_FALSE == r; index++) {
-        r = wkCurrencyIsIdentical (network->associations[index].currency, currency);
-    }
+    WKBoolean r = AS_WK_BOOLEAN (NULL != wkNetworkLookupCurrencyAssociation (network, currency));
     pthread_mutex_unlock (&network->lock);
     return r;
 }
@@ -349,14 +471,9 @@ wkNetworkHasCurrency (WKNetwork network,
 extern WKCurrency
 wkNetworkGetCurrencyForCode (WKNetwork network,
                                    const char *code) {
-    WKCurrency currency = NULL;
     pthread_mutex_lock (&network->lock);
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        if (0 == strcmp (code, wkCurrencyGetCode (network->associations[index].currency))) {
-            currency = wkCurrencyTake (network->associations[index].currency);
-            break;
-        }
-    }
+    WKCurrencyAssociation *association = wkNetworkLookupCurrencyAssociationByKey (network, network->associationsByCode, code);
+    WKCurrency currency = (NULL == association ? NULL : wkCurrencyTake (association->currency));
     pthread_mutex_unlock (&network->lock);
     return currency;
 }
@@ -364,14 +481,9 @@ wkNetworkGetCurrencyForCode (WKNetwork network,
 extern WKCurrency
 wkNetworkGetCurrencyForUids (WKNetwork network,
                                  const char *uids) {
-    WKCurrency currency = NULL;
     pthread_mutex_lock (&network->lock);
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        if (0 == strcasecmp (uids, wkCurrencyGetUids (network->associations[index].currency))) {
-            currency = wkCurrencyTake (network->associations[index].currency);
-            break;
-        }
-    }
+    WKCurrencyAssociation *association = wkNetworkLookupCurrencyAssociationByKey (network, network->associationsByUids, uids);
+    WKCurrency currency = (NULL == association ? NULL : wkCurrencyTake (association->currency));
     pthread_mutex_unlock (&network->lock);
     return currency;
 }
@@ -379,42 +491,13 @@ wkNetworkGetCurrencyForUids (WKNetwork network,
 extern WKCurrency
 wkNetworkGetCurrencyForIssuer (WKNetwork network,
                                    const char *issuer) {
-    WKCurrency currency = NULL;
     pthread_mutex_lock (&network->lock);
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        const char *i = wkCurrencyGetIssuer(network->associations[index].currency);
-        if (NULL != i && 0 == strcasecmp (issuer, i)) {
-            currency = wkCurrencyTake (network->associations[index].currency);
-            break;
-        }
-    }
+    WKCurrencyAssociation *association = wkNetworkLookupCurrencyAssociationByKey (network, network->associationsByIssuer, issuer);
+    WKCurrency currency = (NULL == association ? NULL : wkCurrencyTake (association->currency));
     pthread_mutex_unlock (&network->lock);
     return currency;
 }
 
-static WKCurrencyAssociation *
-wkNetworkLookupCurrencyAssociation (WKNetwork network,
-                                        WKCurrency currency) {
-    // lock is not held for this static method; caller must hold it
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        if (WK_TRUE == wkCurrencyIsIdentical (currency, network->associations[index].currency)) {
-            return &network->associations[index];
-        }
-    }
-    return NULL;
-}
-
-static WKCurrencyAssociation *
-wkNetworkLookupCurrencyAssociationByUids (WKNetwork network,
-                                              const char *uids) {
-    // lock is not held for this static method; caller must hold it
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        if (wkCurrencyHasUids (network->associations[index].currency, uids))
-            return &network->associations[index];
-    }
-    return NULL;
-}
-
 extern WKUnit
 wkNetworkGetUnitAsBase (WKNetwork network,
                             WKCurrency currency) {
@@ -479,6 +562,7 @@ wkNetworkAddCurrency (WKNetwork network,
     pthread_mutex_lock (&network->lock);
     array_new (association.units, 2);
     array_add (network->associations, association);
+    wkNetworkIndexCurrencyAssociation (network, array_count (network->associations) - 1);
     pthread_mutex_unlock (&network->lock);
 }
 
@@ -593,6 +677,7 @@ wkNetworkAddCurrencyAssociationFromBundle (WKNetwork network,
         units
     };
     array_add (network->associations, newAssociation);
+    wkNetworkIndexCurrencyAssociation (network, array_count (network->associations) - 1);
     pthread_mutex_unlock (&network->lock);
 
     if (WK_TRUE == needEvent)
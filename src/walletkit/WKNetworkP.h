@@ -15,6 +15,7 @@
 #include <stdbool.h>
 
 #include "support/BRArray.h"
+#include "support/BRSet.h"
 
 #include "WKBaseP.h"
 #include "WKHashP.h"
@@ -56,6 +57,8 @@ typedef struct {
     BRArrayOf(WKUnit) units;
 } WKCurrencyAssociation;
 
+typedef struct WKCurrencyAssociationEntryRecord *WKCurrencyAssociationEntry;
+
 /// MARK: - Network Handlers
 
 typedef WKNetwork
@@ -139,6 +142,11 @@ struct WKNetworkRecord {
     WKCurrency currency;
     BRArrayOf(WKCurrencyAssociation) associations;
 
+    // The associations indexed by the currency's uids and issuer, ignoring case, and code.
+    BRSetOf(WKCurrencyAssociationEntry) associationsByUids;
+    BRSetOf(WKCurrencyAssociationEntry) associationsByIssuer;
+    BRSetOf(WKCurrencyAssociationEntry) associationsByCode;
+
     uint32_t confirmationPeriodInSeconds;
     uint32_t confirmationsUntilFinal;
 
@@ -242,6 +242,7 @@ wkSystemCreate (WKClient client,
 
     // Create the system-state file service
     system->fileService = fileServiceCreateFromTypeSpecifications (system->path, "system", "state",
+                                                                   &fileServiceDurabilityProfileWAL,
                                                                    system,
                                                                    wkSystemFileServiceErrorHandler,
                                                                    systemFileServiceSpecificationsCount,
@@ -710,8 +711,7 @@ private_extern void
 wkSystemHandleCurrencyBundles (WKSystem system,
                                OwnershipKept BRArrayOf (WKClientCurrencyBundle) bundles) {
     // Save the bundles straight away
-    for (size_t bundleIndex = 0; bundleIndex < array_count(bundles); bundleIndex++)
-        fileServiceSave (system->fileService, FILE_SERVICE_TYPE_CURRENCY_BUNDLE, bundles[bundleIndex]);
+    fileServiceSaveMany (system->fileService, FILE_SERVICE_TYPE_CURRENCY_BUNDLE, (const void **) bundles, array_count(bundles));
 
     pthread_mutex_lock (&system->lock);
 
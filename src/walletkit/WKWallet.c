@@ -43,6 +43,8 @@ struct WKWalletEventRecord {
 
         WKTransfer transfer;
 
+        BRArrayOf(WKTransfer) transfers;
+
         struct {
             /// Handler must 'give'
             WKAmount amount;
@@ -110,6 +112,10 @@ wkWalletEventRelease (WKWalletEvent event) {
             // WKCookie cookie
             wkFeeBasisGive (event->u.feeBasisEstimated.basis);
             break;
+
+        case WK_WALLET_EVENT_TRANSFERS_ADDED:
+            array_free_all (event->u.transfers, wkTransferGive);
+            break;
     }
 
     memset (event, 0, sizeof(*event));
@@ -174,6 +180,36 @@ wkWalletEventExtractTransfer (WKWalletEvent event,
     return WK_TRUE;
 }
 
+private_extern WKWalletEvent
+wkWalletEventCreateTransfers (OwnershipGiven BRArrayOf(WKTransfer) transfers) {
+    WKWalletEvent event = wkWalletEventCreate (WK_WALLET_EVENT_TRANSFERS_ADDED);
+
+    event->u.transfers = transfers;
+
+    return event;
+}
+
+extern WKBoolean
+wkWalletEventExtractTransfers (WKWalletEvent event,
+                               size_t *count,
+                               WKTransfer **transfers) {
+    if (WK_WALLET_EVENT_TRANSFERS_ADDED != event->type) return WK_FALSE;
+
+    size_t transfersCount = array_count (event->u.transfers);
+
+    if (NULL != count) *count = transfersCount;
+    if (NULL != transfers) {
+        *transfers = NULL;
+        if (0 != transfersCount) {
+            *transfers = calloc (transfersCount, sizeof (WKTransfer));
+            for (size_t index = 0; index < transfersCount; index++)
+                (*transfers)[index] = wkTransferTake (event->u.transfers[index]);
+        }
+    }
+
+    return WK_TRUE;
+}
+
 private_extern WKWalletEvent
 wkWalletEventCreateTransferSubmitted (WKTransfer transfer) {
     WKWalletEvent event = wkWalletEventCreate (WK_WALLET_EVENT_TRANSFER_SUBMITTED);
@@ -292,6 +328,13 @@ wkWalletEventIsEqual (WKWalletEvent event1,
                                       event1->u.feeBasisEstimated.cookie == event2->u.feeBasisEstimated.cookie &&
                                       WK_TRUE == wkFeeBasisIsEqual (event1->u.feeBasisEstimated.basis,
                                                                             event2->u.feeBasisEstimated.basis));
+
+        case WK_WALLET_EVENT_TRANSFERS_ADDED:
+            if (array_count (event1->u.transfers) != array_count (event2->u.transfers)) return WK_FALSE;
+            for (size_t index = 0; index < array_count (event1->u.transfers); index++)
+                if (WK_FALSE == wkTransferEqual (event1->u.transfers[index], event2->u.transfers[index]))
+                    return WK_FALSE;
+            return WK_TRUE;
     }
 }
 
@@ -299,6 +342,302 @@ wkWalletEventIsEqual (WKWalletEvent event1,
 
 IMPLEMENT_WK_GIVE_TAKE (WKWallet, wkWallet)
 
+// MARK: - Transfer Index
+
+/// An entry in the wallet's transfer indexes with the `uids` and `hash` that `transfer` had when
+/// indexed.  A transfer can gain a uids (on recovery) or a hash (on submit) after being added to
+/// a wallet; until re-indexed its entry stays in `transfersWithoutUids` or `transfersWithoutHash`,
+/// which lookups check when the index misses.
+struct WKWalletTransferEntryRecord {
+    WKTransfer transfer;
+    char *uids;
+    WKHash hash;
+
+    // Transfers can share a hash, such as ETH transfers from one transaction.  Entries with `hash`
+    // are chained, in the order indexed, from the one in `transfersByHash`.
+    WKWalletTransferEntry nextWithHash;
+
+    // The position in `transfersWithoutUids` and `transfersWithoutHash`, if there.
+    size_t indexWithoutUids;
+    size_t indexWithoutHash;
+};
+
+static size_t
+wkWalletTransferEntryHashByTransfer (const void *entry) {
+    return (size_t) (((uintptr_t) ((WKWalletTransferEntry) entry)->transfer) >> 4);
+}
+
+static int
+wkWalletTransferEntryIsEqualByTransfer (const void *entry1, const void *entry2) {
+    return ((WKWalletTransferEntry) entry1)->transfer == ((WKWalletTransferEntry) entry2)->transfer;
+}
+
+static size_t
+wkWalletTransferEntryHashByUids (const void *entry) {
+    // FNV-1a
+    size_t hash = 0x811c9dc5;
+    for (const char *uids = ((WKWalletTransferEntry) entry)->uids; '\0' != *uids; uids++)
+        hash = (hash ^ (uint8_t) *uids) * 0x01000193;
+    return hash;
+}
+
+static int
+wkWalletTransferEntryIsEqualByUids (const void *entry1, const void *entry2) {
+    return 0 == strcmp (((WKWalletTransferEntry) entry1)->uids, ((WKWalletTransferEntry) entry2)->uids);
+}
+
+static size_t
+wkWalletTransferEntryHashByHash (const void *entry) {
+    return (size_t) wkHashGetHashValue (((WKWalletTransferEntry) entry)->hash);
+}
+
+static int
+wkWalletTransferEntryIsEqualByHash (const void *entry1, const void *entry2) {
+    return WK_TRUE == wkHashEqual (((WKWalletTransferEntry) entry1)->hash, ((WKWalletTransferEntry) entry2)->hash);
+}
+
+static bool
+wkWalletTransferEntryHasStaleUids (WKWalletTransferEntry entry) {
+    pthread_mutex_lock (&entry->transfer->lock);
+    bool stale = (NULL == entry->uids && NULL != entry->transfer->uids);
+    pthread_mutex_unlock (&entry->transfer->lock);
+    return stale;
+}
+
+static bool
+wkWalletTransferEntryHasStaleHash (WKWalletTransferEntry entry) {
+    WKHash hash = wkTransferGetHash (entry->transfer);
+    bool stale = (WK_FALSE == wkHashEqual (hash, entry->hash));
+    wkHashGive (hash);
+    return stale;
+}
+
+static void
+wkWalletTransferEntryFill (WKWalletTransferEntry entry) {
+    pthread_mutex_lock (&entry->transfer->lock);
+    entry->uids = (NULL == entry->transfer->uids ? NULL : strdup (entry->transfer->uids));
+    pthread_mutex_unlock (&entry->transfer->lock);
+
+    entry->hash = wkTransferGetHash (entry->transfer);
+    entry->nextWithHash = NULL;
+}
+
+static void
+wkWalletTransferEntryClear (WKWalletTransferEntry entry) {
+    if (NULL != entry->uids) free (entry->uids);
+    wkHashGive (entry->hash);
+
+    entry->uids = NULL;
+    entry->hash = NULL;
+}
+
+static void
+wkWalletTransferEntryRelease (WKWalletTransferEntry entry) {
+    wkWalletTransferEntryClear (entry);
+    free (entry);
+}
+
+// Remove `entry`, at `index` in `entries`, by moving the last entry into its place.
+#define wkWalletTransferEntriesRemove(entries, index, indexField)   do {  \
+    WKWalletTransferEntry __last = (entries)[array_count (entries) - 1];  \
+    (entries)[(index)] = __last;                                          \
+    __last->indexField = (index);                                         \
+    array_set_count ((entries), array_count (entries) - 1);              \
+} while (0)
+
+static void
+wkWalletTransferIndexAddKeys (WKWallet wallet,
+                              WKWalletTransferEntry entry) {
+    if (NULL == entry->uids) {
+        entry->indexWithoutUids = array_count (wallet->transfersWithoutUids);
+        array_add (wallet->transfersWithoutUids, entry);
+    }
+    else BRSetAdd (wallet->transfersByUids, entry);
+
+    if (NULL == entry->hash) {
+        entry->indexWithoutHash = array_count (wallet->transfersWithoutHash);
+        array_add (wallet->transfersWithoutHash, entry);
+    }
+    else {
+        WKWalletTransferEntry last = BRSetGet (wallet->transfersByHash, entry);
+
+        if (NULL == last) BRSetAdd (wallet->transfersByHash, entry);
+        else {
+            while (NULL != last->nextWithHash) last = last->nextWithHash;
+            last->nextWithHash = entry;
+        }
+    }
+}
+
+static void
+wkWalletTransferIndexRemKeys (WKWallet wallet,
+                              WKWalletTransferEntry entry) {
+    if (NULL == entry->uids)
+        wkWalletTransferEntriesRemove (wallet->transfersWithoutUids, entry->indexWithoutUids, indexWithoutUids);
+    else if (entry == BRSetGet (wallet->transfersByUids, entry))
+        BRSetRemove (wallet->transfersByUids, entry);
+
+    if (NULL == entry->hash)
+        wkWalletTransferEntriesRemove (wallet->transfersWithoutHash, entry->indexWithoutHash, indexWithoutHash);
+    else {
+        WKWalletTransferEntry first = BRSetGet (wallet->transfersByHash, entry);
+
+        if (entry == first) {
+            BRSetRemove (wallet->transfersByHash, entry);
+            if (NULL != entry->nextWithHash) BRSetAdd (wallet->transfersByHash, entry->nextWithHash);
+        }
+        else {
+            while (NULL != first && entry != first->nextWithHash) first = first->nextWithHash;
+            if (NULL != first) first->nextWithHash = entry->nextWithHash;
+        }
+        entry->nextWithHash = NULL;
+    }
+}
+
+static void
+wkWalletTransferIndexAdd (WKWallet wallet,
+                          WKTransfer transfer) {
+    WKWalletTransferEntry entry = calloc (1, sizeof (struct WKWalletTransferEntryRecord));
+
+    entry->transfer = transfer;
+    wkWalletTransferEntryFill (entry);
+
+    BRSetAdd (wallet->transfersByTransfer, entry);
+    wkWalletTransferIndexAddKeys (wallet, entry);
+}
+
+static void
+wkWalletTransferIndexRem (WKWallet wallet,
+                          WKTransfer transfer) {
+    struct WKWalletTransferEntryRecord key = { transfer };
+    WKWalletTransferEntry entry = BRSetRemove (wallet->transfersByTransfer, &key);
+
+    if (NULL != entry) {
+        wkWalletTransferIndexRemKeys (wallet, entry);
+        wkWalletTransferEntryRelease (entry);
+    }
+}
+
+// Re-index `entry` with its transfer's current uids and hash.
+static void
+wkWalletTransferIndexUpdate (WKWallet wallet,
+                             WKWalletTransferEntry entry) {
+    wkWalletTransferIndexRemKeys (wallet, entry);
+    wkWalletTransferEntryClear (entry);
+    wkWalletTransferEntryFill (entry);
+    wkWalletTransferIndexAddKeys (wallet, entry);
+}
+
+/// Find the wallet's transfer with `uids`.  Requires `wallet->lock`.
+static WKTransfer
+wkWalletFindTransferByUIDS (WKWallet wallet,
+                            const char *uids) {
+    struct WKWalletTransferEntryRecord key = { NULL, (char *) uids };
+    WKWalletTransferEntry entry = BRSetGet (wallet->transfersByUids, &key);
+    if (NULL != entry) return entry->transfer;
+
+    // Re-index transfers that have gained a uids, until one has `uids`.
+    for (size_t index = 0; index < array_count (wallet->transfersWithoutUids); ) {
+        entry = wallet->transfersWithoutUids[index];
+
+        if (!wkWalletTransferEntryHasStaleUids (entry)) { index++; continue; }
+
+        // Removes `entry` from `transfersWithoutUids`; another takes its `index`
+        wkWalletTransferIndexUpdate (wallet, entry);
+        if (0 == strcmp (uids, entry->uids)) return entry->transfer;
+    }
+
+    return NULL;
+}
+
+/// Find the first of the wallet's transfers with `hash`; others follow through `nextWithHash`.
+/// Requires `wallet->lock`.
+static WKWalletTransferEntry
+wkWalletFindTransferEntryByHash (WKWallet wallet,
+                                 WKHash hash) {
+    struct WKWalletTransferEntryRecord key = { NULL, NULL, hash };
+    WKWalletTransferEntry entry;
+
+    // Re-index transfers that have gained a hash
+    for (size_t index = 0; index < array_count (wallet->transfersWithoutHash); ) {
+        entry = wallet->transfersWithoutHash[index];
+
+        if (!wkWalletTransferEntryHasStaleHash (entry)) index++;
+        else wkWalletTransferIndexUpdate (wallet, entry);
+    }
+
+    // Re-index transfers that have since changed their hash; then restart, as the chain changed.
+    for (entry = BRSetGet (wallet->transfersByHash, &key); NULL != entry; )
+        if (!wkWalletTransferEntryHasStaleHash (entry)) entry = entry->nextWithHash;
+        else {
+            wkWalletTransferIndexUpdate (wallet, entry);
+            entry = BRSetGet (wallet->transfersByHash, &key);
+        }
+
+    return BRSetGet (wallet->transfersByHash, &key);
+}
+
+/// Find the wallet's transfer that is `wkTransferEqual()` to `transfer`.  Two transfers are equal if
+/// they have the same uids or, otherwise, per the handlers' `isEqual`.  Some handlers' `isEqual`
+/// compares content rather than hash (XTZ compares the originating operation), so a transfer with
+/// a hash is also compared to the wallet's transfers without one, and a transfer without a hash is
+/// compared to every wallet transfer.
+/// Requires `wallet->lock`.
+static WKTransfer
+wkWalletFindTransfer (WKWallet wallet,
+                      WKTransfer transfer) {
+    struct WKWalletTransferEntryRecord key = { transfer };
+    if (NULL != BRSetGet (wallet->transfersByTransfer, &key)) return transfer;
+
+    WKTransfer walletTransfer = NULL;
+
+    pthread_mutex_lock (&transfer->lock);
+    char *uids = (NULL == transfer->uids ? NULL : strdup (transfer->uids));
+    pthread_mutex_unlock (&transfer->lock);
+
+    if (NULL != uids) {
+        walletTransfer = wkWalletFindTransferByUIDS (wallet, uids);
+        free (uids);
+
+        if (NULL != walletTransfer && WK_TRUE == wkTransferEqual (transfer, walletTransfer))
+            return walletTransfer;
+        walletTransfer = NULL;
+    }
+
+    WKHash hash = wkTransferGetHash (transfer);
+
+    if (NULL != hash) {
+        for (WKWalletTransferEntry entry = wkWalletFindTransferEntryByHash (wallet, hash);
+             NULL != entry && NULL == walletTransfer;
+             entry = entry->nextWithHash)
+            if (WK_TRUE == wkTransferEqual (transfer, entry->transfer))
+                walletTransfer = entry->transfer;
+        wkHashGive (hash);
+
+        for (size_t index = 0; index < array_count (wallet->transfersWithoutHash) && NULL == walletTransfer; index++)
+            if (WK_TRUE == wkTransferEqual (transfer, wallet->transfersWithoutHash[index]->transfer))
+                walletTransfer = wallet->transfersWithoutHash[index]->transfer;
+    }
+    else {
+        for (size_t index = 0; index < array_count (wallet->transfers) && NULL == walletTransfer; index++)
+            if (WK_TRUE == wkTransferEqual (transfer, wallet->transfers[index]))
+                walletTransfer = wallet->transfers[index];
+    }
+
+    return walletTransfer;
+}
+
+// Remove `transfer` from `wallet->transfers`, keeping their order.
+static void
+wkWalletRemTransferAt (WKWallet wallet,
+                       WKTransfer transfer) {
+    for (size_t index = array_count (wallet->transfers); index > 0; index--)
+        if (transfer == wallet->transfers[index - 1]) {
+            array_rm (wallet->transfers, index - 1);
+            break;
+        }
+}
+
 extern WKWallet
 wkWalletAllocAndInit (size_t sizeInBytes,
                           WKNetworkType type,
@@ -336,6 +675,12 @@ wkWalletAllocAndInit (size_t sizeInBytes,
 
     array_new (wallet->transfers, 5);
 
+    wallet->transfersByTransfer = BRSetNew (wkWalletTransferEntryHashByTransfer, wkWalletTransferEntryIsEqualByTransfer, 5);
+    wallet->transfersByUids     = BRSetNew (wkWalletTransferEntryHashByUids,     wkWalletTransferEntryIsEqualByUids,     5);
+    wallet->transfersByHash     = BRSetNew (wkWalletTransferEntryHashByHash,     wkWalletTransferEntryIsEqualByHash,     5);
+    array_new (wallet->transfersWithoutUids, 5);
+    array_new (wallet->transfersWithoutHash, 5);
+
     wallet->ref = WK_REF_ASSIGN (wkWalletRelease);
 
     wallet->listenerTransfer = wkListenerCreateTransferListener (&wallet->listener, wallet, wkWalletUpdTransfer);
@@ -351,8 +696,8 @@ wkWalletAllocAndInit (size_t sizeInBytes,
 
 static void
 wkWalletRelease (WKWallet wallet) {
-    pthread_mutex_lock (&wallet->lock);
     wkWalletSetState (wallet, WK_WALLET_STATE_DELETED);
+    pthread_mutex_lock (&wallet->lock);
 
     wkUnitGive (wallet->unit);
     wkUnitGive (wallet->unitForFee);
@@ -363,6 +708,15 @@ wkWalletRelease (WKWallet wallet) {
 
     wkFeeBasisGive (wallet->defaultFeeBasis);
 
+    BRSetFreeAll (wallet->transfersByTransfer, (void (*) (void *)) wkWalletTransferEntryRelease);
+    BRSetFree (wallet->transfersByUids);
+    BRSetFree (wallet->transfersByHash);
+    array_free (wallet->transfersWithoutUids);
+    array_free (wallet->transfersWithoutHash);
+
+    if (NULL != wallet->transfersAdded)
+        array_free_all (wallet->transfersAdded, wkTransferGive);
+
     for (size_t index = 0; index < array_count(wallet->transfers); index++)
         wkTransferGive (wallet->transfers[index]);
     array_free (wallet->transfers);
@@ -595,11 +949,8 @@ static WKBoolean
 wkWalletHasTransferLock (WKWallet wallet,
                              WKTransfer transfer,
                              bool needLock) {
-    WKBoolean r = WK_FALSE;
     if (needLock) pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers) && WK_FALSE == r; index++) {
-        r = wkTransferEqual (transfer, wallet->transfers[index]);
-    }
+    WKBoolean r = AS_WK_BOOLEAN (NULL != wkWalletFindTransfer (wallet, transfer));
     if (needLock) pthread_mutex_unlock (&wallet->lock);
     return r;
 }
@@ -621,16 +972,81 @@ wkWalletAnnounceTransfer (WKWallet wallet,
         wallet->handlers->announceTransfer (wallet, transfer, type);
 }
 
+// Add `transfer`, if not held.  If additions are deferred, the events and balance update are left
+// to `wkWalletFlushTransferAdditions()`.  Requires `wallet->lock`.
+static void
+wkWalletAddTransferLock (WKWallet wallet,
+                         WKTransfer transfer) {
+    if (WK_TRUE == wkWalletHasTransferLock (wallet, transfer, false)) return;
+
+    array_add (wallet->transfers, wkTransferTake(transfer));
+    wkWalletTransferIndexAdd (wallet, transfer);
+    wkWalletAnnounceTransfer (wallet, transfer, WK_WALLET_EVENT_TRANSFER_ADDED);
+
+    if (0 != wallet->transfersAddedDeferrals)
+        array_add (wallet->transfersAdded, wkTransferTake (transfer));
+    else {
+        wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_ADDED, transfer));
+        wkWalletIncBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, transfer));
+    }
+}
+
+// Return the index of `transfer` in the deferred additions or, if not there, their count.
+static size_t
+wkWalletGetTransferAddedIndex (WKWallet wallet,
+                               WKTransfer transfer) {
+    size_t count = (NULL == wallet->transfersAdded ? 0 : array_count (wallet->transfersAdded));
+    for (size_t index = 0; index < count; index++)
+        if (transfer == wallet->transfersAdded[index]) return index;
+    return count;
+}
+
+static void
+wkWalletDeferTransferAdditionsLock (WKWallet wallet,
+                                    bool needLock) {
+    if (needLock) pthread_mutex_lock (&wallet->lock);
+    if (0 == wallet->transfersAddedDeferrals++)
+        array_new (wallet->transfersAdded, 10);
+    if (needLock) pthread_mutex_unlock (&wallet->lock);
+}
+
+static void
+wkWalletFlushTransferAdditionsLock (WKWallet wallet,
+                                    bool needLock) {
+    if (needLock) pthread_mutex_lock (&wallet->lock);
+    assert (0 != wallet->transfersAddedDeferrals);
+
+    if (0 == --wallet->transfersAddedDeferrals) {
+        BRArrayOf(WKTransfer) transfersAdded = wallet->transfersAdded;
+        wallet->transfersAdded = NULL;
+
+        // Announce the additions together, in place of a TRANSFER_ADDED for each.
+        if (0 != array_count (transfersAdded))
+            wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfers (transfersAdded));
+        else
+            array_free (transfersAdded);
+
+        // Balance changes were skipped while deferred; compute the balance once.
+        wkWalletUpdBalance (wallet, false);
+    }
+    if (needLock) pthread_mutex_unlock (&wallet->lock);
+}
+
+private_extern void
+wkWalletDeferTransferAdditions (WKWallet wallet) {
+    wkWalletDeferTransferAdditionsLock (wallet, true);
+}
+
+private_extern void
+wkWalletFlushTransferAdditions (WKWallet wallet) {
+    wkWalletFlushTransferAdditionsLock (wallet, true);
+}
+
 private_extern void
 wkWalletAddTransfer (WKWallet wallet,
                          WKTransfer transfer) {
     pthread_mutex_lock (&wallet->lock);
-    if (WK_FALSE == wkWalletHasTransferLock (wallet, transfer, false)) {
-        array_add (wallet->transfers, wkTransferTake(transfer));
-        wkWalletAnnounceTransfer (wallet, transfer, WK_WALLET_EVENT_TRANSFER_ADDED);
-        wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_ADDED, transfer));
-        wkWalletIncBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, transfer));
-     }
+    wkWalletAddTransferLock (wallet, transfer);
     pthread_mutex_unlock (&wallet->lock);
 }
 
@@ -638,24 +1054,13 @@ private_extern void
 wkWalletAddTransfers (WKWallet wallet,
                           OwnershipGiven BRArrayOf(WKTransfer) transfers) {
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(transfers); index++) {
-        WKTransfer transfer = transfers[index];
-        if (WK_FALSE == wkWalletHasTransferLock (wallet, transfer, false)) {
-            array_add (wallet->transfers, wkTransferTake(transfer));
-            wkWalletAnnounceTransfer (wallet, transfer, WK_WALLET_EVENT_TRANSFER_ADDED);
-            // Must announce
+    wkWalletDeferTransferAdditionsLock (wallet, false);
 
-            // TODO: replace w/ bulk announcement
-            wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_ADDED, transfer));
+    for (size_t index = 0; index < array_count(transfers); index++)
+        wkWalletAddTransferLock (wallet, transfers[index]);
 
-//            wkWalletIncBalance (wallet, wkTransferGetAmountDirectedNet(transfer));
-        }
-    }
-
-    // generate event
-
-    // new balance
-    wkWalletUpdBalance(wallet, false);
+    // Generate the TRANSFERS_ADDED event and compute the new balance
+    wkWalletFlushTransferAdditionsLock (wallet, false);
 
     array_free_all (transfers, wkTransferGive);
     pthread_mutex_unlock (&wallet->lock);
@@ -664,21 +1069,31 @@ wkWalletAddTransfers (WKWallet wallet,
 private_extern void
 wkWalletRemTransfer (WKWallet wallet, WKTransfer transfer) {
     WKTransfer walletTransfer = NULL;
+    WKTransfer addedTransfer  = NULL;
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-        if (WK_TRUE == wkTransferEqual (wallet->transfers[index], transfer)) {
-            walletTransfer = wallet->transfers[index];
-            array_rm (wallet->transfers, index);
-            wkWalletAnnounceTransfer (wallet, transfer, WK_WALLET_EVENT_TRANSFER_DELETED);
+    walletTransfer = wkWalletFindTransfer (wallet, transfer);
+    if (NULL != walletTransfer) {
+        wkWalletRemTransferAt (wallet, walletTransfer);
+        wkWalletTransferIndexRem (wallet, walletTransfer);
+        wkWalletAnnounceTransfer (wallet, transfer, WK_WALLET_EVENT_TRANSFER_DELETED);
+
+        // A deferred addition is never announced, so neither is its removal.
+        size_t addedIndex = wkWalletGetTransferAddedIndex (wallet, walletTransfer);
+        if (0 != wallet->transfersAddedDeferrals && addedIndex < array_count (wallet->transfersAdded)) {
+            addedTransfer = wallet->transfersAdded[addedIndex];
+            array_rm (wallet->transfersAdded, addedIndex);
+        }
+        else
             wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_DELETED, transfer));
+
+        if (0 == wallet->transfersAddedDeferrals)
             wkWalletDecBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, transfer));
-            break;
-        }
     }
     pthread_mutex_unlock (&wallet->lock);
 
     // drop reference outside of lock to avoid potential case where release function runs
     if (NULL != walletTransfer) wkTransferGive (walletTransfer);
+    if (NULL != addedTransfer)  wkTransferGive (addedTransfer);
 }
 
 private_extern void
@@ -686,22 +1101,40 @@ wkWalletReplaceTransfer (WKWallet wallet,
                              OwnershipKept  WKTransfer oldTransfer,
                              OwnershipGiven WKTransfer newTransfer) {
     WKTransfer walletTransfer = NULL;
+    WKTransfer addedTransfer  = NULL;
     
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-        if (oldTransfer == wallet->transfers[index] ||
-            WK_TRUE == wkTransferEqual (wallet->transfers[index], oldTransfer)) {
-
+    WKTransfer found = wkWalletFindTransfer (wallet, oldTransfer);
+    for (size_t index = 0; NULL != found && index < array_count(wallet->transfers); index++) {
+        if (found == wallet->transfers[index]) {
             walletTransfer = wallet->transfers[index];
             wallet->transfers[index] = wkTransferTake (newTransfer);
 
-            wkWalletAnnounceTransfer (wallet, oldTransfer, WK_WALLET_EVENT_TRANSFER_DELETED);
-            wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_DELETED, oldTransfer));
-            wkWalletDecBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, oldTransfer));
+            wkWalletTransferIndexRem (wallet, walletTransfer);
+            wkWalletTransferIndexAdd (wallet, newTransfer);
 
+            wkWalletAnnounceTransfer (wallet, oldTransfer, WK_WALLET_EVENT_TRANSFER_DELETED);
             wkWalletAnnounceTransfer (wallet, newTransfer, WK_WALLET_EVENT_TRANSFER_ADDED);
-            wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_ADDED, newTransfer));
-            wkWalletIncBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, newTransfer));
+
+            if (0 != wallet->transfersAddedDeferrals) {
+                // A deferred addition is replaced, unannounced, by `newTransfer`
+                size_t addedIndex = wkWalletGetTransferAddedIndex (wallet, walletTransfer);
+                if (addedIndex < array_count (wallet->transfersAdded)) {
+                    addedTransfer = wallet->transfersAdded[addedIndex];
+                    array_rm (wallet->transfersAdded, addedIndex);
+                }
+                else
+                    wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_DELETED, oldTransfer));
+
+                array_add (wallet->transfersAdded, wkTransferTake (newTransfer));
+            }
+            else {
+                wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_DELETED, oldTransfer));
+                wkWalletDecBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, oldTransfer));
+
+                wkWalletGenerateEvent (wallet, wkWalletEventCreateTransfer (WK_WALLET_EVENT_TRANSFER_ADDED, newTransfer));
+                wkWalletIncBalance (wallet, wkWalletGetTransferAmountDirectedNet(wallet, newTransfer));
+            }
 
             break;
         }
@@ -710,9 +1143,21 @@ wkWalletReplaceTransfer (WKWallet wallet,
 
     // drop reference outside of lock to avoid potential case where release function runs
     wkTransferGive (walletTransfer);
+    wkTransferGive (addedTransfer);
     wkTransferGive (newTransfer);
 }
 
+private_extern void
+wkWalletUpdTransferIndex (WKWallet wallet,
+                          WKTransfer transfer) {
+    struct WKWalletTransferEntryRecord key = { transfer };
+
+    pthread_mutex_lock (&wallet->lock);
+    WKWalletTransferEntry entry = BRSetGet (wallet->transfersByTransfer, &key);
+    if (NULL != entry) wkWalletTransferIndexUpdate (wallet, entry);
+    pthread_mutex_unlock (&wallet->lock);
+}
+
 // This is called as the 'transferListener' by WKTransfer from `cryptoTransferSetState`.  It
 // is a way for a wallet to listen in on transfer changes.
 static void
@@ -723,7 +1168,8 @@ wkWalletUpdTransfer (WKWallet wallet,
     // perhaps other wallet changes, such a nonce change.
     pthread_mutex_lock (&wallet->lock);
     if (WK_TRUE == wkWalletHasTransferLock (wallet, transfer, false)) {
-        switch (transfer->state->type) {
+        // While additions are deferred, the balance is computed when they are flushed.
+        if (0 == wallet->transfersAddedDeferrals) switch (transfer->state->type) {
             case WK_TRANSFER_STATE_CREATED:
             case WK_TRANSFER_STATE_SIGNED:
             case WK_TRANSFER_STATE_SUBMITTED:
@@ -772,12 +1218,10 @@ wkWalletGetTransferByHash (WKWallet wallet, WKHash hashToMatch) {
     WKTransfer transfer = NULL;
 
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; NULL == transfer && index < array_count(wallet->transfers); index++) {
-        WKHash hash = wkTransferGetHash (wallet->transfers[index]);
-        if (WK_TRUE == wkHashEqual(hash, hashToMatch))
-            transfer = wallet->transfers[index];
-        wkHashGive(hash);
-    }
+    WKWalletTransferEntry entry = (NULL == hashToMatch
+                                   ? NULL
+                                   : wkWalletFindTransferEntryByHash (wallet, hashToMatch));
+    if (NULL != entry) transfer = entry->transfer;
     pthread_mutex_unlock (&wallet->lock);
 
     return wkTransferTake (transfer);
@@ -788,11 +1232,7 @@ wkWalletGetTransferByUIDS (WKWallet wallet, const char *uids) {
     WKTransfer transfer = NULL;
 
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; NULL == transfer && index < array_count(wallet->transfers); index++) {
-        const char *transferUIDS = wallet->transfers[index]->uids;
-        if (NULL != transferUIDS && 0 == strcmp (transferUIDS, uids))
-            transfer = wallet->transfers[index];
-    }
+    if (NULL != uids) transfer = wkWalletFindTransferByUIDS (wallet, uids);
     pthread_mutex_unlock (&wallet->lock);
 
     return wkTransferTake (transfer);
@@ -1093,6 +1533,9 @@ wkWalletEventTypeString (WKWalletEventType t) {
 
         case WK_WALLET_EVENT_FEE_BASIS_ESTIMATED:
         return "WK_WALLET_EVENT_FEE_BASIS_ESTIMATED";
+
+        case WK_WALLET_EVENT_TRANSFERS_ADDED:
+        return "WK_WALLET_EVENT_TRANSFERS_ADDED";
     }
     return "<WK_WALLET_EVENT_TYPE_UNKNOWN>";
 }
@@ -136,94 +136,76 @@ wkWalletManagerReleaseCurrenciesOfInterest (WKWalletManager cwm,
 #pragma clang diagnostic pop
 #pragma GCC diagnostic pop
 
-static void // not locked; called during manager init
-wkWalletManagerInitialTransferBundlesLoad (WKWalletManager manager) {
-    assert (NULL == manager->bundleTransfers);
+typedef struct {
+    WKWalletManager manager;
+    size_t count;
+} WKWalletManagerBundleRecoverContext;
 
-    BRSetOf(WKClientTransferBundle) bundles = wkClientTransferBundleSetCreate (25);
+static int
+wkWalletManagerInitialTransferBundleRecover (BRFileServiceContext context,
+                                             BRFileService fs,
+                                             const char *type,
+                                             void *entity) {
+    WKWalletManagerBundleRecoverContext *recover = (WKWalletManagerBundleRecoverContext *) context;
+    WKClientTransferBundle bundle = (WKClientTransferBundle) entity;
 
-    if (fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER) &&
-        1 != fileServiceLoad (manager->fileService, bundles, WK_FILE_SERVICE_TYPE_TRANSFER, 1)) {
-        printf ("CRY: %4s: failed to load transfer bundles",
-                wkNetworkTypeGetCurrencyCode (manager->type));
-        wkClientTransferBundleSetRelease(bundles);
-        return;
-    }
-    size_t sortedBundlesCount = BRSetCount(bundles);
+    wkWalletManagerRecoverTransferFromTransferBundle (recover->manager, bundle);
+    wkClientTransferBundleRelease (bundle);
 
-    printf ("CRY: %4s: loaded %4zu transfer bundles\n",
-            wkNetworkTypeGetCurrencyCode (manager->type),
-            sortedBundlesCount);
-
-    if (0 != sortedBundlesCount) {
-        array_new (manager->bundleTransfers, sortedBundlesCount);
-        BRSetAll (bundles, (void**) manager->bundleTransfers, sortedBundlesCount);
-        array_set_count (manager->bundleTransfers, sortedBundlesCount);
-
-        mergesort_brd (manager->bundleTransfers, sortedBundlesCount, sizeof (WKClientTransferBundle),
-                       wkClientTransferBundleCompareByBlockheightForSort);
-    }
-
-    // Don't release the set's bundles
-    BRSetFree(bundles);
+    recover->count += 1;
+    return 1;
 }
 
 static void // called wtih manager->lock
 wkWalletManagerInitialTransferBundlesRecover (WKWalletManager manager) {
-    if (NULL != manager->bundleTransfers) {
-        for (size_t index = 0; index < array_count(manager->bundleTransfers); index++) {
-            wkWalletManagerRecoverTransferFromTransferBundle (manager, manager->bundleTransfers[index]);
-        }
-
-        array_free_all (manager->bundleTransfers, wkClientTransferBundleRelease);
-        manager->bundleTransfers = NULL;
-    }
-}
+    if (!fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER)) return;
 
-static void // not locked; called during manager init
-wkWalletManagerInitialTransactionBundlesLoad (WKWalletManager manager) {
-    assert (NULL == manager->bundleTransactions);
+    // Recover each bundle as it is loaded, by blockheight; the bundles are never all in memory.
+    // Each wallet announces its recovered transfers, and computes its balance, once at the end.
+    WKWalletManagerBundleRecoverContext recover = { manager, 0 };
 
-    BRSetOf(WKClientTransactionBundle) bundles = wkClientTransactionBundleSetCreate (25);
-    if (fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSACTION) &&
-        1 != fileServiceLoad (manager->fileService, bundles, WK_FILE_SERVICE_TYPE_TRANSACTION, 1)) {
-        wkClientTransactionBundleSetRelease (bundles);
-        printf ("CRY: %4s: failed to load transaction bundles",
+    wkWalletManagerDeferTransferAdditions (manager);
+    if (1 != fileServiceLoadIterate (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER, 1,
+                                     &recover, wkWalletManagerInitialTransferBundleRecover))
+        printf ("CRY: %4s: failed to load transfer bundles\n",
                 wkNetworkTypeGetCurrencyCode (manager->type));
-        return;
-    }
-    size_t sortedBundlesCount = BRSetCount(bundles);
+    wkWalletManagerFlushTransferAdditions (manager);
 
-    printf ("CRY: %4s: loaded %4zu transaction bundles\n",
+    printf ("CRY: %4s: loaded %4zu transfer bundles\n",
             wkNetworkTypeGetCurrencyCode (manager->type),
-            sortedBundlesCount);
-
-    if (0 != sortedBundlesCount) {
-        BRArrayOf(WKClientTransactionBundle) sortedBundles;
-        array_new (sortedBundles, sortedBundlesCount);
-        BRSetAll (bundles, (void**) sortedBundles, sortedBundlesCount);
-        array_set_count(sortedBundles, sortedBundlesCount);
+            recover.count);
+}
 
-        mergesort_brd (sortedBundles, sortedBundlesCount, sizeof (WKClientTransactionBundle),
-                       wkClientTransactionBundleCompareByBlockheightForSort);
+static int
+wkWalletManagerInitialTransactionBundleRecover (BRFileServiceContext context,
+                                                BRFileService fs,
+                                                const char *type,
+                                                void *entity) {
+    WKWalletManagerBundleRecoverContext *recover = (WKWalletManagerBundleRecoverContext *) context;
+    WKClientTransactionBundle bundle = (WKClientTransactionBundle) entity;
 
-        manager->bundleTransactions = sortedBundles;
-    }
+    wkWalletManagerRecoverTransfersFromTransactionBundle (recover->manager, bundle);
+    wkClientTransactionBundleRelease (bundle);
 
-    // Don't release the set's bundles
-    BRSetFree(bundles);
+    recover->count += 1;
+    return 1;
 }
 
 static void // called wtih manager->lock
 wkWalletManagerInitialTransactionBundlesRecover (WKWalletManager manager) {
-    if (NULL != manager->bundleTransactions) {
-        for (size_t index = 0; index < array_count(manager->bundleTransactions); index++) {
-            wkWalletManagerRecoverTransfersFromTransactionBundle (manager, manager->bundleTransactions[index]);
-        }
+    if (!fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSACTION)) return;
 
-        array_free_all (manager->bundleTransactions, wkClientTransactionBundleRelease);
-        manager->bundleTransactions = NULL;
-    }
+    // Recover each bundle as it is loaded, by blockheight; the bundles are never all in memory.
+    WKWalletManagerBundleRecoverContext recover = { manager, 0 };
+
+    if (1 != fileServiceLoadIterate (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSACTION, 1,
+                                     &recover, wkWalletManagerInitialTransactionBundleRecover))
+        printf ("CRY: %4s: failed to load transaction bundles\n",
+                wkNetworkTypeGetCurrencyCode (manager->type));
+
+    printf ("CRY: %4s: loaded %4zu transaction bundles\n",
+            wkNetworkTypeGetCurrencyCode (manager->type),
+            recover.count);
 }
 
 extern WKWalletManager
@@ -330,14 +312,11 @@ wkWalletManagerAllocAndInit (size_t sizeInBytes,
         WK_WALLET_MANAGER_EVENT_CREATED
     });
 
-    wkWalletManagerInitialTransferBundlesLoad (manager);
-    wkWalletManagerInitialTransactionBundlesLoad (manager);
-
-    // Create the primary wallet
+    // Create the primary wallet; transfers are recovered, from the fileService, once created.
     manager->wallet = wkWalletManagerCreateWalletInitialized (manager,
                                                                   network->currency,
-                                                                  manager->bundleTransactions,
-                                                                  manager->bundleTransfers);
+                                                                  NULL,
+                                                                  NULL);
 
     // Create the P2P manager
     manager->p2pManager = manager->handlers->createP2PManager (manager);
@@ -673,6 +652,8 @@ wkWalletManagerAddWallet (WKWalletManager cwm,
     pthread_mutex_lock (&cwm->lock);
     if (WK_FALSE == wkWalletManagerHasWalletLock (cwm, wallet, false)) {
         array_add (cwm->wallets, wkWalletTake (wallet));
+        if (0 != cwm->transferAdditionsDeferrals)
+            wkWalletDeferTransferAdditions (wallet);
         wkWalletManagerGenerateEvent (cwm, (WKWalletManagerEvent) {
             WK_WALLET_MANAGER_EVENT_WALLET_ADDED,
             { .wallet = wkWalletTake (wallet) }
@@ -1188,6 +1169,38 @@ wkWalletManagerSaveTransferBundle (WKWalletManager manager,
         fileServiceSave (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER, bundle);
 }
 
+private_extern void
+wkWalletManagerSaveTransactionBundles (WKWalletManager manager,
+                                       OwnershipKept BRArrayOf (WKClientTransactionBundle) bundles) {
+    size_t bundlesCount = array_count (bundles);
+
+    if (NULL != manager->handlers->saveTransactionBundle) {
+        // Batch the handler's saves into a single DB transaction
+        fileServiceBeginBatch (manager->fileService);
+        for (size_t index = 0; index < bundlesCount; index++)
+            manager->handlers->saveTransactionBundle (manager, bundles[index]);
+        fileServiceCommitBatch (manager->fileService);
+    }
+    else if (fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSACTION))
+        fileServiceSaveMany (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSACTION, (const void **) bundles, bundlesCount);
+}
+
+private_extern void
+wkWalletManagerSaveTransferBundles (WKWalletManager manager,
+                                    OwnershipKept BRArrayOf (WKClientTransferBundle) bundles) {
+    size_t bundlesCount = array_count (bundles);
+
+    if (NULL != manager->handlers->saveTransferBundle) {
+        // Batch the handler's saves into a single DB transaction
+        fileServiceBeginBatch (manager->fileService);
+        for (size_t index = 0; index < bundlesCount; index++)
+            manager->handlers->saveTransferBundle (manager, bundles[index]);
+        fileServiceCommitBatch (manager->fileService);
+    }
+    else if (fileServiceHasType (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER))
+        fileServiceSaveMany (manager->fileService, WK_FILE_SERVICE_TYPE_TRANSFER, (const void **) bundles, bundlesCount);
+}
+
 private_extern void
 wkWalletManagerRecoverTransfersFromTransactionBundle (WKWalletManager cwm,
                                                           OwnershipKept WKClientTransactionBundle bundle) {
@@ -1200,6 +1213,34 @@ wkWalletManagerRecoverTransferFromTransferBundle (WKWalletManager cwm,
     cwm->handlers->recoverTransferFromTransferBundle (cwm, bundle);
 }
 
+private_extern void
+wkWalletManagerRecoverTransfersFromTransferBundles (WKWalletManager cwm,
+                                                    OwnershipKept BRArrayOf(WKClientTransferBundle) bundles) {
+    wkWalletManagerDeferTransferAdditions (cwm);
+    for (size_t index = 0; index < array_count (bundles); index++)
+        wkWalletManagerRecoverTransferFromTransferBundle (cwm, bundles[index]);
+    wkWalletManagerFlushTransferAdditions (cwm);
+}
+
+private_extern void
+wkWalletManagerDeferTransferAdditions (WKWalletManager cwm) {
+    pthread_mutex_lock (&cwm->lock);
+    if (0 == cwm->transferAdditionsDeferrals++)
+        for (size_t index = 0; index < array_count (cwm->wallets); index++)
+            wkWalletDeferTransferAdditions (cwm->wallets[index]);
+    pthread_mutex_unlock (&cwm->lock);
+}
+
+private_extern void
+wkWalletManagerFlushTransferAdditions (WKWalletManager cwm) {
+    pthread_mutex_lock (&cwm->lock);
+    assert (0 != cwm->transferAdditionsDeferrals);
+    if (0 == --cwm->transferAdditionsDeferrals)
+        for (size_t index = 0; index < array_count (cwm->wallets); index++)
+            wkWalletFlushTransferAdditions (cwm->wallets[index]);
+    pthread_mutex_unlock (&cwm->lock);
+}
+
 private_extern void
 wkWalletManagerRecoverTransferAttributesFromTransferBundle (WKWallet wallet,
                                                                 WKTransfer transfer,
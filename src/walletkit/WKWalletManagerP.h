@@ -200,15 +200,14 @@ struct WKWalletManagerRecord {
     /// All wallets (modifiable)
     BRArrayOf(WKWallet) wallets;
 
+    /// While non-zero, every wallet, including those added meanwhile, defers its transfer additions
+    size_t transferAdditionsDeferrals;
+
     /// The state (modifiable)
     WKWalletManagerState state;
 
     WKWalletManagerListener listener;
     WKWalletListener listenerWallet;
-
-    /// The {Transfer,Transaction}Bundle (modifiable)
-    Nullable BRArrayOf(WKClientTransferBundle) bundleTransfers;
-    Nullable BRArrayOf(WKClientTransactionBundle) bundleTransactions;
 };
 
 typedef void *WKWalletManagerCreateContext;
@@ -278,6 +277,14 @@ private_extern void
 wkWalletManagerSaveTransferBundle (WKWalletManager manager,
                                        OwnershipKept WKClientTransferBundle bundle);
 
+private_extern void
+wkWalletManagerSaveTransactionBundles (WKWalletManager manager,
+                                       OwnershipKept BRArrayOf (WKClientTransactionBundle) bundles);
+
+private_extern void
+wkWalletManagerSaveTransferBundles (WKWalletManager manager,
+                                    OwnershipKept BRArrayOf (WKClientTransferBundle) bundles);
+
 private_extern WKWallet
 wkWalletManagerCreateWalletInitialized (WKWalletManager cwm,
                                             WKCurrency currency,
@@ -294,6 +301,20 @@ private_extern void
 wkWalletManagerRecoverTransferFromTransferBundle (WKWalletManager cwm,
                                                       OwnershipKept WKClientTransferBundle bundle);
 
+/// Recover transfers from each of `bundles`, in order, with transfer additions deferred.  Each
+/// wallet then announces its recovered transfers with one event and computes its balance once.
+private_extern void
+wkWalletManagerRecoverTransfersFromTransferBundles (WKWalletManager cwm,
+                                                    OwnershipKept BRArrayOf(WKClientTransferBundle) bundles);
+
+/// Defer transfer additions in every wallet; see `wkWalletDeferTransferAdditions()`.  Deferrals
+/// nest; the outermost flush announces the additions.
+private_extern void
+wkWalletManagerDeferTransferAdditions (WKWalletManager cwm);
+
+private_extern void
+wkWalletManagerFlushTransferAdditions (WKWalletManager cwm);
+
 private_extern void
 wkWalletManagerRecoverTransferAttributesFromTransferBundle (WKWallet wallet,
                                                                 WKTransfer transfer,
@@ -41,6 +41,9 @@ private_extern WKWalletEvent
 wkWalletEventCreateTransfer (WKWalletEventType type,
                                  WKTransfer transfer);
 
+private_extern WKWalletEvent
+wkWalletEventCreateTransfers (OwnershipGiven BRArrayOf(WKTransfer) transfers);
+
 private_extern WKWalletEvent
 wkWalletEventCreateTransferSubmitted (WKTransfer transfer);
 
@@ -147,6 +150,8 @@ typedef struct {
 
 // MARK: - Wallet
 
+typedef struct WKWalletTransferEntryRecord *WKWalletTransferEntry;
+
 struct WKWalletRecord {
     WKNetworkType type;
     const WKWalletHandlers *handlers;
@@ -165,6 +170,20 @@ struct WKWalletRecord {
     /// The transfers (modifiable)
     BRArrayOf (WKTransfer) transfers;
 
+    /// The transfers indexed by transfer, uids and hash; see `wkWalletFindTransfer()`
+    BRSetOf (WKWalletTransferEntry) transfersByTransfer;
+    BRSetOf (WKWalletTransferEntry) transfersByUids;
+    BRSetOf (WKWalletTransferEntry) transfersByHash;
+
+    /// The indexed transfers that lacked a uids or a hash when indexed
+    BRArrayOf (WKWalletTransferEntry) transfersWithoutUids;
+    BRArrayOf (WKWalletTransferEntry) transfersWithoutHash;
+
+    /// The transfers added, but not yet announced, while additions are deferred; see
+    /// `wkWalletDeferTransferAdditions()`.  Deferrals nest.
+    size_t transfersAddedDeferrals;
+    BRArrayOf (WKTransfer) transfersAdded;
+
     /// The balance (modifiable)
     WKAmount balance;
     WKAmount balanceMinimum;
@@ -218,11 +237,27 @@ wkWalletAddTransfers (WKWallet wallet,
 private_extern void
 wkWalletRemTransfer (WKWallet wallet, WKTransfer transfer);
 
+/// Defer the events and balance updates for transfers added to `wallet`.  The transfers are held
+/// by `wallet`, and found by lookups, as they are added; but they are announced, with a single
+/// TRANSFERS_ADDED event in place of their TRANSFER_ADDED events, and the balance is recomputed
+/// once, on the matching `wkWalletFlushTransferAdditions()`.
+private_extern void
+wkWalletDeferTransferAdditions (WKWallet wallet);
+
+private_extern void
+wkWalletFlushTransferAdditions (WKWallet wallet);
+
 private_extern void
 wkWalletReplaceTransfer (WKWallet wallet,
                              OwnershipKept  WKTransfer oldTransfer,
                              OwnershipGiven WKTransfer newTransfer);
 
+/// Re-index `transfer` after its hash changed, such as on submit.  A transfer that gains a uids
+/// or hash is re-indexed when looked up; one whose hash changes must be re-indexed explicitly.
+private_extern void
+wkWalletUpdTransferIndex (WKWallet wallet,
+                          WKTransfer transfer);
+
 private_extern OwnershipGiven BRSetOf(BRCyptoAddress)
 wkWalletGetAddressesForRecovery (WKWallet wallet);
 
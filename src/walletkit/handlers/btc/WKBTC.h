@@ -169,6 +169,10 @@ wkWalletRemResolvedAsBTC (WKWallet wallet,
 
 typedef struct WKWalletManagerBTCRecord {
     struct WKWalletManagerRecord base;
+
+    /// The number of internal and external chain addresses last saved to the fileService;
+    /// indexed by SEQUENCE_EXTERNAL_CHAIN and SEQUENCE_INTERNAL_CHAIN.
+    size_t addressChainCountsSaved[2];
 } *WKWalletManagerBTC;
 
 extern WKWalletManagerBTC
@@ -251,6 +255,7 @@ wkHashCreateAsBTC (UInt256 btc);
 extern const char *fileServiceTypeTransactionsBTC;
 extern const char *fileServiceTypeBlocksBTC;
 extern const char *fileServiceTypePeersBTC;
+extern const char *fileServiceTypeAddressChainsBTC;
 
 extern size_t fileServiceSpecificationsCountBTC;
 extern BRFileServiceTypeSpecification *fileServiceSpecificationsBTC;
@@ -259,6 +264,24 @@ extern BRArrayOf(BRBitcoinTransaction*) initialTransactionsLoadBTC (WKWalletMana
 extern BRArrayOf(BRBitcoinPeer)         initialPeersLoadBTC        (WKWalletManager manager);
 extern BRArrayOf(BRBitcoinMerkleBlock*) initialBlocksLoadBTC       (WKWalletManager manager);
 
+/// Load the internal and external chain pubKey hashes previously saved for `mpk`; a chain that
+/// was never saved is returned as NULL.  The arrays are owned by the caller.
+extern void
+initialAddressChainsLoadBTC (WKWalletManager manager,
+                             BRMasterPubKey mpk,
+                             BRArrayOf(UInt160) *internalChain,
+                             BRArrayOf(UInt160) *externalChain);
+
+/// Save the pubKey hashes of `mpk`'s `chain`, given that the first `pkhsCountSaved` of them are
+/// already saved.  Only the saved segments holding hashes past `pkhsCountSaved` are rewritten.
+extern void
+addressChainSaveBTC (WKWalletManager manager,
+                     BRMasterPubKey mpk,
+                     uint32_t chain,
+                     OwnershipKept const UInt160 *pkhs,
+                     size_t pkhsCount,
+                     size_t pkhsCountSaved);
+
 #ifdef __cplusplus
 }
 #endif
@@ -82,6 +82,7 @@ crytpWalletManagerCreateFileServiceBTC (WKWalletManager manager,
                                         BRFileServiceContext context,
                                         BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     fileServiceSpecificationsCountBTC,
                                                     fileServiceSpecificationsBTC);
@@ -118,7 +119,8 @@ wkWalletManagerSignTransactionWithKeyBTC (WKWalletManager manager,
     BRKey         *btcKey          = wkKeyGetCore (key);
     const BRBitcoinChainParams *btcParams = wkNetworkAsBTC  (manager->network);
 
-    return AS_WK_BOOLEAN (1 == btcTransactionSign (btcTransaction, btcParams->forkId, btcKey, 1));
+    // Signing with a key is for sweeps, which can spend many inputs; sign them on all processors
+    return AS_WK_BOOLEAN (1 == btcTransactionSignParallel (btcTransaction, btcParams->forkId, btcKey, 1, 0));
 }
 
 static WKAmount
@@ -257,6 +259,50 @@ wkWalletManagerGetMPK (WKWalletManager manager) {
                                             manager->type));
 }
 
+// The number of `saved` pubKey hashes that `wid` actually used for `chain`: all of them, or none if
+// the btcWallet ignored `saved` as not matching its master public key.
+static size_t
+wkWalletManagerAddressChainCountUsedBTC (BRBitcoinWallet *wid,
+                                         uint32_t chain,
+                                         BRArrayOf(UInt160) saved) {
+    size_t savedCount = (NULL == saved ? 0 : array_count (saved));
+    if (0 == savedCount) return 0;
+
+    size_t pkhsCount = btcWalletChainPKHs (wid, NULL, 0, chain);
+    if (pkhsCount < savedCount) return 0;
+
+    UInt160 *pkhs = calloc (pkhsCount, sizeof (UInt160));
+    btcWalletChainPKHs (wid, pkhs, pkhsCount, chain);
+    int used = (0 == memcmp (pkhs, saved, savedCount * sizeof (UInt160)));
+    free (pkhs);
+
+    return used ? savedCount : 0;
+}
+
+// Save any chain that has grown since last saved.  The chains only ever grow, so the saved count
+// is enough to tell which of the saved pubKey hashes are stale.
+static void
+wkWalletManagerSaveAddressChainsBTC (WKWalletManagerBTC manager,
+                                     BRBitcoinWallet *wid) {
+    uint32_t chains[] = { SEQUENCE_EXTERNAL_CHAIN, SEQUENCE_INTERNAL_CHAIN };
+
+    for (size_t index = 0; index < sizeof (chains) / sizeof (chains[0]); index++) {
+        uint32_t chain = chains[index];
+
+        size_t pkhsCount = btcWalletChainPKHs (wid, NULL, 0, chain);
+        if (pkhsCount <= manager->addressChainCountsSaved[chain]) continue;
+
+        UInt160 *pkhs = calloc (pkhsCount, sizeof (UInt160));
+        pkhsCount = btcWalletChainPKHs (wid, pkhs, pkhsCount, chain);
+
+        addressChainSaveBTC (&manager->base, wkWalletManagerGetMPK (&manager->base), chain,
+                             pkhs, pkhsCount, manager->addressChainCountsSaved[chain]);
+        manager->addressChainCountsSaved[chain] = pkhsCount;
+
+        free (pkhs);
+    }
+}
+
 static WKWallet
 wkWalletManagerCreateWalletBTC (WKWalletManager manager,
                                 WKCurrency currency,
@@ -275,17 +321,38 @@ wkWalletManagerCreateWalletBTC (WKWalletManager manager,
 
     BRArrayOf(BRBitcoinTransaction*) transactions = initialTransactionsLoadBTC(manager);
 
+    // Load the previously derived address chains, if any, so that only addresses past their end
+    // need to be derived from `btcMPK`.
+    BRArrayOf(UInt160) internalChain;
+    BRArrayOf(UInt160) externalChain;
+    initialAddressChainsLoadBTC (manager, btcMPK, &internalChain, &externalChain);
+
     // Create the BTC wallet
     //
     // Since the BRBitcoinWallet callbacks are not set, none of these transactions generate callbacks.
     // And, in fact, looking at btcWalletNew(), there is not even an attempt to generate callbacks
     // even if they could have been specified.
-    BRBitcoinWallet *btcWallet = btcWalletNew (btcChainParams->addrParams, transactions, array_count(transactions), btcMPK);
+    BRBitcoinWallet *btcWallet = btcWalletNewWithChains (btcChainParams->addrParams,
+                                                         transactions, array_count(transactions),
+                                                         btcMPK,
+                                                         internalChain, (NULL == internalChain ? 0 : array_count (internalChain)),
+                                                         externalChain, (NULL == externalChain ? 0 : array_count (externalChain)));
     assert (NULL != btcWallet);
 
     // The btcWallet now should include *all* the transactions
     array_free (transactions);
 
+    // The btcWallet copied the chains; save them back if they grew or weren't usable.
+    WKWalletManagerBTC managerBTC = wkWalletManagerCoerceBTC (manager, manager->type);
+    managerBTC->addressChainCountsSaved[SEQUENCE_INTERNAL_CHAIN] =
+        wkWalletManagerAddressChainCountUsedBTC (btcWallet, SEQUENCE_INTERNAL_CHAIN, internalChain);
+    managerBTC->addressChainCountsSaved[SEQUENCE_EXTERNAL_CHAIN] =
+        wkWalletManagerAddressChainCountUsedBTC (btcWallet, SEQUENCE_EXTERNAL_CHAIN, externalChain);
+    if (NULL != internalChain) array_free (internalChain);
+    if (NULL != externalChain) array_free (externalChain);
+
+    wkWalletManagerSaveAddressChainsBTC (managerBTC, btcWallet);
+
     // Set the callbacks
     btcWalletSetCallbacks (btcWallet,
                           wkWalletManagerCoerceBTC(manager, manager->network->type),
@@ -540,6 +607,9 @@ static void wkWalletManagerBTCTxAdded   (void *info, BRBitcoinTransaction *tid)
     // Save `tid` to the fileService.
     fileServiceSave (manager->base.fileService, fileServiceTypeTransactionsBTC, tid);
 
+    // Registering `tid` may have extended the address chains; save them too.
+    wkWalletManagerSaveAddressChainsBTC (manager, wid);
+
     // If `tid` is not resolved in `wid`, then add it as unresolved to `wid` and skip out.
     if (!btcWalletTransactionIsResolved (wid, tid)) {
         printf ("BTC: TxAdded  : %s (Not Resolved)\n", u256hex(UInt256Reverse(tid->txHash)));
@@ -635,6 +705,9 @@ static void wkWalletManagerBTCTxUpdated (void *info,
 
     WKWallet wallet = manager->base.wallet;
 
+    // Save all the modified `tid`s in a single DB transaction
+    fileServiceBeginBatch (manager->base.fileService);
+
     for (size_t index = 0; index < count; index++) {
         // TODO: This is here to allow events to flow; otherwise we'd block for too long??
         pthread_mutex_lock (&manager->base.lock);
@@ -681,6 +754,8 @@ static void wkWalletManagerBTCTxUpdated (void *info,
         pthread_mutex_unlock (&manager->base.lock);
     }
 
+    fileServiceCommitBatch (manager->base.fileService);
+
     pthread_mutex_lock (&manager->base.lock);
     // Find other transations in `wallet` that are now resolved.
     size_t resolvedTransactionsCount = wkWalletRemResolvedAsBTC (wallet, NULL, 0);
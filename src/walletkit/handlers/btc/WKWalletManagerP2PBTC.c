@@ -351,8 +351,7 @@ static void wkWalletManagerBTCSaveBlocks (void *info, int replace, BRBitcoinMerk
         fileServiceReplace (manager->base.fileService, fileServiceTypeBlocksBTC, (const void **) blocks, count);
     }
     else {
-        for (size_t index = 0; index < count; index++)
-            fileServiceSave (manager->base.fileService, fileServiceTypeBlocksBTC, blocks[index]);
+        fileServiceSaveMany (manager->base.fileService, fileServiceTypeBlocksBTC, (const void **) blocks, count);
     }
 }
 
@@ -361,27 +360,24 @@ static void wkWalletManagerBTCSavePeers  (void *info, int replace, const BRBitco
 
     // filesystem changes are NOT queued; they are acted upon immediately
 
-    if (!replace) {
-        // save each peer, one-by-one
-        for (size_t index = 0; index < count; index++)
-            fileServiceSave (manager->base.fileService, fileServiceTypePeersBTC, &peers[index]);
-    }
-
-    else if (0 == count) {
+    if (replace && 0 == count) {
         // no peers to set, just do a clear
         fileServiceClear (manager->base.fileService, fileServiceTypePeersBTC);
     }
 
-    else {
-        // fileServiceReplace expects an array of pointers to entities, instead of an array of
-        // structures so let's do the conversion here
+    else if (0 != count) {
+        // fileServiceSaveMany and fileServiceReplace expect an array of pointers to entities,
+        // instead of an array of structures so let's do the conversion here
         const BRBitcoinPeer **peerRefs = calloc (count, sizeof(BRBitcoinPeer *));
 
         for (size_t i = 0; i < count; i++) {
             peerRefs[i] = &peers[i];
         }
 
-        fileServiceReplace (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
+        if (replace)
+            fileServiceReplace  (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
+        else
+            fileServiceSaveMany (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
         free (peerRefs);
     }
 }
@@ -293,6 +293,216 @@ initialPeersLoadBTC (WKWalletManager manager) {
     return peers;
 }
 
+/// MARK: - Address Chain File Service
+
+#define FILE_SERVICE_TYPE_ADDRESS_CHAIN     "address_chains"
+
+enum {
+    FILE_SERVICE_TYPE_ADDRESS_CHAIN_VERSION_1
+};
+
+// A segment of the pubKey hashes derived for one chain (internal or external) of one master public
+// key.  The hashes are persisted so that a restarted wallet need only derive addresses past the
+// chain's end.  A chain is saved as fixed-size segments so that, as the chain grows, only its last
+// segment and any new ones need to be written.
+typedef struct {
+    uint32_t fingerPrint;
+    uint32_t chain;
+    uint32_t segment;
+    size_t pkhsCount;
+    UInt160 *pkhs;
+} WKAddressChainBTC;
+
+#define ADDRESS_CHAIN_SEGMENT_SIZE      (100)
+#define ADDRESS_CHAIN_HEADER_SIZE       (4 * sizeof (uint32_t))
+
+static UInt256
+addressChainIdentifierBTC (uint32_t fingerPrint, uint32_t chain, uint32_t segment) {
+    uint8_t bytes[3 * sizeof (uint32_t)];
+    UInt32SetLE (&bytes[0],                     fingerPrint);
+    UInt32SetLE (&bytes[1 * sizeof (uint32_t)], chain);
+    UInt32SetLE (&bytes[2 * sizeof (uint32_t)], segment);
+
+    UInt256 hash;
+    BRSHA256 (&hash, bytes, sizeof (bytes));
+    return hash;
+}
+
+static void
+addressChainReleaseBTC (WKAddressChainBTC *addressChain) {
+    free (addressChain->pkhs);
+    free (addressChain);
+}
+
+static int
+addressChainSegmentCompareBTC (const void *one, const void *two) {
+    const WKAddressChainBTC *chain1 = *((const WKAddressChainBTC **) one);
+    const WKAddressChainBTC *chain2 = *((const WKAddressChainBTC **) two);
+    return (chain1->segment < chain2->segment ? -1 : (chain1->segment > chain2->segment ? 1 : 0));
+}
+
+static UInt256
+fileServiceTypeAddressChainV1Identifier (BRFileServiceContext context,
+                                         BRFileService fs,
+                                         const void *entity) {
+    const WKAddressChainBTC *addressChain = entity;
+    return addressChainIdentifierBTC (addressChain->fingerPrint, addressChain->chain, addressChain->segment);
+}
+
+static uint8_t *
+fileServiceTypeAddressChainV1Writer (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     const void* entity,
+                                     uint32_t *bytesCount) {
+    const WKAddressChainBTC *addressChain = entity;
+    size_t offset = 0;
+
+    *bytesCount = (uint32_t) (ADDRESS_CHAIN_HEADER_SIZE + addressChain->pkhsCount * sizeof (UInt160));
+    uint8_t *bytes = malloc (*bytesCount);
+
+    UInt32SetLE (&bytes[offset], addressChain->fingerPrint);
+    offset += sizeof (uint32_t);
+
+    UInt32SetLE (&bytes[offset], addressChain->chain);
+    offset += sizeof (uint32_t);
+
+    UInt32SetLE (&bytes[offset], addressChain->segment);
+    offset += sizeof (uint32_t);
+
+    UInt32SetLE (&bytes[offset], (uint32_t) addressChain->pkhsCount);
+    offset += sizeof (uint32_t);
+
+    memcpy (&bytes[offset], addressChain->pkhs, addressChain->pkhsCount * sizeof (UInt160));
+
+    return bytes;
+}
+
+static void *
+fileServiceTypeAddressChainV1Reader (BRFileServiceContext context,
+                                     BRFileService fs,
+                                     uint8_t *bytes,
+                                     uint32_t bytesCount) {
+    if (bytesCount < ADDRESS_CHAIN_HEADER_SIZE) return NULL;
+
+    size_t pkhsCount = UInt32GetLE (&bytes[3 * sizeof (uint32_t)]);
+    if (pkhsCount > ADDRESS_CHAIN_SEGMENT_SIZE ||
+        bytesCount != ADDRESS_CHAIN_HEADER_SIZE + pkhsCount * sizeof (UInt160)) return NULL;
+
+    WKAddressChainBTC *addressChain = calloc (1, sizeof (WKAddressChainBTC));
+
+    addressChain->fingerPrint = UInt32GetLE (&bytes[0]);
+    addressChain->chain       = UInt32GetLE (&bytes[1 * sizeof (uint32_t)]);
+    addressChain->segment     = UInt32GetLE (&bytes[2 * sizeof (uint32_t)]);
+    addressChain->pkhsCount   = pkhsCount;
+    addressChain->pkhs        = calloc (pkhsCount > 0 ? pkhsCount : 1, sizeof (UInt160));
+
+    memcpy (addressChain->pkhs, &bytes[ADDRESS_CHAIN_HEADER_SIZE], pkhsCount * sizeof (UInt160));
+
+    return addressChain;
+}
+
+typedef struct {
+    uint32_t fingerPrint;
+    BRArrayOf(WKAddressChainBTC*) segments[2];  // indexed by SEQUENCE_{EXTERNAL,INTERNAL}_CHAIN
+} WKAddressChainLoadContextBTC;
+
+static int
+addressChainLoadHandlerBTC (BRFileServiceContext context,
+                            BRFileService fs,
+                            const char *type,
+                            void *entity) {
+    WKAddressChainLoadContextBTC *load = context;
+    WKAddressChainBTC *addressChain    = entity;
+
+    if (addressChain->fingerPrint == load->fingerPrint &&
+        (SEQUENCE_INTERNAL_CHAIN == addressChain->chain || SEQUENCE_EXTERNAL_CHAIN == addressChain->chain))
+        array_add (load->segments[addressChain->chain], addressChain);
+    else
+        addressChainReleaseBTC (addressChain);
+
+    return 1;
+}
+
+// Join `segments` into a chain; the chain ends at the first missing segment or the first segment
+// that is not full.  Returns NULL if there is no segment 0.  Releases `segments`.
+static BRArrayOf(UInt160)
+addressChainJoinSegmentsBTC (BRArrayOf(WKAddressChainBTC*) segments) {
+    BRArrayOf(UInt160) pkhs = NULL;
+    size_t segmentsCount = array_count (segments);
+
+    qsort (segments, segmentsCount, sizeof (WKAddressChainBTC*), addressChainSegmentCompareBTC);
+
+    for (size_t index = 0; index < segmentsCount && index == segments[index]->segment; index++) {
+        if (NULL == pkhs) array_new (pkhs, segmentsCount * ADDRESS_CHAIN_SEGMENT_SIZE);
+        array_add_array (pkhs, segments[index]->pkhs, segments[index]->pkhsCount);
+        if (ADDRESS_CHAIN_SEGMENT_SIZE != segments[index]->pkhsCount) break;
+    }
+
+    for (size_t index = 0; index < segmentsCount; index++)
+        addressChainReleaseBTC (segments[index]);
+    array_free (segments);
+
+    return pkhs;
+}
+
+extern void
+initialAddressChainsLoadBTC (WKWalletManager manager,
+                             BRMasterPubKey mpk,
+                             BRArrayOf(UInt160) *internalChain,
+                             BRArrayOf(UInt160) *externalChain) {
+    *internalChain = NULL;
+    *externalChain = NULL;
+
+    WKAddressChainLoadContextBTC load = { mpk.fingerPrint, { NULL, NULL } };
+    array_new (load.segments[SEQUENCE_EXTERNAL_CHAIN], 10);
+    array_new (load.segments[SEQUENCE_INTERNAL_CHAIN], 10);
+
+    int success = fileServiceLoadIterate (manager->fileService, fileServiceTypeAddressChainsBTC, 1,
+                                          &load, addressChainLoadHandlerBTC);
+
+    *internalChain = addressChainJoinSegmentsBTC (load.segments[SEQUENCE_INTERNAL_CHAIN]);
+    *externalChain = addressChainJoinSegmentsBTC (load.segments[SEQUENCE_EXTERNAL_CHAIN]);
+
+    if (1 != success) {
+        if (NULL != *internalChain) { array_free (*internalChain); *internalChain = NULL; }
+        if (NULL != *externalChain) { array_free (*externalChain); *externalChain = NULL; }
+        _peer_log ("BWM: %4s: failed to load address chains",
+                   wkNetworkTypeGetCurrencyCode (manager->type));
+        return;
+    }
+
+    _peer_log ("BWM: %4s: loaded %4zu internal, %4zu external addresses\n",
+               wkNetworkTypeGetCurrencyCode (manager->type),
+               (NULL == *internalChain ? 0 : array_count (*internalChain)),
+               (NULL == *externalChain ? 0 : array_count (*externalChain)));
+}
+
+extern void
+addressChainSaveBTC (WKWalletManager manager,
+                     BRMasterPubKey mpk,
+                     uint32_t chain,
+                     OwnershipKept const UInt160 *pkhs,
+                     size_t pkhsCount,
+                     size_t pkhsCountSaved) {
+    // Segments before the one holding `pkhsCountSaved` are full and unchanged.
+    for (size_t start = (pkhsCountSaved / ADDRESS_CHAIN_SEGMENT_SIZE) * ADDRESS_CHAIN_SEGMENT_SIZE;
+         start < pkhsCount;
+         start += ADDRESS_CHAIN_SEGMENT_SIZE) {
+        size_t count = (pkhsCount - start < ADDRESS_CHAIN_SEGMENT_SIZE
+                        ? pkhsCount - start
+                        : ADDRESS_CHAIN_SEGMENT_SIZE);
+
+        WKAddressChainBTC addressChain = {
+            mpk.fingerPrint,
+            chain,
+            (uint32_t) (start / ADDRESS_CHAIN_SEGMENT_SIZE),
+            count,
+            (UInt160 *) &pkhs[start]
+        };
+        fileServiceSave (manager->fileService, fileServiceTypeAddressChainsBTC, &addressChain);
+    }
+}
+
 ///
 /// For BTC, the FileService DOES NOT save WKClientTransactionBundles; instead BTC saves
 /// BRBitcoinTransaction.  This allows the P2P mode to work seamlessly as P2P mode has zero knowledge of
@@ -342,12 +552,27 @@ static BRFileServiceTypeSpecification fileServiceSpecificationsArrayBTC[] = {
                 fileServiceTypePeerV1Writer
             }
         }
+    },
+
+    {
+        FILE_SERVICE_TYPE_ADDRESS_CHAIN,
+        FILE_SERVICE_TYPE_ADDRESS_CHAIN_VERSION_1,
+        1,
+        {
+            {
+                FILE_SERVICE_TYPE_ADDRESS_CHAIN_VERSION_1,
+                fileServiceTypeAddressChainV1Identifier,
+                fileServiceTypeAddressChainV1Reader,
+                fileServiceTypeAddressChainV1Writer
+            }
+        }
     }
 };
 
-const char *fileServiceTypeTransactionsBTC = FILE_SERVICE_TYPE_TRANSACTION;
-const char *fileServiceTypeBlocksBTC       = FILE_SERVICE_TYPE_BLOCK;
-const char *fileServiceTypePeersBTC        = FILE_SERVICE_TYPE_PEER;
+const char *fileServiceTypeTransactionsBTC  = FILE_SERVICE_TYPE_TRANSACTION;
+const char *fileServiceTypeBlocksBTC        = FILE_SERVICE_TYPE_BLOCK;
+const char *fileServiceTypePeersBTC         = FILE_SERVICE_TYPE_PEER;
+const char *fileServiceTypeAddressChainsBTC = FILE_SERVICE_TYPE_ADDRESS_CHAIN;
 
 size_t fileServiceSpecificationsCountBTC = sizeof(fileServiceSpecificationsArrayBTC)/sizeof(BRFileServiceTypeSpecification);
 BRFileServiceTypeSpecification *fileServiceSpecificationsBTC = fileServiceSpecificationsArrayBTC;
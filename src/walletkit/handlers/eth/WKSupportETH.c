@@ -36,17 +36,9 @@ wkHashAsETH (WKHash hash) {
 private_extern WKCurrency
 wkNetworkGetCurrencyforTokenETH (WKNetwork network,
                                      BREthereumToken token) {
-    WKCurrency tokenCurrency = NULL;
-    pthread_mutex_lock (&network->lock);
-    for (size_t index = 0; index < array_count(network->associations); index++) {
-        WKCurrency currency = network->associations[index].currency;
-        const char *address = wkCurrencyGetIssuer (currency);
-
-        if (NULL != address && ETHEREUM_BOOLEAN_IS_TRUE (ethTokenHasAddress (token, address))) {
-            tokenCurrency = wkCurrencyTake (currency);
-            break;
-        }
-    }
-    pthread_mutex_unlock (&network->lock);
-    return tokenCurrency;
+    // Look up the token's parsed address, not its string as given; the issuer index matches an
+    // address by its hex digits, whatever their case.
+    char address[ADDRESS_ENCODED_CHARS];
+    ethAddressFillEncodedString (ethTokenGetAddressRaw (token), 0, address);
+    return wkNetworkGetCurrencyForIssuer (network, address);
 }
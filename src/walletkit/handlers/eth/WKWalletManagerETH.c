@@ -144,6 +144,7 @@ wkWalletManagerCreateFileServiceETH (WKWalletManager manager,
                                          BRFileServiceContext context,
                                          BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     wkFileServiceSpecificationsCount,
                                                     wkFileServiceSpecifications);
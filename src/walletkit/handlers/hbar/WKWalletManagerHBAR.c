@@ -67,6 +67,7 @@ crytpWalletManagerCreateFileServiceHBAR (WKWalletManager manager,
                                          BRFileServiceContext context,
                                          BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     wkFileServiceSpecificationsCount,
                                                     wkFileServiceSpecifications);
@@ -67,6 +67,7 @@ crytpWalletManagerCreateFileServiceXLM (WKWalletManager manager,
                                          BRFileServiceContext context,
                                          BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     wkFileServiceSpecificationsCount,
                                                     wkFileServiceSpecifications);
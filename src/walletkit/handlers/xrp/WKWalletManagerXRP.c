@@ -75,6 +75,7 @@ crytpWalletManagerCreateFileServiceXRP (WKWalletManager manager,
                                         BRFileServiceContext context,
                                         BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     wkFileServiceSpecificationsCount,
                                                     wkFileServiceSpecifications);
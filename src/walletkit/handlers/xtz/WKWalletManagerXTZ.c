@@ -71,6 +71,7 @@ crytpWalletManagerCreateFileServiceXTZ (WKWalletManager manager,
                                         BRFileServiceContext context,
                                         BRFileServiceErrorHandler handler) {
     return fileServiceCreateFromTypeSpecifications (basePath, currency, network,
+                                                    &fileServiceDurabilityProfileWAL,
                                                     context, handler,
                                                     wkFileServiceSpecificationsCount,
                                                     wkFileServiceSpecifications);